@@ -33,6 +33,7 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 #define ICA_EXPORT __attribute__((__visibility__("default")))
 #define ICA_DEPRECATED __attribute__((deprecated))
@@ -514,6 +515,40 @@ void ica_set_offload_mode(int offload_mode);
 ICA_EXPORT
 void ica_set_stats_mode(int stats_mode);
 
+/**
+ * Environment variable for setting libica drbg thread mode.
+ * By default all threads draw their random bytes from one shared drbg
+ * instance. If this environment variable is defined to be an integer not
+ * equal to zero, every thread uses its own instances.
+ */
+#define ICA_DRBG_THREAD_ENV "LIBICA_DRBG_THREAD_MODE"
+
+/**
+ * Set libica drbg thread mode.
+ * If this function is called with drbg_thread_mode != 0,
+ * ica_random_number_generate() and the library-internal random number
+ * generation use a drbg instance per thread instead of the shared ones,
+ * so that concurrent requests do not serialize on a lock. The instances
+ * are instantiated on first use, each seeded independently from the same
+ * entropy source, and reseeded in a child process after fork().
+ */
+ICA_EXPORT
+void ica_set_drbg_thread_mode(int drbg_thread_mode);
+
+/**
+ * Initialize libica.
+ * Loading libica only detects the available CPACF functions. The shared
+ * memory segment for statistics, the crypto card scan, the function list
+ * and the internal random number generators are set up when they are
+ * first needed. Applications that want to pay these costs up front, e.g.
+ * before entering a latency sensitive phase, may call this function.
+ * Calling it more than once is harmless.
+ *
+ * @return 0
+ */
+ICA_EXPORT
+int ica_init(void);
+
 /**
  * Opens the specified adapter
  * @param adapter_handle Pointer to the file descriptor for the adapter or
@@ -911,6 +946,385 @@ unsigned int ica_shake_256(unsigned int message_part,
 			unsigned char *output_data,
 			unsigned int output_length);
 
+/**
+ * Hash num independent, complete messages with SHA-256, SHA-512 or
+ * SHA3-256.
+ *
+ * This is meant for many short messages, e.g. the leaves of a hash tree:
+ * no contexts are involved, every message is hashed with a single
+ * instruction (or, without CPACF support, by software that hashes several
+ * SHA3-256 messages at once), and the batch is accounted in the
+ * statistics with one update.
+ *
+ * @param num
+ * Number of messages, must be greater than zero.
+ * @param input_data
+ * Array of num pointers to the messages. A pointer may only be NULL if the
+ * length of its message is zero.
+ * @param input_length
+ * Array of num message lengths in bytes.
+ * @param output_data
+ * Array of num pointers to buffers of SHA256_HASH_LENGTH,
+ * SHA512_HASH_LENGTH or SHA3_256_HASH_LENGTH bytes that receive the
+ * digests.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENODEV if the hash function is neither supported by CPACF nor by
+ * software fallbacks
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+unsigned int ica_sha256_multi(unsigned int num,
+			      const unsigned char *const input_data[],
+			      const size_t input_length[],
+			      unsigned char *const output_data[]);
+
+ICA_EXPORT
+unsigned int ica_sha512_multi(unsigned int num,
+			      const unsigned char *const input_data[],
+			      const size_t input_length[],
+			      unsigned char *const output_data[]);
+
+ICA_EXPORT
+unsigned int ica_sha3_256_multi(unsigned int num,
+				const unsigned char *const input_data[],
+				const size_t input_length[],
+				unsigned char *const output_data[]);
+
+typedef struct ica_hash_ctx ica_hash_ctx_t;
+
+/**
+ * Create a streaming hash context.
+ *
+ * Unlike the ica_sha* functions, a hash context accepts data of any
+ * length in every update. Incomplete blocks are buffered in the context,
+ * complete blocks are hashed directly from the caller's buffer.
+ *
+ * @param alg
+ * One of SHA1, SHA224, SHA256, SHA384, SHA512, SHA3_224, SHA3_256,
+ * SHA3_384 or SHA3_512.
+ * @param ctx
+ * Pointer to the address of the new context. Release it with
+ * ica_hash_ctx_free().
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENOMEM if memory allocation fails
+ */
+ICA_EXPORT
+int ica_hash_ctx_new(unsigned int alg, ica_hash_ctx_t **ctx);
+
+/**
+ * Discard all data passed to the context and start a new message.
+ * ica_hash_final() does this implicitly.
+ *
+ * @return 0 if successful.
+ * EINVAL if ctx is NULL
+ */
+ICA_EXPORT
+int ica_hash_init(ica_hash_ctx_t *ctx);
+
+/**
+ * Add data_length bytes to the message. data may only be NULL if
+ * data_length is zero.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENODEV if the hash function is neither supported by CPACF nor by
+ * software fallbacks
+ * EIO if the operation fails. This should never happen.
+ * The context must be reinitialized with ica_hash_init() after an error.
+ */
+ICA_EXPORT
+int ica_hash_update(ica_hash_ctx_t *ctx, const unsigned char *data,
+		    uint64_t data_length);
+
+/**
+ * Add the iovcnt buffers described by iov to the message, in order.
+ *
+ * @return see ica_hash_update()
+ */
+ICA_EXPORT
+int ica_hash_updatev(ica_hash_ctx_t *ctx, const struct iovec *iov,
+		     unsigned int iovcnt);
+
+/**
+ * Complete the message and write its digest to digest, which must hold
+ * the hash length of the algorithm, e.g. SHA256_HASH_LENGTH. The context
+ * is reinitialized for the next message.
+ *
+ * @return see ica_hash_update()
+ */
+ICA_EXPORT
+int ica_hash_final(ica_hash_ctx_t *ctx, unsigned char *digest);
+
+/**
+ * Copy the state of src to dst, e.g. to hash several messages sharing a
+ * common prefix. dst may have been created for any algorithm, it takes
+ * over the algorithm of src.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ */
+ICA_EXPORT
+int ica_hash_ctx_copy(ica_hash_ctx_t *dst, const ica_hash_ctx_t *src);
+
+/**
+ * Free a hash context. ctx may be NULL.
+ */
+ICA_EXPORT
+void ica_hash_ctx_free(ica_hash_ctx_t *ctx);
+
+typedef struct ica_hmac_ctx ica_hmac_ctx_t;
+
+/**
+ * Create an HMAC context (RFC 2104) for a key.
+ *
+ * The hash states after the inner and outer key blocks are computed here
+ * once, so a MAC only costs the hashing of the message plus one block for
+ * the outer hash. A context can be used for any number of messages.
+ *
+ * @param alg
+ * The underlying hash function. One of SHA1, SHA224, SHA256, SHA384,
+ * SHA512, SHA3_224, SHA3_256, SHA3_384 or SHA3_512.
+ * @param key
+ * The key. Keys longer than the block length of the hash function are
+ * hashed first.
+ * @param key_length
+ * Length of the key in bytes.
+ * @param ctx
+ * Pointer to the address of the new context. Release it with
+ * ica_hmac_ctx_free().
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENOMEM if memory allocation fails
+ * ENODEV if the hash function is neither supported by CPACF nor by
+ * software fallbacks
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+int ica_hmac_ctx_new(unsigned int alg, const unsigned char *key,
+		     size_t key_length, ica_hmac_ctx_t **ctx);
+
+/**
+ * Discard all data of the current message.
+ *
+ * @return 0 if successful.
+ * EINVAL if ctx is NULL
+ */
+ICA_EXPORT
+int ica_hmac_init(ica_hmac_ctx_t *ctx);
+
+/**
+ * Add data_length bytes to the message. data may only be NULL if
+ * data_length is zero.
+ *
+ * @return see ica_hash_update()
+ */
+ICA_EXPORT
+int ica_hmac_update(ica_hmac_ctx_t *ctx, const unsigned char *data,
+		    uint64_t data_length);
+
+/**
+ * Complete the message and write the MAC to mac, which must hold the hash
+ * length of the algorithm. The context is ready for the next message.
+ *
+ * @return see ica_hash_update()
+ */
+ICA_EXPORT
+int ica_hmac_final(ica_hmac_ctx_t *ctx, unsigned char *mac);
+
+/**
+ * Compute the MAC of a complete message, i.e. ica_hmac_update() and
+ * ica_hmac_final() in one call.
+ *
+ * @return see ica_hash_update()
+ */
+ICA_EXPORT
+int ica_hmac(ica_hmac_ctx_t *ctx, const unsigned char *data,
+	     uint64_t data_length, unsigned char *mac);
+
+/**
+ * Free an HMAC context and wipe the key material. ctx may be NULL.
+ */
+ICA_EXPORT
+void ica_hmac_ctx_free(ica_hmac_ctx_t *ctx);
+
+/**
+ * Derive a key from a password with PBKDF2 (RFC 8018) and HMAC.
+ *
+ * The HMAC pad states are computed once per password. With CPACF every
+ * iteration then takes one KLMD for the inner and one for the outer hash.
+ * The software fallback for HMAC-SHA-3 computes up to four output blocks
+ * of dk at once.
+ *
+ * @param alg
+ * The underlying hash function, see ica_hmac_ctx_new().
+ * @param password
+ * The password, may only be NULL if password_length is zero.
+ * @param salt
+ * The salt, may only be NULL if salt_length is zero.
+ * @param iterations
+ * The iteration count, must be greater than zero.
+ * @param dk
+ * Buffer for the derived key of dk_length bytes.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENODEV if the hash function is neither supported by CPACF nor by
+ * software fallbacks
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+int ica_pbkdf2(unsigned int alg, const unsigned char *password,
+	       size_t password_length, const unsigned char *salt,
+	       size_t salt_length, uint64_t iterations, unsigned char *dk,
+	       size_t dk_length);
+
+/**
+ * Derive a key with HKDF (RFC 5869), i.e. extract and expand.
+ *
+ * @param alg
+ * The underlying hash function, see ica_hmac_ctx_new().
+ * @param ikm
+ * The input keying material, may only be NULL if ikm_length is zero.
+ * @param salt
+ * The salt. If salt is NULL or salt_length is zero, a string of zeros of
+ * the hash length is used.
+ * @param info
+ * Context information, may only be NULL if info_length is zero.
+ * @param okm
+ * Buffer for the output keying material of okm_length bytes, at most 255
+ * times the hash length.
+ *
+ * @return see ica_pbkdf2()
+ */
+ICA_EXPORT
+int ica_hkdf(unsigned int alg, const unsigned char *ikm, size_t ikm_length,
+	     const unsigned char *salt, size_t salt_length,
+	     const unsigned char *info, size_t info_length,
+	     unsigned char *okm, size_t okm_length);
+
+/**
+ * Compute ParallelHash128 (NIST SP 800-185). The message is split into
+ * blocks of block_size bytes, which are hashed independently and spread
+ * over several threads. The chaining values are then hashed by cSHAKE128.
+ *
+ * KangarooTwelve is not offered: it uses a reduced-round permutation that
+ * cannot be computed by CPACF.
+ *
+ * @param data
+ * The message, may only be NULL if data_length is zero.
+ * @param block_size
+ * The block size B in bytes, must be greater than zero.
+ * @param custom
+ * The customization string S, may only be NULL if custom_length is zero.
+ * @param output
+ * Buffer for output_length bytes of output, output_length must be greater
+ * than zero.
+ * @param threads
+ * Maximum number of threads used, the calling thread included. Zero
+ * selects a default. The other threads are taken from the worker pool
+ * described at ica_rsa_mod_expo_batch().
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENOMEM if memory allocation fails
+ * ENODEV if SHAKE is neither supported by CPACF nor by software fallbacks
+ * EACCES if SHAKE is not supported by CPACF in FIPS mode
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+int ica_parallelhash128(const unsigned char *data, uint64_t data_length,
+			size_t block_size, const unsigned char *custom,
+			size_t custom_length, unsigned char *output,
+			size_t output_length, unsigned int threads);
+
+/**
+ * Compute ParallelHash256 (NIST SP 800-185), see ica_parallelhash128().
+ */
+ICA_EXPORT
+int ica_parallelhash256(const unsigned char *data, uint64_t data_length,
+			size_t block_size, const unsigned char *custom,
+			size_t custom_length, unsigned char *output,
+			size_t output_length, unsigned int threads);
+
+typedef struct ica_xof_ctx ica_xof_ctx_t;
+
+/**
+ * Create a SHAKE context for output of arbitrary length.
+ *
+ * Data is absorbed with ica_xof_absorb(). The first call of
+ * ica_xof_squeeze() completes the message; it and any later calls then
+ * return consecutive parts of one output stream of unlimited length, so
+ * the output need not be known in advance.
+ *
+ * @param alg
+ * SHAKE128 or SHAKE256.
+ * @param ctx
+ * Pointer to the address of the new context. Release it with
+ * ica_xof_ctx_free().
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * ENOMEM if memory allocation fails
+ * ENODEV if SHAKE is neither supported by CPACF nor by software fallbacks
+ * EACCES if SHAKE is not supported by CPACF in FIPS mode
+ */
+ICA_EXPORT
+int ica_xof_ctx_new(unsigned int alg, ica_xof_ctx_t **ctx);
+
+/**
+ * Discard the state of the context and start a new message.
+ *
+ * @return see ica_xof_ctx_new()
+ */
+ICA_EXPORT
+int ica_xof_init(ica_xof_ctx_t *ctx);
+
+/**
+ * Add data_length bytes to the message. data may only be NULL if
+ * data_length is zero.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given or output has already
+ * been squeezed from the context
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+int ica_xof_absorb(ica_xof_ctx_t *ctx, const unsigned char *data,
+		   uint64_t data_length);
+
+/**
+ * Write the next output_length bytes of the output stream to output.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ * EIO if the operation fails. This should never happen.
+ */
+ICA_EXPORT
+int ica_xof_squeeze(ica_xof_ctx_t *ctx, unsigned char *output,
+		    size_t output_length);
+
+/**
+ * Copy the state of src to dst, e.g. to derive several output streams
+ * from a common prefix. dst may have been created for either algorithm, it
+ * takes over the algorithm of src.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given
+ */
+ICA_EXPORT
+int ica_xof_ctx_copy(ica_xof_ctx_t *dst, const ica_xof_ctx_t *src);
+
+/**
+ * Free a SHAKE context. ctx may be NULL.
+ */
+ICA_EXPORT
+void ica_xof_ctx_free(ica_xof_ctx_t *ctx);
+
 /*******************************************************************************
  *
  *                          Begin of ECC API
@@ -1096,6 +1510,69 @@ int ica_ecdsa_verify(ica_adapter_handle_t adapter_handle,
 		const ICA_EC_KEY *pubkey, const unsigned char *hash, unsigned int hash_length,
 		const unsigned char *signature, unsigned int signature_length);
 
+typedef struct ica_ecdsa_ctx ica_ecdsa_ctx_t;
+
+/**
+ * Create a pre-parsed ECDSA key from a given ICA_EC_KEY.
+ *
+ * The key is copied and validated once: the public point is checked to be
+ * on the curve and, for a private key, to match the private value (it is
+ * derived if only D is set). The software path additionally precomputes
+ * the multiples of the curve generator. Later calls of ica_ecdsa_ctx_sign()
+ * and ica_ecdsa_ctx_verify() skip all of that. The context is read-only
+ * after creation and may be used by several threads at the same time.
+ *
+ * @param key
+ * Pointer to a readable ICA_EC_KEY object with D and/or (X,Y) set.
+ *
+ * @param ctx
+ * Pointer to where the address of the new context is placed.
+ *
+ * @return 0 if success
+ * EINVAL if at least one invalid parameter is given or the key is invalid.
+ * ENOMEM if memory allocation fails.
+ * EIO if an internal processing error occurred.
+ */
+ICA_EXPORT
+int ica_ecdsa_ctx_new(const ICA_EC_KEY *key, ica_ecdsa_ctx_t **ctx);
+
+/**
+ * Create an ECDSA signature like ica_ecdsa_sign(), with a pre-parsed key.
+ * The context must have been created from a private key.
+ *
+ * @return 0 if success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if an internal processing error occurred.
+ */
+ICA_EXPORT
+int ica_ecdsa_ctx_sign(ica_adapter_handle_t adapter_handle,
+		const ica_ecdsa_ctx_t *ctx, const unsigned char *hash,
+		unsigned int hash_length, unsigned char *signature,
+		unsigned int signature_length);
+
+/**
+ * Verify an ECDSA signature like ica_ecdsa_verify(), with a pre-parsed key.
+ *
+ * @return 0 if success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if an internal processing error occurred.
+ * EFAULT if signature invalid
+ */
+ICA_EXPORT
+int ica_ecdsa_ctx_verify(ica_adapter_handle_t adapter_handle,
+		const ica_ecdsa_ctx_t *ctx, const unsigned char *hash,
+		unsigned int hash_length, const unsigned char *signature,
+		unsigned int signature_length);
+
+/**
+ * Free an ECDSA key context. The key material is cleared.
+ *
+ * @param ctx
+ * Pointer to the context, may be NULL.
+ */
+ICA_EXPORT
+void ica_ecdsa_ctx_free(ica_ecdsa_ctx_t *ctx);
+
 /**
  * provide the public key (X,Y) of the given ICA_EC_KEY.
  *
@@ -1147,6 +1624,13 @@ typedef struct ica_x448_ctx ICA_X448_CTX;
 typedef struct ica_ed25519_ctx ICA_ED25519_CTX;
 typedef struct ica_ed448_ctx ICA_ED448_CTX;
 
+/*
+ * The following functions use MSA9 CPACF instructions if available. Otherwise
+ * they are done in software, which requires software fallbacks to be enabled
+ * (see ica_set_fallback_mode). Below, "MSA9 required" means MSA9 or
+ * enabled fallbacks.
+ */
+
 /*
  * Allocate a new context. MSA9 required.
  * Returns 0 if successful. Otherwise, -1 is returned.
@@ -1233,6 +1717,8 @@ int ica_ed448_sign(ICA_ED448_CTX *ctx, unsigned char sig[114],
 /*
  * Verify. Requires the public key. If the context only holds the private key,
  * the public key is derived. MSA9 required.
+ * Ed25519 signatures are checked with the cofactorless equation
+ * [S]B = R + [k]A, with or without MSA9.
  * Returns 0 if signature is valid. Otherwise, -1 is returned.
  */
 ICA_EXPORT
@@ -1243,7 +1729,30 @@ int ica_ed448_verify(ICA_ED448_CTX *ctx, const unsigned char sig[114],
 		     const unsigned char *msg, size_t msglen);
 
 /*
- * Delete a context. Its sensitive data is erased. MSA9 required.
+ * Verify num Ed25519 signatures at once: sig[i] (64 bytes) is checked for
+ * the message msg[i] of msglen[i] bytes and the public key pub[i] (32 bytes).
+ * If status is not NULL, status[i] is set to 0 if sig[i] is valid and to -1
+ * otherwise. MSA9 required.
+ * Without MSA9, the signatures are checked together via one randomized
+ * multi-scalar multiplication, which is much cheaper than verifying them one
+ * by one. If that check fails, the invalid signatures are identified by
+ * splitting the batch. Like ica_ed25519_verify() and KDSA, the batch uses
+ * the cofactorless verification equation [S]B = R + [k]A: signatures whose
+ * A or R has a small order component are verified one by one, so that
+ * status[i] equals the result of ica_ed25519_verify() for sig[i], for any
+ * num.
+ * Returns 0 if all signatures are valid. Otherwise, -1 is returned.
+ */
+ICA_EXPORT
+int ica_ed25519_verify_batch(unsigned int num,
+			     const unsigned char *const msg[],
+			     const size_t msglen[],
+			     const unsigned char *const sig[],
+			     const unsigned char *const pub[],
+			     int status[]);
+
+/*
+ * Delete a context. Its sensitive data is erased.
  * Returns 0 if successful. Otherwise, -1 is returned.
  */
 ICA_EXPORT
@@ -1389,6 +1898,164 @@ unsigned int ica_rsa_crt(ica_adapter_handle_t adapter_handle,
 ICA_EXPORT
 unsigned int ica_rsa_crt_key_check(ica_rsa_key_crt_t *rsa_key);
 
+typedef struct ica_rsa_key_ctx ica_rsa_key_ctx_t;
+
+/**
+ * @brief Create a pre-parsed RSA key from a key in modulus/exponent form.
+ *
+ * The key is copied, validated and converted to the internal
+ * representation once. Later operations with ica_rsa_key_ctx_compute()
+ * do not have to parse the key again. The context may be used by several
+ * threads at the same time.
+ * @param rsa_key
+ * Pointer to the key in modulus/exponent format.
+ * @param key_ctx
+ * Pointer to where the address of the new key context is placed.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given or the key is invalid.
+ * ENOMEM if memory allocation fails.
+ */
+ICA_EXPORT
+unsigned int ica_rsa_key_ctx_new_mod_expo(const ica_rsa_key_mod_expo_t *rsa_key,
+					  ica_rsa_key_ctx_t **key_ctx);
+
+/**
+ * @brief Create a pre-parsed RSA key from a key in CRT form.
+ *
+ * Like ica_rsa_key_ctx_new_mod_expo(). The copy of the key is brought into
+ * privileged form (see ica_rsa_crt_key_check()), the key passed by the
+ * caller is not modified.
+ * @param rsa_key
+ * Pointer to the key in CRT format.
+ * @param key_ctx
+ * Pointer to where the address of the new key context is placed.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given or the key is invalid.
+ * ENOMEM if memory allocation fails.
+ */
+ICA_EXPORT
+unsigned int ica_rsa_key_ctx_new_crt(const ica_rsa_key_crt_t *rsa_key,
+				     ica_rsa_key_ctx_t **key_ctx);
+
+/**
+ * @brief Perform a RSA encryption/decryption operation with a pre-parsed
+ * key.
+ *
+ * Equivalent to ica_rsa_mod_expo() or ica_rsa_crt(), depending on the form
+ * of the key the context was created from.
+ * @param adapter_handle
+ * Pointer to a previously opened device handle.
+ * @param key_ctx
+ * Pointer to the key context.
+ * @param input_data
+ * Pointer to input data in big endian format, key length bytes.
+ * @param output_data
+ * Pointer to where the output results are to be placed, key length bytes.
+ *
+ * @return 0 if successful.
+ * EINVAL if at least one invalid parameter is given.
+ * ENOMEM if memory allocation fails.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+unsigned int ica_rsa_key_ctx_compute(ica_adapter_handle_t adapter_handle,
+				     ica_rsa_key_ctx_t *key_ctx,
+				     const unsigned char *input_data,
+				     unsigned char *output_data);
+
+/**
+ * Free a key context. The key material is cleared.
+ * @param key_ctx
+ * Pointer to the key context, may be NULL.
+ */
+ICA_EXPORT
+void ica_rsa_key_ctx_free(ica_rsa_key_ctx_t *key_ctx);
+
+/**
+ * Completion callback of the RSA batch functions.
+ * @param user_data
+ * The user_data pointer passed to the batch function.
+ * @param index
+ * Index of the completed request within the batch.
+ * @param rc
+ * Return code of the request, see ica_rsa_mod_expo() and ica_rsa_crt().
+ *
+ * The callback is invoked from the worker threads of the batch, possibly
+ * concurrently and in any order of index. It must be thread-safe.
+ */
+typedef void (*ica_rsa_batch_cb_t)(void *user_data, unsigned int index,
+				   unsigned int rc);
+
+/**
+ * @brief Perform a batch of RSA encryption/decryption operations using the
+ * same key in modulus/exponent form.
+ *
+ * The requests are processed by the calling thread and a pool of worker
+ * threads, so that several requests are outstanding at the crypto adapters
+ * at the same time. The function returns when all requests have completed.
+ * The pool threads are created on first use and kept for later batches and
+ * ParallelHash computations. A child process created by fork() starts
+ * without them, they are created again when needed.
+ * @param adapter_handle
+ * Pointer to a previously opened device handle.
+ * @param num
+ * Number of requests in the batch.
+ * @param input_data
+ * Array of num pointers to input data, see ica_rsa_mod_expo().
+ * @param rsa_key
+ * Pointer to the key to be used, in modulus/exponent format.
+ * @param output_data
+ * Array of num pointers to where the output results are to be placed.
+ * @param status
+ * Array of num return codes, one per request, or NULL.
+ * @param workers
+ * Maximum number of worker threads including the calling thread.
+ * 0 selects the default of 4. At most 32 workers are used.
+ * @param callback
+ * Function called as each request completes, or NULL.
+ * @param user_data
+ * Pointer passed to the callback.
+ *
+ * @return 0 if all requests were successful.
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if at least one request failed. The return codes of the single
+ * requests are provided in status and to the callback.
+ */
+ICA_EXPORT
+unsigned int ica_rsa_mod_expo_batch(ica_adapter_handle_t adapter_handle,
+				    unsigned int num,
+				    unsigned char *const *input_data,
+				    ica_rsa_key_mod_expo_t *rsa_key,
+				    unsigned char *const *output_data,
+				    unsigned int *status,
+				    unsigned int workers,
+				    ica_rsa_batch_cb_t callback,
+				    void *user_data);
+
+/**
+ * @brief Perform a batch of RSA encryption/decryption operations using the
+ * same key in CRT form.
+ *
+ * See ica_rsa_mod_expo_batch(). The key is brought into privileged form
+ * (see ica_rsa_crt_key_check()) once before the requests are started.
+ *
+ * @return 0 if all requests were successful.
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if at least one request failed.
+ */
+ICA_EXPORT
+unsigned int ica_rsa_crt_batch(ica_adapter_handle_t adapter_handle,
+			       unsigned int num,
+			       unsigned char *const *input_data,
+			       ica_rsa_key_crt_t *rsa_key,
+			       unsigned char *const *output_data,
+			       unsigned int *status,
+			       unsigned int workers,
+			       ica_rsa_batch_cb_t callback,
+			       void *user_data);
+
 /**
  * @deprecated, use ica_des_ecb() or ica_des_cbc() instead.
  *
@@ -3439,6 +4106,31 @@ int ica_aes_gcm_kma_init(unsigned int direction,
 					const unsigned char *key, unsigned int key_length,
 					kma_ctx* ctx);
 
+/**
+ * Start a new message in a GCM context that has been initialized with
+ * ica_aes_gcm_kma_init() before. Key, direction and the hash subkey are
+ * kept; only the initial counter, the lengths and the tag are reset. This
+ * is much cheaper than ica_aes_gcm_kma_init() for many messages with the
+ * same key and different nonces.
+ *
+ * @param iv
+ * Pointer to the new initialization vector, see ica_aes_gcm_kma_init().
+ * The buffer must stay valid until the tag has been computed.
+ *
+ * @param iv_length
+ * Length in bytes of the initialization vector in iv.
+ *
+ * @param ctx
+ * Pointer to an initialized gcm context.
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_gcm_kma_set_iv(const unsigned char *iv, unsigned int iv_length,
+		kma_ctx* ctx);
+
 /**
  * Perform encryption or decryption with authentication, depending on the
  * direction specified in ica_aes_gcm_kma_init().
@@ -3564,6 +4256,388 @@ void ica_aes_gcm_kma_ctx_free(kma_ctx* ctx);
   *
   ******************************************************************************/
 
+typedef struct ica_aes_key ica_aes_key_t;
+
+/**
+ * Create an AES key object.
+ *
+ * The key is validated and prepared once: it is stored in the layout of
+ * the CPACF parameter blocks, the key schedules for the software fallbacks
+ * are expanded and the GCM hash subkey is computed. The ica_aes_*_key
+ * functions then skip this work on every call. A key object is not
+ * modified by the operations and may be used by several threads at once.
+ *
+ * @param key
+ * Pointer to the AES key.
+ * @param key_length
+ * AES_KEY_LEN128, AES_KEY_LEN192 or AES_KEY_LEN256.
+ * @param aes_key
+ * Pointer to the address of the new key object. Release it with
+ * ica_aes_key_free().
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given.
+ * ENOMEM if memory allocation fails.
+ * ENODEV if AES is neither supported by CPACF nor by software fallbacks.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_key_new(const unsigned char *key, unsigned int key_length,
+		    ica_aes_key_t **aes_key);
+
+/**
+ * Free an AES key object. aes_key may be NULL.
+ */
+ICA_EXPORT
+void ica_aes_key_free(ica_aes_key_t *aes_key);
+
+/**
+ * Like ica_aes_ecb(), with the key given as key object.
+ */
+ICA_EXPORT
+int ica_aes_ecb_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned int direction);
+
+/**
+ * Like ica_aes_cbc(), with the key given as key object.
+ */
+ICA_EXPORT
+int ica_aes_cbc_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned char *iv,
+		    unsigned int direction);
+
+/**
+ * Like ica_aes_ctr(), with the key given as key object. Encryption and
+ * decryption are the same operation.
+ */
+ICA_EXPORT
+int ica_aes_ctr_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned char *ctr,
+		    unsigned int ctr_width);
+
+/**
+ * Like ica_aes_gcm(), with the key given as key object. The hash subkey
+ * stored in the key object is used, so no AES operation is needed to
+ * derive it.
+ */
+ICA_EXPORT
+int ica_aes_gcm_key(const ica_aes_key_t *aes_key,
+		    unsigned char *plaintext, unsigned long plaintext_length,
+		    unsigned char *ciphertext,
+		    const unsigned char *iv, unsigned int iv_length,
+		    const unsigned char *aad, unsigned long aad_length,
+		    unsigned char *tag, unsigned int tag_length,
+		    unsigned int direction);
+
+/**
+ * AES-GCM encryption of a message that is scattered over several buffers,
+ * e.g. packet fragments. The buffers are processed in place; only blocks
+ * that span two buffers are copied.
+ *
+ * @param aes_key
+ * Key object, see ica_aes_key_new().
+ * @param iv
+ * Pointer to the initialization vector.
+ * @param iv_length
+ * Length of the initialization vector in bytes.
+ * @param aad
+ * Buffers with the additional authenticated data. May be NULL if aad_cnt
+ * is 0.
+ * @param aad_cnt
+ * Number of aad buffers.
+ * @param in
+ * Buffers with the plaintext. May be NULL if in_cnt is 0.
+ * @param in_cnt
+ * Number of in buffers.
+ * @param out
+ * Buffers for the ciphertext. The buffers may be split differently than
+ * in, but must have the same total length. in and out may describe the
+ * same memory.
+ * @param out_cnt
+ * Number of out buffers.
+ * @param tag
+ * Pointer to the buffer for the authentication tag.
+ * @param tag_length
+ * Length of the tag in bytes, see ica_aes_gcm().
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_gcm_sealv(const ica_aes_key_t *aes_key,
+		      const unsigned char *iv, unsigned int iv_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      unsigned char *tag, unsigned int tag_length);
+
+/**
+ * AES-GCM decryption of a message that is scattered over several buffers.
+ * The parameters are the same as for ica_aes_gcm_sealv(), with in holding
+ * the ciphertext and out receiving the plaintext.
+ *
+ * @return 0 on success
+ * EFAULT if the tag does not match. The plaintext is written to out
+ * anyway and must be discarded.
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_gcm_openv(const ica_aes_key_t *aes_key,
+		      const unsigned char *iv, unsigned int iv_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      const unsigned char *tag, unsigned int tag_length);
+
+/**
+ * AES-GCM encryption of num independent messages under one key, e.g. the
+ * packets of an IPsec SA or a QUIC connection. The key is set up once for
+ * all messages; with KMA each message is a single instruction, and the
+ * batch is accounted in the statistics with one update.
+ *
+ * @param aes_key
+ * Key object, see ica_aes_key_new().
+ * @param num
+ * Number of messages, must be greater than zero.
+ * @param iv
+ * Array of num pointers to the initialization vectors.
+ * @param iv_length
+ * Length of every initialization vector in bytes. 12 is recommended.
+ * @param aad
+ * Array of num pointers to the additional authenticated data, or NULL if
+ * no message has any. A pointer may only be NULL if its length is zero.
+ * @param aad_length
+ * Array of num aad lengths in bytes. Ignored if aad is NULL.
+ * @param plaintext
+ * Array of num pointers to the plaintexts. A pointer may only be NULL if
+ * its length is zero.
+ * @param ciphertext
+ * Array of num pointers to buffers for the ciphertexts. A ciphertext may
+ * overlap its plaintext only exactly.
+ * @param length
+ * Array of num plaintext lengths in bytes.
+ * @param tag
+ * Array of num pointers to buffers for the authentication tags.
+ * @param tag_length
+ * Length of every tag in bytes, see ica_aes_gcm().
+ * @param status
+ * Array of num results, one per message: 0 on success, otherwise an error
+ * code as returned by this function. May be NULL.
+ *
+ * @return 0 if all messages were encrypted.
+ * EINVAL if at least one invalid parameter is given. Nothing is processed
+ * in this case.
+ * Otherwise the error code of the first message that failed.
+ */
+ICA_EXPORT
+int ica_aes_gcm_seal_batch(const ica_aes_key_t *aes_key, unsigned int num,
+			   const unsigned char *const iv[],
+			   unsigned int iv_length,
+			   const unsigned char *const aad[],
+			   const size_t aad_length[],
+			   const unsigned char *const plaintext[],
+			   unsigned char *const ciphertext[],
+			   const size_t length[],
+			   unsigned char *const tag[], unsigned int tag_length,
+			   int status[]);
+
+/**
+ * AES-GCM decryption of num independent messages under one key, see
+ * ica_aes_gcm_seal_batch(). status[i] is set to EFAULT if the tag of
+ * message i does not match. Its plaintext is written anyway and must be
+ * discarded.
+ *
+ * @return 0 if all messages were decrypted and verified.
+ * EINVAL if at least one invalid parameter is given. Nothing is processed
+ * in this case.
+ * Otherwise the error code of the first message that failed, e.g. EFAULT.
+ */
+ICA_EXPORT
+int ica_aes_gcm_open_batch(const ica_aes_key_t *aes_key, unsigned int num,
+			   const unsigned char *const iv[],
+			   unsigned int iv_length,
+			   const unsigned char *const aad[],
+			   const size_t aad_length[],
+			   const unsigned char *const ciphertext[],
+			   unsigned char *const plaintext[],
+			   const size_t length[],
+			   const unsigned char *const tag[],
+			   unsigned int tag_length, int status[]);
+
+/**
+ * AES-CCM encryption of a message that is scattered over several buffers.
+ * The parameters are as for ica_aes_gcm_sealv(), with nonce and mac as
+ * described for ica_aes_ccm(). The MAC is returned in its own buffer
+ * instead of being appended to the ciphertext.
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_sealv(const ica_aes_key_t *aes_key,
+		      const unsigned char *nonce, unsigned int nonce_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      unsigned char *mac, unsigned int mac_length);
+
+/**
+ * AES-CCM decryption of a message that is scattered over several buffers,
+ * see ica_aes_ccm_sealv().
+ *
+ * @return 0 on success
+ * EFAULT if the MAC does not match. The plaintext is written to out
+ * anyway and must be discarded.
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_openv(const ica_aes_key_t *aes_key,
+		      const unsigned char *nonce, unsigned int nonce_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      const unsigned char *mac, unsigned int mac_length);
+
+typedef struct ica_aes_ccm_ctx ica_aes_ccm_ctx_t;
+
+/**
+ * Allocate a context for AES-CCM on a message that is passed in several
+ * parts, e.g. a large object that is read piecewise. It must be freed by
+ * ica_aes_ccm_ctx_free().
+ *
+ * @return Pointer to the opaque context, or NULL if no memory could be
+ * allocated.
+ */
+ICA_EXPORT
+ica_aes_ccm_ctx_t *ica_aes_ccm_ctx_new(void);
+
+/**
+ * Start a message. CCM authenticates the lengths of the associated data
+ * and of the payload first, so both must be known in advance.
+ *
+ * @param direction
+ * ICA_ENCRYPT or ICA_DECRYPT.
+ * @param nonce
+ * Pointer to the nonce, see ica_aes_ccm().
+ * @param nonce_length
+ * Length of the nonce in bytes, see ica_aes_ccm().
+ * @param assoc_data_length
+ * Total length of the associated data in bytes.
+ * @param payload_length
+ * Total length of the payload in bytes.
+ * @param mac_length
+ * Length of the MAC in bytes, see ica_aes_ccm().
+ * @param key
+ * Pointer to the AES key.
+ * @param key_length
+ * AES_KEY_LEN128, AES_KEY_LEN192 or AES_KEY_LEN256.
+ * @param ctx
+ * Pointer to a context from ica_aes_ccm_ctx_new().
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_init(unsigned int direction,
+		     const unsigned char *nonce, unsigned int nonce_length,
+		     unsigned long assoc_data_length,
+		     unsigned long payload_length, unsigned int mac_length,
+		     const unsigned char *key, unsigned int key_length,
+		     ica_aes_ccm_ctx_t *ctx);
+
+/**
+ * Process a part of the message: first the associated data, then the
+ * payload. The associated data may be passed in parts of any length, but
+ * all of it must have been passed before the first payload part. Like
+ * with ica_aes_gcm_kma_update(), all payload parts except the last one
+ * must be multiples of the AES block size.
+ *
+ * @param in_data
+ * Pointer to data_length bytes of plaintext (encryption) or ciphertext
+ * (decryption).
+ * @param out_data
+ * Pointer to a buffer of data_length bytes for the result. It may be the
+ * same as in_data.
+ * @param data_length
+ * Length of this payload part in bytes, may be 0.
+ * @param assoc_data
+ * Pointer to assoc_data_length bytes of associated data.
+ * @param assoc_data_length
+ * Length of this part of the associated data in bytes, may be 0.
+ * @param ctx
+ * Pointer to a context initialized by ica_aes_ccm_init().
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given, the parts exceed
+ * the lengths given to ica_aes_ccm_init() or come in the wrong order.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_update(const unsigned char *in_data, unsigned char *out_data,
+		       unsigned long data_length,
+		       const unsigned char *assoc_data,
+		       unsigned long assoc_data_length,
+		       ica_aes_ccm_ctx_t *ctx);
+
+/**
+ * Get the MAC of an encrypted message, after all of the message has been
+ * passed to ica_aes_ccm_update().
+ *
+ * @param mac
+ * Pointer to a buffer of mac_length bytes.
+ * @param mac_length
+ * Length of the MAC, as given to ica_aes_ccm_init().
+ * @param ctx
+ * Pointer to a context initialized for encryption.
+ *
+ * @return 0 on success
+ * EINVAL if at least one invalid parameter is given or the message is
+ * incomplete.
+ * EFAULT if the context is initialized for decryption.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_get_mac(unsigned char *mac, unsigned int mac_length,
+			ica_aes_ccm_ctx_t *ctx);
+
+/**
+ * Verify the MAC of a decrypted message, after all of the message has been
+ * passed to ica_aes_ccm_update(). The plaintext must not be used before
+ * the MAC is verified.
+ *
+ * @param mac
+ * Pointer to the received MAC of mac_length bytes.
+ * @param mac_length
+ * Length of the MAC, as given to ica_aes_ccm_init().
+ * @param ctx
+ * Pointer to a context initialized for decryption.
+ *
+ * @return 0 if the MAC is valid
+ * EINVAL if at least one invalid parameter is given or the message is
+ * incomplete.
+ * EFAULT if the MAC does not match or the context is initialized for
+ * encryption.
+ * EIO if the operation fails.
+ */
+ICA_EXPORT
+int ica_aes_ccm_verify_mac(const unsigned char *mac, unsigned int mac_length,
+			   ica_aes_ccm_ctx_t *ctx);
+
+/**
+ * Free a context from ica_aes_ccm_ctx_new(). Its sensitive data is erased.
+ * ctx may be NULL.
+ */
+ICA_EXPORT
+void ica_aes_ccm_ctx_free(ica_aes_ccm_ctx_t *ctx);
+
 /**
  * Return libica version information.
  * @param version_info
@@ -0,0 +1,743 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <openssl/aes.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+
+#include "aes_sw.h"
+#include "s390_crypto.h"
+
+/* Independent blocks that are passed to the cipher at once. */
+#define AES_SW_BATCH	(32 * AES_BLOCK_SIZE)
+
+/* An ECB context with the key length of fc. */
+static int aes_sw_new(EVP_CIPHER_CTX **ctx, unsigned int fc,
+		      const unsigned char *key, int enc)
+{
+	const EVP_CIPHER *cipher;
+
+	switch (fc & 0x0f) {
+	case 2:
+		cipher = EVP_aes_128_ecb();
+		break;
+	case 3:
+		cipher = EVP_aes_192_ecb();
+		break;
+	case 4:
+		cipher = EVP_aes_256_ecb();
+		break;
+	default:
+		return EINVAL;
+	}
+
+	*ctx = EVP_CIPHER_CTX_new();
+	if (*ctx == NULL)
+		return ENOMEM;
+
+	if (EVP_CipherInit_ex(*ctx, cipher, NULL, key, NULL, enc) != 1
+	    || EVP_CIPHER_CTX_set_padding(*ctx, 0) != 1) {
+		EVP_CIPHER_CTX_free(*ctx);
+		return EIO;
+	}
+
+	return 0;
+}
+
+/* len is at most AES_SW_BATCH and a multiple of the block size */
+static int aes_sw_blocks(EVP_CIPHER_CTX *ctx, const unsigned char *in,
+			 unsigned char *out, unsigned int len)
+{
+	int outl;
+
+	if (EVP_CipherUpdate(ctx, out, &outl, in, len) != 1
+	    || (unsigned int)outl != len)
+		return EIO;
+
+	return 0;
+}
+
+static inline void aes_sw_xor(unsigned char *out, const unsigned char *a,
+			      const unsigned char *b, unsigned long len)
+{
+	unsigned long i;
+
+	for (i = 0; i < len; i++)
+		out[i] = a[i] ^ b[i];
+}
+
+int aes_ctr_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       const unsigned char *ctrlist, const unsigned char *key,
+	       unsigned char *out)
+{
+	unsigned char ks[AES_SW_BATCH];
+	EVP_CIPHER_CTX *ctx;
+	unsigned long n;
+	int rc;
+
+	rc = aes_sw_new(&ctx, fc, key, 1);
+	if (rc)
+		return rc;
+
+	while (len) {
+		n = len < AES_SW_BATCH ? len : AES_SW_BATCH;
+		rc = aes_sw_blocks(ctx, ctrlist, ks, n);
+		if (rc)
+			break;
+		aes_sw_xor(out, in, ks, n);
+
+		in += n;
+		out += n;
+		ctrlist += n;
+		len -= n;
+	}
+
+	OPENSSL_cleanse(ks, sizeof(ks));
+	EVP_CIPHER_CTX_free(ctx);
+	return rc;
+}
+
+int aes_ofb_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       unsigned char *iv, const unsigned char *key, unsigned char *out)
+{
+	EVP_CIPHER_CTX *ctx;
+	int rc;
+
+	rc = aes_sw_new(&ctx, fc, key, 1);
+	if (rc)
+		return rc;
+
+	for (; len; len -= AES_BLOCK_SIZE) {
+		rc = aes_sw_blocks(ctx, iv, iv, AES_BLOCK_SIZE);
+		if (rc)
+			break;
+		aes_sw_xor(out, in, iv, AES_BLOCK_SIZE);
+
+		in += AES_BLOCK_SIZE;
+		out += AES_BLOCK_SIZE;
+	}
+
+	EVP_CIPHER_CTX_free(ctx);
+	return rc;
+}
+
+int aes_cfb_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       unsigned char *iv, const unsigned char *key, unsigned char *out,
+	       unsigned int lcfb)
+{
+	unsigned char ks[AES_BLOCK_SIZE], c[AES_BLOCK_SIZE];
+	int decrypt = fc & S390_CRYPTO_DIRECTION_MASK;
+	EVP_CIPHER_CTX *ctx;
+	int rc;
+
+	/* the cipher is used in the encrypt direction only */
+	rc = aes_sw_new(&ctx, fc, key, 1);
+	if (rc)
+		return rc;
+
+	for (; len; len -= lcfb) {
+		rc = aes_sw_blocks(ctx, iv, ks, AES_BLOCK_SIZE);
+		if (rc)
+			break;
+
+		/* the ciphertext segment is shifted into the iv */
+		if (decrypt)
+			memcpy(c, in, lcfb);
+		aes_sw_xor(out, in, ks, lcfb);
+		if (!decrypt)
+			memcpy(c, out, lcfb);
+		memmove(iv, iv + lcfb, AES_BLOCK_SIZE - lcfb);
+		memcpy(iv + AES_BLOCK_SIZE - lcfb, c, lcfb);
+
+		in += lcfb;
+		out += lcfb;
+	}
+
+	OPENSSL_cleanse(ks, sizeof(ks));
+	EVP_CIPHER_CTX_free(ctx);
+	return rc;
+}
+
+/* Multiply the tweak by alpha in GF(2^128), little-endian (IEEE 1619). */
+static inline void xts_mul_alpha(unsigned char t[AES_BLOCK_SIZE])
+{
+	unsigned int carry = -(unsigned int)(t[AES_BLOCK_SIZE - 1] >> 7) & 0x87;
+	int i;
+
+	for (i = AES_BLOCK_SIZE - 1; i > 0; i--)
+		t[i] = (t[i] << 1) | (t[i - 1] >> 7);
+	t[0] = (t[0] << 1) ^ carry;
+}
+
+/*
+ * len bytes of full blocks with the tweaks t, t * alpha, ..., t is
+ * advanced past the last block.
+ */
+static int xts_blocks(EVP_CIPHER_CTX *ctx, const unsigned char *in,
+		      unsigned char *out, unsigned int len,
+		      unsigned char t[AES_BLOCK_SIZE])
+{
+	unsigned char buf[AES_SW_BATCH], tweaks[AES_SW_BATCH];
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < len; i += AES_BLOCK_SIZE) {
+		memcpy(tweaks + i, t, AES_BLOCK_SIZE);
+		xts_mul_alpha(t);
+	}
+
+	aes_sw_xor(buf, in, tweaks, len);
+	rc = aes_sw_blocks(ctx, buf, buf, len);
+	if (!rc)
+		aes_sw_xor(out, buf, tweaks, len);
+
+	OPENSSL_cleanse(buf, len);
+	return rc;
+}
+
+int aes_xts_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       const unsigned char *tweak, const unsigned char *key1,
+	       const unsigned char *key2, unsigned char *out)
+{
+	unsigned char t[AES_BLOCK_SIZE], t_next[AES_BLOCK_SIZE];
+	unsigned char partial[AES_BLOCK_SIZE], stolen[AES_BLOCK_SIZE];
+	int decrypt = fc & S390_CRYPTO_DIRECTION_MASK;
+	unsigned long rest, bulk, n;
+	EVP_CIPHER_CTX *ctx;
+	int rc;
+
+	/* the XTS parameter of the first block */
+	rc = aes_sw_new(&ctx, fc, key2, 1);
+	if (rc)
+		return rc;
+	rc = aes_sw_blocks(ctx, tweak, t, AES_BLOCK_SIZE);
+	EVP_CIPHER_CTX_free(ctx);
+	if (rc)
+		return rc;
+
+	rc = aes_sw_new(&ctx, fc, key1, !decrypt);
+	if (rc)
+		return rc;
+
+	/* with a partial block, the last full block is part of the stealing */
+	rest = len % AES_BLOCK_SIZE;
+	bulk = len - rest - (rest ? AES_BLOCK_SIZE : 0);
+
+	for (; bulk; bulk -= n) {
+		n = bulk < AES_SW_BATCH ? bulk : AES_SW_BATCH;
+		rc = xts_blocks(ctx, in, out, n, t);
+		if (rc)
+			goto out;
+
+		in += n;
+		out += n;
+	}
+
+	if (rest) {
+		/*
+		 * Ciphertext stealing: the partial block is padded with the
+		 * tail of the processed last full block. When decrypting, the
+		 * two tweaks are used in the opposite order.
+		 */
+		memcpy(t_next, t, AES_BLOCK_SIZE);
+		xts_mul_alpha(t_next);
+		memcpy(partial, in + AES_BLOCK_SIZE, rest);
+
+		rc = xts_blocks(ctx, in, stolen, AES_BLOCK_SIZE,
+				decrypt ? t_next : t);
+		if (rc)
+			goto out;
+
+		memcpy(partial + rest, stolen + rest, AES_BLOCK_SIZE - rest);
+		memcpy(out + AES_BLOCK_SIZE, stolen, rest);
+		rc = xts_blocks(ctx, partial, out, AES_BLOCK_SIZE,
+				decrypt ? t : t_next);
+	}
+
+out:
+	OPENSSL_cleanse(partial, sizeof(partial));
+	OPENSSL_cleanse(stolen, sizeof(stolen));
+	EVP_CIPHER_CTX_free(ctx);
+	return rc;
+}
+
+/* Multiply by x in GF(2^128), big-endian (SP 800-38B). */
+static inline void cmac_dbl(unsigned char b[AES_BLOCK_SIZE])
+{
+	unsigned int carry = -(unsigned int)(b[0] >> 7) & 0x87;
+	int i;
+
+	for (i = 0; i < AES_BLOCK_SIZE - 1; i++)
+		b[i] = (b[i] << 1) | (b[i + 1] >> 7);
+	b[AES_BLOCK_SIZE - 1] = (b[AES_BLOCK_SIZE - 1] << 1) ^ carry;
+}
+
+/* CBC-MAC, len must be a multiple of the block size */
+static int cbc_mac(EVP_CIPHER_CTX *ctx, const unsigned char *in,
+		   unsigned long len, unsigned char cv[AES_BLOCK_SIZE])
+{
+	int rc;
+
+	for (; len; len -= AES_BLOCK_SIZE) {
+		aes_sw_xor(cv, cv, in, AES_BLOCK_SIZE);
+		rc = aes_sw_blocks(ctx, cv, cv, AES_BLOCK_SIZE);
+		if (rc)
+			return rc;
+		in += AES_BLOCK_SIZE;
+	}
+
+	return 0;
+}
+
+int aes_cmac_sw(unsigned int fc, const unsigned char *message,
+		unsigned long len, const unsigned char *key,
+		unsigned int mac_length, unsigned char *mac,
+		unsigned char *iv)
+{
+	unsigned char cv[AES_BLOCK_SIZE], last[AES_BLOCK_SIZE];
+	unsigned char subkey[AES_BLOCK_SIZE];
+	unsigned long head, tail;
+	EVP_CIPHER_CTX *ctx;
+	int rc;
+
+	/* an intermediate part needs the chaining value */
+	if (mac == NULL && iv == NULL)
+		return EINVAL;
+
+	rc = aes_sw_new(&ctx, fc, key, 1);
+	if (rc)
+		return rc;
+
+	if (iv != NULL)
+		memcpy(cv, iv, AES_BLOCK_SIZE);
+	else
+		memset(cv, 0, AES_BLOCK_SIZE);
+
+	if (mac == NULL) {
+		/* intermediate */
+		rc = cbc_mac(ctx, message, len, cv);
+		if (!rc)
+			memcpy(iv, cv, AES_BLOCK_SIZE);
+		goto out;
+	}
+
+	/* the last block is either complete or padded */
+	tail = len % AES_BLOCK_SIZE;
+	if (len && !tail)
+		tail = AES_BLOCK_SIZE;
+	head = len - tail;
+
+	rc = cbc_mac(ctx, message, head, cv);
+	if (rc)
+		goto out;
+
+	/* K1 = 2 * AES(0), K2 = 4 * AES(0) */
+	memset(subkey, 0, sizeof(subkey));
+	rc = aes_sw_blocks(ctx, subkey, subkey, AES_BLOCK_SIZE);
+	if (rc)
+		goto out;
+	cmac_dbl(subkey);
+
+	memset(last, 0, sizeof(last));
+	if (tail)
+		memcpy(last, message + head, tail);
+	if (tail < AES_BLOCK_SIZE) {
+		last[tail] = 0x80;
+		cmac_dbl(subkey);
+	}
+	aes_sw_xor(last, last, subkey, AES_BLOCK_SIZE);
+
+	rc = cbc_mac(ctx, last, AES_BLOCK_SIZE, cv);
+	if (!rc)
+		memcpy(mac, cv, mac_length);
+
+out:
+	OPENSSL_cleanse(subkey, sizeof(subkey));
+	OPENSSL_cleanse(last, sizeof(last));
+	OPENSSL_cleanse(cv, sizeof(cv));
+	EVP_CIPHER_CTX_free(ctx);
+	return rc;
+}
+
+static inline uint64_t load_be64(const unsigned char *p)
+{
+	return (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 |
+	       (uint64_t)p[2] << 40 | (uint64_t)p[3] << 32 |
+	       (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 |
+	       (uint64_t)p[6] << 8 | (uint64_t)p[7];
+}
+
+static inline void store_be64(unsigned char *p, uint64_t x)
+{
+	int i;
+
+	for (i = 7; i >= 0; i--) {
+		p[i] = x;
+		x >>= 8;
+	}
+}
+
+static inline uint64_t rev64(uint64_t x)
+{
+	x = ((x & 0x5555555555555555ULL) << 1) |
+	    ((x >> 1) & 0x5555555555555555ULL);
+	x = ((x & 0x3333333333333333ULL) << 2) |
+	    ((x >> 2) & 0x3333333333333333ULL);
+	x = ((x & 0x0f0f0f0f0f0f0f0fULL) << 4) |
+	    ((x >> 4) & 0x0f0f0f0f0f0f0f0fULL);
+	x = ((x & 0x00ff00ff00ff00ffULL) << 8) |
+	    ((x >> 8) & 0x00ff00ff00ff00ffULL);
+	x = ((x & 0x0000ffff0000ffffULL) << 16) |
+	    ((x >> 16) & 0x0000ffff0000ffffULL);
+	return (x << 32) | (x >> 32);
+}
+
+/*
+ * The low 64 bits of the carry-less product of x and y. Each operand is
+ * split into four sets of bits that are four positions apart, so the
+ * carries of an integer multiplication cannot reach the next bit of the
+ * same set, except above bit 63.
+ */
+static inline uint64_t bmul64(uint64_t x, uint64_t y)
+{
+	const uint64_t m0 = 0x1111111111111111ULL, m1 = m0 << 1;
+	const uint64_t m2 = m0 << 2, m3 = m0 << 3;
+	uint64_t x0 = x & m0, x1 = x & m1, x2 = x & m2, x3 = x & m3;
+	uint64_t y0 = y & m0, y1 = y & m1, y2 = y & m2, y3 = y & m3;
+	uint64_t z0, z1, z2, z3;
+
+	z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+	z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+	z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+	z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+
+	return (z0 & m0) | (z1 & m1) | (z2 & m2) | (z3 & m3);
+}
+
+void ghash_sw(const unsigned char *in, unsigned long len,
+	      const unsigned char *subkey, unsigned char *iv)
+{
+	uint64_t y0, y1, y2, y0r, y1r, y2r;
+	uint64_t h0, h1, h2, h0r, h1r, h2r;
+	uint64_t z0, z1, z2, z0h, z1h, z2h;
+	uint64_t v0, v1, v2, v3;
+
+	/* GCM bit order: the first bit of a block is the constant term */
+	y1 = load_be64(iv);
+	y0 = load_be64(iv + 8);
+	h1 = load_be64(subkey);
+	h0 = load_be64(subkey + 8);
+	h0r = rev64(h0);
+	h1r = rev64(h1);
+	h2 = h0 ^ h1;
+	h2r = h0r ^ h1r;
+
+	for (; len; len -= AES_BLOCK_SIZE, in += AES_BLOCK_SIZE) {
+		y1 ^= load_be64(in);
+		y0 ^= load_be64(in + 8);
+		y0r = rev64(y0);
+		y1r = rev64(y1);
+		y2 = y0 ^ y1;
+		y2r = y0r ^ y1r;
+
+		/* Karatsuba, the high halves from the bit-reversed inputs */
+		z0 = bmul64(y0, h0);
+		z1 = bmul64(y1, h1);
+		z2 = bmul64(y2, h2);
+		z0h = bmul64(y0r, h0r);
+		z1h = bmul64(y1r, h1r);
+		z2h = bmul64(y2r, h2r);
+		z2 ^= z0 ^ z1;
+		z2h ^= z0h ^ z1h;
+		z0h = rev64(z0h) >> 1;
+		z1h = rev64(z1h) >> 1;
+		z2h = rev64(z2h) >> 1;
+
+		/* the 256 bit product, shifted for the reflected order */
+		v0 = z0;
+		v1 = z0h ^ z2;
+		v2 = z1 ^ z2h;
+		v3 = z1h;
+		v3 = (v3 << 1) | (v2 >> 63);
+		v2 = (v2 << 1) | (v1 >> 63);
+		v1 = (v1 << 1) | (v0 >> 63);
+		v0 = (v0 << 1);
+
+		/* reduction modulo x^128 + x^7 + x^2 + x + 1 */
+		v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+		v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+		v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+		v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+		y0 = v2;
+		y1 = v3;
+	}
+
+	store_be64(iv, y1);
+	store_be64(iv + 8, y0);
+}
+
+#ifdef ICA_INTERNAL_TEST_AES
+
+#include <stdio.h>
+
+#include "init.h"
+#include "../test/testcase.h"
+
+#define TEST_ERROR(msg, alg, tv)					    \
+do {									    \
+	fprintf(stderr, "ERROR: %s. (%s test vector %lu)\n", msg, alg, tv); \
+	exit(TEST_FAIL);						    \
+} while(0)
+
+#define AES_SW_DIGEST_LENGTH	32	/* SHA-256 */
+
+enum { SW_CTR, SW_OFB, SW_CFB, SW_XTS, SW_CMAC, SW_GCM };
+
+/*
+ * Known answers computed with OpenSSL. Key, iv, aad and message are
+ * generated by aes_sw_tv_fill(). Cipher texts are given as their SHA-256
+ * digest. The lengths cross AES_SW_BATCH, end in partial blocks (XTS
+ * ciphertext stealing) or are not block aligned (CFB8).
+ */
+static const struct aes_sw_tv {
+	int mode;
+	unsigned int keylen;
+	unsigned long len;
+	unsigned int lcfb;	/* CFB segment */
+	unsigned int ivlen;	/* GCM */
+	unsigned int aadlen;	/* GCM */
+	unsigned char digest[AES_SW_DIGEST_LENGTH];
+	unsigned char mac[AES_BLOCK_SIZE];
+} AES_SW_TV[] = {
+	{ SW_CTR, 16, 601, 0, 0, 0,
+	  { 0x3c, 0x5b, 0x29, 0xe3, 0x0c, 0x93, 0xca, 0x52,
+	    0xa0, 0xfe, 0x11, 0x5d, 0x93, 0xe2, 0x26, 0x93,
+	    0xf5, 0xce, 0xb0, 0x17, 0x7a, 0xe7, 0xbf, 0xf6,
+	    0x60, 0x31, 0xe3, 0xfa, 0xa8, 0x00, 0xa6, 0x73 }, { 0 } },
+	{ SW_OFB, 24, 601, 0, 0, 0,
+	  { 0x6f, 0x48, 0xc7, 0xe1, 0x56, 0xb5, 0x09, 0x40,
+	    0x0f, 0xca, 0xf6, 0xe5, 0x5a, 0x71, 0xc1, 0x0e,
+	    0x42, 0x6b, 0xc3, 0x91, 0x25, 0xab, 0xf4, 0xd2,
+	    0x89, 0xc4, 0x38, 0xfa, 0x30, 0x45, 0x36, 0x8e }, { 0 } },
+	{ SW_CFB, 32, 601, 16, 0, 0,
+	  { 0x70, 0x19, 0x24, 0xab, 0xcb, 0x1e, 0x2b, 0xbe,
+	    0x4a, 0xf8, 0x04, 0x8d, 0x6a, 0x39, 0x41, 0x14,
+	    0x77, 0xcc, 0x54, 0x52, 0xae, 0x62, 0xde, 0xc0,
+	    0x6e, 0x34, 0x2c, 0xa2, 0xf0, 0x03, 0xbe, 0xfe }, { 0 } },
+	{ SW_CFB, 16, 37, 1, 0, 0,
+	  { 0x49, 0x8f, 0xfc, 0x51, 0x9e, 0xbb, 0x6c, 0xdb,
+	    0x2e, 0x38, 0xe7, 0xe1, 0x79, 0x9d, 0xf2, 0x83,
+	    0x31, 0xdd, 0xb4, 0x3e, 0xf1, 0xc7, 0xc6, 0xb6,
+	    0x0d, 0xb2, 0x91, 0x36, 0x1b, 0xdc, 0xd2, 0xca }, { 0 } },
+	{ SW_XTS, 16, 601, 0, 0, 0,
+	  { 0xa2, 0x60, 0x62, 0x5a, 0xc5, 0x1a, 0xcb, 0x54,
+	    0x47, 0xd1, 0xaf, 0xaa, 0xa9, 0xa1, 0x23, 0x1a,
+	    0x49, 0xfa, 0x70, 0x4e, 0xa3, 0x82, 0xf9, 0xaf,
+	    0x8b, 0x7f, 0x41, 0xd5, 0x7e, 0x29, 0x35, 0xab }, { 0 } },
+	{ SW_XTS, 32, 17, 0, 0, 0,
+	  { 0xbf, 0x7e, 0x1f, 0xdd, 0x26, 0x1f, 0xe8, 0xea,
+	    0xa7, 0xbb, 0xd6, 0xfb, 0x0e, 0x3e, 0xc8, 0x03,
+	    0x4f, 0x0a, 0x6d, 0xce, 0x16, 0x0a, 0x4c, 0x84,
+	    0x3e, 0x1d, 0x16, 0xd2, 0xf8, 0x13, 0xeb, 0x0e }, { 0 } },
+	{ SW_CMAC, 16, 613, 0, 0, 0, { 0 },
+	  { 0x2b, 0x84, 0x46, 0x53, 0xb4, 0xd5, 0xf3, 0x88,
+	    0xd6, 0xc8, 0x0b, 0xde, 0x99, 0x93, 0x93, 0xe1 } },
+	{ SW_CMAC, 24, 32, 0, 0, 0, { 0 },
+	  { 0x1b, 0x6e, 0x8f, 0x48, 0xc1, 0xa5, 0x94, 0x44,
+	    0x0a, 0x43, 0x9a, 0xfc, 0x90, 0x54, 0xc4, 0x55 } },
+	{ SW_GCM, 16, 601, 0, 12, 20,
+	  { 0xf8, 0xcb, 0xb2, 0xce, 0x14, 0x4a, 0x92, 0x2c,
+	    0xae, 0xba, 0x1f, 0x3d, 0x11, 0x01, 0xd2, 0xd1,
+	    0x62, 0x5c, 0xf6, 0x10, 0x38, 0xf6, 0x30, 0xdc,
+	    0x76, 0xf9, 0x53, 0xb4, 0x9d, 0xf4, 0xdc, 0x7b },
+	  { 0x50, 0xb0, 0x72, 0x9f, 0x03, 0x10, 0xed, 0x97,
+	    0x24, 0xa1, 0x64, 0xbb, 0x77, 0x71, 0xe4, 0xdb } },
+	{ SW_GCM, 32, 37, 0, 60, 0,
+	  { 0x21, 0x29, 0x90, 0x4f, 0x21, 0x89, 0x32, 0xfe,
+	    0xc2, 0xb2, 0x31, 0xf2, 0x53, 0x43, 0x3e, 0x76,
+	    0x72, 0x55, 0x41, 0x45, 0xfc, 0xee, 0xd3, 0xc7,
+	    0x60, 0x30, 0x10, 0x53, 0xba, 0x3e, 0x2c, 0xae },
+	  { 0xe1, 0x0c, 0x51, 0x67, 0x7e, 0xbe, 0xc9, 0xac,
+	    0xea, 0x7f, 0x9e, 0x90, 0x92, 0x14, 0x78, 0x27 } },
+};
+
+#define AES_SW_TV_LEN	(sizeof(AES_SW_TV) / sizeof(AES_SW_TV[0]))
+
+/* CMAC messages are passed in parts of these lengths, the rest is last. */
+#define AES_SW_CMAC_PART1	64
+#define AES_SW_CMAC_PART2	512
+
+static unsigned char tv_key[64], tv_iv[60], tv_aad[32], tv_msg[1024];
+
+static void aes_sw_tv_fill(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(tv_key); i++)
+		tv_key[i] = i * 7 + 1;
+	for (i = 0; i < sizeof(tv_iv); i++)
+		tv_iv[i] = 0xf0 + i;
+	for (i = 0; i < sizeof(tv_aad); i++)
+		tv_aad[i] = i;
+	for (i = 0; i < sizeof(tv_msg); i++)
+		tv_msg[i] = i * 13 + 5;
+}
+
+static int aes_sw_tv_crypt(const struct aes_sw_tv *t, const unsigned char *in,
+			   unsigned char *out, unsigned char *tag,
+			   unsigned int direction)
+{
+	unsigned char cv[AES_BLOCK_SIZE];
+
+	memcpy(cv, tv_iv, AES_BLOCK_SIZE);
+
+	switch (t->mode) {
+	case SW_CTR:
+		return ica_aes_ctr(in, out, t->len, tv_key, t->keylen, cv,
+				   AES_BLOCK_SIZE * 8, direction);
+	case SW_OFB:
+		return ica_aes_ofb(in, out, t->len, tv_key, t->keylen, cv,
+				   direction);
+	case SW_CFB:
+		return ica_aes_cfb(in, out, t->len, tv_key, t->keylen, cv,
+				   t->lcfb, direction);
+	case SW_XTS:
+		return ica_aes_xts(in, out, t->len, tv_key, tv_key + 32,
+				   t->keylen, cv, direction);
+	case SW_GCM:
+		return ica_aes_gcm(direction ? (unsigned char *)in : out,
+				   t->len, direction ? out : (unsigned char *)in,
+				   tv_iv, t->ivlen, tv_aad, t->aadlen,
+				   tag, AES_BLOCK_SIZE, tv_key, t->keylen,
+				   direction);
+	default:
+		return EINVAL;
+	}
+}
+
+static void aes_sw_cipher_test(void)
+{
+	unsigned char out[sizeof(tv_msg)], dec[sizeof(tv_msg)];
+	unsigned char digest[AES_SW_DIGEST_LENGTH];
+	unsigned char tag[AES_BLOCK_SIZE];
+	const struct aes_sw_tv *t;
+	unsigned long i;
+	int rc;
+
+	for (i = 0; i < AES_SW_TV_LEN; i++) {
+		t = &AES_SW_TV[i];
+		if (t->mode == SW_CMAC)
+			continue;
+
+		rc = aes_sw_tv_crypt(t, tv_msg, out, tag, ICA_ENCRYPT);
+		if (rc == EACCES)
+			exit(TEST_SKIP);	/* FIPS mode */
+		if (rc)
+			TEST_ERROR("Encryption failed", "AES-SW", i);
+
+		if (EVP_Digest(out, t->len, digest, NULL, EVP_sha256(),
+			       NULL) != 1)
+			TEST_ERROR("Digest failed", "AES-SW", i);
+		if (memcmp(digest, t->digest, sizeof(digest))) {
+			printf("Result:\n");
+			dump_array(out, t->len);
+			TEST_ERROR("Wrong cipher text", "AES-SW", i);
+		}
+		if (t->mode == SW_GCM && memcmp(tag, t->mac, AES_BLOCK_SIZE)) {
+			printf("Result tag:\n");
+			dump_array(tag, AES_BLOCK_SIZE);
+			printf("Correct tag:\n");
+			dump_array((unsigned char *)t->mac, AES_BLOCK_SIZE);
+			TEST_ERROR("Wrong tag", "AES-SW", i);
+		}
+
+		/* the GCM decryption checks the tag */
+		rc = aes_sw_tv_crypt(t, out, dec, tag, ICA_DECRYPT);
+		if (rc)
+			TEST_ERROR("Decryption failed", "AES-SW", i);
+		if (memcmp(dec, tv_msg, t->len))
+			TEST_ERROR("Wrong plain text", "AES-SW", i);
+	}
+}
+
+static void aes_sw_cmac_test(void)
+{
+	unsigned char cv[AES_BLOCK_SIZE];
+	unsigned char mac[AES_BLOCK_SIZE];
+	const struct aes_sw_tv *t;
+	unsigned long i, off;
+	int rc;
+
+	for (i = 0; i < AES_SW_TV_LEN; i++) {
+		t = &AES_SW_TV[i];
+		if (t->mode != SW_CMAC)
+			continue;
+
+		/* chain the parts that fit into the message */
+		memset(cv, 0, sizeof(cv));
+		off = 0;
+		if (t->len > AES_SW_CMAC_PART1 + AES_SW_CMAC_PART2) {
+			rc = ica_aes_cmac_intermediate(tv_msg, AES_SW_CMAC_PART1,
+						       tv_key, t->keylen, cv);
+			if (!rc)
+				rc = ica_aes_cmac_intermediate(tv_msg + AES_SW_CMAC_PART1,
+							       AES_SW_CMAC_PART2,
+							       tv_key, t->keylen, cv);
+			if (rc == EACCES)
+				exit(TEST_SKIP);	/* FIPS mode */
+			if (rc)
+				TEST_ERROR("Intermediate CMAC failed", "AES-SW-CMAC", i);
+			off = AES_SW_CMAC_PART1 + AES_SW_CMAC_PART2;
+		}
+
+		rc = ica_aes_cmac_last(tv_msg + off, t->len - off, mac,
+				       AES_BLOCK_SIZE, tv_key, t->keylen, cv,
+				       ICA_ENCRYPT);
+		if (rc == EACCES)
+			exit(TEST_SKIP);
+		if (rc)
+			TEST_ERROR("CMAC failed", "AES-SW-CMAC", i);
+		if (memcmp(mac, t->mac, AES_BLOCK_SIZE)) {
+			printf("Result MAC:\n");
+			dump_array(mac, AES_BLOCK_SIZE);
+			printf("Correct MAC:\n");
+			dump_array((unsigned char *)t->mac, AES_BLOCK_SIZE);
+			TEST_ERROR("Wrong MAC", "AES-SW-CMAC", i);
+		}
+	}
+
+	/* an intermediate part without chaining value */
+	if (aes_cmac_sw(S390_CRYPTO_AES_128_ENCRYPT, tv_msg, AES_BLOCK_SIZE,
+			tv_key, AES_BLOCK_SIZE, NULL, NULL) != EINVAL)
+		TEST_ERROR("Missing chaining value accepted", "AES-SW-CMAC", 0UL);
+}
+
+int main(void)
+{
+	if (!ica_fallbacks_enabled)
+		exit(TEST_SKIP);
+
+	/* route the MSA 4 modes and GCM to the software implementations */
+	msa4_switch = 0;
+	msa8_switch = 0;
+
+	verbosity_ = 2;
+	aes_sw_tv_fill();
+
+	/* test exit on first failure */
+	aes_sw_cipher_test();
+	aes_sw_cmac_test();
+
+	return TEST_SUCC;
+}
+
+#endif /* ICA_INTERNAL_TEST_AES */
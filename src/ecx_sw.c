@@ -0,0 +1,1720 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+/*
+ * Software engine for X25519, X448, Ed25519 and Ed448.
+ *
+ * Field elements are kept in 64-bit limbs and multiplied via 128-bit
+ * products: radix 2^51 (5 limbs) for p = 2^255 - 19 and radix 2^56
+ * (8 limbs) for p = 2^448 - 2^224 - 1. Limbs are only weakly reduced
+ * between operations; a full reduction is done when encoding. Scalar
+ * multiplications use a Montgomery ladder with conditional swaps, so
+ * there are no secret dependent branches or memory accesses.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+#include <openssl/sha.h>
+
+#include "ecx_sw.h"
+#include "rng.h"
+
+typedef unsigned __int128 uint128_t;
+
+static inline uint64_t load64_le(const unsigned char *in)
+{
+	uint64_t r = 0;
+	int i;
+
+	for (i = 7; i >= 0; i--)
+		r = (r << 8) | in[i];
+	return r;
+}
+
+static inline void store64_le(unsigned char *out, uint64_t in)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		out[i] = in & 0xff;
+		in >>= 8;
+	}
+}
+
+/*
+ * GF(2^255 - 19)
+ */
+
+#define MASK51	((1ULL << 51) - 1)
+
+typedef struct {
+	uint64_t v[5];
+} fe25519;
+
+static void fe25519_frombytes(fe25519 *r, const unsigned char s[32])
+{
+	uint64_t w0 = load64_le(s), w1 = load64_le(s + 8),
+		 w2 = load64_le(s + 16), w3 = load64_le(s + 24);
+
+	/* bit 255 is ignored */
+	r->v[0] = w0 & MASK51;
+	r->v[1] = ((w0 >> 51) | (w1 << 13)) & MASK51;
+	r->v[2] = ((w1 >> 38) | (w2 << 26)) & MASK51;
+	r->v[3] = ((w2 >> 25) | (w3 << 39)) & MASK51;
+	r->v[4] = (w3 >> 12) & MASK51;
+}
+
+static void fe25519_carry(fe25519 *r)
+{
+	uint64_t c;
+
+	c = r->v[0] >> 51; r->v[0] &= MASK51; r->v[1] += c;
+	c = r->v[1] >> 51; r->v[1] &= MASK51; r->v[2] += c;
+	c = r->v[2] >> 51; r->v[2] &= MASK51; r->v[3] += c;
+	c = r->v[3] >> 51; r->v[3] &= MASK51; r->v[4] += c;
+	c = r->v[4] >> 51; r->v[4] &= MASK51; r->v[0] += 19 * c;
+	c = r->v[0] >> 51; r->v[0] &= MASK51; r->v[1] += c;
+}
+
+static void fe25519_tobytes(unsigned char s[32], const fe25519 *a)
+{
+	fe25519 t = *a;
+	uint64_t q;
+
+	fe25519_carry(&t);
+
+	/* q = 1 iff t >= p */
+	q = (t.v[0] + 19) >> 51;
+	q = (t.v[1] + q) >> 51;
+	q = (t.v[2] + q) >> 51;
+	q = (t.v[3] + q) >> 51;
+	q = (t.v[4] + q) >> 51;
+
+	/* t - q * p = t + 19 * q - q * 2^255 */
+	t.v[0] += 19 * q;
+	t.v[1] += t.v[0] >> 51; t.v[0] &= MASK51;
+	t.v[2] += t.v[1] >> 51; t.v[1] &= MASK51;
+	t.v[3] += t.v[2] >> 51; t.v[2] &= MASK51;
+	t.v[4] += t.v[3] >> 51; t.v[3] &= MASK51;
+	t.v[4] &= MASK51;
+
+	store64_le(s, t.v[0] | (t.v[1] << 51));
+	store64_le(s + 8, (t.v[1] >> 13) | (t.v[2] << 38));
+	store64_le(s + 16, (t.v[2] >> 26) | (t.v[3] << 25));
+	store64_le(s + 24, (t.v[3] >> 39) | (t.v[4] << 12));
+}
+
+static void fe25519_set(fe25519 *r, uint64_t x)
+{
+	memset(r, 0, sizeof(*r));
+	r->v[0] = x;
+}
+
+static void fe25519_add(fe25519 *r, const fe25519 *a, const fe25519 *b)
+{
+	int i;
+
+	for (i = 0; i < 5; i++)
+		r->v[i] = a->v[i] + b->v[i];
+	fe25519_carry(r);
+}
+
+static void fe25519_sub(fe25519 *r, const fe25519 *a, const fe25519 *b)
+{
+	int i;
+
+	/* add 2p to stay positive */
+	r->v[0] = a->v[0] + 0xfffffffffffdaULL - b->v[0];
+	for (i = 1; i < 5; i++)
+		r->v[i] = a->v[i] + 0xffffffffffffeULL - b->v[i];
+	fe25519_carry(r);
+}
+
+static void fe25519_neg(fe25519 *r, const fe25519 *a)
+{
+	fe25519 zero;
+
+	fe25519_set(&zero, 0);
+	fe25519_sub(r, &zero, a);
+}
+
+static void fe25519_reduce128(fe25519 *r, uint128_t t[5])
+{
+	uint128_t c;
+
+	t[1] += t[0] >> 51;
+	t[2] += t[1] >> 51;
+	t[3] += t[2] >> 51;
+	t[4] += t[3] >> 51;
+	c = (t[0] & MASK51) + (t[4] >> 51) * 19;
+
+	r->v[0] = (uint64_t)c & MASK51;
+	r->v[1] = ((uint64_t)t[1] & MASK51) + (uint64_t)(c >> 51);
+	r->v[2] = (uint64_t)t[2] & MASK51;
+	r->v[3] = (uint64_t)t[3] & MASK51;
+	r->v[4] = (uint64_t)t[4] & MASK51;
+}
+
+static void fe25519_mul(fe25519 *r, const fe25519 *a, const fe25519 *b)
+{
+	const uint64_t a0 = a->v[0], a1 = a->v[1], a2 = a->v[2],
+		       a3 = a->v[3], a4 = a->v[4];
+	const uint64_t b0 = b->v[0], b1 = b->v[1], b2 = b->v[2],
+		       b3 = b->v[3], b4 = b->v[4];
+	const uint64_t b1_19 = 19 * b1, b2_19 = 19 * b2, b3_19 = 19 * b3,
+		       b4_19 = 19 * b4;
+	uint128_t t[5];
+
+	t[0] = (uint128_t)a0 * b0 + (uint128_t)a1 * b4_19
+	     + (uint128_t)a2 * b3_19 + (uint128_t)a3 * b2_19
+	     + (uint128_t)a4 * b1_19;
+	t[1] = (uint128_t)a0 * b1 + (uint128_t)a1 * b0
+	     + (uint128_t)a2 * b4_19 + (uint128_t)a3 * b3_19
+	     + (uint128_t)a4 * b2_19;
+	t[2] = (uint128_t)a0 * b2 + (uint128_t)a1 * b1
+	     + (uint128_t)a2 * b0 + (uint128_t)a3 * b4_19
+	     + (uint128_t)a4 * b3_19;
+	t[3] = (uint128_t)a0 * b3 + (uint128_t)a1 * b2
+	     + (uint128_t)a2 * b1 + (uint128_t)a3 * b0
+	     + (uint128_t)a4 * b4_19;
+	t[4] = (uint128_t)a0 * b4 + (uint128_t)a1 * b3
+	     + (uint128_t)a2 * b2 + (uint128_t)a3 * b1
+	     + (uint128_t)a4 * b0;
+
+	fe25519_reduce128(r, t);
+}
+
+static void fe25519_sq(fe25519 *r, const fe25519 *a)
+{
+	const uint64_t a0 = a->v[0], a1 = a->v[1], a2 = a->v[2],
+		       a3 = a->v[3], a4 = a->v[4];
+	const uint64_t d0 = 2 * a0, d1 = 2 * a1, d2 = 2 * a2, d3 = 2 * a3;
+	const uint64_t a3_19 = 19 * a3, a4_19 = 19 * a4;
+	uint128_t t[5];
+
+	t[0] = (uint128_t)a0 * a0 + (uint128_t)d1 * a4_19
+	     + (uint128_t)d2 * a3_19;
+	t[1] = (uint128_t)d0 * a1 + (uint128_t)d2 * a4_19
+	     + (uint128_t)a3 * a3_19;
+	t[2] = (uint128_t)d0 * a2 + (uint128_t)a1 * a1
+	     + (uint128_t)d3 * a4_19;
+	t[3] = (uint128_t)d0 * a3 + (uint128_t)d1 * a2
+	     + (uint128_t)a4 * a4_19;
+	t[4] = (uint128_t)d0 * a4 + (uint128_t)d1 * a3
+	     + (uint128_t)a2 * a2;
+
+	fe25519_reduce128(r, t);
+}
+
+static void fe25519_sq_n(fe25519 *r, const fe25519 *a, int n)
+{
+	fe25519_sq(r, a);
+	while (--n > 0)
+		fe25519_sq(r, r);
+}
+
+static void fe25519_mul_small(fe25519 *r, const fe25519 *a, uint32_t k)
+{
+	uint128_t t[5];
+	int i;
+
+	for (i = 0; i < 5; i++)
+		t[i] = (uint128_t)a->v[i] * k;
+	fe25519_reduce128(r, t);
+}
+
+static void fe25519_cswap(fe25519 *a, fe25519 *b, uint64_t swap)
+{
+	const uint64_t mask = -swap;
+	uint64_t x;
+	int i;
+
+	for (i = 0; i < 5; i++) {
+		x = mask & (a->v[i] ^ b->v[i]);
+		a->v[i] ^= x;
+		b->v[i] ^= x;
+	}
+}
+
+/* Sets r = a^(2^250 - 1) and a11 = a^11. */
+static void fe25519_pow2501(fe25519 *r, fe25519 *a11, const fe25519 *a)
+{
+	fe25519 t0, t1, t2, t3;
+
+	fe25519_sq(&t0, a);			/* 2 */
+	fe25519_sq_n(&t1, &t0, 2);		/* 8 */
+	fe25519_mul(&t1, a, &t1);		/* 9 */
+	fe25519_mul(a11, &t0, &t1);		/* 11 */
+	fe25519_sq(&t0, a11);			/* 22 */
+	fe25519_mul(&t1, &t1, &t0);		/* 2^5 - 1 */
+	fe25519_sq_n(&t0, &t1, 5);
+	fe25519_mul(&t1, &t0, &t1);		/* 2^10 - 1 */
+	fe25519_sq_n(&t0, &t1, 10);
+	fe25519_mul(&t2, &t0, &t1);		/* 2^20 - 1 */
+	fe25519_sq_n(&t0, &t2, 20);
+	fe25519_mul(&t0, &t0, &t2);		/* 2^40 - 1 */
+	fe25519_sq_n(&t0, &t0, 10);
+	fe25519_mul(&t1, &t0, &t1);		/* 2^50 - 1 */
+	fe25519_sq_n(&t0, &t1, 50);
+	fe25519_mul(&t2, &t0, &t1);		/* 2^100 - 1 */
+	fe25519_sq_n(&t0, &t2, 100);
+	fe25519_mul(&t3, &t0, &t2);		/* 2^200 - 1 */
+	fe25519_sq_n(&t0, &t3, 50);
+	fe25519_mul(r, &t0, &t1);		/* 2^250 - 1 */
+}
+
+/* r = a^(p - 2) = 1 / a */
+static void fe25519_invert(fe25519 *r, const fe25519 *a)
+{
+	fe25519 t, a11;
+
+	fe25519_pow2501(&t, &a11, a);
+	fe25519_sq_n(&t, &t, 5);		/* 2^255 - 32 */
+	fe25519_mul(r, &t, &a11);		/* 2^255 - 21 */
+}
+
+/* r = a^((p - 5) / 8) */
+static void fe25519_pow22523(fe25519 *r, const fe25519 *a)
+{
+	fe25519 t, a11;
+
+	fe25519_pow2501(&t, &a11, a);
+	fe25519_sq_n(&t, &t, 2);		/* 2^252 - 4 */
+	fe25519_mul(r, &t, a);			/* 2^252 - 3 */
+}
+
+static int fe25519_equal(const fe25519 *a, const fe25519 *b)
+{
+	unsigned char sa[32], sb[32];
+
+	fe25519_tobytes(sa, a);
+	fe25519_tobytes(sb, b);
+	return CRYPTO_memcmp(sa, sb, 32) == 0;
+}
+
+/*
+ * GF(2^448 - 2^224 - 1)
+ */
+
+#define MASK56	((1ULL << 56) - 1)
+
+typedef struct {
+	uint64_t v[8];
+} fe448;
+
+static void fe448_frombytes(fe448 *r, const unsigned char s[56])
+{
+	int i, j;
+
+	for (i = 0; i < 8; i++) {
+		r->v[i] = 0;
+		for (j = 6; j >= 0; j--)
+			r->v[i] = (r->v[i] << 8) | s[7 * i + j];
+	}
+}
+
+static void fe448_carry(fe448 *r)
+{
+	uint64_t c;
+	int i;
+
+	for (i = 0; i < 7; i++) {
+		c = r->v[i] >> 56;
+		r->v[i] &= MASK56;
+		r->v[i + 1] += c;
+	}
+	/* 2^448 = 2^224 + 1 */
+	c = r->v[7] >> 56;
+	r->v[7] &= MASK56;
+	r->v[0] += c;
+	r->v[4] += c;
+}
+
+static void fe448_tobytes(unsigned char s[56], const fe448 *a)
+{
+	fe448 t = *a;
+	int64_t scarry = 0;
+	uint64_t carry = 0, mask;
+	int i, j;
+
+	fe448_carry(&t);
+
+	/* t - p, p = 2^448 - 2^224 - 1 */
+	for (i = 0; i < 8; i++) {
+		scarry += (int64_t)t.v[i] - (int64_t)(i == 4 ? MASK56 - 1 : MASK56);
+		t.v[i] = (uint64_t)scarry & MASK56;
+		scarry >>= 56;
+	}
+	/* add p back if t was < p */
+	mask = (uint64_t)scarry;
+	for (i = 0; i < 8; i++) {
+		carry += t.v[i] + (mask & (i == 4 ? MASK56 - 1 : MASK56));
+		t.v[i] = carry & MASK56;
+		carry >>= 56;
+	}
+
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 7; j++)
+			s[7 * i + j] = (t.v[i] >> (8 * j)) & 0xff;
+}
+
+static void fe448_set(fe448 *r, uint64_t x)
+{
+	memset(r, 0, sizeof(*r));
+	r->v[0] = x;
+}
+
+static void fe448_add(fe448 *r, const fe448 *a, const fe448 *b)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		r->v[i] = a->v[i] + b->v[i];
+	fe448_carry(r);
+}
+
+static void fe448_sub(fe448 *r, const fe448 *a, const fe448 *b)
+{
+	int i;
+
+	/* add 2p to stay positive */
+	for (i = 0; i < 8; i++)
+		r->v[i] = a->v[i] + (i == 4 ? 0x1fffffffffffffcULL
+					    : 0x1fffffffffffffeULL) - b->v[i];
+	fe448_carry(r);
+}
+
+static void fe448_neg(fe448 *r, const fe448 *a)
+{
+	fe448 zero;
+
+	fe448_set(&zero, 0);
+	fe448_sub(r, &zero, a);
+}
+
+static void fe448_reduce128(fe448 *r, uint128_t t[8])
+{
+	uint128_t c;
+	int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = 0; i < 7; i++) {
+			t[i + 1] += t[i] >> 56;
+			t[i] &= MASK56;
+		}
+		c = t[7] >> 56;
+		t[7] &= MASK56;
+		t[0] += c;
+		t[4] += c;
+	}
+
+	for (i = 0; i < 8; i++)
+		r->v[i] = (uint64_t)t[i];
+}
+
+static void fe448_mul(fe448 *r, const fe448 *a, const fe448 *b)
+{
+	uint128_t t[15];
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+	for (i = 0; i < 8; i++)
+		for (j = 0; j < 8; j++)
+			t[i + j] += (uint128_t)a->v[i] * b->v[j];
+
+	/* fold limbs 8..14 with 2^448 = 2^224 + 1, top down */
+	for (i = 14; i >= 8; i--) {
+		t[i - 8] += t[i];
+		t[i - 4] += t[i];
+	}
+
+	fe448_reduce128(r, t);
+}
+
+static void fe448_sq(fe448 *r, const fe448 *a)
+{
+	uint128_t t[15];
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+	for (i = 0; i < 8; i++) {
+		t[2 * i] += (uint128_t)a->v[i] * a->v[i];
+		for (j = i + 1; j < 8; j++)
+			t[i + j] += (uint128_t)(2 * a->v[i]) * a->v[j];
+	}
+
+	for (i = 14; i >= 8; i--) {
+		t[i - 8] += t[i];
+		t[i - 4] += t[i];
+	}
+
+	fe448_reduce128(r, t);
+}
+
+static void fe448_sq_n(fe448 *r, const fe448 *a, int n)
+{
+	fe448_sq(r, a);
+	while (--n > 0)
+		fe448_sq(r, r);
+}
+
+static void fe448_mul_small(fe448 *r, const fe448 *a, uint32_t k)
+{
+	uint128_t t[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		t[i] = (uint128_t)a->v[i] * k;
+	fe448_reduce128(r, t);
+}
+
+static void fe448_cswap(fe448 *a, fe448 *b, uint64_t swap)
+{
+	const uint64_t mask = -swap;
+	uint64_t x;
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		x = mask & (a->v[i] ^ b->v[i]);
+		a->v[i] ^= x;
+		b->v[i] ^= x;
+	}
+}
+
+/* r = a^((p - 3) / 4) = a^(2^446 - 2^222 - 1) */
+static void fe448_pow_p34(fe448 *r, const fe448 *a)
+{
+	fe448 b3, b6, b12, b24, b30, b48, b96, b192, b222, b223, t;
+
+	fe448_sq(&t, a);
+	fe448_mul(&t, &t, a);			/* 2^2 - 1 */
+	fe448_sq(&t, &t);
+	fe448_mul(&b3, &t, a);			/* 2^3 - 1 */
+	fe448_sq_n(&t, &b3, 3);
+	fe448_mul(&b6, &t, &b3);		/* 2^6 - 1 */
+	fe448_sq_n(&t, &b6, 6);
+	fe448_mul(&b12, &t, &b6);		/* 2^12 - 1 */
+	fe448_sq_n(&t, &b12, 12);
+	fe448_mul(&b24, &t, &b12);		/* 2^24 - 1 */
+	fe448_sq_n(&t, &b24, 6);
+	fe448_mul(&b30, &t, &b6);		/* 2^30 - 1 */
+	fe448_sq_n(&t, &b24, 24);
+	fe448_mul(&b48, &t, &b24);		/* 2^48 - 1 */
+	fe448_sq_n(&t, &b48, 48);
+	fe448_mul(&b96, &t, &b48);		/* 2^96 - 1 */
+	fe448_sq_n(&t, &b96, 96);
+	fe448_mul(&b192, &t, &b96);		/* 2^192 - 1 */
+	fe448_sq_n(&t, &b192, 30);
+	fe448_mul(&b222, &t, &b30);		/* 2^222 - 1 */
+	fe448_sq(&t, &b222);
+	fe448_mul(&b223, &t, a);		/* 2^223 - 1 */
+	fe448_sq_n(&t, &b223, 223);
+	fe448_mul(r, &t, &b222);		/* 2^446 - 2^222 - 1 */
+}
+
+/* r = a^(p - 2) = 1 / a */
+static void fe448_invert(fe448 *r, const fe448 *a)
+{
+	fe448 t;
+
+	fe448_pow_p34(&t, a);
+	fe448_sq_n(&t, &t, 2);			/* 2^448 - 2^224 - 4 */
+	fe448_mul(r, &t, a);			/* 2^448 - 2^224 - 3 */
+}
+
+static int fe448_equal(const fe448 *a, const fe448 *b)
+{
+	unsigned char sa[56], sb[56];
+
+	fe448_tobytes(sa, a);
+	fe448_tobytes(sb, b);
+	return CRYPTO_memcmp(sa, sb, 56) == 0;
+}
+
+/*
+ * X25519 and X448 (RFC 7748)
+ */
+
+int x25519_sw(unsigned char res_u[32], const unsigned char scalar[32],
+	      const unsigned char u[32])
+{
+	fe25519 x1, x2, z2, x3, z3, a, aa, b, bb, e, c, d, da, cb;
+	unsigned char k[32];
+	uint64_t swap = 0, bit;
+	int t;
+
+	memcpy(k, scalar, sizeof(k));
+	k[0] &= 248;
+	k[31] &= 127;
+	k[31] |= 64;
+
+	fe25519_frombytes(&x1, u);
+	fe25519_set(&x2, 1);
+	fe25519_set(&z2, 0);
+	x3 = x1;
+	fe25519_set(&z3, 1);
+
+	for (t = 254; t >= 0; t--) {
+		bit = (k[t >> 3] >> (t & 7)) & 1;
+		swap ^= bit;
+		fe25519_cswap(&x2, &x3, swap);
+		fe25519_cswap(&z2, &z3, swap);
+		swap = bit;
+
+		fe25519_add(&a, &x2, &z2);
+		fe25519_sq(&aa, &a);
+		fe25519_sub(&b, &x2, &z2);
+		fe25519_sq(&bb, &b);
+		fe25519_sub(&e, &aa, &bb);
+		fe25519_add(&c, &x3, &z3);
+		fe25519_sub(&d, &x3, &z3);
+		fe25519_mul(&da, &d, &a);
+		fe25519_mul(&cb, &c, &b);
+		fe25519_add(&x3, &da, &cb);
+		fe25519_sq(&x3, &x3);
+		fe25519_sub(&z3, &da, &cb);
+		fe25519_sq(&z3, &z3);
+		fe25519_mul(&z3, &z3, &x1);
+		fe25519_mul(&x2, &aa, &bb);
+		fe25519_mul_small(&z2, &e, 121665);
+		fe25519_add(&z2, &z2, &aa);
+		fe25519_mul(&z2, &z2, &e);
+	}
+	fe25519_cswap(&x2, &x3, swap);
+	fe25519_cswap(&z2, &z3, swap);
+
+	fe25519_invert(&z2, &z2);
+	fe25519_mul(&x2, &x2, &z2);
+	fe25519_tobytes(res_u, &x2);
+
+	OPENSSL_cleanse(k, sizeof(k));
+	OPENSSL_cleanse(&x2, sizeof(x2));
+	OPENSSL_cleanse(&z2, sizeof(z2));
+	OPENSSL_cleanse(&x3, sizeof(x3));
+	OPENSSL_cleanse(&z3, sizeof(z3));
+	return 0;
+}
+
+int x448_sw(unsigned char res_u[56], const unsigned char scalar[56],
+	    const unsigned char u[56])
+{
+	fe448 x1, x2, z2, x3, z3, a, aa, b, bb, e, c, d, da, cb;
+	unsigned char k[56];
+	uint64_t swap = 0, bit;
+	int t;
+
+	memcpy(k, scalar, sizeof(k));
+	k[0] &= 252;
+	k[55] |= 128;
+
+	fe448_frombytes(&x1, u);
+	fe448_set(&x2, 1);
+	fe448_set(&z2, 0);
+	x3 = x1;
+	fe448_set(&z3, 1);
+
+	for (t = 447; t >= 0; t--) {
+		bit = (k[t >> 3] >> (t & 7)) & 1;
+		swap ^= bit;
+		fe448_cswap(&x2, &x3, swap);
+		fe448_cswap(&z2, &z3, swap);
+		swap = bit;
+
+		fe448_add(&a, &x2, &z2);
+		fe448_sq(&aa, &a);
+		fe448_sub(&b, &x2, &z2);
+		fe448_sq(&bb, &b);
+		fe448_sub(&e, &aa, &bb);
+		fe448_add(&c, &x3, &z3);
+		fe448_sub(&d, &x3, &z3);
+		fe448_mul(&da, &d, &a);
+		fe448_mul(&cb, &c, &b);
+		fe448_add(&x3, &da, &cb);
+		fe448_sq(&x3, &x3);
+		fe448_sub(&z3, &da, &cb);
+		fe448_sq(&z3, &z3);
+		fe448_mul(&z3, &z3, &x1);
+		fe448_mul(&x2, &aa, &bb);
+		fe448_mul_small(&z2, &e, 39081);
+		fe448_add(&z2, &z2, &aa);
+		fe448_mul(&z2, &z2, &e);
+	}
+	fe448_cswap(&x2, &x3, swap);
+	fe448_cswap(&z2, &z3, swap);
+
+	fe448_invert(&z2, &z2);
+	fe448_mul(&x2, &x2, &z2);
+	fe448_tobytes(res_u, &x2);
+
+	OPENSSL_cleanse(k, sizeof(k));
+	OPENSSL_cleanse(&x2, sizeof(x2));
+	OPENSSL_cleanse(&z2, sizeof(z2));
+	OPENSSL_cleanse(&x3, sizeof(x3));
+	OPENSSL_cleanse(&z3, sizeof(z3));
+	return 0;
+}
+
+/*
+ * Scalars modulo the group order l
+ */
+
+#define SC_MAX_LIMBS	8
+
+/* l = 2^252 + 27742317777372353535851937790883648493 */
+static const uint64_t ed25519_l[4] = {
+	0x5812631a5cf5d3edULL, 0x14def9dea2f79cd6ULL,
+	0x0000000000000000ULL, 0x1000000000000000ULL,
+};
+
+/* l = 2^446 - 13818066809895115352007386748515426880336692474882178609894547503885 */
+static const uint64_t ed448_l[7] = {
+	0x2378c292ab5844f3ULL, 0x216cc2728dc58f55ULL,
+	0xc44edb49aed63690ULL, 0xffffffff7cca23e9ULL,
+	0xffffffffffffffffULL, 0xffffffffffffffffULL,
+	0x3fffffffffffffffULL,
+};
+
+/*
+ * r = in mod l, for an n limb l < 2^(64n - 1). Bit serial and constant
+ * time; the inputs are at most 114 bytes, so this is cheap compared to
+ * a scalar multiplication.
+ */
+static void sc_reduce(uint64_t *r, const unsigned char *in, size_t inlen,
+		      const uint64_t *l, size_t n)
+{
+	uint64_t t[SC_MAX_LIMBS], borrow, mask;
+	uint128_t d;
+	size_t i, j;
+
+	memset(r, 0, n * sizeof(*r));
+	for (i = inlen * 8; i-- > 0; ) {
+		for (j = n - 1; j > 0; j--)
+			r[j] = (r[j] << 1) | (r[j - 1] >> 63);
+		r[0] = (r[0] << 1) | ((in[i >> 3] >> (i & 7)) & 1);
+
+		borrow = 0;
+		for (j = 0; j < n; j++) {
+			d = (uint128_t)r[j] - l[j] - borrow;
+			t[j] = (uint64_t)d;
+			borrow = (uint64_t)(d >> 64) & 1;
+		}
+		mask = borrow - 1;	/* all ones if r >= l */
+		for (j = 0; j < n; j++)
+			r[j] = (t[j] & mask) | (r[j] & ~mask);
+	}
+	OPENSSL_cleanse(t, sizeof(t));
+}
+
+static void sc_tobytes(unsigned char *out, size_t outlen, const uint64_t *r,
+		       size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < outlen; i++)
+		out[i] = i < 8 * n ? (r[i >> 3] >> (8 * (i & 7))) & 0xff : 0;
+}
+
+static void sc_frombytes(uint64_t *r, size_t n, const unsigned char *in,
+			 size_t inlen)
+{
+	size_t i;
+
+	memset(r, 0, n * sizeof(*r));
+	for (i = 0; i < inlen; i++)
+		r[i >> 3] |= (uint64_t)in[i] << (8 * (i & 7));
+}
+
+/* out = (a * b + c) mod l, all scalars len bytes long */
+static void sc_muladd(unsigned char *out, const unsigned char *a,
+		      const unsigned char *b, const unsigned char *c,
+		      size_t len, const uint64_t *l, size_t n)
+{
+	uint64_t x[SC_MAX_LIMBS], y[SC_MAX_LIMBS], z[SC_MAX_LIMBS];
+	uint64_t p[2 * SC_MAX_LIMBS], r[SC_MAX_LIMBS], carry;
+	unsigned char buf[16 * SC_MAX_LIMBS];
+	const size_t m = (len + 7) / 8;
+	uint128_t t;
+	size_t i, j;
+
+	sc_frombytes(x, m, a, len);
+	sc_frombytes(y, m, b, len);
+	sc_frombytes(z, m, c, len);
+
+	memset(p, 0, sizeof(p));
+	for (i = 0; i < m; i++) {
+		carry = 0;
+		for (j = 0; j < m; j++) {
+			t = (uint128_t)x[i] * y[j] + p[i + j] + carry;
+			p[i + j] = (uint64_t)t;
+			carry = (uint64_t)(t >> 64);
+		}
+		p[i + m] = carry;
+	}
+	carry = 0;
+	for (i = 0; i < 2 * m; i++) {
+		t = (uint128_t)p[i] + (i < m ? z[i] : 0) + carry;
+		p[i] = (uint64_t)t;
+		carry = (uint64_t)(t >> 64);
+	}
+
+	for (i = 0; i < 2 * m; i++)
+		store64_le(buf + 8 * i, p[i]);
+	sc_reduce(r, buf, 16 * m, l, n);
+	sc_tobytes(out, len, r, n);
+
+	OPENSSL_cleanse(x, sizeof(x));
+	OPENSSL_cleanse(y, sizeof(y));
+	OPENSSL_cleanse(z, sizeof(z));
+	OPENSSL_cleanse(p, sizeof(p));
+	OPENSSL_cleanse(r, sizeof(r));
+	OPENSSL_cleanse(buf, sizeof(buf));
+}
+
+/* Returns 1 if the len byte scalar s is < l. */
+static int sc_is_canonical(const unsigned char *s, size_t len,
+			   const uint64_t *l, size_t n)
+{
+	uint64_t r[SC_MAX_LIMBS];
+	size_t i;
+
+	for (i = 8 * n; i < len; i++) {
+		if (s[i] != 0)
+			return 0;
+	}
+	sc_frombytes(r, n, s, len < 8 * n ? len : 8 * n);
+	for (i = n; i-- > 0; ) {
+		if (r[i] != l[i])
+			return r[i] < l[i];
+	}
+	return 0;
+}
+
+/*
+ * Ed25519: twisted Edwards curve -x^2 + y^2 = 1 + d x^2 y^2 in extended
+ * coordinates (X:Y:Z:T), x = X/Z, y = Y/Z, x*y = T/Z.
+ */
+
+typedef struct {
+	fe25519 x, y, z, t;
+} ge25519;
+
+static const unsigned char ed25519_d[32] = {
+	0xa3, 0x78, 0x59, 0x13, 0xca, 0x4d, 0xeb, 0x75,
+	0xab, 0xd8, 0x41, 0x41, 0x4d, 0x0a, 0x70, 0x00,
+	0x98, 0xe8, 0x79, 0x77, 0x79, 0x40, 0xc7, 0x8c,
+	0x73, 0xfe, 0x6f, 0x2b, 0xee, 0x6c, 0x03, 0x52,
+};
+
+static const unsigned char ed25519_sqrtm1[32] = {
+	0xb0, 0xa0, 0x0e, 0x4a, 0x27, 0x1b, 0xee, 0xc4,
+	0x78, 0xe4, 0x2f, 0xad, 0x06, 0x18, 0x43, 0x2f,
+	0xa7, 0xd7, 0xfb, 0x3d, 0x99, 0x00, 0x4d, 0x2b,
+	0x0b, 0xdf, 0xc1, 0x4f, 0x80, 0x24, 0x83, 0x2b,
+};
+
+static const unsigned char ed25519_base_x[32] = {
+	0x1a, 0xd5, 0x25, 0x8f, 0x60, 0x2d, 0x56, 0xc9,
+	0xb2, 0xa7, 0x25, 0x95, 0x60, 0xc7, 0x2c, 0x69,
+	0x5c, 0xdc, 0xd6, 0xfd, 0x31, 0xe2, 0xa4, 0xc0,
+	0xfe, 0x53, 0x6e, 0xcd, 0xd3, 0x36, 0x69, 0x21,
+};
+
+static const unsigned char ed25519_base_y[32] = {
+	0x58, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+	0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+	0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+	0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66,
+};
+
+static void ge25519_identity(ge25519 *r)
+{
+	fe25519_set(&r->x, 0);
+	fe25519_set(&r->y, 1);
+	fe25519_set(&r->z, 1);
+	fe25519_set(&r->t, 0);
+}
+
+static void ge25519_base(ge25519 *r)
+{
+	fe25519_frombytes(&r->x, ed25519_base_x);
+	fe25519_frombytes(&r->y, ed25519_base_y);
+	fe25519_set(&r->z, 1);
+	fe25519_mul(&r->t, &r->x, &r->y);
+}
+
+/* add-2008-hwcd-3, complete for Ed25519 */
+static void ge25519_add(ge25519 *r, const ge25519 *p, const ge25519 *q)
+{
+	fe25519 a, b, c, d, e, f, g, h, t, d2;
+
+	fe25519_sub(&a, &p->y, &p->x);
+	fe25519_sub(&t, &q->y, &q->x);
+	fe25519_mul(&a, &a, &t);
+	fe25519_add(&b, &p->y, &p->x);
+	fe25519_add(&t, &q->y, &q->x);
+	fe25519_mul(&b, &b, &t);
+	fe25519_frombytes(&d2, ed25519_d);
+	fe25519_add(&d2, &d2, &d2);
+	fe25519_mul(&c, &p->t, &q->t);
+	fe25519_mul(&c, &c, &d2);
+	fe25519_mul(&d, &p->z, &q->z);
+	fe25519_add(&d, &d, &d);
+	fe25519_sub(&e, &b, &a);
+	fe25519_sub(&f, &d, &c);
+	fe25519_add(&g, &d, &c);
+	fe25519_add(&h, &b, &a);
+
+	fe25519_mul(&r->x, &e, &f);
+	fe25519_mul(&r->y, &g, &h);
+	fe25519_mul(&r->t, &e, &h);
+	fe25519_mul(&r->z, &f, &g);
+}
+
+/* dbl-2008-hwcd */
+static void ge25519_dbl(ge25519 *r, const ge25519 *p)
+{
+	fe25519 a, b, c, e, f, g, h;
+
+	fe25519_sq(&a, &p->x);
+	fe25519_sq(&b, &p->y);
+	fe25519_sq(&c, &p->z);
+	fe25519_add(&c, &c, &c);
+	fe25519_add(&h, &a, &b);
+	fe25519_add(&e, &p->x, &p->y);
+	fe25519_sq(&e, &e);
+	fe25519_sub(&e, &h, &e);
+	fe25519_sub(&g, &a, &b);
+	fe25519_add(&f, &c, &g);
+
+	fe25519_mul(&r->x, &e, &f);
+	fe25519_mul(&r->y, &g, &h);
+	fe25519_mul(&r->t, &e, &h);
+	fe25519_mul(&r->z, &f, &g);
+}
+
+static void ge25519_cswap(ge25519 *p, ge25519 *q, uint64_t swap)
+{
+	fe25519_cswap(&p->x, &q->x, swap);
+	fe25519_cswap(&p->y, &q->y, swap);
+	fe25519_cswap(&p->z, &q->z, swap);
+	fe25519_cswap(&p->t, &q->t, swap);
+}
+
+/* r = [k]p, k is a little-endian scalar of at most bits bits */
+static void ge25519_scalarmult(ge25519 *r, const ge25519 *p,
+			       const unsigned char *k, int bits)
+{
+	ge25519 r0, r1;
+	uint64_t swap = 0, bit;
+	int i;
+
+	ge25519_identity(&r0);
+	r1 = *p;
+	for (i = bits - 1; i >= 0; i--) {
+		bit = (k[i >> 3] >> (i & 7)) & 1;
+		ge25519_cswap(&r0, &r1, swap ^ bit);
+		swap = bit;
+		ge25519_add(&r1, &r0, &r1);
+		ge25519_dbl(&r0, &r0);
+	}
+	ge25519_cswap(&r0, &r1, swap);
+
+	*r = r0;
+	OPENSSL_cleanse(&r0, sizeof(r0));
+	OPENSSL_cleanse(&r1, sizeof(r1));
+}
+
+static void ge25519_encode(unsigned char s[32], const ge25519 *p)
+{
+	fe25519 zinv, x, y;
+	unsigned char xs[32];
+
+	fe25519_invert(&zinv, &p->z);
+	fe25519_mul(&x, &p->x, &zinv);
+	fe25519_mul(&y, &p->y, &zinv);
+	fe25519_tobytes(s, &y);
+	fe25519_tobytes(xs, &x);
+	s[31] |= (xs[0] & 1) << 7;
+}
+
+/* Returns 0 if s is the canonical encoding of a curve point. */
+static int ge25519_decode(ge25519 *r, const unsigned char s[32])
+{
+	fe25519 u, v, v3, vx2, t, one, d;
+	unsigned char check[32], xs[32];
+	const int sign = s[31] >> 7;
+
+	fe25519_frombytes(&r->y, s);
+	fe25519_tobytes(check, &r->y);
+	check[31] |= sign << 7;
+	if (memcmp(check, s, 32))
+		return EINVAL;		/* y >= p */
+
+	/* x^2 = (y^2 - 1) / (d y^2 + 1) = u / v */
+	fe25519_set(&one, 1);
+	fe25519_frombytes(&d, ed25519_d);
+	fe25519_sq(&u, &r->y);
+	fe25519_mul(&v, &u, &d);
+	fe25519_sub(&u, &u, &one);
+	fe25519_add(&v, &v, &one);
+
+	/* x = u v^3 (u v^7)^((p - 5) / 8) */
+	fe25519_sq(&v3, &v);
+	fe25519_mul(&v3, &v3, &v);
+	fe25519_sq(&t, &v3);
+	fe25519_mul(&t, &t, &v);
+	fe25519_mul(&t, &t, &u);
+	fe25519_pow22523(&t, &t);
+	fe25519_mul(&t, &t, &v3);
+	fe25519_mul(&r->x, &t, &u);
+
+	fe25519_sq(&vx2, &r->x);
+	fe25519_mul(&vx2, &vx2, &v);
+	if (!fe25519_equal(&vx2, &u)) {
+		fe25519_neg(&t, &u);
+		if (!fe25519_equal(&vx2, &t))
+			return EINVAL;	/* not a square */
+		fe25519_frombytes(&t, ed25519_sqrtm1);
+		fe25519_mul(&r->x, &r->x, &t);
+	}
+
+	fe25519_tobytes(xs, &r->x);
+	if ((xs[0] & 1) != sign) {
+		fe25519_set(&t, 0);
+		if (fe25519_equal(&r->x, &t))
+			return EINVAL;	/* x = 0 with sign bit set */
+		fe25519_neg(&r->x, &r->x);
+	}
+
+	fe25519_set(&r->z, 1);
+	fe25519_mul(&r->t, &r->x, &r->y);
+	return 0;
+}
+
+static void ed25519_hash(unsigned char out[64],
+			 const unsigned char *a, size_t alen,
+			 const unsigned char *b, size_t blen,
+			 const unsigned char *c, size_t clen)
+{
+	SHA512_CTX ctx;
+
+	SHA512_Init(&ctx);
+	if (alen)
+		SHA512_Update(&ctx, a, alen);
+	if (blen)
+		SHA512_Update(&ctx, b, blen);
+	if (clen)
+		SHA512_Update(&ctx, c, clen);
+	SHA512_Final(out, &ctx);
+	OPENSSL_cleanse(&ctx, sizeof(ctx));
+}
+
+/* h = SHA-512(priv), with the lower half clamped to the secret scalar */
+static void ed25519_expand(unsigned char h[64], const unsigned char priv[32])
+{
+	ed25519_hash(h, priv, 32, NULL, 0, NULL, 0);
+	h[0] &= 248;
+	h[31] &= 127;
+	h[31] |= 64;
+}
+
+int ed25519_derive_pub_sw(unsigned char pub[32],
+			  const unsigned char priv[32])
+{
+	unsigned char h[64];
+	ge25519 b, a;
+
+	ed25519_expand(h, priv);
+	ge25519_base(&b);
+	ge25519_scalarmult(&a, &b, h, 255);
+	ge25519_encode(pub, &a);
+
+	OPENSSL_cleanse(h, sizeof(h));
+	OPENSSL_cleanse(&a, sizeof(a));
+	return 0;
+}
+
+int ed25519_sign_sw(unsigned char sig[64], const unsigned char priv[32],
+		    const unsigned char *msg, size_t msglen)
+{
+	unsigned char h[64], hash[64], r[32], k[32], pub[32];
+	uint64_t sc[4];
+	ge25519 b, p;
+
+	ed25519_expand(h, priv);
+	ge25519_base(&b);
+	ge25519_scalarmult(&p, &b, h, 255);
+	ge25519_encode(pub, &p);
+
+	/* r = SHA-512(prefix || M) mod l, R = [r]B */
+	ed25519_hash(hash, h + 32, 32, msg, msglen, NULL, 0);
+	sc_reduce(sc, hash, sizeof(hash), ed25519_l, 4);
+	sc_tobytes(r, sizeof(r), sc, 4);
+	ge25519_scalarmult(&p, &b, r, 255);
+	ge25519_encode(sig, &p);
+
+	/* k = SHA-512(R || A || M) mod l, S = r + k s mod l */
+	ed25519_hash(hash, sig, 32, pub, 32, msg, msglen);
+	sc_reduce(sc, hash, sizeof(hash), ed25519_l, 4);
+	sc_tobytes(k, sizeof(k), sc, 4);
+	sc_muladd(sig + 32, k, h, r, 32, ed25519_l, 4);
+
+	OPENSSL_cleanse(h, sizeof(h));
+	OPENSSL_cleanse(hash, sizeof(hash));
+	OPENSSL_cleanse(r, sizeof(r));
+	OPENSSL_cleanse(sc, sizeof(sc));
+	OPENSSL_cleanse(&p, sizeof(p));
+	return 0;
+}
+
+int ed25519_verify_sw(const unsigned char sig[64],
+		      const unsigned char pub[32],
+		      const unsigned char *msg, size_t msglen)
+{
+	unsigned char hash[64], k[32], r[32];
+	uint64_t sc[4];
+	ge25519 a, b, p, q;
+
+	if (!sc_is_canonical(sig + 32, 32, ed25519_l, 4))
+		return EINVAL;
+	if (ge25519_decode(&a, pub))
+		return EINVAL;
+
+	ed25519_hash(hash, sig, 32, pub, 32, msg, msglen);
+	sc_reduce(sc, hash, sizeof(hash), ed25519_l, 4);
+	sc_tobytes(k, sizeof(k), sc, 4);
+
+	/* R == [S]B - [k]A */
+	fe25519_neg(&a.x, &a.x);
+	fe25519_neg(&a.t, &a.t);
+	ge25519_base(&b);
+	ge25519_scalarmult(&p, &b, sig + 32, 255);
+	ge25519_scalarmult(&q, &a, k, 255);
+	ge25519_add(&p, &p, &q);
+	ge25519_encode(r, &p);
+
+	return CRYPTO_memcmp(r, sig, 32) ? EINVAL : 0;
+}
+
+/*
+ * Ed25519 batch verification
+ *
+ * For random 128-bit z_i the batch equation
+ *
+ *	[-sum z_i S_i]B + sum [z_i]R_i + sum [z_i k_i]A_i = 0
+ *
+ * holds if all signatures are valid and fails with probability at least
+ * 1 - 2^-128 otherwise, provided that all A_i and R_i are in the subgroup
+ * of order l. For such points it is equivalent to the cofactorless
+ * equation of ed25519_verify_sw() and KDSA. Signatures with an A or R that
+ * has a small order component are verified on their own, so a batch
+ * accepts exactly the signatures that are accepted one by one, whatever
+ * its size. The left hand side is a multi-scalar multiplication,
+ * computed with Pippenger's bucket method, which is much cheaper than 2n
+ * separate scalar multiplications. All inputs are public, so the code is
+ * not constant-time. If the equation fails, the batch is split in halves
+ * until the invalid signatures are found.
+ */
+
+#define ED25519_BATCH_MIN	4	/* verify smaller batches one by one */
+
+struct ed25519_batch {
+	const unsigned char *const *msg;
+	const size_t *msglen;
+	const unsigned char *const *sig;
+	const unsigned char *const *pub;
+	int *status;
+
+	ge25519 *a;			/* decoded public keys */
+	ge25519 *r;			/* decoded R parts */
+	unsigned char (*k)[32];		/* SHA-512(R || A || M) mod l */
+
+	/* multi-scalar multiplication workspace */
+	ge25519 *points;
+	unsigned char (*scalars)[32];
+	unsigned char (*z)[16];
+};
+
+static int ge25519_is_identity(const ge25519 *p)
+{
+	fe25519 zero;
+
+	fe25519_set(&zero, 0);
+	return fe25519_equal(&p->x, &zero) && fe25519_equal(&p->y, &p->z);
+}
+
+/* Returns 1 if [l]p = 0, i.e. p has no small order component. */
+static int ge25519_is_torsion_free(const ge25519 *p)
+{
+	unsigned char l[32];
+	ge25519 q;
+	int i;
+
+	/* p is public, double-and-add */
+	sc_tobytes(l, sizeof(l), ed25519_l, 4);
+	ge25519_identity(&q);
+	for (i = 252; i >= 0; i--) {
+		ge25519_dbl(&q, &q);
+		if ((l[i >> 3] >> (i & 7)) & 1)
+			ge25519_add(&q, &q, p);
+	}
+	return ge25519_is_identity(&q);
+}
+
+/* r = sum [scalars[i]]points[i] */
+static int ge25519_msm(ge25519 *r, const ge25519 *points,
+		       const unsigned char (*scalars)[32], size_t n)
+{
+	ge25519 *buckets, running, sum;
+	unsigned char *used;
+	unsigned int c, nbuckets, digit, bit;
+	size_t i;
+	int w, j;
+
+	/* window size: about log2(n) - 2 bits */
+	for (c = 2; c < 12 && ((size_t)1 << (c + 2)) < n; c++)
+		;
+	nbuckets = (1U << c) - 1;
+
+	buckets = malloc(nbuckets * sizeof(*buckets));
+	used = malloc(nbuckets);
+	if (buckets == NULL || used == NULL) {
+		free(buckets);
+		free(used);
+		return ENOMEM;
+	}
+
+	ge25519_identity(r);
+	for (w = (256 + c - 1) / c - 1; w >= 0; w--) {
+		for (j = 0; j < (int)c; j++)
+			ge25519_dbl(r, r);
+
+		memset(used, 0, nbuckets);
+		for (i = 0; i < n; i++) {
+			digit = 0;
+			for (j = c - 1; j >= 0; j--) {
+				bit = w * c + j;
+				if (bit < 256)
+					digit = (digit << 1)
+					      | ((scalars[i][bit >> 3]
+						  >> (bit & 7)) & 1);
+				else
+					digit <<= 1;
+			}
+			if (digit == 0)
+				continue;
+			if (used[digit - 1]) {
+				ge25519_add(&buckets[digit - 1],
+					    &buckets[digit - 1], &points[i]);
+			} else {
+				buckets[digit - 1] = points[i];
+				used[digit - 1] = 1;
+			}
+		}
+
+		/* sum [d]bucket[d - 1] = sum of the running sums, top down */
+		ge25519_identity(&running);
+		ge25519_identity(&sum);
+		for (i = nbuckets; i-- > 0; ) {
+			if (used[i])
+				ge25519_add(&running, &running, &buckets[i]);
+			ge25519_add(&sum, &sum, &running);
+		}
+		ge25519_add(r, r, &sum);
+	}
+
+	free(buckets);
+	free(used);
+	return 0;
+}
+
+/* Checks the batch equation for the entries idx[0..n-1]. */
+static int ed25519_batch_equation(struct ed25519_batch *b, const size_t *idx,
+				  size_t n)
+{
+	static const unsigned char zero[32];
+	unsigned char s[32], z[32];
+	uint64_t lm1[4];
+	ge25519 res;
+	size_t i, j;
+	int rc;
+
+	rng_gen((unsigned char *)b->z, n * sizeof(*b->z));
+	memset(s, 0, sizeof(s));
+	memset(z, 0, sizeof(z));
+	for (i = 0; i < n; i++) {
+		j = idx[i];
+		memcpy(z, b->z[i], sizeof(b->z[i]));
+
+		/* s += z_i S_i */
+		sc_muladd(s, z, b->sig[j] + 32, s, 32, ed25519_l, 4);
+
+		memcpy(b->scalars[2 * i], z, 32);
+		b->points[2 * i] = b->r[j];
+		sc_muladd(b->scalars[2 * i + 1], z, b->k[j], zero, 32,
+			  ed25519_l, 4);
+		b->points[2 * i + 1] = b->a[j];
+	}
+
+	/* -s = (l - 1) s mod l */
+	memcpy(lm1, ed25519_l, sizeof(lm1));
+	lm1[0]--;
+	sc_tobytes(z, sizeof(z), lm1, 4);
+	sc_muladd(b->scalars[2 * n], z, s, zero, 32, ed25519_l, 4);
+	ge25519_base(&b->points[2 * n]);
+
+	rc = ge25519_msm(&res, b->points,
+			 (const unsigned char (*)[32])b->scalars, 2 * n + 1);
+	if (rc)
+		return rc;
+
+	return ge25519_is_identity(&res) ? 0 : EINVAL;
+}
+
+static int ed25519_batch_verify(struct ed25519_batch *b, const size_t *idx,
+				size_t n)
+{
+	size_t i;
+	int rc;
+
+	if (n < ED25519_BATCH_MIN) {
+		for (i = 0; i < n; i++) {
+			if (ed25519_verify_sw(b->sig[idx[i]], b->pub[idx[i]],
+					      b->msg[idx[i]],
+					      b->msglen[idx[i]]))
+				b->status[idx[i]] = -1;
+		}
+		return 0;
+	}
+
+	rc = ed25519_batch_equation(b, idx, n);
+	if (rc != EINVAL)
+		return rc;
+
+	rc = ed25519_batch_verify(b, idx, n / 2);
+	if (rc)
+		return rc;
+	return ed25519_batch_verify(b, idx + n / 2, n - n / 2);
+}
+
+int ed25519_verify_batch_sw(unsigned int num,
+			    const unsigned char *const msg[],
+			    const size_t msglen[],
+			    const unsigned char *const sig[],
+			    const unsigned char *const pub[],
+			    int status[])
+{
+	struct ed25519_batch b;
+	unsigned char hash[64];
+	uint64_t sc[4];
+	size_t *idx = NULL, n, i;
+	int rc = ENOMEM;
+
+	if (num == 0)
+		return 0;
+
+	memset(&b, 0, sizeof(b));
+	b.msg = msg;
+	b.msglen = msglen;
+	b.sig = sig;
+	b.pub = pub;
+	b.status = status;
+
+	idx = malloc(num * sizeof(*idx));
+	b.a = malloc(num * sizeof(*b.a));
+	b.r = malloc(num * sizeof(*b.r));
+	b.k = malloc(num * sizeof(*b.k));
+	b.points = malloc((2 * (size_t)num + 1) * sizeof(*b.points));
+	b.scalars = malloc((2 * (size_t)num + 1) * sizeof(*b.scalars));
+	b.z = malloc(num * sizeof(*b.z));
+	if (idx == NULL || b.a == NULL || b.r == NULL || b.k == NULL
+	    || b.points == NULL || b.scalars == NULL || b.z == NULL)
+		goto out;
+
+	/* entries that do not even decode are invalid right away */
+	for (i = 0, n = 0; i < num; i++) {
+		status[i] = 0;
+		if (!sc_is_canonical(sig[i] + 32, 32, ed25519_l, 4)
+		    || ge25519_decode(&b.a[i], pub[i])
+		    || ge25519_decode(&b.r[i], sig[i])) {
+			status[i] = -1;
+			continue;
+		}
+		if (!ge25519_is_torsion_free(&b.a[i])
+		    || !ge25519_is_torsion_free(&b.r[i])) {
+			if (ed25519_verify_sw(sig[i], pub[i], msg[i],
+					      msglen[i]))
+				status[i] = -1;
+			continue;
+		}
+
+		ed25519_hash(hash, sig[i], 32, pub[i], 32, msg[i], msglen[i]);
+		sc_reduce(sc, hash, sizeof(hash), ed25519_l, 4);
+		sc_tobytes(b.k[i], sizeof(b.k[i]), sc, 4);
+		idx[n++] = i;
+	}
+
+	rc = ed25519_batch_verify(&b, idx, n);
+	if (rc == 0) {
+		for (i = 0; i < num; i++) {
+			if (status[i])
+				rc = EINVAL;
+		}
+	}
+out:
+	free(idx);
+	free(b.a);
+	free(b.r);
+	free(b.k);
+	free(b.points);
+	free(b.scalars);
+	free(b.z);
+	return rc;
+}
+
+/*
+ * Ed448: Edwards curve x^2 + y^2 = 1 + d x^2 y^2, d = -39081, in projective
+ * coordinates (X:Y:Z).
+ */
+
+typedef struct {
+	fe448 x, y, z;
+} ge448;
+
+static const unsigned char ed448_base_x[56] = {
+	0x5e, 0xc0, 0x0c, 0xc7, 0x2b, 0xa8, 0x26, 0x26,
+	0x8e, 0x93, 0x00, 0x8b, 0xe1, 0x80, 0x3b, 0x43,
+	0x11, 0x65, 0xb6, 0x2a, 0xf7, 0x1a, 0xae, 0x12,
+	0x64, 0xa4, 0xd3, 0xa3, 0x24, 0xe3, 0x6d, 0xea,
+	0x67, 0x17, 0x0f, 0x47, 0x70, 0x65, 0x14, 0x9e,
+	0xda, 0x36, 0xbf, 0x22, 0xa6, 0x15, 0x1d, 0x22,
+	0xed, 0x0d, 0xed, 0x6b, 0xc6, 0x70, 0x19, 0x4f,
+};
+
+static const unsigned char ed448_base_y[56] = {
+	0x14, 0xfa, 0x30, 0xf2, 0x5b, 0x79, 0x08, 0x98,
+	0xad, 0xc8, 0xd7, 0x4e, 0x2c, 0x13, 0xbd, 0xfd,
+	0xc4, 0x39, 0x7c, 0xe6, 0x1c, 0xff, 0xd3, 0x3a,
+	0xd7, 0xc2, 0xa0, 0x05, 0x1e, 0x9c, 0x78, 0x87,
+	0x40, 0x98, 0xa3, 0x6c, 0x73, 0x73, 0xea, 0x4b,
+	0x62, 0xc7, 0xc9, 0x56, 0x37, 0x20, 0x76, 0x88,
+	0x24, 0xbc, 0xb6, 0x6e, 0x71, 0x46, 0x3f, 0x69,
+};
+
+static void ge448_identity(ge448 *r)
+{
+	fe448_set(&r->x, 0);
+	fe448_set(&r->y, 1);
+	fe448_set(&r->z, 1);
+}
+
+static void ge448_base(ge448 *r)
+{
+	fe448_frombytes(&r->x, ed448_base_x);
+	fe448_frombytes(&r->y, ed448_base_y);
+	fe448_set(&r->z, 1);
+}
+
+/* RFC 8032 5.2.4, complete for Ed448 */
+static void ge448_add(ge448 *r, const ge448 *p, const ge448 *q)
+{
+	fe448 a, b, c, d, e, f, g, h, t;
+
+	fe448_mul(&a, &p->z, &q->z);
+	fe448_sq(&b, &a);
+	fe448_mul(&c, &p->x, &q->x);
+	fe448_mul(&d, &p->y, &q->y);
+	fe448_mul(&e, &c, &d);
+	fe448_mul_small(&e, &e, 39081);	/* -d C D */
+	fe448_add(&f, &b, &e);
+	fe448_sub(&g, &b, &e);
+	fe448_add(&h, &p->x, &p->y);
+	fe448_add(&t, &q->x, &q->y);
+	fe448_mul(&h, &h, &t);
+
+	fe448_sub(&h, &h, &c);
+	fe448_sub(&h, &h, &d);
+	fe448_mul(&h, &h, &f);
+	fe448_mul(&r->x, &h, &a);
+	fe448_sub(&t, &d, &c);
+	fe448_mul(&t, &t, &g);
+	fe448_mul(&r->y, &t, &a);
+	fe448_mul(&r->z, &f, &g);
+}
+
+/* RFC 8032 5.2.4 */
+static void ge448_dbl(ge448 *r, const ge448 *p)
+{
+	fe448 b, c, d, e, h, j;
+
+	fe448_add(&b, &p->x, &p->y);
+	fe448_sq(&b, &b);
+	fe448_sq(&c, &p->x);
+	fe448_sq(&d, &p->y);
+	fe448_add(&e, &c, &d);
+	fe448_sq(&h, &p->z);
+	fe448_add(&h, &h, &h);
+	fe448_sub(&j, &e, &h);
+
+	fe448_sub(&b, &b, &e);
+	fe448_mul(&r->x, &b, &j);
+	fe448_sub(&c, &c, &d);
+	fe448_mul(&r->y, &e, &c);
+	fe448_mul(&r->z, &e, &j);
+}
+
+static void ge448_cswap(ge448 *p, ge448 *q, uint64_t swap)
+{
+	fe448_cswap(&p->x, &q->x, swap);
+	fe448_cswap(&p->y, &q->y, swap);
+	fe448_cswap(&p->z, &q->z, swap);
+}
+
+/* r = [k]p, k is a little-endian scalar of at most bits bits */
+static void ge448_scalarmult(ge448 *r, const ge448 *p,
+			     const unsigned char *k, int bits)
+{
+	ge448 r0, r1;
+	uint64_t swap = 0, bit;
+	int i;
+
+	ge448_identity(&r0);
+	r1 = *p;
+	for (i = bits - 1; i >= 0; i--) {
+		bit = (k[i >> 3] >> (i & 7)) & 1;
+		ge448_cswap(&r0, &r1, swap ^ bit);
+		swap = bit;
+		ge448_add(&r1, &r0, &r1);
+		ge448_dbl(&r0, &r0);
+	}
+	ge448_cswap(&r0, &r1, swap);
+
+	*r = r0;
+	OPENSSL_cleanse(&r0, sizeof(r0));
+	OPENSSL_cleanse(&r1, sizeof(r1));
+}
+
+static void ge448_encode(unsigned char s[57], const ge448 *p)
+{
+	fe448 zinv, x, y;
+	unsigned char xs[56];
+
+	fe448_invert(&zinv, &p->z);
+	fe448_mul(&x, &p->x, &zinv);
+	fe448_mul(&y, &p->y, &zinv);
+	fe448_tobytes(s, &y);
+	fe448_tobytes(xs, &x);
+	s[56] = (xs[0] & 1) << 7;
+}
+
+/* Returns 0 if s is the canonical encoding of a curve point. */
+static int ge448_decode(ge448 *r, const unsigned char s[57])
+{
+	fe448 u, v, t, one;
+	unsigned char check[56], xs[56];
+	const int sign = s[56] >> 7;
+
+	if (s[56] & 0x7f)
+		return EINVAL;
+
+	fe448_frombytes(&r->y, s);
+	fe448_tobytes(check, &r->y);
+	if (memcmp(check, s, 56))
+		return EINVAL;		/* y >= p */
+
+	/* x^2 = (y^2 - 1) / (d y^2 - 1) = u / v */
+	fe448_set(&one, 1);
+	fe448_sq(&u, &r->y);
+	fe448_mul_small(&v, &u, 39081);
+	fe448_add(&v, &v, &one);
+	fe448_neg(&v, &v);
+	fe448_sub(&u, &u, &one);
+
+	/* x = u^3 v (u^5 v^3)^((p - 3) / 4) */
+	fe448_sq(&t, &u);
+	fe448_mul(&r->x, &t, &u);
+	fe448_mul(&r->x, &r->x, &v);		/* u^3 v */
+	fe448_sq(&t, &t);
+	fe448_mul(&t, &t, &u);			/* u^5 */
+	fe448_mul(&t, &t, &v);
+	fe448_mul(&t, &t, &v);
+	fe448_mul(&t, &t, &v);			/* u^5 v^3 */
+	fe448_pow_p34(&t, &t);
+	fe448_mul(&r->x, &r->x, &t);
+
+	fe448_sq(&t, &r->x);
+	fe448_mul(&t, &t, &v);
+	if (!fe448_equal(&t, &u))
+		return EINVAL;		/* not a square */
+
+	fe448_tobytes(xs, &r->x);
+	if ((xs[0] & 1) != sign) {
+		fe448_set(&t, 0);
+		if (fe448_equal(&r->x, &t))
+			return EINVAL;	/* x = 0 with sign bit set */
+		fe448_neg(&r->x, &r->x);
+	}
+
+	fe448_set(&r->z, 1);
+	return 0;
+}
+
+/*
+ * out = SHAKE256(dom4(0, "") || a || b || c, 114), without the dom4 prefix
+ * if dom is 0.
+ */
+static int ed448_hash(unsigned char out[114], int dom,
+		      const unsigned char *a, size_t alen,
+		      const unsigned char *b, size_t blen,
+		      const unsigned char *c, size_t clen)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	static const unsigned char dom4[] = {
+		'S', 'i', 'g', 'E', 'd', '4', '4', '8', 0x00, 0x00
+	};
+	EVP_MD_CTX *md_ctx;
+	int rc = EIO;
+
+	md_ctx = EVP_MD_CTX_new();
+	if (md_ctx == NULL)
+		return ENOMEM;
+
+	if (EVP_DigestInit_ex(md_ctx, EVP_shake256(), NULL) != 1)
+		goto out;
+	if (dom && EVP_DigestUpdate(md_ctx, dom4, sizeof(dom4)) != 1)
+		goto out;
+	if (alen && EVP_DigestUpdate(md_ctx, a, alen) != 1)
+		goto out;
+	if (blen && EVP_DigestUpdate(md_ctx, b, blen) != 1)
+		goto out;
+	if (clen && EVP_DigestUpdate(md_ctx, c, clen) != 1)
+		goto out;
+	if (EVP_DigestFinalXOF(md_ctx, out, 114) != 1)
+		goto out;
+	rc = 0;
+out:
+	EVP_MD_CTX_free(md_ctx);
+	return rc;
+#else
+	(void)out; (void)dom;
+	(void)a; (void)alen; (void)b; (void)blen; (void)c; (void)clen;
+	return ENODEV;
+#endif
+}
+
+/* h = SHAKE256(priv, 114), with the lower half clamped to the secret scalar */
+static int ed448_expand(unsigned char h[114], const unsigned char priv[57])
+{
+	int rc;
+
+	rc = ed448_hash(h, 0, priv, 57, NULL, 0, NULL, 0);
+	if (rc)
+		return rc;
+
+	h[0] &= 252;
+	h[55] |= 128;
+	h[56] = 0;
+	return 0;
+}
+
+int ed448_derive_pub_sw(unsigned char pub[57],
+			const unsigned char priv[57])
+{
+	unsigned char h[114];
+	ge448 b, a;
+	int rc;
+
+	rc = ed448_expand(h, priv);
+	if (rc)
+		return rc;
+
+	ge448_base(&b);
+	ge448_scalarmult(&a, &b, h, 448);
+	ge448_encode(pub, &a);
+
+	OPENSSL_cleanse(h, sizeof(h));
+	OPENSSL_cleanse(&a, sizeof(a));
+	return 0;
+}
+
+int ed448_sign_sw(unsigned char sig[114], const unsigned char priv[57],
+		  const unsigned char *msg, size_t msglen)
+{
+	unsigned char h[114], hash[114], r[57], k[57], pub[57];
+	uint64_t sc[7];
+	ge448 b, p;
+	int rc;
+
+	rc = ed448_expand(h, priv);
+	if (rc)
+		return rc;
+
+	ge448_base(&b);
+	ge448_scalarmult(&p, &b, h, 448);
+	ge448_encode(pub, &p);
+
+	/* r = SHAKE256(dom4 || prefix || M) mod l, R = [r]B */
+	rc = ed448_hash(hash, 1, h + 57, 57, msg, msglen, NULL, 0);
+	if (rc)
+		goto out;
+	sc_reduce(sc, hash, sizeof(hash), ed448_l, 7);
+	sc_tobytes(r, sizeof(r), sc, 7);
+	ge448_scalarmult(&p, &b, r, 448);
+	ge448_encode(sig, &p);
+
+	/* k = SHAKE256(dom4 || R || A || M) mod l, S = r + k s mod l */
+	rc = ed448_hash(hash, 1, sig, 57, pub, 57, msg, msglen);
+	if (rc)
+		goto out;
+	sc_reduce(sc, hash, sizeof(hash), ed448_l, 7);
+	sc_tobytes(k, sizeof(k), sc, 7);
+	sc_muladd(sig + 57, k, h, r, 57, ed448_l, 7);
+out:
+	OPENSSL_cleanse(h, sizeof(h));
+	OPENSSL_cleanse(hash, sizeof(hash));
+	OPENSSL_cleanse(r, sizeof(r));
+	OPENSSL_cleanse(sc, sizeof(sc));
+	OPENSSL_cleanse(&p, sizeof(p));
+	return rc;
+}
+
+int ed448_verify_sw(const unsigned char sig[114],
+		    const unsigned char pub[57],
+		    const unsigned char *msg, size_t msglen)
+{
+	unsigned char hash[114], k[57], r[57];
+	uint64_t sc[7];
+	ge448 a, b, p, q;
+	int rc;
+
+	if (!sc_is_canonical(sig + 57, 57, ed448_l, 7))
+		return EINVAL;
+	if (ge448_decode(&a, pub))
+		return EINVAL;
+
+	rc = ed448_hash(hash, 1, sig, 57, pub, 57, msg, msglen);
+	if (rc)
+		return rc;
+	sc_reduce(sc, hash, sizeof(hash), ed448_l, 7);
+	sc_tobytes(k, sizeof(k), sc, 7);
+
+	/* R == [S]B - [k]A */
+	fe448_neg(&a.x, &a.x);
+	ge448_base(&b);
+	ge448_scalarmult(&p, &b, sig + 57, 448);
+	ge448_scalarmult(&q, &a, k, 448);
+	ge448_add(&p, &p, &q);
+	ge448_encode(r, &p);
+
+	return CRYPTO_memcmp(r, sig, 57) ? EINVAL : 0;
+}
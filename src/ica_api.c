@@ -25,6 +25,7 @@
 #include <linux/types.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "init.h"
 #include "ica_api.h"
@@ -33,8 +34,10 @@
 #include "rng.h"
 #include "s390_rsa.h"
 #include "s390_ecc.h"
+#include "ecx_sw.h"
 #include "s390_crypto.h"
 #include "s390_sha.h"
+#include "s390_parallelhash.h"
 #include "s390_prng.h"
 #include "s390_des.h"
 #include "s390_aes.h"
@@ -43,6 +46,7 @@
 #include "s390_ccm.h"
 #include "s390_gcm.h"
 #include "s390_drbg.h"
+#include "worker_pool.h"
 
 #define DEFAULT_CRYPT_DEVICE "/udev/z90crypt"
 #define DEFAULT2_CRYPT_DEVICE "/dev/z90crypt"
@@ -74,6 +78,13 @@ void ica_set_stats_mode(int stats_mode)
 	ica_stats_enabled = stats_mode ? 1 : 0;
 }
 
+int ica_drbg_thread_enabled = 0;
+
+void ica_set_drbg_thread_mode(int drbg_thread_mode)
+{
+	ica_drbg_thread_enabled = drbg_thread_mode ? 1 : 0;
+}
+
 static unsigned int check_des_parms(unsigned int mode,
 				    unsigned long data_length,
 				    const unsigned char *in_data,
@@ -291,11 +302,11 @@ static unsigned int check_gcm_parms(unsigned long text_length,
 	return 0;
 }
 
-static unsigned int check_ccm_parms(unsigned long payload_length,
-				    unsigned long assoc_data_length,
-				    const unsigned char *mac,
-				    unsigned int mac_length,
-				    unsigned int nonce_length)
+/* the lengths only, for a streaming init that has no mac yet */
+static unsigned int check_ccm_lengths(unsigned long payload_length,
+				      unsigned long assoc_data_length,
+				      unsigned int mac_length,
+				      unsigned int nonce_length)
 {
 	if ((payload_length == 0) && (assoc_data_length == 0))
 		return EINVAL;
@@ -311,9 +322,6 @@ static unsigned int check_ccm_parms(unsigned long payload_length,
 	    (payload_length > ((1ull << (8*(15-nonce_length))))))
 		return EINVAL;
 
-	if (mac == NULL)
-		return EINVAL;
-
 	if ((mac_length > S390_CCM_MAX_MAC_LENGTH) ||
 	    (mac_length < S390_CCM_MIN_MAC_LENGTH) ||
 	    (mac_length % 2))
@@ -322,6 +330,19 @@ static unsigned int check_ccm_parms(unsigned long payload_length,
 	return 0;
 }
 
+static unsigned int check_ccm_parms(unsigned long payload_length,
+				    unsigned long assoc_data_length,
+				    const unsigned char *mac,
+				    unsigned int mac_length,
+				    unsigned int nonce_length)
+{
+	if (mac == NULL)
+		return EINVAL;
+
+	return check_ccm_lengths(payload_length, assoc_data_length,
+				 mac_length, nonce_length);
+}
+
 static unsigned int check_message_part(unsigned int message_part)
 {
 	if (message_part != SHA_MSG_PART_ONLY &&
@@ -897,208 +918,296 @@ unsigned int ica_shake_256(unsigned int message_part,
 			   (uint64_t *) &shake_256_context->runningLengthHigh);
 }
 
-unsigned int ica_random_number_generate(unsigned int output_length,
-					unsigned char *output_data)
+static unsigned int sha_multi(unsigned int num,
+			      const unsigned char *const input_data[],
+			      const size_t input_length[],
+			      unsigned char *const output_data[],
+			      kimd_functions_t sha_function)
 {
+	unsigned int i;
+
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
 	/* check for obvious errors in parms */
-	if (output_data == NULL)
+	if (num == 0 || input_data == NULL || input_length == NULL ||
+	    output_data == NULL)
 		return EINVAL;
 
-	return s390_prng(output_data, output_length);
+	for (i = 0; i < num; i++) {
+		if ((input_data[i] == NULL && input_length[i] != 0) ||
+		    output_data[i] == NULL)
+			return EINVAL;
+	}
+
+	return s390_sha_multi(num, input_data, input_length, output_data,
+			      sha_function);
 }
 
-unsigned int ica_rsa_key_generate_mod_expo(ica_adapter_handle_t adapter_handle,
-					   unsigned int modulus_bit_length,
-					   ica_rsa_key_mod_expo_t *public_key,
-					   ica_rsa_key_mod_expo_t *private_key)
+unsigned int ica_sha256_multi(unsigned int num,
+			      const unsigned char *const input_data[],
+			      const size_t input_length[],
+			      unsigned char *const output_data[])
 {
-	unsigned int num_ignored_bytes;
-	unsigned char *public_exponent;
+	return sha_multi(num, input_data, input_length, output_data, SHA_256);
+}
+
+unsigned int ica_sha512_multi(unsigned int num,
+			      const unsigned char *const input_data[],
+			      const size_t input_length[],
+			      unsigned char *const output_data[])
+{
+	return sha_multi(num, input_data, input_length, output_data, SHA_512);
+}
+
+unsigned int ica_sha3_256_multi(unsigned int num,
+				const unsigned char *const input_data[],
+				const size_t input_length[],
+				unsigned char *const output_data[])
+{
+	return sha_multi(num, input_data, input_length, output_data,
+			 SHA_3_256);
+}
+
+static int hash_function_from_alg(unsigned int alg)
+{
+	switch (alg) {
+	case SHA1:
+		return SHA_1;
+	case SHA224:
+		return SHA_224;
+	case SHA256:
+		return SHA_256;
+	case SHA384:
+		return SHA_384;
+	case SHA512:
+		return SHA_512;
+	case SHA3_224:
+		return SHA_3_224;
+	case SHA3_256:
+		return SHA_3_256;
+	case SHA3_384:
+		return SHA_3_384;
+	case SHA3_512:
+		return SHA_3_512;
+	default:
+		return -1;
+	}
+}
+
+int ica_hash_ctx_new(unsigned int alg, ica_hash_ctx_t **ctx)
+{
+	ica_hash_ctx_t *tmp;
+	int sha_function, rc;
 
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	if (public_key->key_length != private_key->key_length)
-		return EINVAL;
-	/* Keys should comply with modulus_bit_length */
-	if ((modulus_bit_length + 7) / 8 != public_key->key_length)
-		return EINVAL;
-	/* Minimum length for public exponent is sizeof(unsigned long) */
-	if (public_key->key_length < sizeof(unsigned long))
+	/* check for obvious errors in parms */
+	sha_function = hash_function_from_alg(alg);
+	if (ctx == NULL || sha_function < 0)
 		return EINVAL;
 
-	/* OpenSSL takes only exponents of type unsigned long, so we have to
-	 * be sure that we give a value of the right size to OpenSSL.
-	 */
-	num_ignored_bytes = public_key->key_length - sizeof(unsigned long);
-	public_exponent = public_key->exponent;
+	if ((tmp = malloc(sizeof(*tmp))) == NULL)
+		return ENOMEM;
 
-	for (; num_ignored_bytes; --num_ignored_bytes, ++public_exponent)
-		if (*public_exponent != 0)
-			return EINVAL;
+	rc = s390_hash_init(tmp, sha_function);
+	if (rc) {
+		free(tmp);
+		return rc;
+	}
 
-	/* There is no need to zeroize any buffers here. This will be done in
-	 * the lower routines.
-	 */
-	return rsa_key_generate_mod_expo(adapter_handle, modulus_bit_length,
-					 public_key, private_key);
+	*ctx = tmp;
+	return 0;
 }
 
-unsigned int ica_rsa_key_generate_crt(ica_adapter_handle_t adapter_handle,
-				      unsigned int modulus_bit_length,
-				      ica_rsa_key_mod_expo_t *public_key,
-				      ica_rsa_key_crt_t *private_key)
+int ica_hash_init(ica_hash_ctx_t *ctx)
 {
-	unsigned int num_ignored_bytes;
-	unsigned char *public_exponent;
+	if (ctx == NULL)
+		return EINVAL;
 
+	return s390_hash_init(ctx, ctx->sha_function);
+}
+
+int ica_hash_update(ica_hash_ctx_t *ctx, const unsigned char *data,
+		    uint64_t data_length)
+{
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	if (public_key->key_length != private_key->key_length)
-		return EINVAL;
-	if ((modulus_bit_length + 7) / 8 != public_key->key_length)
-		return EINVAL;
-	if (public_key->key_length < sizeof(unsigned long))
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (data == NULL && data_length != 0))
 		return EINVAL;
 
-	num_ignored_bytes = public_key->key_length - sizeof(unsigned long);
-	public_exponent = public_key->exponent;
+	return s390_hash_update(ctx, data, data_length);
+}
 
-	for (; num_ignored_bytes; --num_ignored_bytes, ++public_exponent)
-		if (*public_exponent != 0)
+int ica_hash_updatev(ica_hash_ctx_t *ctx, const struct iovec *iov,
+		     unsigned int iovcnt)
+{
+	unsigned int i;
+	int rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (iov == NULL && iovcnt != 0))
+		return EINVAL;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_base == NULL && iov[i].iov_len != 0)
 			return EINVAL;
+	}
 
-	/* There is no need to zeroize any buffers here. This will be done in
-	 * the lower routines.
-	 */
-	return rsa_key_generate_crt(adapter_handle, modulus_bit_length,
-				    public_key, private_key);
+	for (i = 0; i < iovcnt; i++) {
+		rc = s390_hash_update(ctx, iov[i].iov_base, iov[i].iov_len);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
 }
 
-unsigned int ica_rsa_mod_expo(ica_adapter_handle_t adapter_handle,
-			      unsigned char *input_data,
-			      ica_rsa_key_mod_expo_t *rsa_key,
-			      unsigned char *output_data)
+int ica_hash_final(ica_hash_ctx_t *ctx, unsigned char *digest)
 {
-	ica_rsa_modexpo_t rb;
-	int hardware, rc;
-
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
 	/* check for obvious errors in parms */
-	if (input_data == NULL || rsa_key == NULL || output_data == NULL)
+	if (ctx == NULL || digest == NULL)
 		return EINVAL;
 
-	if (rsa_key->key_length < sizeof(unsigned long))
+	return s390_hash_final(ctx, digest);
+}
+
+int ica_hash_ctx_copy(ica_hash_ctx_t *dst, const ica_hash_ctx_t *src)
+{
+	if (dst == NULL || src == NULL)
 		return EINVAL;
 
-	/* fill driver structure */
-	rb.inputdata = (char *)input_data;
-	rb.inputdatalength = rsa_key->key_length;
-	rb.outputdata = (char *)output_data;
-	rb.outputdatalength = rsa_key->key_length;
-	rb.b_key = (char *)rsa_key->exponent;
-	rb.n_modulus = (char *)rsa_key->modulus;
+	if (dst != src)
+		memcpy(dst, src, sizeof(*dst));
+	return 0;
+}
 
-	hardware = ALGO_SW;
-	if (adapter_handle == DRIVER_NOT_LOADED)
-		rc = ica_fallbacks_enabled ?
-			rsa_mod_expo_sw(&rb) : ENODEV;
-	else {
-		if (any_card_online)
-			rc = ioctl(adapter_handle, ICARSAMODEXPO, &rb);
-		else
-			rc = ENODEV;
+void ica_hash_ctx_free(ica_hash_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
 
-		if (!rc)
-			hardware = ALGO_HW;
-		else
-			rc = ica_fallbacks_enabled ?
-				rsa_mod_expo_sw(&rb) : ENODEV;
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	free(ctx);
+}
+
+int ica_hmac_ctx_new(unsigned int alg, const unsigned char *key,
+		     size_t key_length, ica_hmac_ctx_t **ctx)
+{
+	ica_hmac_ctx_t *tmp;
+	int sha_function, rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	sha_function = hash_function_from_alg(alg);
+	if (ctx == NULL || sha_function < 0 ||
+	    (key == NULL && key_length != 0))
+		return EINVAL;
+
+	if ((tmp = malloc(sizeof(*tmp))) == NULL)
+		return ENOMEM;
+
+	rc = s390_hmac_init(tmp, sha_function, key, key_length);
+	if (rc) {
+		ica_hmac_ctx_free(tmp);
+		return rc;
 	}
-	if (rc == 0)
-		stats_increment(ICA_STATS_RSA_ME, hardware, ENCRYPT);
 
-	return rc;
+	*ctx = tmp;
+	return 0;
 }
 
-unsigned int ica_rsa_crt_key_check(ica_rsa_key_crt_t *rsa_key)
+int ica_hmac_init(ica_hmac_ctx_t *ctx)
 {
-	int pq_comp;
-	int keyfmt = 1;
-	BIGNUM *bn_p;
-	BIGNUM *bn_q;
-	BIGNUM *bn_invq;
-	BN_CTX *ctx;
-	unsigned char *tmp_buf = NULL;
+	if (ctx == NULL)
+		return EINVAL;
+
+	memcpy(&ctx->inner, &ctx->inner_pad, sizeof(ctx->inner));
+	return 0;
+}
 
+int ica_hmac_update(ica_hmac_ctx_t *ctx, const unsigned char *data,
+		    uint64_t data_length)
+{
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	/* check if p > q  */
-	pq_comp = memcmp( (rsa_key->p + 8), (rsa_key->q), rsa_key->key_length/2);
-	if (pq_comp < 0) /* unprivileged key format */
-		keyfmt = 0;
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (data == NULL && data_length != 0))
+		return EINVAL;
 
-	if (!keyfmt) {
-		/* swap p and q */
-		tmp_buf = calloc(1, rsa_key->key_length/2);
-		if (!tmp_buf)
-			return ENOMEM;
-		memcpy(tmp_buf, rsa_key->p + 8, rsa_key->key_length/2);
-		memcpy(rsa_key->p + 8, rsa_key->q, rsa_key->key_length/2);
-		memcpy(rsa_key->q, tmp_buf, rsa_key->key_length/2);
+	return s390_hash_update(&ctx->inner, data, data_length);
+}
 
-		/* swap dp and dq */
-		memcpy(tmp_buf, rsa_key->dp + 8, rsa_key->key_length/2);
-		memcpy(rsa_key->dp + 8, rsa_key->dq, rsa_key->key_length/2);
-		memcpy(rsa_key->dq, tmp_buf, rsa_key->key_length/2);
+int ica_hmac_final(ica_hmac_ctx_t *ctx, unsigned char *mac)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
 
-		/* calculate new qInv */
-		bn_p = BN_new();
-		bn_q = BN_new();
-		bn_invq = BN_new();
-		ctx = BN_CTX_new();
+	/* check for obvious errors in parms */
+	if (ctx == NULL || mac == NULL)
+		return EINVAL;
 
-		BN_bin2bn(rsa_key->p, rsa_key->key_length/2+8, bn_p);
-		BN_bin2bn(rsa_key->q, rsa_key->key_length/2, bn_q);
+	return s390_hmac_final(ctx, mac);
+}
 
-		/* qInv = (1/q) mod p */
-		BN_mod_inverse(bn_invq, bn_q, bn_p, ctx);
-		memset(tmp_buf, 0, rsa_key->key_length/2);
-		BN_bn2bin(bn_invq, tmp_buf);
+int ica_hmac(ica_hmac_ctx_t *ctx, const unsigned char *data,
+	     uint64_t data_length, unsigned char *mac)
+{
+	int rc;
 
-		memcpy(rsa_key->qInverse + 8, tmp_buf, rsa_key->key_length/2);
+	rc = ica_hmac_update(ctx, data, data_length);
+	if (rc) {
+		if (ctx != NULL)
+			ica_hmac_init(ctx);
+		return rc;
+	}
 
-		free(tmp_buf);
+	return ica_hmac_final(ctx, mac);
+}
 
-		return 1;
-	}
-	return 0;
+void ica_hmac_ctx_free(ica_hmac_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	free(ctx);
 }
 
-unsigned int ica_rsa_crt(ica_adapter_handle_t adapter_handle,
-			 unsigned char *input_data,
-			 ica_rsa_key_crt_t *rsa_key,
-			 unsigned char *output_data)
+int ica_pbkdf2(unsigned int alg, const unsigned char *password,
+	       size_t password_length, const unsigned char *salt,
+	       size_t salt_length, uint64_t iterations, unsigned char *dk,
+	       size_t dk_length)
 {
-	ica_rsa_modexpo_crt_t rb;
-	int hardware, rc;
+	int sha_function;
 
 #ifdef ICA_FIPS
 	if (fips >> 1)
@@ -1106,48 +1215,814 @@ unsigned int ica_rsa_crt(ica_adapter_handle_t adapter_handle,
 #endif /* ICA_FIPS */
 
 	/* check for obvious errors in parms */
-	if (input_data == NULL || rsa_key == NULL || output_data == NULL)
+	sha_function = hash_function_from_alg(alg);
+	if (sha_function < 0 || iterations == 0 || dk == NULL ||
+	    dk_length == 0 || (password == NULL && password_length != 0) ||
+	    (salt == NULL && salt_length != 0))
 		return EINVAL;
 
-	if (rsa_key->key_length < sizeof(unsigned long))
+	/* the block index is a 32 bit integer */
+	if ((dk_length - 1) / sha_constants[sha_function].hash_length
+	    >= UINT32_MAX)
 		return EINVAL;
 
-	/* fill driver structure */
-	rb.inputdata = (char *)input_data;
-	rb.inputdatalength = rsa_key->key_length;
-	rb.outputdata = (char *)output_data;
-	rb.outputdatalength = rsa_key->key_length;
+	return s390_pbkdf2(sha_function, password, password_length, salt,
+			   salt_length, iterations, dk, dk_length);
+}
 
-	ica_rsa_crt_key_check(rsa_key);
+int ica_hkdf(unsigned int alg, const unsigned char *ikm, size_t ikm_length,
+	     const unsigned char *salt, size_t salt_length,
+	     const unsigned char *info, size_t info_length,
+	     unsigned char *okm, size_t okm_length)
+{
+	int sha_function;
 
-	rb.np_prime = (char *)rsa_key->p;
-	rb.nq_prime = (char *)rsa_key->q;
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	sha_function = hash_function_from_alg(alg);
+	if (sha_function < 0 || okm == NULL || okm_length == 0 ||
+	    (ikm == NULL && ikm_length != 0) ||
+	    (info == NULL && info_length != 0))
+		return EINVAL;
+
+	if (okm_length > 255 * sha_constants[sha_function].hash_length)
+		return EINVAL;
+
+	return s390_hkdf(sha_function, ikm, ikm_length, salt, salt_length,
+			 info, info_length, okm, okm_length);
+}
+
+static int parallelhash(kimd_functions_t sha_function,
+			const unsigned char *data, uint64_t data_length,
+			size_t block_size, const unsigned char *custom,
+			size_t custom_length, unsigned char *output,
+			size_t output_length, unsigned int threads)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if ((data == NULL && data_length != 0) || block_size == 0 ||
+	    (custom == NULL && custom_length != 0) ||
+	    output == NULL || output_length == 0)
+		return EINVAL;
+
+	return s390_parallelhash(sha_function, data, data_length, block_size,
+				 custom, custom_length, output, output_length,
+				 threads);
+}
+
+int ica_parallelhash128(const unsigned char *data, uint64_t data_length,
+			size_t block_size, const unsigned char *custom,
+			size_t custom_length, unsigned char *output,
+			size_t output_length, unsigned int threads)
+{
+	return parallelhash(SHAKE_128, data, data_length, block_size, custom,
+			    custom_length, output, output_length, threads);
+}
+
+int ica_parallelhash256(const unsigned char *data, uint64_t data_length,
+			size_t block_size, const unsigned char *custom,
+			size_t custom_length, unsigned char *output,
+			size_t output_length, unsigned int threads)
+{
+	return parallelhash(SHAKE_256, data, data_length, block_size, custom,
+			    custom_length, output, output_length, threads);
+}
+
+int ica_xof_ctx_new(unsigned int alg, ica_xof_ctx_t **ctx)
+{
+	ica_xof_ctx_t *tmp;
+	int rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (alg != SHAKE128 && alg != SHAKE256))
+		return EINVAL;
+
+	if ((tmp = malloc(sizeof(*tmp))) == NULL)
+		return ENOMEM;
+
+	rc = s390_xof_init(tmp, alg == SHAKE128 ? SHAKE_128 : SHAKE_256);
+	if (rc) {
+		free(tmp);
+		return rc;
+	}
+
+	*ctx = tmp;
+	return 0;
+}
+
+int ica_xof_init(ica_xof_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return EINVAL;
+
+	return s390_xof_init(ctx, ctx->sha_function);
+}
+
+int ica_xof_absorb(ica_xof_ctx_t *ctx, const unsigned char *data,
+		   uint64_t data_length)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (data == NULL && data_length != 0))
+		return EINVAL;
+
+	return s390_xof_absorb(ctx, data, data_length);
+}
+
+int ica_xof_squeeze(ica_xof_ctx_t *ctx, unsigned char *output,
+		    size_t output_length)
+{
+	uint64_t start = stats_clock();
+	int squeezing, rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || (output == NULL && output_length != 0))
+		return EINVAL;
+
+	squeezing = ctx->squeezing;
+	rc = s390_xof_squeeze(ctx, output, output_length);
+	/* a message is counted once, when its output starts */
+	if (rc == 0 && !squeezing)
+		stats_add(ctx->sha_function == SHAKE_128 ?
+			  ICA_STATS_SHAKE_128 : ICA_STATS_SHAKE_256,
+			  ctx->hw ? ALGO_HW : ALGO_SW, ENCRYPT, ctx->absorbed,
+			  start);
+	return rc;
+}
+
+int ica_xof_ctx_copy(ica_xof_ctx_t *dst, const ica_xof_ctx_t *src)
+{
+	if (dst == NULL || src == NULL)
+		return EINVAL;
+
+	if (dst != src)
+		memcpy(dst, src, sizeof(*dst));
+	return 0;
+}
+
+void ica_xof_ctx_free(ica_xof_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	free(ctx);
+}
+
+unsigned int ica_random_number_generate(unsigned int output_length,
+					unsigned char *output_data)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (output_data == NULL)
+		return EINVAL;
+
+	return s390_prng(output_data, output_length);
+}
+
+unsigned int ica_rsa_key_generate_mod_expo(ica_adapter_handle_t adapter_handle,
+					   unsigned int modulus_bit_length,
+					   ica_rsa_key_mod_expo_t *public_key,
+					   ica_rsa_key_mod_expo_t *private_key)
+{
+	unsigned int num_ignored_bytes;
+	unsigned char *public_exponent;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (public_key->key_length != private_key->key_length)
+		return EINVAL;
+	/* Keys should comply with modulus_bit_length */
+	if ((modulus_bit_length + 7) / 8 != public_key->key_length)
+		return EINVAL;
+	/* Minimum length for public exponent is sizeof(unsigned long) */
+	if (public_key->key_length < sizeof(unsigned long))
+		return EINVAL;
+
+	/* OpenSSL takes only exponents of type unsigned long, so we have to
+	 * be sure that we give a value of the right size to OpenSSL.
+	 */
+	num_ignored_bytes = public_key->key_length - sizeof(unsigned long);
+	public_exponent = public_key->exponent;
+
+	for (; num_ignored_bytes; --num_ignored_bytes, ++public_exponent)
+		if (*public_exponent != 0)
+			return EINVAL;
+
+	/* There is no need to zeroize any buffers here. This will be done in
+	 * the lower routines.
+	 */
+	return rsa_key_generate_mod_expo(adapter_handle, modulus_bit_length,
+					 public_key, private_key);
+}
+
+unsigned int ica_rsa_key_generate_crt(ica_adapter_handle_t adapter_handle,
+				      unsigned int modulus_bit_length,
+				      ica_rsa_key_mod_expo_t *public_key,
+				      ica_rsa_key_crt_t *private_key)
+{
+	unsigned int num_ignored_bytes;
+	unsigned char *public_exponent;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (public_key->key_length != private_key->key_length)
+		return EINVAL;
+	if ((modulus_bit_length + 7) / 8 != public_key->key_length)
+		return EINVAL;
+	if (public_key->key_length < sizeof(unsigned long))
+		return EINVAL;
+
+	num_ignored_bytes = public_key->key_length - sizeof(unsigned long);
+	public_exponent = public_key->exponent;
+
+	for (; num_ignored_bytes; --num_ignored_bytes, ++public_exponent)
+		if (*public_exponent != 0)
+			return EINVAL;
+
+	/* There is no need to zeroize any buffers here. This will be done in
+	 * the lower routines.
+	 */
+	return rsa_key_generate_crt(adapter_handle, modulus_bit_length,
+				    public_key, private_key);
+}
+
+/*
+ * Perform one RSA mod expo operation, the parameters are already checked.
+ */
+static unsigned int rsa_mod_expo(ica_adapter_handle_t adapter_handle,
+				 unsigned char *input_data,
+				 ica_rsa_key_mod_expo_t *rsa_key,
+				 unsigned char *output_data)
+{
+	ica_rsa_modexpo_t rb;
+	int hardware, rc;
+	uint64_t start;
+
+	/* fill driver structure */
+	rb.inputdata = (char *)input_data;
+	rb.inputdatalength = rsa_key->key_length;
+	rb.outputdata = (char *)output_data;
+	rb.outputdatalength = rsa_key->key_length;
+	rb.b_key = (char *)rsa_key->exponent;
+	rb.n_modulus = (char *)rsa_key->modulus;
+
+	start = stats_clock();
+	hardware = ALGO_SW;
+	if (adapter_handle == DRIVER_NOT_LOADED)
+		rc = ica_fallbacks_enabled ?
+			rsa_mod_expo_sw(&rb) : ENODEV;
+	else {
+		if (s390_any_card_online())
+			rc = ioctl(adapter_handle, ICARSAMODEXPO, &rb);
+		else
+			rc = ENODEV;
+
+		if (!rc)
+			hardware = ALGO_HW;
+		else
+			rc = ica_fallbacks_enabled ?
+				rsa_mod_expo_sw(&rb) : ENODEV;
+	}
+	if (rc == 0)
+		stats_add(ICA_STATS_RSA_ME, hardware, ENCRYPT,
+			  rsa_key->key_length, start);
+
+	return rc;
+}
+
+unsigned int ica_rsa_mod_expo(ica_adapter_handle_t adapter_handle,
+			      unsigned char *input_data,
+			      ica_rsa_key_mod_expo_t *rsa_key,
+			      unsigned char *output_data)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (input_data == NULL || rsa_key == NULL || output_data == NULL)
+		return EINVAL;
+
+	if (rsa_key->key_length < sizeof(unsigned long))
+		return EINVAL;
+
+	return rsa_mod_expo(adapter_handle, input_data, rsa_key, output_data);
+}
+
+unsigned int ica_rsa_crt_key_check(ica_rsa_key_crt_t *rsa_key)
+{
+	int pq_comp;
+	int keyfmt = 1;
+	BIGNUM *bn_p;
+	BIGNUM *bn_q;
+	BIGNUM *bn_invq;
+	BN_CTX *ctx;
+	unsigned char *tmp_buf = NULL;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check if p > q  */
+	pq_comp = memcmp( (rsa_key->p + 8), (rsa_key->q), rsa_key->key_length/2);
+	if (pq_comp < 0) /* unprivileged key format */
+		keyfmt = 0;
+
+	if (!keyfmt) {
+		/* swap p and q */
+		tmp_buf = calloc(1, rsa_key->key_length/2);
+		if (!tmp_buf)
+			return ENOMEM;
+		memcpy(tmp_buf, rsa_key->p + 8, rsa_key->key_length/2);
+		memcpy(rsa_key->p + 8, rsa_key->q, rsa_key->key_length/2);
+		memcpy(rsa_key->q, tmp_buf, rsa_key->key_length/2);
+
+		/* swap dp and dq */
+		memcpy(tmp_buf, rsa_key->dp + 8, rsa_key->key_length/2);
+		memcpy(rsa_key->dp + 8, rsa_key->dq, rsa_key->key_length/2);
+		memcpy(rsa_key->dq, tmp_buf, rsa_key->key_length/2);
+
+		/* calculate new qInv */
+		bn_p = BN_new();
+		bn_q = BN_new();
+		bn_invq = BN_new();
+		ctx = BN_CTX_new();
+
+		BN_bin2bn(rsa_key->p, rsa_key->key_length/2+8, bn_p);
+		BN_bin2bn(rsa_key->q, rsa_key->key_length/2, bn_q);
+
+		/* qInv = (1/q) mod p */
+		BN_mod_inverse(bn_invq, bn_q, bn_p, ctx);
+		memset(tmp_buf, 0, rsa_key->key_length/2);
+		BN_bn2bin(bn_invq, tmp_buf);
+
+		memcpy(rsa_key->qInverse + 8, tmp_buf, rsa_key->key_length/2);
+
+		free(tmp_buf);
+
+		return 1;
+	}
+	return 0;
+}
+
+/*
+ * Perform one RSA CRT operation, the parameters are already checked and
+ * the key is in privileged form (see ica_rsa_crt_key_check).
+ */
+static unsigned int rsa_crt(ica_adapter_handle_t adapter_handle,
+			    unsigned char *input_data,
+			    ica_rsa_key_crt_t *rsa_key,
+			    unsigned char *output_data)
+{
+	ica_rsa_modexpo_crt_t rb;
+	int hardware, rc;
+	uint64_t start;
+
+	/* fill driver structure */
+	rb.inputdata = (char *)input_data;
+	rb.inputdatalength = rsa_key->key_length;
+	rb.outputdata = (char *)output_data;
+	rb.outputdatalength = rsa_key->key_length;
+
+	rb.np_prime = (char *)rsa_key->p;
+	rb.nq_prime = (char *)rsa_key->q;
 	rb.bp_key = (char *)rsa_key->dp;
 	rb.bq_key = (char *)rsa_key->dq;
 	rb.u_mult_inv = (char *)rsa_key->qInverse;
 
-	hardware = ALGO_SW;
-	if (adapter_handle == DRIVER_NOT_LOADED)
-		rc = ica_fallbacks_enabled ?
-			rsa_crt_sw(&rb) : ENODEV;
-	else {
-		if (any_card_online)
-			rc = ioctl(adapter_handle, ICARSACRT, &rb);
-		else
-			rc = ENODEV;
+	start = stats_clock();
+	hardware = ALGO_SW;
+	if (adapter_handle == DRIVER_NOT_LOADED)
+		rc = ica_fallbacks_enabled ?
+			rsa_crt_sw(&rb) : ENODEV;
+	else {
+		if (s390_any_card_online())
+			rc = ioctl(adapter_handle, ICARSACRT, &rb);
+		else
+			rc = ENODEV;
+
+		if(!rc)
+			hardware = ALGO_HW;
+		else
+			rc = ica_fallbacks_enabled ?
+				rsa_crt_sw(&rb) : ENODEV;
+	}
+	if (rc == 0)
+		stats_add(ICA_STATS_RSA_CRT, hardware, ENCRYPT,
+			  rsa_key->key_length, start);
+
+	return rc;
+}
+
+unsigned int ica_rsa_crt(ica_adapter_handle_t adapter_handle,
+			 unsigned char *input_data,
+			 ica_rsa_key_crt_t *rsa_key,
+			 unsigned char *output_data)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (input_data == NULL || rsa_key == NULL || output_data == NULL)
+		return EINVAL;
+
+	if (rsa_key->key_length < sizeof(unsigned long))
+		return EINVAL;
+
+	ica_rsa_crt_key_check(rsa_key);
+
+	return rsa_crt(adapter_handle, input_data, rsa_key, output_data);
+}
+
+static ica_rsa_key_ctx_t *rsa_key_ctx_alloc(unsigned int key_length,
+					    size_t buf_length)
+{
+	ica_rsa_key_ctx_t *key_ctx;
+
+	key_ctx = calloc(1, sizeof(*key_ctx));
+	if (key_ctx == NULL)
+		return NULL;
+
+	key_ctx->buf = calloc(1, buf_length);
+	if (key_ctx->buf == NULL) {
+		free(key_ctx);
+		return NULL;
+	}
+	key_ctx->buf_length = buf_length;
+	key_ctx->key_length = key_length;
+
+	return key_ctx;
+}
+
+unsigned int ica_rsa_key_ctx_new_mod_expo(const ica_rsa_key_mod_expo_t *rsa_key,
+					  ica_rsa_key_ctx_t **key_ctx)
+{
+	ica_rsa_key_ctx_t *tmp;
+	unsigned int len, rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (rsa_key == NULL || key_ctx == NULL || rsa_key->modulus == NULL ||
+	    rsa_key->exponent == NULL)
+		return EINVAL;
+
+	len = rsa_key->key_length;
+	if (len < sizeof(unsigned long))
+		return EINVAL;
+
+	if ((tmp = rsa_key_ctx_alloc(len, 2 * len)) == NULL)
+		return ENOMEM;
+
+	tmp->is_crt = 0;
+	tmp->me.key_length = len;
+	tmp->me.modulus = tmp->buf;
+	tmp->me.exponent = tmp->buf + len;
+	memcpy(tmp->me.modulus, rsa_key->modulus, len);
+	memcpy(tmp->me.exponent, rsa_key->exponent, len);
+
+	rc = rsa_key_ctx_init_sw(tmp);
+	if (rc) {
+		ica_rsa_key_ctx_free(tmp);
+		return rc;
+	}
+
+	*key_ctx = tmp;
+	return 0;
+}
+
+unsigned int ica_rsa_key_ctx_new_crt(const ica_rsa_key_crt_t *rsa_key,
+				     ica_rsa_key_ctx_t **key_ctx)
+{
+	ica_rsa_key_ctx_t *tmp;
+	unsigned int len, short_len, long_len, rc;
+	unsigned char *ptr;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
 
-		if(!rc)
+	if (rsa_key == NULL || key_ctx == NULL || rsa_key->p == NULL ||
+	    rsa_key->q == NULL || rsa_key->dp == NULL || rsa_key->dq == NULL ||
+	    rsa_key->qInverse == NULL)
+		return EINVAL;
+
+	len = rsa_key->key_length;
+	if (len < sizeof(unsigned long))
+		return EINVAL;
+
+	/* p, dp and qInverse carry 8 bytes of leading zeros */
+	short_len = (len + 1) / 2;
+	long_len = short_len + 8;
+
+	if ((tmp = rsa_key_ctx_alloc(len, 3 * long_len + 2 * short_len)) == NULL)
+		return ENOMEM;
+
+	tmp->is_crt = 1;
+	tmp->crt.key_length = len;
+	ptr = tmp->buf;
+	tmp->crt.p = ptr;
+	ptr += long_len;
+	tmp->crt.q = ptr;
+	ptr += short_len;
+	tmp->crt.dp = ptr;
+	ptr += long_len;
+	tmp->crt.dq = ptr;
+	ptr += short_len;
+	tmp->crt.qInverse = ptr;
+	memcpy(tmp->crt.p, rsa_key->p, long_len);
+	memcpy(tmp->crt.q, rsa_key->q, short_len);
+	memcpy(tmp->crt.dp, rsa_key->dp, long_len);
+	memcpy(tmp->crt.dq, rsa_key->dq, short_len);
+	memcpy(tmp->crt.qInverse, rsa_key->qInverse, long_len);
+
+	/* swap p and q on the copy if necessary, once */
+	if (ica_rsa_crt_key_check(&tmp->crt) == ENOMEM) {
+		ica_rsa_key_ctx_free(tmp);
+		return ENOMEM;
+	}
+
+	rc = rsa_key_ctx_init_sw(tmp);
+	if (rc) {
+		ica_rsa_key_ctx_free(tmp);
+		return rc;
+	}
+
+	*key_ctx = tmp;
+	return 0;
+}
+
+unsigned int ica_rsa_key_ctx_compute(ica_adapter_handle_t adapter_handle,
+				     ica_rsa_key_ctx_t *key_ctx,
+				     const unsigned char *input_data,
+				     unsigned char *output_data)
+{
+	ica_rsa_modexpo_t rb;
+	ica_rsa_modexpo_crt_t rb_crt;
+	int hardware, rc;
+	uint64_t start;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (key_ctx == NULL || input_data == NULL || output_data == NULL)
+		return EINVAL;
+
+	start = stats_clock();
+	hardware = ALGO_SW;
+	rc = ENODEV;
+	if (adapter_handle != DRIVER_NOT_LOADED && s390_any_card_online()) {
+		if (key_ctx->is_crt) {
+			rb_crt.inputdata = (char *)input_data;
+			rb_crt.inputdatalength = key_ctx->key_length;
+			rb_crt.outputdata = (char *)output_data;
+			rb_crt.outputdatalength = key_ctx->key_length;
+			rb_crt.np_prime = (char *)key_ctx->crt.p;
+			rb_crt.nq_prime = (char *)key_ctx->crt.q;
+			rb_crt.bp_key = (char *)key_ctx->crt.dp;
+			rb_crt.bq_key = (char *)key_ctx->crt.dq;
+			rb_crt.u_mult_inv = (char *)key_ctx->crt.qInverse;
+			rc = ioctl(adapter_handle, ICARSACRT, &rb_crt);
+		} else {
+			rb.inputdata = (char *)input_data;
+			rb.inputdatalength = key_ctx->key_length;
+			rb.outputdata = (char *)output_data;
+			rb.outputdatalength = key_ctx->key_length;
+			rb.b_key = (char *)key_ctx->me.exponent;
+			rb.n_modulus = (char *)key_ctx->me.modulus;
+			rc = ioctl(adapter_handle, ICARSAMODEXPO, &rb);
+		}
+		if (!rc)
 			hardware = ALGO_HW;
-		else
-			rc = ica_fallbacks_enabled ?
-				rsa_crt_sw(&rb) : ENODEV;
 	}
+	if (rc)
+		rc = ica_fallbacks_enabled ?
+			rsa_key_ctx_sw(key_ctx, input_data, output_data) : ENODEV;
+
 	if (rc == 0)
-		stats_increment(ICA_STATS_RSA_CRT, hardware, ENCRYPT);
+		stats_add(key_ctx->is_crt ? ICA_STATS_RSA_CRT : ICA_STATS_RSA_ME,
+			  hardware, ENCRYPT, key_ctx->key_length, start);
 
 	return rc;
 }
 
+void ica_rsa_key_ctx_free(ica_rsa_key_ctx_t *key_ctx)
+{
+	if (key_ctx == NULL)
+		return;
+
+	rsa_key_ctx_free_sw(key_ctx);
+	if (key_ctx->buf) {
+		OPENSSL_cleanse(key_ctx->buf, key_ctx->buf_length);
+		free(key_ctx->buf);
+	}
+	free(key_ctx);
+}
+
+/*
+ * RSA batch processing: the requests of one batch are handed out to the
+ * calling thread and threads of the worker pool. Each thread issues
+ * blocking requests on the shared adapter handle, so up to @workers
+ * requests are outstanding at the device at the same time. Requests
+ * complete in any order.
+ */
+#define RSA_BATCH_DEFAULT_WORKERS	4
+#define RSA_BATCH_MAX_WORKERS		32
+
+struct rsa_batch {
+	ica_adapter_handle_t adapter_handle;
+	unsigned int num;
+	unsigned char *const *input_data;
+	unsigned char *const *output_data;
+	ica_rsa_key_mod_expo_t *me_key;
+	ica_rsa_key_crt_t *crt_key;
+	unsigned int *status;
+	ica_rsa_batch_cb_t callback;
+	void *user_data;
+	unsigned int next;	/* next request to process */
+	unsigned int failed;	/* number of failed requests */
+};
+
+static void *rsa_batch_worker(void *arg)
+{
+	struct rsa_batch *batch = arg;
+	unsigned int i, rc;
+
+	while ((i = __sync_fetch_and_add(&batch->next, 1)) < batch->num) {
+		if (batch->crt_key)
+			rc = rsa_crt(batch->adapter_handle,
+				     batch->input_data[i], batch->crt_key,
+				     batch->output_data[i]);
+		else
+			rc = rsa_mod_expo(batch->adapter_handle,
+					  batch->input_data[i], batch->me_key,
+					  batch->output_data[i]);
+		if (batch->status)
+			batch->status[i] = rc;
+		if (rc)
+			__sync_fetch_and_add(&batch->failed, 1);
+		if (batch->callback)
+			batch->callback(batch->user_data, i, rc);
+	}
+
+	return NULL;
+}
+
+static unsigned int rsa_batch_run(struct rsa_batch *batch,
+				  unsigned int workers)
+{
+	if (workers == 0)
+		workers = RSA_BATCH_DEFAULT_WORKERS;
+	if (workers > RSA_BATCH_MAX_WORKERS)
+		workers = RSA_BATCH_MAX_WORKERS;
+	if (workers > batch->num)
+		workers = batch->num;
+
+	worker_pool_run(rsa_batch_worker, batch, workers);
+
+	return batch->failed ? EIO : 0;
+}
+
+static unsigned int check_rsa_batch_parms(unsigned int num,
+					  unsigned char *const *input_data,
+					  unsigned char *const *output_data,
+					  unsigned int key_length)
+{
+	unsigned int i;
+
+	if (num == 0 || input_data == NULL || output_data == NULL)
+		return EINVAL;
+
+	if (key_length < sizeof(unsigned long))
+		return EINVAL;
+
+	for (i = 0; i < num; i++) {
+		if (input_data[i] == NULL || output_data[i] == NULL)
+			return EINVAL;
+	}
+
+	return 0;
+}
+
+unsigned int ica_rsa_mod_expo_batch(ica_adapter_handle_t adapter_handle,
+				    unsigned int num,
+				    unsigned char *const *input_data,
+				    ica_rsa_key_mod_expo_t *rsa_key,
+				    unsigned char *const *output_data,
+				    unsigned int *status,
+				    unsigned int workers,
+				    ica_rsa_batch_cb_t callback,
+				    void *user_data)
+{
+	struct rsa_batch batch;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (rsa_key == NULL)
+		return EINVAL;
+
+	if (check_rsa_batch_parms(num, input_data, output_data,
+				  rsa_key->key_length))
+		return EINVAL;
+
+	memset(&batch, 0, sizeof(batch));
+	batch.adapter_handle = adapter_handle;
+	batch.num = num;
+	batch.input_data = input_data;
+	batch.output_data = output_data;
+	batch.me_key = rsa_key;
+	batch.status = status;
+	batch.callback = callback;
+	batch.user_data = user_data;
+
+	return rsa_batch_run(&batch, workers);
+}
+
+unsigned int ica_rsa_crt_batch(ica_adapter_handle_t adapter_handle,
+			       unsigned int num,
+			       unsigned char *const *input_data,
+			       ica_rsa_key_crt_t *rsa_key,
+			       unsigned char *const *output_data,
+			       unsigned int *status,
+			       unsigned int workers,
+			       ica_rsa_batch_cb_t callback,
+			       void *user_data)
+{
+	struct rsa_batch batch;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (rsa_key == NULL)
+		return EINVAL;
+
+	if (check_rsa_batch_parms(num, input_data, output_data,
+				  rsa_key->key_length))
+		return EINVAL;
+
+	/* bring the key in privileged form once, before it is shared */
+	ica_rsa_crt_key_check(rsa_key);
+
+	memset(&batch, 0, sizeof(batch));
+	batch.adapter_handle = adapter_handle;
+	batch.num = num;
+	batch.input_data = input_data;
+	batch.output_data = output_data;
+	batch.crt_key = rsa_key;
+	batch.status = status;
+	batch.callback = callback;
+	batch.user_data = user_data;
+
+	return rsa_batch_run(&batch, workers);
+}
+
 /*******************************************************************************
  *
  *                          Begin of ECC API
@@ -1386,6 +2261,150 @@ int ica_ecdsa_verify(ica_adapter_handle_t adapter_handle,
 	return rc;
 }
 
+int ica_ecdsa_ctx_new(const ICA_EC_KEY *key, ica_ecdsa_ctx_t **ctx)
+{
+	ica_ecdsa_ctx_t *tmp;
+	int privlen, rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (key == NULL || ctx == NULL || !curve_supported(key->nid))
+		return EINVAL;
+
+	privlen = privlen_from_nid(key->nid);
+	if (privlen <= 0 || privlen > MAX_ECC_PRIV_SIZE)
+		return EINVAL;
+
+	if ((tmp = calloc(1, sizeof(*tmp))) == NULL)
+		return ENOMEM;
+
+	tmp->privlen = privlen;
+	tmp->key.nid = key->nid;
+	tmp->key.X = tmp->buf;
+	tmp->key.Y = tmp->key.X + privlen;
+	tmp->key.D = tmp->key.Y + privlen;
+	if (key->X != NULL && key->Y != NULL) {
+		memcpy(tmp->key.X, key->X, privlen);
+		memcpy(tmp->key.Y, key->Y, privlen);
+	}
+	if (key->D != NULL)
+		memcpy(tmp->key.D, key->D, privlen);
+
+	rc = ecdsa_ctx_init_sw(tmp);
+	if (rc) {
+		ica_ecdsa_ctx_free(tmp);
+		return rc;
+	}
+
+	*ctx = tmp;
+	return 0;
+}
+
+int ica_ecdsa_ctx_sign(ica_adapter_handle_t adapter_handle,
+		const ica_ecdsa_ctx_t *ctx, const unsigned char *hash,
+		unsigned int hash_length, unsigned char *signature,
+		unsigned int signature_length)
+{
+	int hardware, rc;
+	unsigned int icapath = 0;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || !ctx->has_priv || hash == NULL ||
+		!hash_length_valid(hash_length) || signature == NULL ||
+		signature_length < 2*ctx->privlen)
+		return EINVAL;
+
+	icapath = getenv_icapath();
+	switch (icapath) {
+	case 1: /* hw only */
+		hardware = ALGO_HW;
+		rc = ecdsa_sign_hw(adapter_handle, &ctx->key, hash, hash_length, signature);
+		break;
+	case 2: /* sw only */
+		hardware = ALGO_SW;
+		rc = ecdsa_ctx_sign_sw(ctx, hash, hash_length, signature);
+		break;
+	default: /* hw with sw fallback (default) */
+		hardware = ALGO_SW;
+		rc = ecdsa_sign_hw(adapter_handle, &ctx->key, hash, hash_length, signature);
+		if (rc == 0)
+			hardware = ALGO_HW;
+		else
+			rc = ica_fallbacks_enabled ?
+				ecdsa_ctx_sign_sw(ctx, hash, hash_length, signature) : ENODEV;
+	}
+
+	if (rc == 0)
+		stats_increment(ICA_STATS_ECDSA_SIGN, hardware, ENCRYPT);
+
+	return rc;
+}
+
+int ica_ecdsa_ctx_verify(ica_adapter_handle_t adapter_handle,
+		const ica_ecdsa_ctx_t *ctx, const unsigned char *hash,
+		unsigned int hash_length, const unsigned char *signature,
+		unsigned int signature_length)
+{
+	int hardware, rc;
+	unsigned int icapath = 0;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || hash == NULL || !hash_length_valid(hash_length) ||
+		signature == NULL || signature_length < 2*ctx->privlen)
+		return EINVAL;
+
+	icapath = getenv_icapath();
+	switch (icapath) {
+	case 1: /* hw only */
+		hardware = ALGO_HW;
+		rc = ecdsa_verify_hw(adapter_handle, &ctx->key, hash, hash_length, signature);
+		break;
+	case 2: /* sw only */
+		hardware = ALGO_SW;
+		rc = ecdsa_ctx_verify_sw(ctx, hash, hash_length, signature);
+		break;
+	default: /* hw with sw fallback (default) */
+		hardware = ALGO_SW;
+		rc = ecdsa_verify_hw(adapter_handle, &ctx->key, hash, hash_length, signature);
+		if (rc == 0) {
+			hardware = ALGO_HW;
+		} else if (rc != EFAULT) {
+			rc = ica_fallbacks_enabled ?
+			     ecdsa_ctx_verify_sw(ctx, hash, hash_length,
+						 signature) : ENODEV;
+		}
+	}
+
+	if (rc == 0)
+		stats_increment(ICA_STATS_ECDSA_VERIFY, hardware, ENCRYPT);
+
+	return rc;
+}
+
+void ica_ecdsa_ctx_free(ica_ecdsa_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	ecdsa_ctx_free_sw(ctx);
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	free(ctx);
+}
+
 int ica_ec_key_get_public_key(const ICA_EC_KEY *key, unsigned char *q, unsigned int *q_len)
 {
 	if (!key || !(key->X) || privlen_from_nid(key->nid) < 0)
@@ -1432,10 +2451,19 @@ static inline int check_fips(void)
 #endif
 }
 
+/*
+ * X25519, X448, Ed25519 and Ed448 are done via CPACF on MSA 9 machines and
+ * by the software engine otherwise, if fallbacks are enabled.
+ */
+static inline int ecx_enabled(void)
+{
+	return msa9_switch || ica_fallbacks_enabled;
+}
+
 
 int ica_x25519_ctx_new(ICA_X25519_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL)
+	if (!ecx_enabled() || ctx == NULL)
 		return -1;
 
 	*ctx = calloc(1, sizeof(**ctx));
@@ -1444,7 +2472,7 @@ int ica_x25519_ctx_new(ICA_X25519_CTX **ctx)
 
 int ica_x448_ctx_new(ICA_X448_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL)
+	if (!ecx_enabled() || ctx == NULL)
 		return -1;
 
 	*ctx = calloc(1, sizeof(**ctx));
@@ -1453,7 +2481,7 @@ int ica_x448_ctx_new(ICA_X448_CTX **ctx)
 
 int ica_ed25519_ctx_new(ICA_ED25519_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL)
+	if (!ecx_enabled() || ctx == NULL)
 		return -1;
 
 	*ctx = calloc(1, sizeof(**ctx));
@@ -1462,7 +2490,7 @@ int ica_ed25519_ctx_new(ICA_ED25519_CTX **ctx)
 
 int ica_ed448_ctx_new(ICA_ED448_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL)
+	if (!ecx_enabled() || ctx == NULL)
 		return -1;
 
 	*ctx = calloc(1, sizeof(**ctx));
@@ -1473,7 +2501,7 @@ int ica_x25519_key_set(ICA_X25519_CTX *ctx,
 		       const unsigned char priv[32],
 		       const unsigned char pub[32])
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1494,7 +2522,7 @@ int ica_x448_key_set(ICA_X448_CTX *ctx,
 		     const unsigned char priv[56],
 		     const unsigned char pub[56])
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1515,7 +2543,7 @@ int ica_ed25519_key_set(ICA_ED25519_CTX *ctx,
 			const unsigned char priv[32],
 			const unsigned char pub[32])
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1536,7 +2564,7 @@ int ica_ed448_key_set(ICA_ED448_CTX *ctx,
 		      const unsigned char priv[57],
 		      const unsigned char pub[57])
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1563,7 +2591,7 @@ int ica_x25519_key_get(ICA_X25519_CTX *ctx, unsigned char priv[32],
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1596,7 +2624,7 @@ int ica_x448_key_get(ICA_X448_CTX *ctx, unsigned char priv[56],
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1629,7 +2657,7 @@ int ica_ed25519_key_get(ICA_ED25519_CTX *ctx, unsigned char priv[32],
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1665,7 +2693,7 @@ int ica_ed448_key_get(ICA_ED448_CTX *ctx, unsigned char priv[57],
 	unsigned char pub64[64];
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	if (priv != NULL) {
@@ -1702,15 +2730,23 @@ int ica_x25519_derive(ICA_X25519_CTX *ctx,
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL
 	    || !ctx->priv_init || shared_secret == NULL || peer_pub == NULL)
 		return -1;
 
-	rc = scalar_mulx_cpacf(shared_secret, ctx->priv, peer_pub,
-			       NID_X25519);
+	rc = ENODEV;
+	if (msa9_switch)
+		rc = scalar_mulx_cpacf(shared_secret, ctx->priv, peer_pub,
+				       NID_X25519);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return -1;
+		rc = x25519_sw(shared_secret, ctx->priv, peer_pub);
+		stats_increment(ICA_STATS_X25519_DERIVE, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_X25519_DERIVE, ALGO_HW, ENCRYPT);
 
-	stats_increment(ICA_STATS_X25519_DERIVE, ALGO_HW, ENCRYPT);
-	return rc;
+	return rc ? -1 : 0;
 }
 
 int ica_x448_derive(ICA_X448_CTX *ctx,
@@ -1719,14 +2755,23 @@ int ica_x448_derive(ICA_X448_CTX *ctx,
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL
 	    || !ctx->priv_init || shared_secret == NULL || peer_pub == NULL)
 		return -1;
 
-	rc = scalar_mulx_cpacf(shared_secret, ctx->priv, peer_pub, NID_X448);
+	rc = ENODEV;
+	if (msa9_switch)
+		rc = scalar_mulx_cpacf(shared_secret, ctx->priv, peer_pub,
+				       NID_X448);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return -1;
+		rc = x448_sw(shared_secret, ctx->priv, peer_pub);
+		stats_increment(ICA_STATS_X448_DERIVE, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_X448_DERIVE, ALGO_HW, ENCRYPT);
 
-	stats_increment(ICA_STATS_X448_DERIVE, ALGO_HW, ENCRYPT);
-	return rc;
+	return rc ? -1 : 0;
 }
 
 int ica_ed25519_sign(ICA_ED25519_CTX *ctx, unsigned char sig[64],
@@ -1734,14 +2779,24 @@ int ica_ed25519_sign(ICA_ED25519_CTX *ctx, unsigned char sig[64],
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL
 	    || !ctx->priv_init || sig == NULL || (msg == NULL && msglen != 0))
 		return -1;
 
-	rc = s390_kdsa(S390_CRYPTO_EDDSA_SIGN_ED25519,
-		       &ctx->sign_param, msg, msglen);
-	if (rc)
-		return -1;
+	rc = ENODEV;
+	if (msa9_switch)
+		rc = s390_kdsa(S390_CRYPTO_EDDSA_SIGN_ED25519,
+			       &ctx->sign_param, msg, msglen);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return -1;
+		rc = ed25519_sign_sw(sig, ctx->sign_param.priv, msg, msglen);
+		if (rc)
+			return -1;
+
+		stats_increment(ICA_STATS_ED25519_SIGN, ALGO_SW, ENCRYPT);
+		return 0;
+	}
 
 	s390_flip_endian_32(sig, ctx->sign_param.sig);
 	s390_flip_endian_32(sig + 32, ctx->sign_param.sig + 32);
@@ -1756,14 +2811,25 @@ int ica_ed448_sign(ICA_ED448_CTX *ctx, unsigned char sig[114],
 {
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL
 	    || !ctx->priv_init || sig == NULL || (msg == NULL && msglen != 0))
 		return -1;
 
-	rc = s390_kdsa(S390_CRYPTO_EDDSA_SIGN_ED448,
-		       &ctx->sign_param, msg, msglen);
-	if (rc)
-		return -1;
+	rc = ENODEV;
+	if (msa9_switch)
+		rc = s390_kdsa(S390_CRYPTO_EDDSA_SIGN_ED448,
+			       &ctx->sign_param, msg, msglen);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return -1;
+		rc = ed448_sign_sw(sig, ctx->sign_param.priv + 64 - 57,
+				   msg, msglen);
+		if (rc)
+			return -1;
+
+		stats_increment(ICA_STATS_ED448_SIGN, ALGO_SW, ENCRYPT);
+		return 0;
+	}
 
 	s390_flip_endian_64(ctx->sign_param.sig, ctx->sign_param.sig);
 	s390_flip_endian_64(ctx->sign_param.sig + 64,
@@ -1779,9 +2845,10 @@ int ica_ed448_sign(ICA_ED448_CTX *ctx, unsigned char sig[114],
 int ica_ed25519_verify(ICA_ED25519_CTX *ctx, const unsigned char sig[64],
 		       const unsigned char *msg, size_t msglen)
 {
+	unsigned char pub[32];
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL || sig == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL || sig == NULL
 	    || (msg == NULL && msglen != 0))
 		return -1;
 
@@ -1797,6 +2864,17 @@ int ica_ed25519_verify(ICA_ED25519_CTX *ctx, const unsigned char sig[64],
 		ctx->pub_init = 1;
 	}
 
+	if (!msa9_switch) {
+		/* the public key is kept in big-endian */
+		s390_flip_endian_32(pub, ctx->verify_param.pub);
+		rc = ed25519_verify_sw(sig, pub, msg, msglen);
+		if (rc)
+			return -1;
+
+		stats_increment(ICA_STATS_ED25519_VERIFY, ALGO_SW, ENCRYPT);
+		return 0;
+	}
+
 	s390_flip_endian_32(ctx->verify_param.sig, sig);
 	s390_flip_endian_32(ctx->verify_param.sig + 32, sig + 32);
 
@@ -1814,9 +2892,10 @@ int ica_ed25519_verify(ICA_ED25519_CTX *ctx, const unsigned char sig[64],
 int ica_ed448_verify(ICA_ED448_CTX *ctx, const unsigned char sig[114],
 		     const unsigned char *msg, size_t msglen)
 {
+	unsigned char pub64[64];
 	int rc;
 
-	if (check_fips() || !msa9_switch || ctx == NULL || sig == NULL
+	if (check_fips() || !ecx_enabled() || ctx == NULL || sig == NULL
 	    || (msg == NULL && msglen != 0))
 		return -1;
 
@@ -1832,6 +2911,17 @@ int ica_ed448_verify(ICA_ED448_CTX *ctx, const unsigned char sig[114],
 		ctx->pub_init = 1;
 	}
 
+	if (!msa9_switch) {
+		/* the public key is kept in big-endian */
+		s390_flip_endian_64(pub64, ctx->verify_param.pub);
+		rc = ed448_verify_sw(sig, pub64, msg, msglen);
+		if (rc)
+			return -1;
+
+		stats_increment(ICA_STATS_ED448_VERIFY, ALGO_SW, ENCRYPT);
+		return 0;
+	}
+
 	memcpy(ctx->verify_param.sig, sig, 57);
 	memcpy(ctx->verify_param.sig + 64, sig + 57, 57);
 	s390_flip_endian_64(ctx->verify_param.sig, ctx->verify_param.sig);
@@ -1843,15 +2933,76 @@ int ica_ed448_verify(ICA_ED448_CTX *ctx, const unsigned char sig[114],
 	if (rc || sig[113] != 0)	/* XXX kdsa doesnt check last byte */
 		return -1;
 
-	memset(ctx->verify_param.sig, 0, sizeof(ctx->verify_param.sig));
+	memset(ctx->verify_param.sig, 0, sizeof(ctx->verify_param.sig));
+
+	stats_increment(ICA_STATS_ED448_VERIFY, ALGO_HW, ENCRYPT);
+	return 0;
+}
+
+int ica_ed25519_verify_batch(unsigned int num,
+			     const unsigned char *const msg[],
+			     const size_t msglen[],
+			     const unsigned char *const sig[],
+			     const unsigned char *const pub[],
+			     int status[])
+{
+	struct {
+		unsigned char sig[64];
+		unsigned char pub[32];
+		unsigned char buf[4096 - 64 - 32];
+	} param;
+	unsigned int i;
+	int *st, rc;
+
+	if (check_fips() || !ecx_enabled() || num == 0 || msg == NULL
+	    || msglen == NULL || sig == NULL || pub == NULL)
+		return -1;
+
+	for (i = 0; i < num; i++) {
+		if (sig[i] == NULL || pub[i] == NULL
+		    || (msg[i] == NULL && msglen[i] != 0))
+			return -1;
+	}
 
-	stats_increment(ICA_STATS_ED448_VERIFY, ALGO_HW, ENCRYPT);
-	return 0;
+	st = status;
+	if (st == NULL) {
+		st = malloc(num * sizeof(*st));
+		if (st == NULL)
+			return -1;
+	}
+
+	rc = 0;
+	if (msa9_switch) {
+		/* KDSA verifies one signature at a time */
+		memset(&param, 0, sizeof(param));
+		for (i = 0; i < num; i++) {
+			s390_flip_endian_32(param.sig, sig[i]);
+			s390_flip_endian_32(param.sig + 32, sig[i] + 32);
+			s390_flip_endian_32(param.pub, pub[i]);
+
+			st[i] = s390_kdsa(S390_CRYPTO_EDDSA_VERIFY_ED25519,
+					  &param, msg[i], msglen[i]) ? -1 : 0;
+			if (st[i])
+				rc = -1;
+			stats_increment(ICA_STATS_ED25519_VERIFY, ALGO_HW,
+					ENCRYPT);
+		}
+	} else {
+		if (ed25519_verify_batch_sw(num, msg, msglen, sig, pub, st))
+			rc = -1;
+		for (i = 0; i < num; i++)
+			stats_increment(ICA_STATS_ED25519_VERIFY, ALGO_SW,
+					ENCRYPT);
+	}
+
+	if (st != status)
+		free(st);
+	return rc;
 }
 
 int ica_x25519_ctx_del(ICA_X25519_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL || *ctx == NULL)
+	if (ctx == NULL || *ctx == NULL)
 		return -1;
 
 	OPENSSL_cleanse(*ctx, sizeof(**ctx));
@@ -1862,7 +3013,7 @@ int ica_x25519_ctx_del(ICA_X25519_CTX **ctx)
 
 int ica_x448_ctx_del(ICA_X448_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL || *ctx == NULL)
+	if (ctx == NULL || *ctx == NULL)
 		return -1;
 
 	OPENSSL_cleanse(*ctx, sizeof(**ctx));
@@ -1873,7 +3024,7 @@ int ica_x448_ctx_del(ICA_X448_CTX **ctx)
 
 int ica_ed25519_ctx_del(ICA_ED25519_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL || *ctx == NULL)
+	if (ctx == NULL || *ctx == NULL)
 		return -1;
 
 	OPENSSL_cleanse(*ctx, sizeof(**ctx));
@@ -1884,7 +3035,7 @@ int ica_ed25519_ctx_del(ICA_ED25519_CTX **ctx)
 
 int ica_ed448_ctx_del(ICA_ED448_CTX **ctx)
 {
-	if (!msa9_switch || ctx == NULL || *ctx == NULL)
+	if (ctx == NULL || *ctx == NULL)
 		return -1;
 
 	OPENSSL_cleanse(*ctx, sizeof(**ctx));
@@ -1895,7 +3046,7 @@ int ica_ed448_ctx_del(ICA_ED448_CTX **ctx)
 
 int ica_x25519_key_gen(ICA_X25519_CTX *ctx)
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	memset(ctx, 0, sizeof(*ctx));
@@ -1909,7 +3060,7 @@ int ica_x25519_key_gen(ICA_X25519_CTX *ctx)
 
 int ica_x448_key_gen(ICA_X448_CTX *ctx)
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	memset(ctx, 0, sizeof(*ctx));
@@ -1923,7 +3074,7 @@ int ica_x448_key_gen(ICA_X448_CTX *ctx)
 
 int ica_ed25519_key_gen(ICA_ED25519_CTX *ctx)
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	memset(ctx, 0, sizeof(*ctx));
@@ -1937,7 +3088,7 @@ int ica_ed25519_key_gen(ICA_ED25519_CTX *ctx)
 
 int ica_ed448_key_gen(ICA_ED448_CTX *ctx)
 {
-	if (check_fips() || !msa9_switch || ctx == NULL)
+	if (check_fips() || !ecx_enabled() || ctx == NULL)
 		return -1;
 
 	memset(ctx, 0, sizeof(*ctx));
@@ -3037,68 +4188,417 @@ unsigned int ica_aes_gcm_initialize(const unsigned char *iv,
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	function_code = aes_directed_fc(key_length, direction);
+	function_code = aes_directed_fc(key_length, direction);
+
+	return s390_gcm_initialize(function_code, iv, iv_length,
+							   key, icb, ucb, subkey);
+}
+
+unsigned int ica_aes_gcm_intermediate(unsigned char *plaintext,
+			 unsigned long plaintext_length,
+			 unsigned char *ciphertext,
+			 unsigned char *cb,
+			 unsigned char *aad, unsigned long aad_length,
+			 unsigned char *tag, unsigned int tag_length,
+			 unsigned char *key, unsigned int key_length,
+			 unsigned char *subkey, unsigned int direction)
+{
+	unsigned long function_code;
+	int rc, iv_length_dummy = 12;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (plaintext_length != 0) {
+		if (check_aes_parms(MODE_GCM, plaintext_length, plaintext, cb, key_length,
+				    key, ciphertext))
+			return EINVAL;
+	} else {
+		/* If only aad is processed (ghash), pt/ct may be NULL. */
+		if (check_aes_parms(MODE_GCM, plaintext_length, (unsigned char *)1,
+				    cb, key_length, key, (unsigned char *)1))
+			return EINVAL;
+	}
+	if (check_gcm_parms(plaintext_length, aad_length, tag, tag_length,
+			    iv_length_dummy))
+		return EINVAL;
+
+	function_code = aes_directed_fc(key_length, direction);
+	if (direction) {
+		/* encrypt & generate */
+		rc = s390_gcm_intermediate(function_code, plaintext, plaintext_length,
+		    ciphertext, cb, aad, aad_length, tag, key, subkey);
+		if (rc)
+			return rc;
+	} else {
+		/* decrypt & verify */
+		rc = s390_gcm_intermediate(function_code, plaintext, plaintext_length,
+		    ciphertext, cb, aad, aad_length, tag, key, subkey);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
+
+unsigned int ica_aes_gcm_last( unsigned char *icb,
+			 unsigned long aad_length, unsigned long ciph_length,
+			 unsigned char *tag,
+			 unsigned char *final_tag, unsigned int final_tag_length,
+			 unsigned char *key, unsigned int key_length,
+			 unsigned char *subkey, unsigned int direction)
+{
+	unsigned long function_code;
+	int rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	function_code = aes_directed_fc(key_length, direction);
+	if (direction) {
+		/* encrypt & generate */
+		rc = s390_gcm_last(function_code, icb, aad_length, ciph_length,
+						   tag, AES_BLOCK_SIZE, key, subkey);
+		if (rc)
+			return rc;
+	} else {
+		/* decrypt & verify */
+		rc = s390_gcm_last(function_code, icb, aad_length, ciph_length,
+			      tag, AES_BLOCK_SIZE, key, subkey);
+		if (rc)
+			return rc;
+
+		if (CRYPTO_memcmp(tag, final_tag, final_tag_length))
+			return EFAULT;
+	}
+	return 0;
+}
+
+/*************************************************************************************
+ *
+ *                                     GCM(2) API
+ */
+
+kma_ctx* ica_aes_gcm_kma_ctx_new(void)
+{
+	kma_ctx* ctx = malloc(sizeof(kma_ctx));
+	if (!ctx)
+		return NULL;
+
+	memset(ctx, 0, sizeof(kma_ctx));
+
+	return ctx;
+}
+
+int ica_aes_gcm_kma_init(unsigned int direction,
+		const unsigned char *iv, unsigned int iv_length,
+		const unsigned char *key, unsigned int key_length,
+		kma_ctx* ctx)
+{
+	/* Check for obvious errors */
+	if (!ctx || !key || iv_length == 0 || !is_valid_aes_key_length(key_length) ||
+		!is_valid_direction(direction)) {
+		return EINVAL;
+	}
+
+	memset(ctx, 0, sizeof(kma_ctx));
+	ctx->version = 0x00;
+	ctx->direction = direction;
+	ctx->key_length = key_length;
+	memcpy(&(ctx->key), key, key_length);
+
+	return s390_aes_gcm_kma_set_iv(iv, iv_length, ctx);
+}
+
+int ica_aes_gcm_kma_set_iv(const unsigned char *iv, unsigned int iv_length,
+		kma_ctx* ctx)
+{
+	/* Check for obvious errors */
+	if (!ctx || !iv || iv_length == 0 ||
+		!is_valid_aes_key_length(ctx->key_length))
+		return EINVAL;
+
+	return s390_aes_gcm_kma_set_iv(iv, iv_length, ctx);
+}
+
+int ica_aes_gcm_kma_update(const unsigned char *in_data,
+		unsigned char *out_data, unsigned long data_length,
+		const unsigned char *aad, unsigned long aad_length,
+		unsigned int end_of_aad, unsigned int end_of_data,
+		kma_ctx* ctx)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (data_length > 0 && (!in_data || !out_data))
+		return EFAULT;
+
+	return s390_aes_gcm_kma_update(in_data, out_data, data_length,
+			aad, aad_length, end_of_aad, end_of_data, ctx);
+}
+
+int ica_aes_gcm_kma_get_tag(unsigned char *tag, unsigned int tag_length, const kma_ctx* ctx)
+{
+	int rc;
+
+	if (!ctx || !tag || !is_valid_tag_length(tag_length))
+		return EINVAL;
+
+	if (ctx->direction == ICA_DECRYPT)
+		return EFAULT;
+
+	rc = s390_aes_gcm_kma_tag((kma_ctx*)ctx);
+	if (rc)
+		return rc;
+
+	memcpy(tag, ctx->tag, tag_length);
+
+	return 0;
+}
+
+int ica_aes_gcm_kma_verify_tag(const unsigned char* known_tag, unsigned int tag_length, const kma_ctx* ctx)
+{
+	int rc;
+
+	if (!ctx || !known_tag || !is_valid_tag_length(tag_length))
+		return EINVAL;
+
+	if (ctx->direction == ICA_ENCRYPT)
+		return EFAULT;
+
+	rc = s390_aes_gcm_kma_tag((kma_ctx*)ctx);
+	if (rc)
+		return rc;
+
+	if (CRYPTO_memcmp(ctx->tag, known_tag, tag_length) != 0)
+		return EFAULT;
+
+	return 0;
+}
+
+void ica_aes_gcm_kma_ctx_free(kma_ctx* ctx)
+{
+    if (!ctx)
+	return;
+
+    OPENSSL_cleanse((void *)ctx, sizeof(kma_ctx));
+
+    free(ctx);
+}
+
+/**
+ *                             End of GCM(2) API
+ *
+ ***************************************************************************************/
+
+int ica_aes_key_new(const unsigned char *key, unsigned int key_length,
+		    ica_aes_key_t **aes_key)
+{
+	ica_aes_key_t *tmp;
+	int rc;
+
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (key == NULL || aes_key == NULL ||
+	    !is_valid_aes_key_length(key_length))
+		return EINVAL;
+
+	if ((tmp = malloc(sizeof(*tmp))) == NULL)
+		return ENOMEM;
+
+	rc = s390_aes_key_init(tmp, key, key_length);
+	if (rc) {
+		ica_aes_key_free(tmp);
+		return rc;
+	}
+
+	*aes_key = tmp;
+	return 0;
+}
+
+void ica_aes_key_free(ica_aes_key_t *aes_key)
+{
+	if (aes_key == NULL)
+		return;
+
+	OPENSSL_cleanse(aes_key, sizeof(*aes_key));
+	free(aes_key);
+}
+
+int ica_aes_ecb_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned int direction)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (aes_key == NULL ||
+	    check_aes_parms(MODE_ECB, data_length, in_data, NULL,
+			    aes_key->key_length, aes_key->key, out_data))
+		return EINVAL;
+
+	return s390_aes_ecb_key(aes_key,
+				aes_directed_fc(aes_key->key_length, direction),
+				data_length, in_data, out_data);
+}
+
+int ica_aes_cbc_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned char *iv,
+		    unsigned int direction)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (aes_key == NULL ||
+	    check_aes_parms(MODE_CBC, data_length, in_data, iv,
+			    aes_key->key_length, aes_key->key, out_data))
+		return EINVAL;
+
+	return s390_aes_cbc_key(aes_key,
+				aes_directed_fc(aes_key->key_length, direction),
+				data_length, in_data, iv, out_data);
+}
+
+int ica_aes_ctr_key(const ica_aes_key_t *aes_key,
+		    const unsigned char *in_data, unsigned char *out_data,
+		    unsigned long data_length, unsigned char *ctr,
+		    unsigned int ctr_width)
+{
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (aes_key == NULL ||
+	    check_aes_parms(MODE_CTR, data_length, in_data, ctr,
+			    aes_key->key_length, aes_key->key, out_data))
+		return EINVAL;
 
-	return s390_gcm_initialize(function_code, iv, iv_length,
-							   key, icb, ucb, subkey);
+	if ((ctr_width & (8 - 1)) ||
+	    (ctr_width < 8) ||
+	    (ctr_width > (AES_BLOCK_SIZE*8)))
+		return EINVAL;
+
+	return s390_aes_ctr_key(aes_key,
+				aes_directed_fc(aes_key->key_length, ICA_ENCRYPT),
+				in_data, out_data, data_length, ctr, ctr_width);
 }
 
-unsigned int ica_aes_gcm_intermediate(unsigned char *plaintext,
-			 unsigned long plaintext_length,
-			 unsigned char *ciphertext,
-			 unsigned char *cb,
-			 unsigned char *aad, unsigned long aad_length,
-			 unsigned char *tag, unsigned int tag_length,
-			 unsigned char *key, unsigned int key_length,
-			 unsigned char *subkey, unsigned int direction)
+int ica_aes_gcm_key(const ica_aes_key_t *aes_key,
+		    unsigned char *plaintext, unsigned long plaintext_length,
+		    unsigned char *ciphertext,
+		    const unsigned char *iv, unsigned int iv_length,
+		    const unsigned char *aad, unsigned long aad_length,
+		    unsigned char *tag, unsigned int tag_length,
+		    unsigned int direction)
 {
+	unsigned char tmp_tag[AES_BLOCK_SIZE];
 	unsigned long function_code;
-	int rc, iv_length_dummy = 12;
+	int rc;
 
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
+	if (aes_key == NULL)
+		return EINVAL;
 	if (plaintext_length != 0) {
-		if (check_aes_parms(MODE_GCM, plaintext_length, plaintext, cb, key_length,
-				    key, ciphertext))
+		if (check_aes_parms(MODE_GCM, plaintext_length, plaintext, iv,
+				    aes_key->key_length, aes_key->key,
+				    ciphertext))
 			return EINVAL;
 	} else {
 		/* If only aad is processed (ghash), pt/ct may be NULL. */
-		if (check_aes_parms(MODE_GCM, plaintext_length, (unsigned char *)1,
-				    cb, key_length, key, (unsigned char *)1))
+		if (check_aes_parms(MODE_GCM, plaintext_length,
+				    (unsigned char *)1, iv, aes_key->key_length,
+				    aes_key->key, (unsigned char *)1))
 			return EINVAL;
 	}
 	if (check_gcm_parms(plaintext_length, aad_length, tag, tag_length,
-			    iv_length_dummy))
+			    iv_length))
 		return EINVAL;
 
-	function_code = aes_directed_fc(key_length, direction);
+	memset(tmp_tag, 0, sizeof(tmp_tag));
+
+	function_code = aes_directed_fc(aes_key->key_length, direction);
 	if (direction) {
 		/* encrypt & generate */
-		rc = s390_gcm_intermediate(function_code, plaintext, plaintext_length,
-		    ciphertext, cb, aad, aad_length, tag, key, subkey);
-		if (rc)
-			return rc;
-	} else {
-		/* decrypt & verify */
-		rc = s390_gcm_intermediate(function_code, plaintext, plaintext_length,
-		    ciphertext, cb, aad, aad_length, tag, key, subkey);
-		if (rc)
-			return rc;
+		return __s390_gcm(function_code, plaintext, plaintext_length,
+				  ciphertext, iv, iv_length, aad, aad_length,
+				  tag, tag_length,
+				  (unsigned char *)aes_key->key,
+				  (unsigned char *)aes_key->subkey_h);
 	}
+
+	/* decrypt & verify */
+	rc = __s390_gcm(function_code, plaintext, plaintext_length,
+			ciphertext, iv, iv_length, aad, aad_length,
+			tmp_tag, AES_BLOCK_SIZE,
+			(unsigned char *)aes_key->key,
+			(unsigned char *)aes_key->subkey_h);
+	if (rc)
+		return rc;
+
+	if (CRYPTO_memcmp(tmp_tag, tag, tag_length))
+		return EFAULT;
 	return 0;
 }
 
-unsigned int ica_aes_gcm_last( unsigned char *icb,
-			 unsigned long aad_length, unsigned long ciph_length,
-			 unsigned char *tag,
-			 unsigned char *final_tag, unsigned int final_tag_length,
-			 unsigned char *key, unsigned int key_length,
-			 unsigned char *subkey, unsigned int direction)
+/* Total length of a list of buffers. A NULL list must be empty. */
+static int get_iov_length(const struct iovec *iov, unsigned int iovcnt,
+			  uint64_t *length)
 {
-	unsigned long function_code;
+	unsigned int i;
+
+	if (iov == NULL && iovcnt)
+		return EINVAL;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_base == NULL && iov[i].iov_len)
+			return EINVAL;
+	}
+
+	*length = iov_total_length(iov, iovcnt);
+	return *length == UINT64_MAX ? EINVAL : 0;
+}
+
+/* A GCM context for the key object, with the precomputed subkey H. */
+static void gcm_ctx_from_key(kma_ctx *ctx, const ica_aes_key_t *aes_key,
+			     unsigned int direction)
+{
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->direction = direction;
+	ctx->key_length = aes_key->key_length;
+	memcpy(ctx->key, aes_key->key, aes_key->key_length);
+	memcpy(ctx->subkey_h, aes_key->subkey_h, sizeof(ctx->subkey_h));
+	ctx->subkey_provided = 1;
+}
+
+static int aes_gcm_iov(const ica_aes_key_t *aes_key,
+		       const unsigned char *iv, unsigned int iv_length,
+		       const struct iovec *aad, unsigned int aad_cnt,
+		       const struct iovec *in, unsigned int in_cnt,
+		       const struct iovec *out, unsigned int out_cnt,
+		       unsigned char *tag, unsigned int tag_length,
+		       unsigned int direction)
+{
+	uint64_t aad_length, in_length, out_length;
+	kma_ctx ctx;
 	int rc;
 
 #ifdef ICA_FIPS
@@ -3106,188 +4606,389 @@ unsigned int ica_aes_gcm_last( unsigned char *icb,
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	function_code = aes_directed_fc(key_length, direction);
-	if (direction) {
-		/* encrypt & generate */
-		rc = s390_gcm_last(function_code, icb, aad_length, ciph_length,
-						   tag, AES_BLOCK_SIZE, key, subkey);
-		if (rc)
-			return rc;
-	} else {
-		/* decrypt & verify */
-		rc = s390_gcm_last(function_code, icb, aad_length, ciph_length,
-			      tag, AES_BLOCK_SIZE, key, subkey);
-		if (rc)
-			return rc;
+	/* check for obvious errors in parms */
+	if (aes_key == NULL || iv == NULL ||
+	    get_iov_length(aad, aad_cnt, &aad_length) ||
+	    get_iov_length(in, in_cnt, &in_length) ||
+	    get_iov_length(out, out_cnt, &out_length) ||
+	    in_length != out_length)
+		return EINVAL;
+	if (check_gcm_parms(in_length, aad_length, tag, tag_length,
+			    iv_length))
+		return EINVAL;
 
-		if (CRYPTO_memcmp(tag, final_tag, final_tag_length))
-			return EFAULT;
+	gcm_ctx_from_key(&ctx, aes_key, direction);
+
+	rc = s390_aes_gcm_kma_set_iv(iv, iv_length, &ctx);
+	if (rc == 0)
+		rc = s390_aes_gcm_kma_iov(aad, aad_cnt, aad_length,
+					  in, in_cnt, out, out_cnt, in_length,
+					  &ctx);
+	if (rc == 0) {
+		if (direction == ICA_ENCRYPT)
+			memcpy(tag, ctx.tag, tag_length);
+		else if (CRYPTO_memcmp(ctx.tag, tag, tag_length))
+			rc = EFAULT;
 	}
-	return 0;
-}
 
-/*************************************************************************************
- *
- *                                     GCM(2) API
- */
+	OPENSSL_cleanse(&ctx, sizeof(ctx));
+	return rc;
+}
 
-kma_ctx* ica_aes_gcm_kma_ctx_new(void)
+int ica_aes_gcm_sealv(const ica_aes_key_t *aes_key,
+		      const unsigned char *iv, unsigned int iv_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      unsigned char *tag, unsigned int tag_length)
 {
-	kma_ctx* ctx = malloc(sizeof(kma_ctx));
-	if (!ctx)
-		return NULL;
-
-	memset(ctx, 0, sizeof(kma_ctx));
+	return aes_gcm_iov(aes_key, iv, iv_length, aad, aad_cnt, in, in_cnt,
+			   out, out_cnt, tag, tag_length, ICA_ENCRYPT);
+}
 
-	return ctx;
+int ica_aes_gcm_openv(const ica_aes_key_t *aes_key,
+		      const unsigned char *iv, unsigned int iv_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      const unsigned char *tag, unsigned int tag_length)
+{
+	return aes_gcm_iov(aes_key, iv, iv_length, aad, aad_cnt, in, in_cnt,
+			   out, out_cnt, (unsigned char *)tag, tag_length,
+			   ICA_DECRYPT);
 }
 
-int ica_aes_gcm_kma_init(unsigned int direction,
-		const unsigned char *iv, unsigned int iv_length,
-		const unsigned char *key, unsigned int key_length,
-		kma_ctx* ctx)
+static int aes_gcm_batch(const ica_aes_key_t *aes_key, unsigned int num,
+			 const unsigned char *const iv[],
+			 unsigned int iv_length,
+			 const unsigned char *const aad[],
+			 const size_t aad_length[],
+			 const unsigned char *const in_data[],
+			 unsigned char *const out_data[],
+			 const size_t data_length[],
+			 unsigned char *const tag[], unsigned int tag_length,
+			 int status[], unsigned int direction)
 {
-	int rc = 0;
-	unsigned long function_code = aes_directed_fc(key_length, direction);
+	uint64_t bytes = 0, ops = 0, start;
+	unsigned int i, hw_fc;
+	size_t alen;
+	kma_ctx ctx;
+	int rc, ret = 0;
 
-	/* Check for obvious errors */
-	if (!ctx || !key || iv_length == 0 || !is_valid_aes_key_length(key_length) ||
-		!is_valid_direction(direction)) {
-		return EINVAL;
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (aes_key == NULL || num == 0 || iv == NULL ||
+	    (aad != NULL && aad_length == NULL) || in_data == NULL ||
+	    out_data == NULL || data_length == NULL || tag == NULL)
+		return EINVAL;
+	for (i = 0; i < num; i++) {
+		alen = aad ? aad_length[i] : 0;
+		if (iv[i] == NULL || (alen && aad[i] == NULL) ||
+		    (data_length[i] &&
+		     (in_data[i] == NULL || out_data[i] == NULL)) ||
+		    check_gcm_parms(data_length[i], alen, tag[i], tag_length,
+				    iv_length))
+			return EINVAL;
 	}
 
-	memset(ctx, 0, sizeof(kma_ctx));
-	ctx->version = 0x00;
-	ctx->direction = direction;
-	ctx->key_length = key_length;
-	ctx->iv = (unsigned char*)iv;
-	ctx->iv_length = iv_length;
-	memcpy(&(ctx->key), key, key_length);
+	gcm_ctx_from_key(&ctx, aes_key, direction);
+	hw_fc = s390_aes_gcm_kma_message_fc(&ctx);
+	start = hw_fc ? stats_clock() : 0;
 
-	/* Calculate subkey_h and j0 depending on iv_length */
-	if (*s390_kma_functions[function_code].enabled && iv_length == GCM_RECOMMENDED_IV_LENGTH) {
-		/* let KMA provide the subkey_h, j0 = iv || 00000001 */
-		memcpy(&(ctx->j0), iv, iv_length);
-		ctx->cv = 1;
-		unsigned int* cv = (unsigned int*)&(ctx->j0[GCM_RECOMMENDED_IV_LENGTH]);
-		*cv = 1;
-	} else {
-		/* Calculate subkey H and initial counter, based on iv */
-		rc = s390_aes_ecb(UNDIRECTED_FC(function_code),
-				AES_BLOCK_SIZE, zero_block,
-				(unsigned char*)key, (unsigned char*)&(ctx->subkey_h));
-		if (rc)
-			return rc;
-		__compute_j0(iv, iv_length, (const unsigned char*)&(ctx->subkey_h),
-				(unsigned char*)&(ctx->j0));
-		unsigned int *cv = (unsigned int*)&(ctx->j0[GCM_RECOMMENDED_IV_LENGTH]);
-		ctx->cv = *cv;
-		ctx->subkey_provided = 1;
+	/* the key part of the parameter block stays the same for all */
+	for (i = 0; i < num; i++) {
+		alen = aad ? aad_length[i] : 0;
+		rc = s390_aes_gcm_kma_set_iv(iv[i], iv_length, &ctx);
+		if (rc == 0)
+			rc = s390_aes_gcm_kma_message(in_data[i], out_data[i],
+						      data_length[i],
+						      alen ? aad[i] : NULL,
+						      alen, hw_fc, &ctx);
+		if (rc == 0) {
+			ops++;
+			bytes += data_length[i];
+			if (direction == ICA_ENCRYPT)
+				memcpy(tag[i], ctx.tag, tag_length);
+			else if (CRYPTO_memcmp(ctx.tag, tag[i], tag_length))
+				rc = EFAULT;
+		}
+
+		if (status)
+			status[i] = rc;
+		if (rc && !ret)
+			ret = rc;
 	}
 
-	return rc;
+	if (hw_fc && ops)
+		stats_add_batch(ICA_STATS_AES_GCM, ALGO_HW,
+				direction == ICA_ENCRYPT ? ENCRYPT : DECRYPT,
+				ops, bytes, start);
+
+	OPENSSL_cleanse(&ctx, sizeof(ctx));
+	return ret;
 }
 
-int ica_aes_gcm_kma_update(const unsigned char *in_data,
-		unsigned char *out_data, unsigned long data_length,
-		const unsigned char *aad, unsigned long aad_length,
-		unsigned int end_of_aad, unsigned int end_of_data,
-		kma_ctx* ctx)
+int ica_aes_gcm_seal_batch(const ica_aes_key_t *aes_key, unsigned int num,
+			   const unsigned char *const iv[],
+			   unsigned int iv_length,
+			   const unsigned char *const aad[],
+			   const size_t aad_length[],
+			   const unsigned char *const plaintext[],
+			   unsigned char *const ciphertext[],
+			   const size_t length[],
+			   unsigned char *const tag[], unsigned int tag_length,
+			   int status[])
+{
+	return aes_gcm_batch(aes_key, num, iv, iv_length, aad, aad_length,
+			     plaintext, ciphertext, length, tag, tag_length,
+			     status, ICA_ENCRYPT);
+}
+
+int ica_aes_gcm_open_batch(const ica_aes_key_t *aes_key, unsigned int num,
+			   const unsigned char *const iv[],
+			   unsigned int iv_length,
+			   const unsigned char *const aad[],
+			   const size_t aad_length[],
+			   const unsigned char *const ciphertext[],
+			   unsigned char *const plaintext[],
+			   const size_t length[],
+			   const unsigned char *const tag[],
+			   unsigned int tag_length, int status[])
 {
-	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+	return aes_gcm_batch(aes_key, num, iv, iv_length, aad, aad_length,
+			     ciphertext, plaintext, length,
+			     (unsigned char *const *)tag, tag_length,
+			     status, ICA_DECRYPT);
+}
+
+static int aes_ccm_iov(const ica_aes_key_t *aes_key,
+		       const unsigned char *nonce, unsigned int nonce_length,
+		       const struct iovec *aad, unsigned int aad_cnt,
+		       const struct iovec *in, unsigned int in_cnt,
+		       const struct iovec *out, unsigned int out_cnt,
+		       unsigned char *mac, unsigned int mac_length,
+		       unsigned int direction)
+{
+	uint64_t aad_length, in_length, out_length;
+	unsigned char tmp_mac[AES_BLOCK_SIZE];
+	struct ccm_state state;
+	int rc;
 
 #ifdef ICA_FIPS
 	if (fips >> 1)
 		return EACCES;
 #endif /* ICA_FIPS */
 
-	if (data_length > 0 && (!in_data || !out_data))
-		return EFAULT;
+	/* check for obvious errors in parms */
+	if (aes_key == NULL || nonce == NULL ||
+	    get_iov_length(aad, aad_cnt, &aad_length) ||
+	    get_iov_length(in, in_cnt, &in_length) ||
+	    get_iov_length(out, out_cnt, &out_length) ||
+	    in_length != out_length)
+		return EINVAL;
+	if (check_ccm_parms(in_length, aad_length, mac, mac_length,
+			    nonce_length))
+		return EINVAL;
+
+	rc = s390_ccm_start(&state,
+			    aes_directed_fc(aes_key->key_length, direction),
+			    aes_key->key, nonce, nonce_length,
+			    aad_length, in_length, mac_length);
+	if (rc == 0)
+		rc = s390_ccm_iov(&state, aad, aad_cnt, in, in_cnt,
+				  out, out_cnt, in_length);
+	if (rc == 0)
+		rc = s390_ccm_finish(&state, direction == ICA_ENCRYPT ?
+				     mac : tmp_mac, mac_length);
+	if (rc == 0 && direction == ICA_DECRYPT &&
+	    CRYPTO_memcmp(tmp_mac, mac, mac_length))
+		rc = EFAULT;
 
-	if (!(*s390_kma_functions[function_code].enabled)) {
+	OPENSSL_cleanse(&state, sizeof(state));
+	return rc;
+}
 
-		if (end_of_aad && end_of_data && !ctx->intermediate) {
-			ctx->done = 1;
-			return s390_aes_gcm_simulate_kma_full(in_data, out_data, data_length,
-									aad, aad_length, ctx);
-		} else {
-			ctx->intermediate = 1;
-			return s390_aes_gcm_simulate_kma_intermediate(in_data, out_data, data_length,
-									aad, aad_length, ctx);
-		}
+int ica_aes_ccm_sealv(const ica_aes_key_t *aes_key,
+		      const unsigned char *nonce, unsigned int nonce_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      unsigned char *mac, unsigned int mac_length)
+{
+	return aes_ccm_iov(aes_key, nonce, nonce_length, aad, aad_cnt,
+			   in, in_cnt, out, out_cnt, mac, mac_length,
+			   ICA_ENCRYPT);
+}
 
-	} else {
+int ica_aes_ccm_openv(const ica_aes_key_t *aes_key,
+		      const unsigned char *nonce, unsigned int nonce_length,
+		      const struct iovec *aad, unsigned int aad_cnt,
+		      const struct iovec *in, unsigned int in_cnt,
+		      const struct iovec *out, unsigned int out_cnt,
+		      const unsigned char *mac, unsigned int mac_length)
+{
+	return aes_ccm_iov(aes_key, nonce, nonce_length, aad, aad_cnt,
+			   in, in_cnt, out, out_cnt, (unsigned char *)mac,
+			   mac_length, ICA_DECRYPT);
+}
 
-		return s390_aes_gcm_kma(in_data, out_data, data_length,
-								aad, aad_length, end_of_aad, end_of_data, ctx);
-	}
+ica_aes_ccm_ctx_t *ica_aes_ccm_ctx_new(void)
+{
+	return calloc(1, sizeof(ica_aes_ccm_ctx_t));
 }
 
-int ica_aes_gcm_kma_get_tag(unsigned char *tag, unsigned int tag_length, const kma_ctx* ctx)
+int ica_aes_ccm_init(unsigned int direction,
+		     const unsigned char *nonce, unsigned int nonce_length,
+		     unsigned long assoc_data_length,
+		     unsigned long payload_length, unsigned int mac_length,
+		     const unsigned char *key, unsigned int key_length,
+		     ica_aes_ccm_ctx_t *ctx)
 {
-	int rc=0;
-	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+	int rc;
 
-	if (!ctx || !tag || !is_valid_tag_length(tag_length))
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms, the mac follows at the end */
+	if (ctx == NULL || nonce == NULL || key == NULL ||
+	    !is_valid_aes_key_length(key_length) ||
+	    !is_valid_direction(direction) ||
+	    check_ccm_lengths(payload_length, assoc_data_length,
+			      mac_length, nonce_length))
 		return EINVAL;
 
-	if (ctx->direction == ICA_DECRYPT)
-		return EFAULT;
+	memset(ctx, 0, sizeof(*ctx));
+	rc = s390_ccm_start(&ctx->state, aes_directed_fc(key_length, direction),
+			    key, nonce, nonce_length, assoc_data_length,
+			    payload_length, mac_length);
+	if (rc)
+		return rc;
+
+	ctx->assoc_data_left = assoc_data_length;
+	ctx->payload_left = payload_length;
+	ctx->mac_length = mac_length;
+	return 0;
+}
+
+int ica_aes_ccm_update(const unsigned char *in_data, unsigned char *out_data,
+		       unsigned long data_length,
+		       const unsigned char *assoc_data,
+		       unsigned long assoc_data_length,
+		       ica_aes_ccm_ctx_t *ctx)
+{
+	int rc;
 
-	if (!(*s390_kma_functions[function_code].enabled) && !ctx->done) {
-		rc = s390_gcm_last(function_code, (unsigned char*)ctx->j0,
-				ctx->total_aad_length, ctx->total_input_length,
-				(unsigned char*)ctx->tag, AES_BLOCK_SIZE,
-				(unsigned char*)ctx->key, (unsigned char*)ctx->subkey_h);
+#ifdef ICA_FIPS
+	if (fips >> 1)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* check for obvious errors in parms */
+	if (ctx == NULL || ctx->mac_length == 0 || ctx->done ||
+	    (assoc_data_length && assoc_data == NULL) ||
+	    (data_length && (in_data == NULL || out_data == NULL)) ||
+	    assoc_data_length > ctx->assoc_data_left ||
+	    data_length > ctx->payload_left)
+		return EINVAL;
+
+	/* associated data first, payload in blocks except at the end */
+	if (assoc_data_length && ctx->state.payload)
+		return EINVAL;
+	if (data_length &&
+	    (ctx->partial || assoc_data_length < ctx->assoc_data_left))
+		return EINVAL;
+
+	if (assoc_data_length) {
+		rc = s390_ccm_mac_update(&ctx->state, assoc_data,
+					 assoc_data_length);
 		if (rc)
 			return rc;
+		ctx->assoc_data_left -= assoc_data_length;
 	}
 
-	memcpy(tag, ctx->tag, tag_length);
+	if (data_length) {
+		rc = s390_ccm_crypt(&ctx->state, in_data, out_data,
+				    data_length);
+		if (rc)
+			return rc;
+		ctx->payload_left -= data_length;
+		ctx->partial = data_length % AES_BLOCK_SIZE != 0;
+	}
 
 	return 0;
 }
 
-int ica_aes_gcm_kma_verify_tag(const unsigned char* known_tag, unsigned int tag_length, const kma_ctx* ctx)
+static int aes_ccm_final(ica_aes_ccm_ctx_t *ctx, unsigned int mac_length)
 {
 	int rc;
-	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
 
-	if (!ctx || !known_tag || !is_valid_tag_length(tag_length))
+	if (mac_length != ctx->mac_length ||
+	    ctx->assoc_data_left || ctx->payload_left)
 		return EINVAL;
 
-	if (ctx->direction == ICA_ENCRYPT)
-		return EFAULT;
-
-	if (!(*s390_kma_functions[function_code].enabled) && !ctx->done) {
-		rc = s390_gcm_last(function_code, (unsigned char*)ctx->j0,
-				ctx->total_aad_length, ctx->total_input_length,
-				(unsigned char*)ctx->tag, AES_BLOCK_SIZE,
-				(unsigned char*)ctx->key, (unsigned char*)ctx->subkey_h);
+	if (!ctx->done) {
+		rc = s390_ccm_finish(&ctx->state, ctx->mac, ctx->mac_length);
 		if (rc)
 			return rc;
+		ctx->done = 1;
 	}
 
-	if (CRYPTO_memcmp(ctx->tag, known_tag, tag_length) != 0)
+	return 0;
+}
+
+int ica_aes_ccm_get_mac(unsigned char *mac, unsigned int mac_length,
+			ica_aes_ccm_ctx_t *ctx)
+{
+	int rc;
+
+	if (mac == NULL || ctx == NULL || ctx->mac_length == 0)
+		return EINVAL;
+
+	if (ctx->state.function_code % 2)
 		return EFAULT;
 
+	rc = aes_ccm_final(ctx, mac_length);
+	if (rc)
+		return rc;
+
+	memcpy(mac, ctx->mac, mac_length);
 	return 0;
 }
 
-void ica_aes_gcm_kma_ctx_free(kma_ctx* ctx)
+int ica_aes_ccm_verify_mac(const unsigned char *mac, unsigned int mac_length,
+			   ica_aes_ccm_ctx_t *ctx)
 {
-    if (!ctx)
-	return;
+	int rc;
 
-    OPENSSL_cleanse((void *)ctx, sizeof(kma_ctx));
+	if (mac == NULL || ctx == NULL || ctx->mac_length == 0)
+		return EINVAL;
 
-    free(ctx);
+	if (!(ctx->state.function_code % 2))
+		return EFAULT;
+
+	rc = aes_ccm_final(ctx, mac_length);
+	if (rc)
+		return rc;
+
+	if (CRYPTO_memcmp(ctx->mac, mac, mac_length))
+		return EFAULT;
+	return 0;
 }
 
-/**
- *                             End of GCM(2) API
- *
- ***************************************************************************************/
+void ica_aes_ccm_ctx_free(ica_aes_ccm_ctx_t *ctx)
+{
+	if (ctx == NULL)
+		return;
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	free(ctx);
+}
 
 unsigned int ica_get_version(libica_version_info *version_info)
 {
@@ -3462,26 +5163,40 @@ int ica_drbg_generate(ica_drbg_t *sh,
 	if(status)
 		return ica_drbg_error(status);
 
+	status = pthread_rwlock_rdlock(&sh->mech->lock);
+	if(EAGAIN == status)
+		return ica_drbg_error(DRBG_REQUEST_INV);
+
 	/* Run generate and reseed health tests before first use of these
-	 * functions and when indicated by the test counter (11.3.3). */
-	pthread_rwlock_wrlock(&sh->mech->lock);
-	if(!(sh->mech->test_ctr %= sh->mech->test_intervall)){
-		status = drbg_health_test(drbg_reseed, sec, pr, sh->mech);
-		if(!status)
-			status = drbg_health_test(drbg_generate, sec, pr,
+	 * functions and when indicated by the test counter (11.3.3). The
+	 * counter is advanced atomically under the read lock, so that
+	 * generate requests on different instances only take the write lock
+	 * when a test is due. The request that makes a test due clears
+	 * test_ok, and no request generates under the read lock until the
+	 * test has passed under the write lock. */
+	if(!sh->mech->test_ok
+	   || !(__sync_add_and_fetch(&sh->mech->test_ctr, 1)
+		% sh->mech->test_intervall)){
+		__sync_lock_test_and_set(&sh->mech->test_ok, 0);
+		pthread_rwlock_unlock(&sh->mech->lock);
+		pthread_rwlock_wrlock(&sh->mech->lock);
+		if(!sh->mech->test_ok){
+			status = drbg_health_test(drbg_reseed, sec, pr,
 						  sh->mech);
-		if(status){
-			pthread_rwlock_unlock(&sh->mech->lock);
-			return ica_drbg_error(status);
+			if(!status)
+				status = drbg_health_test(drbg_generate, sec,
+							  pr, sh->mech);
+			if(status){
+				/* test_ok stays clear, test again next time */
+				pthread_rwlock_unlock(&sh->mech->lock);
+				return ica_drbg_error(status);
+			}
+			sh->mech->test_ctr = 0;
+			sh->mech->test_ok = 1;
 		}
 	}
-	sh->mech->test_ctr++;
-	pthread_rwlock_unlock(&sh->mech->lock);
 
-	/* Generate. */
-	status = pthread_rwlock_rdlock(&sh->mech->lock);
-	if(EAGAIN == status)
-		return ica_drbg_error(DRBG_REQUEST_INV);
+	/* Generate, under the read or the write lock. */
 	status = drbg_generate(sh, sec, pr, add, add_len, false, NULL, 0, prnd,
 			       prnd_len);
 	pthread_rwlock_unlock(&sh->mech->lock);
@@ -3526,7 +5241,8 @@ int ica_drbg_health_test(void *func,
 		if(!status)
 			status = drbg_health_test(drbg_generate, sec, pr,
 						  mech);
-		mech->test_ctr = 1; /* reset test counter */
+		mech->test_ctr = 0; /* reset test counter */
+		mech->test_ok = !status;
 	}
 	else
 		status = DRBG_REQUEST_INV;
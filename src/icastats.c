@@ -45,11 +45,13 @@ void print_help(char *cmd)
 	       " -U, --user <userid> show the statistics from one user. (root user only)\n"
 	       " -S, --summary       show the accumulated statistics from alle users. (root user only)\n"
 	       " -A, --all	     show the statistic tables from all users. (root user only)\n"
+	       " -x, --extended      also show bytes processed and latency percentiles.\n"
+	       " -j, --json          print the statistics in JSON format.\n"
 	       " -v, --version       output version information\n"
 	       " -h, --help          display help information\n");
 }
 
-#define getopt_string "rRdDU:SAvh"
+#define getopt_string "rRdDU:SAxjvh"
 static struct option getopt_long_options[] = {
 	{"reset", 0, 0, 'r'},
 	{"reset-all", 0, 0, 'R'},
@@ -58,6 +60,8 @@ static struct option getopt_long_options[] = {
 	{"user", required_argument, 0, 'U'},
 	{"summary", 0, 0, 'S'},
 	{"all", 0, 0, 'A'},
+	{"extended", 0, 0, 'x'},
+	{"json", 0, 0, 'j'},
 	{"version", 0, 0, 'v'},
 	{"help", 0, 0, 'h'},
 	{0, 0, 0, 0}
@@ -79,28 +83,143 @@ void print_stats(stats_entry_t *stats)
 	unsigned int i;
 	for (i = 0; i < ICA_NUM_STATS; ++i){
 		if(i<=ICA_STATS_RSA_CRT){
-			printf(" %14s |      %*d          |       %*d\n",
+			printf(" %14s |      %*llu          |       %*llu\n",
 			       STATS_DESC[i],
 			       CELL_SIZE,
-			       stats[i].enc.hw,
+			       (unsigned long long)stats[i].enc.hw,
 			       CELL_SIZE,
-			       stats[i].enc.sw);
+			       (unsigned long long)stats[i].enc.sw);
 		} else{
-			printf(" %14s |%*d     %*d |%*d    %*d\n",
+			printf(" %14s |%*llu     %*llu |%*llu    %*llu\n",
 			       STATS_DESC[i],
 			       CELL_SIZE,
-			       stats[i].enc.hw,
+			       (unsigned long long)stats[i].enc.hw,
 			       CELL_SIZE,
-			       stats[i].dec.hw,
+			       (unsigned long long)stats[i].dec.hw,
 			       CELL_SIZE,
-			       stats[i].enc.sw,
+			       (unsigned long long)stats[i].enc.sw,
 			       CELL_SIZE,
-			       stats[i].dec.sw);
+			       (unsigned long long)stats[i].dec.sw);
 
 	       }
 	}
 }
 
+/* format the upper bound of latency bucket @bucket */
+static void format_bucket(char *buf, size_t len, unsigned int bucket)
+{
+	unsigned long long nsec = 2ull << bucket;
+
+	if (nsec < 1000ull)
+		snprintf(buf, len, "%lluns", nsec);
+	else if (nsec < 1000000ull)
+		snprintf(buf, len, "%lluus", nsec / 1000ull);
+	else if (nsec < 1000000000ull)
+		snprintf(buf, len, "%llums", nsec / 1000000ull);
+	else
+		snprintf(buf, len, "%llus", nsec / 1000000000ull);
+}
+
+/* print median, 99th percentile and maximum of a latency histogram */
+static void print_latency(const uint64_t *hist)
+{
+	char p50[16], p99[16], max[16];
+	uint64_t total = 0, cum = 0;
+	unsigned int i;
+
+	for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+		total += hist[i];
+
+	if (total == 0) {
+		printf(" %7s %7s %7s", "-", "-", "-");
+		return;
+	}
+
+	p50[0] = p99[0] = '\0';
+	for (i = 0; i < STATS_LATENCY_BUCKETS; i++) {
+		cum += hist[i];
+		if (!p50[0] && cum * 2 >= total)
+			format_bucket(p50, sizeof(p50), i);
+		if (!p99[0] && cum * 100 >= total * 99)
+			format_bucket(p99, sizeof(p99), i);
+		if (hist[i])
+			format_bucket(max, sizeof(max), i);
+	}
+	printf(" %7s %7s %7s", p50, p99, max);
+}
+
+void print_stats_extended(stats_entry_t *stats)
+{
+	unsigned int i;
+
+	printf("\n");
+	printf(" function       |        bytes processed       |  hardware latency (<=)  |  software latency (<=)\n");
+	printf("----------------+------------------------------+-------------------------+------------------------\n");
+	printf("                |      hardware      software  |     p50     p99     max |     p50     p99     max\n");
+	printf("----------------+------------------------------+-------------------------+------------------------\n");
+	for (i = 0; i < ICA_NUM_STATS; ++i) {
+		printf(" %14s | %13llu %13llu |", STATS_DESC[i],
+		       (unsigned long long)stats[i].bytes.hw,
+		       (unsigned long long)stats[i].bytes.sw);
+		print_latency(stats[i].latency[ALGO_HW]);
+		printf(" |");
+		print_latency(stats[i].latency[ALGO_SW]);
+		printf("\n");
+	}
+}
+
+static void print_json_engine(const char *name, uint64_t enc, uint64_t dec,
+			      uint64_t bytes, const uint64_t *hist, int last)
+{
+	unsigned int i;
+
+	printf("      \"%s\": { \"enc\": %llu, \"dec\": %llu, "
+	       "\"bytes\": %llu, \"latency\": [", name,
+	       (unsigned long long)enc, (unsigned long long)dec,
+	       (unsigned long long)bytes);
+	for (i = 0; i < STATS_LATENCY_BUCKETS; i++)
+		printf("%s%llu", i ? ", " : "", (unsigned long long)hist[i]);
+	printf("] }%s\n", last ? "" : ",");
+}
+
+/* print one statistics object, @usr may be NULL for the summary */
+void print_stats_json(stats_entry_t *stats, const char *usr)
+{
+	unsigned int i;
+
+	printf("{\n");
+	printf("  \"version\": %d,\n", STATS_VERSION);
+	if (usr)
+		printf("  \"user\": \"%s\",\n", usr);
+	printf("  \"latency_buckets\": %d,\n", STATS_LATENCY_BUCKETS);
+	printf("  \"functions\": [\n");
+	for (i = 0; i < ICA_NUM_STATS; ++i) {
+		printf("    {\n      \"name\": \"%s\",\n", STATS_DESC[i]);
+		print_json_engine("hw", stats[i].enc.hw, stats[i].dec.hw,
+				  stats[i].bytes.hw,
+				  stats[i].latency[ALGO_HW], 0);
+		print_json_engine("sw", stats[i].enc.sw, stats[i].dec.sw,
+				  stats[i].bytes.sw,
+				  stats[i].latency[ALGO_SW], 1);
+		printf("    }%s\n", i + 1 < ICA_NUM_STATS ? "," : "");
+	}
+	printf("  ]\n}");
+}
+
+static void show_stats(stats_entry_t *stats, const char *usr, int json,
+		       int extended)
+{
+	if (json) {
+		print_stats_json(stats, usr);
+		return;
+	}
+	if (usr)
+		printf("user: %s\n", usr);
+	print_stats(stats);
+	if (extended)
+		print_stats_extended(stats);
+}
+
 
 
 
@@ -113,6 +232,9 @@ int main(int argc, char *argv[])
 	int sum = 0;
 	int user = -1;
 	int all = 0;
+	int json = 0;
+	int extended = 0;
+	int first = 1;
 	struct passwd *pswd;
 
 	while ((rc = getopt_long(argc, argv, getopt_string,
@@ -155,6 +277,12 @@ int main(int argc, char *argv[])
 		case 'A':
 			all = 1;
 			break;
+		case 'x':
+			extended = 1;
+			break;
+		case 'j':
+			json = 1;
+			break;
 		case 'v':
 			print_version();
 			exit(0);
@@ -191,16 +319,22 @@ int main(int argc, char *argv[])
 	if(all){
 		char *usr;
 		stats_entry_t *entries;
+		if (json)
+			printf("[\n");
 		while((usr = get_next_usr()) != NULL){
 			if((entries = malloc(sizeof(stats_entry_t)*ICA_NUM_STATS)) == NULL){
 				perror("malloc: ");
 				return EXIT_FAILURE;
 			}
 			get_stats_data(entries);;
-			printf("user: %s\n", usr);
-			print_stats(entries);
+			if (json && !first)
+				printf(",\n");
+			show_stats(entries, usr, json, extended);
+			first = 0;
 			free(entries);
 		}
+		if (json)
+			printf("\n]\n");
 		return EXIT_SUCCESS;
 	}
 
@@ -215,7 +349,9 @@ int main(int argc, char *argv[])
 			perror("get_stats_sum: ");
 			return EXIT_FAILURE;
 		}
-		print_stats(entries);
+		show_stats(entries, NULL, json, extended);
+		if (json)
+			printf("\n");
 		return EXIT_SUCCESS;
 
 
@@ -243,7 +379,9 @@ int main(int argc, char *argv[])
 			return EXIT_FAILURE;
 		}
 		get_stats_data(stats);
-		print_stats(stats);
+		show_stats(stats, NULL, json, extended);
+		if (json)
+			printf("\n");
 
 	}
 	return EXIT_SUCCESS;
@@ -22,26 +22,97 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/file.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <syslog.h>
 #include "icastats.h"
 #include "init.h"
 
 #define NOT_INITIALIZED (-1)
 #define NAME_LENGHT 20
 
-static stats_entry_t *stats = NULL;
+static unsigned char *stats = NULL;
 volatile int stats_shm_handle = NOT_INITIALIZED;
 
+#ifndef ICASTATS
+/* shard of the calling thread, -1 until the first increment */
+static __thread int stats_shard = -1;
+#endif
+
+/* return the counter array of shard @i within the segment at @base */
+static inline stats_entry_t *stats_shard_entries(unsigned char *base,
+						 unsigned int i)
+{
+	return (stats_entry_t *)(base + STATS_HEADER_SIZE +
+				 i * STATS_SHARD_SIZE);
+}
+
+/* check whether the segment at @base uses the current layout */
+static inline int stats_header_valid(unsigned char *base)
+{
+	stats_header_t *hdr = (stats_header_t *)base;
+
+	return hdr->magic == STATS_MAGIC &&
+	       hdr->version == STATS_VERSION &&
+	       hdr->num_stats == ICA_NUM_STATS &&
+	       hdr->shards == STATS_SHARDS &&
+	       hdr->shard_size == STATS_SHARD_SIZE &&
+	       hdr->latency_buckets == STATS_LATENCY_BUCKETS;
+}
+
+/* clear the segment at @base and stamp it with the current layout */
+static void stats_header_init(unsigned char *base)
+{
+	stats_header_t *hdr = (stats_header_t *)base;
+
+	memset(base, 0, STATS_SHM_SIZE);
+	hdr->num_stats = ICA_NUM_STATS;
+	hdr->shards = STATS_SHARDS;
+	hdr->shard_size = STATS_SHARD_SIZE;
+	hdr->latency_buckets = STATS_LATENCY_BUCKETS;
+	hdr->version = STATS_VERSION;
+	hdr->magic = STATS_MAGIC;
+}
 
-static inline void atomic_add(int *x, int i)
+/* fold all shards of the segment at @base into @sum
+ * @sum must be an array of size ICA_NUM_STATS and is added to, not cleared.
+ */
+static void stats_fold(unsigned char *base, stats_entry_t *sum)
 {
-	int old;
-	int new;
-	asm volatile ("	l	%0,%2\n"
-		      "0:	lr	%1,%0\n"
-		      "	ar	%1,%3\n"
-		      "	cs	%0,%1,%2\n"
+	stats_entry_t *shard;
+	unsigned int i, j, k;
+
+	for (i = 0; i < STATS_SHARDS; i++) {
+		shard = stats_shard_entries(base, i);
+		for (j = 0; j < ICA_NUM_STATS; j++) {
+			sum[j].enc.hw += shard[j].enc.hw;
+			sum[j].enc.sw += shard[j].enc.sw;
+			sum[j].dec.hw += shard[j].dec.hw;
+			sum[j].dec.sw += shard[j].dec.sw;
+			sum[j].bytes.hw += shard[j].bytes.hw;
+			sum[j].bytes.sw += shard[j].bytes.sw;
+			for (k = 0; k < STATS_LATENCY_BUCKETS; k++) {
+				sum[j].latency[ALGO_SW][k] +=
+					shard[j].latency[ALGO_SW][k];
+				sum[j].latency[ALGO_HW][k] +=
+					shard[j].latency[ALGO_HW][k];
+			}
+		}
+	}
+}
+
+
+static inline void atomic_add(uint64_t *x, uint64_t i)
+{
+	uint64_t old;
+	uint64_t new;
+	asm volatile ("	lg	%0,%2\n"
+		      "0:	lgr	%1,%0\n"
+		      "	agr	%1,%3\n"
+		      "	csg	%0,%1,%2\n"
 		      "	jl	0b"
 		      :"=&d" (old), "=&d"(new), "=Q"(*x)
 		      :"d"(i), "Q"(*x)
@@ -63,6 +134,7 @@ static inline void atomic_add(int *x, int i)
 int stats_mmap(int user)
 {
 	char shm_id[NAME_LENGHT];
+	struct stat st;
 
 	if (stats == NULL) {
 		sprintf(shm_id, "icastats_%d",
@@ -79,10 +151,14 @@ int stats_mmap(int user)
 				return -1;
 		}
 
-		if (ftruncate(stats_shm_handle, STATS_SHM_SIZE) == -1)
+		/* never shrink a segment, other users may still map it */
+		if (fstat(stats_shm_handle, &st) == -1)
+			return -1;
+		if (st.st_size < (off_t)STATS_SHM_SIZE &&
+		    ftruncate(stats_shm_handle, STATS_SHM_SIZE) == -1)
 			return -1;
 
-		stats = (stats_entry_t *) mmap(NULL, STATS_SHM_SIZE, PROT_READ |
+		stats = (unsigned char *) mmap(NULL, STATS_SHM_SIZE, PROT_READ |
 						 PROT_WRITE, MAP_SHARED,
 						 stats_shm_handle, 0);
 		if (stats == MAP_FAILED){
@@ -90,6 +166,12 @@ int stats_mmap(int user)
 			stats = NULL;
 			return -1;
 		}
+
+		/* new segment or one left behind by an older layout */
+		flock(stats_shm_handle, LOCK_EX);
+		if (!stats_header_valid(stats))
+			stats_header_init(stats);
+		flock(stats_shm_handle, LOCK_UN);
 	}
 	return 0;
 }
@@ -125,21 +207,29 @@ void stats_munmap(int unlink)
  * @direction - valid values are ENCRYPT and DECRYPT
  */
 
-uint32_t stats_query(stats_fields_t field, int hardware, int direction)
+uint64_t stats_query(stats_fields_t field, int hardware, int direction)
 {
+	stats_entry_t *shard;
+	uint64_t sum = 0;
+	unsigned int i;
+
 	if (stats == NULL)
 		return 0;
 
-	if (direction == ENCRYPT)
-		if (hardware == ALGO_HW)
-			return stats[field].enc.hw;
-		else
-			return stats[field].enc.sw;
-	else
-		if (hardware == ALGO_HW)
-			return stats[field].dec.hw;
+	for (i = 0; i < STATS_SHARDS; i++) {
+		shard = stats_shard_entries(stats, i);
+		if (direction == ENCRYPT)
+			if (hardware == ALGO_HW)
+				sum += shard[field].enc.hw;
+			else
+				sum += shard[field].enc.sw;
 		else
-			return stats[field].dec.sw;
+			if (hardware == ALGO_HW)
+				sum += shard[field].dec.hw;
+			else
+				sum += shard[field].dec.sw;
+	}
+	return sum;
 }
 
 /* Returns the statistic data in a stats_entry_t array
@@ -148,13 +238,11 @@ uint32_t stats_query(stats_fields_t field, int hardware, int direction)
 
 void get_stats_data(stats_entry_t *entries)
 {
-	unsigned int i;
-	for(i = 0;i<ICA_NUM_STATS; i++){
-		entries[i].enc.hw = stats_query(i, ALGO_HW, ENCRYPT);
-		entries[i].enc.sw = stats_query(i, ALGO_SW, ENCRYPT);
-		entries[i].dec.hw = stats_query(i, ALGO_HW, DECRYPT);
-		entries[i].dec.sw = stats_query(i, ALGO_SW, DECRYPT);
-	}
+	memset(entries, 0, sizeof(stats_entry_t)*ICA_NUM_STATS);
+	if (stats == NULL)
+		return;
+
+	stats_fold(stats, entries);
 }
 
 
@@ -171,7 +259,6 @@ void get_stats_data(stats_entry_t *entries)
 
 int get_stats_sum(stats_entry_t *sum)
 {
-	unsigned int i;
 	struct dirent *direntp;
 	DIR *shmDir;
 
@@ -182,7 +269,8 @@ int get_stats_sum(stats_entry_t *sum)
 	while((direntp = readdir(shmDir)) != NULL){
 		if(strstr(direntp->d_name, "icastats_") != NULL){
 			int fd;
-			stats_entry_t *tmp;
+			unsigned char *tmp;
+			struct stat st;
 
 			if((getpwuid(atoi(&direntp->d_name[9]))) == NULL){
 				closedir(shmDir);
@@ -193,7 +281,13 @@ int get_stats_sum(stats_entry_t *sum)
 				closedir(shmDir);
 				return 0;
 			}
-			if ((tmp = (stats_entry_t *)mmap(NULL, STATS_SHM_SIZE,
+			/* skip segments of an older layout */
+			if (fstat(fd, &st) == -1 ||
+			    st.st_size < (off_t)STATS_SHM_SIZE) {
+				close(fd);
+				continue;
+			}
+			if ((tmp = (unsigned char *)mmap(NULL, STATS_SHM_SIZE,
 						    PROT_READ, MAP_SHARED,
 						    fd, 0)) == MAP_FAILED){
 				closedir(shmDir);
@@ -201,12 +295,8 @@ int get_stats_sum(stats_entry_t *sum)
 				return 0;
 			}
 
-			for(i = 0; i<ICA_NUM_STATS; ++i){
-				sum[i].enc.hw += tmp[i].enc.hw;
-				sum[i].enc.sw += tmp[i].enc.sw;
-				sum[i].dec.hw += tmp[i].dec.hw;
-				sum[i].dec.sw += tmp[i].dec.sw;
-			}
+			if (stats_header_valid(tmp))
+				stats_fold(tmp, sum);
 			munmap(tmp, STATS_SHM_SIZE);
 			close(fd);
 		}
@@ -259,32 +349,134 @@ char *get_next_usr()
 }
 
 #ifndef ICASTATS
-/* increments a field of the shared memory segment
+/* the library maps the segment when the first operation is counted */
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+
+static void stats_init_once(void)
+{
+	if (stats_mmap(-1) == -1)
+		syslog(LOG_INFO,
+		  "Failed to access shared memory segment for libica statistics.");
+}
+
+/* maps the shared memory segment of the current user, once
+ */
+
+void stats_init(void)
+{
+	pthread_once(&stats_once, stats_init_once);
+}
+
+/* returns a monotonic time stamp in nanoseconds to be passed to stats_add
+ * as @start, or 0 if statistics are disabled.
+ */
+
+uint64_t stats_clock(void)
+{
+	struct timespec ts;
+
+	if (!ica_stats_enabled)
+		return 0;
+
+	if (stats == NULL) {
+		stats_init();
+		if (stats == NULL)
+			return 0;
+	}
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		return 0;
+
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec + 1;
+}
+
+/* accounts a batch of operations in the shared memory segment
  * arguments:
  * @field - the enum of the field see icastats.h
  * @hardware - valid values are ALGO_SW for software statistics
  * and ALGO_HW for hardware statistics
  * @direction - valid values are ENCRYPT and DECRYPT
+ * @ops - number of operations in the batch
+ * @bytes - number of bytes processed by all operations
+ * @start - time stamp from stats_clock taken before the batch,
+ * or 0 if no latency shall be recorded. The batch is recorded as a
+ * single latency sample.
  */
 
-void stats_increment(stats_fields_t field, int hardware, int direction)
+void stats_add_batch(stats_fields_t field, int hardware, int direction,
+		     uint64_t ops, uint64_t bytes, uint64_t start)
 {
+	stats_entry_t *shard;
+	uint64_t nsec;
+	unsigned int bucket;
+
 	if (!ica_stats_enabled)
 		return;
 
-	if (stats == NULL)
-		return;
+	if (stats == NULL) {
+		stats_init();
+		if (stats == NULL)
+			return;
+	}
+
+	/* The shard is picked by thread id, so threads of all processes
+	 * sharing the segment spread over the shards. Two threads may still
+	 * land on the same shard, hence the increment stays atomic, but the
+	 * compare-and-swap is uncontended in the common case. */
+	if (stats_shard < 0)
+		stats_shard = (unsigned int)syscall(SYS_gettid) % STATS_SHARDS;
+	shard = stats_shard_entries(stats, stats_shard);
 
 	if(direction == ENCRYPT)
 		if (hardware == ALGO_HW)
-			atomic_add((int *)&stats[field].enc.hw, 1);
+			atomic_add(&shard[field].enc.hw, ops);
 		else
-			atomic_add((int *)&stats[field].enc.sw, 1);
+			atomic_add(&shard[field].enc.sw, ops);
 	else
 		if (hardware == ALGO_HW)
-			atomic_add((int *)&stats[field].dec.hw, 1);
+			atomic_add(&shard[field].dec.hw, ops);
 		else
-			atomic_add((int *)&stats[field].dec.sw, 1);
+			atomic_add(&shard[field].dec.sw, ops);
+
+	if (bytes) {
+		if (hardware == ALGO_HW)
+			atomic_add(&shard[field].bytes.hw, bytes);
+		else
+			atomic_add(&shard[field].bytes.sw, bytes);
+	}
+
+	if (start) {
+		nsec = stats_clock();
+		nsec = nsec > start ? nsec - start : 0;
+		bucket = nsec ? 63 - __builtin_clzll(nsec) : 0;
+		if (bucket >= STATS_LATENCY_BUCKETS)
+			bucket = STATS_LATENCY_BUCKETS - 1;
+		atomic_add(&shard[field].latency[hardware == ALGO_HW ?
+				 ALGO_HW : ALGO_SW][bucket], 1);
+	}
+}
+
+/* accounts one operation in the shared memory segment
+ * arguments: see stats_add_batch
+ */
+
+void stats_add(stats_fields_t field, int hardware, int direction,
+	       uint64_t bytes, uint64_t start)
+{
+	stats_add_batch(field, hardware, direction, 1, bytes, start);
+}
+
+/* increments a field of the shared memory segment
+ * arguments:
+ * @field - the enum of the field see icastats.h
+ * @hardware - valid values are ALGO_SW for software statistics
+ * and ALGO_HW for hardware statistics
+ * @direction - valid values are ENCRYPT and DECRYPT
+ */
+
+void stats_increment(stats_fields_t field, int hardware, int direction)
+{
+	stats_add(field, hardware, direction, 0, 0);
 }
 #endif
 
@@ -296,7 +488,8 @@ void stats_reset()
 	if (stats == NULL)
 		return;
 
-	memset(stats, 0, sizeof(stats_entry_t)*ICA_NUM_STATS);
+	memset(stats + STATS_HEADER_SIZE, 0,
+	       STATS_SHM_SIZE - STATS_HEADER_SIZE);
 }
 
 
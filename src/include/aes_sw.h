@@ -0,0 +1,63 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef AES_SW_H
+# define AES_SW_H
+
+/*
+ * Software implementations of the MSA 4 AES modes for machines without
+ * the corresponding CPACF functions.
+ *
+ * fc is the CPACF function code of the mode (including the direction
+ * bit), from which the key length is taken, and all functions have the
+ * semantics of the instruction they replace: the chaining values are
+ * updated in place, the XTS tweak is not. The AES block operations run
+ * through OpenSSL's EVP interface, which picks the fastest constant-time
+ * implementation of the machine, and independent blocks are passed to it
+ * in batches so it can pipeline them. They return 0 or an errno value.
+ */
+
+/* KMCTR: in ^ AES(ctrlist), len must be a multiple of the block size. */
+int aes_ctr_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       const unsigned char *ctrlist, const unsigned char *key,
+	       unsigned char *out);
+
+/* KMO, len must be a multiple of the block size. */
+int aes_ofb_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       unsigned char *iv, const unsigned char *key, unsigned char *out);
+
+/* KMF with lcfb byte segments, len must be a multiple of lcfb. */
+int aes_cfb_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       unsigned char *iv, const unsigned char *key, unsigned char *out,
+	       unsigned int lcfb);
+
+/* PCC and KM-XTS on a complete message of at least one block. */
+int aes_xts_sw(unsigned int fc, unsigned long len, const unsigned char *in,
+	       const unsigned char *tweak, const unsigned char *key1,
+	       const unsigned char *key2, unsigned char *out);
+
+/*
+ * KMAC and PCC-CMAC as used by s390_cmac_hw(): without mac, len must be
+ * a multiple of the block size and iv is updated. With mac, the message
+ * is finished and mac_length bytes of the MAC are stored. iv may be NULL
+ * for a message that has no intermediate part, but not without mac.
+ */
+int aes_cmac_sw(unsigned int fc, const unsigned char *message,
+		unsigned long len, const unsigned char *key,
+		unsigned int mac_length, unsigned char *mac,
+		unsigned char *iv);
+
+/*
+ * KIMD-GHASH, len must be a multiple of the block size. Constant-time
+ * and without tables: the carry-less products are computed with integer
+ * multiplications on bits spread four apart.
+ */
+void ghash_sw(const unsigned char *in, unsigned long len,
+	      const unsigned char *subkey, unsigned char *iv);
+
+#endif
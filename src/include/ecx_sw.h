@@ -0,0 +1,66 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef ECX_SW_H
+# define ECX_SW_H
+
+#include <stddef.h>
+#include <openssl/opensslv.h>
+
+/* Ed448 hashes with SHAKE256, which OpenSSL provides as of 1.1.1. */
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+# define ED448_SW_FLAGS	ICA_FLAG_SW
+#else
+# define ED448_SW_FLAGS	0
+#endif
+
+/*
+ * Software implementation of X25519, X448 (RFC 7748), Ed25519 and Ed448
+ * (RFC 8032) for machines without MSA 9. All keys, points and signatures
+ * use the little-endian encodings of the RFCs, i.e. the byte order of the
+ * ica_x25519_* / ica_ed25519_* api, not the big-endian CPACF parameter
+ * block layout.
+ *
+ * All functions return 0 on success, EINVAL if a point does not decode or
+ * a signature does not verify, ENODEV if the required hash function is not
+ * available and ENOMEM/EIO on internal errors.
+ */
+int x25519_sw(unsigned char res_u[32], const unsigned char scalar[32],
+	      const unsigned char u[32]);
+int x448_sw(unsigned char res_u[56], const unsigned char scalar[56],
+	    const unsigned char u[56]);
+
+int ed25519_derive_pub_sw(unsigned char pub[32],
+			  const unsigned char priv[32]);
+int ed25519_sign_sw(unsigned char sig[64], const unsigned char priv[32],
+		    const unsigned char *msg, size_t msglen);
+int ed25519_verify_sw(const unsigned char sig[64],
+		      const unsigned char pub[32],
+		      const unsigned char *msg, size_t msglen);
+
+/*
+ * Verify num signatures at once. status[i] is set to 0 if sig[i] is valid
+ * and to -1 otherwise. Returns 0 if all signatures are valid, EINVAL if at
+ * least one is invalid.
+ */
+int ed25519_verify_batch_sw(unsigned int num,
+			    const unsigned char *const msg[],
+			    const size_t msglen[],
+			    const unsigned char *const sig[],
+			    const unsigned char *const pub[],
+			    int status[]);
+
+int ed448_derive_pub_sw(unsigned char pub[57],
+			const unsigned char priv[57]);
+int ed448_sign_sw(unsigned char sig[114], const unsigned char priv[57],
+		  const unsigned char *msg, size_t msglen);
+int ed448_verify_sw(const unsigned char sig[114],
+		    const unsigned char pub[57],
+		    const unsigned char *msg, size_t msglen);
+
+#endif
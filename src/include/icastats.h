@@ -17,16 +17,43 @@
 #include <stdint.h>
 
 
+/*
+ * Layout version of the shared memory segment. Bump it whenever
+ * stats_header_t, stats_entry_t, the shard geometry or the number of
+ * counters changes. Segments with a different version are reinitialized
+ * by libica and skipped by the icastats summary.
+ */
+#define STATS_MAGIC	0x49434153	/* "ICAS" */
+#define STATS_VERSION	2
+
+/*
+ * Latency histogram: bucket i counts operations which took
+ * [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts faster ones and the
+ * last bucket also counts slower ones.
+ */
+#define STATS_LATENCY_BUCKETS	32
+
 typedef struct crypt_opts{
-	uint32_t hw;
-	uint32_t sw;
+	uint64_t hw;
+	uint64_t sw;
 } crypt_opts_t;
 
 typedef struct statis_entry {
 	crypt_opts_t  enc;
 	crypt_opts_t  dec;
+	crypt_opts_t  bytes;	/* bytes processed (enc and dec) */
+	uint64_t      latency[2][STATS_LATENCY_BUCKETS]; /* [ALGO_SW/HW] */
 } stats_entry_t;
 
+typedef struct stats_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t num_stats;
+	uint32_t shards;
+	uint32_t shard_size;
+	uint32_t latency_buckets;
+} stats_header_t;
+
 
 typedef enum stats_fields {
 	/* crypt counter */
@@ -146,7 +173,20 @@ typedef enum stats_fields {
 
 
 
-#define STATS_SHM_SIZE (sizeof(stats_entry_t) * ICA_NUM_STATS)
+/*
+ * The shared memory segment starts with a stats_header_t, padded to one
+ * cache line, followed by STATS_SHARDS copies of the counter array. Each
+ * thread increments only the shard selected by its thread id, so
+ * concurrent threads do not bounce the same cache lines between cores.
+ * Readers fold all shards together. A shard is padded to a multiple of
+ * the s390 cache line size (256 bytes).
+ */
+#define STATS_SHARDS		64
+#define STATS_CACHE_LINE	256
+#define STATS_HEADER_SIZE	STATS_CACHE_LINE
+#define STATS_SHARD_SIZE	(((sizeof(stats_entry_t) * ICA_NUM_STATS) + \
+				  STATS_CACHE_LINE - 1) & ~(STATS_CACHE_LINE - 1))
+#define STATS_SHM_SIZE (STATS_HEADER_SIZE + STATS_SHARD_SIZE * STATS_SHARDS)
 #define ENCRYPT 1
 #define DECRYPT 0
 
@@ -159,9 +199,15 @@ typedef enum stats_fields {
 
 int stats_mmap(int user);
 void stats_munmap(int unlink);
-uint32_t stats_query(stats_fields_t field, int hardware, int direction);
+uint64_t stats_query(stats_fields_t field, int hardware, int direction);
 void get_stats_data(stats_entry_t *entries);
+void stats_init(void);
 void stats_increment(stats_fields_t field, int hardware, int direction);
+uint64_t stats_clock(void);
+void stats_add(stats_fields_t field, int hardware, int direction,
+	       uint64_t bytes, uint64_t start);
+void stats_add_batch(stats_fields_t field, int hardware, int direction,
+		     uint64_t ops, uint64_t bytes, uint64_t start);
 int get_stats_sum(stats_entry_t *sum);
 char *get_next_usr();
 void stats_reset();
@@ -21,10 +21,12 @@
 
 int begin_sigill_section(struct sigaction *oldact, sigset_t * oldset);
 void end_sigill_section(struct sigaction *oldact, sigset_t * oldset);
+void init_rng(void);
 
 extern int ica_fallbacks_enabled;
 extern int ica_offload_enabled;
 extern int ica_stats_enabled;
+extern int ica_drbg_thread_enabled;
 
 #endif
 
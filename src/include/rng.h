@@ -9,6 +9,10 @@
 #ifndef RNG_H
 # define RNG_H
 
+#include <stddef.h>
+
+#include "ica_api.h"
+
 /*
  * libica's rng for library-internal stuff. Cannot be queried by applications
  * directly via the api.
@@ -17,4 +21,37 @@ void rng_init(void);
 void rng_gen(unsigned char *buf, size_t buflen);
 void rng_fini(void);
 
+/*
+ * Per-thread drbg instances, used instead of the shared ones if enabled via
+ * ica_set_drbg_thread_mode(). RNG_SH_GLOBAL replaces ica_drbg_global
+ * (ica_random_number_generate), RNG_SH_INTERNAL the instance of rng_gen.
+ * Returns NULL if the mode is off or the instance cannot be created.
+ */
+#define RNG_SH_GLOBAL	0
+#define RNG_SH_INTERNAL	1
+#define RNG_SH_NUM	2
+
+ica_drbg_t *rng_thread_sh(int which);
+
+/*
+ * A shared drbg instance is copied into the child by fork(). Reseeds @sh
+ * if the process forked since @fork_gen was last updated, so that parent
+ * and child do not generate the same output. Returns 0 if @sh may be
+ * used, nonzero if the reseed failed.
+ */
+int rng_fork_reseed(ica_drbg_t *sh, unsigned int *fork_gen);
+
+/*
+ * Per-thread pool of random bytes, refilled from @sh in RNG_POOL_SIZE
+ * blocks. Serves requests of up to RNG_POOL_MAX_REQ bytes with a memcpy
+ * instead of a drbg generate pass each. Served bytes are wiped from the
+ * pool at once, the pool is dropped in a child process after fork().
+ * Returns 0 on success, EINVAL if the request is too large, or an error
+ * of ica_drbg_generate().
+ */
+#define RNG_POOL_SIZE		4096
+#define RNG_POOL_MAX_REQ	256
+
+int rng_pool_gen(ica_drbg_t *sh, unsigned char *buf, size_t buflen);
+
 #endif
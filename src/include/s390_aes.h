@@ -23,6 +23,7 @@
 #include <openssl/fips.h>
 #endif /* OPENSSL_FIPS */
 
+#include "aes_sw.h"
 #include "fips.h"
 #include "ica_api.h"
 #include "icastats.h"
@@ -127,6 +128,7 @@ static inline int s390_aes_gcm(unsigned int fc, const unsigned char *in_data,
 			unsigned int laad, unsigned int lpc)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (*s390_kma_functions[fc].enabled) {
 		rc = s390_aes_gcm_hw(s390_kma_functions[fc].hw_fc, in_data,
@@ -136,20 +138,33 @@ static inline int s390_aes_gcm(unsigned int fc, const unsigned char *in_data,
 	if (rc)
 		return rc;
 
-	stats_increment(ICA_STATS_AES_GCM,
+	stats_add(ICA_STATS_AES_GCM,
 			ALGO_HW,
 			(s390_kma_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			data_length, start);
 
 	return 0;
 }
 
+static inline void s390_aes_ctr_stats(unsigned int fc, int hardware,
+				      unsigned long data_length,
+				      uint64_t start)
+{
+	stats_add(ICA_STATS_AES_CTR, hardware,
+			 (s390_msa4_functions[fc].hw_fc &
+			 S390_CRYPTO_DIRECTION_MASK) ==
+			 0 ?ENCRYPT:DECRYPT,
+			data_length, start);
+}
+
 static inline int __s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
 				     const unsigned char *in_data,
 				     const unsigned char *ctrlist,
 				     unsigned char *key,
-				     unsigned char *out_data)
+				     unsigned char *out_data,
+				     int *hardware)
 {
 	int rc = ENODEV;
 
@@ -157,22 +172,35 @@ static inline int __s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
 		rc = s390_ctr_hw(s390_msa4_functions[fc].hw_fc,
 				 data_length, in_data, key,
 				 out_data, ctrlist);
-	if (rc)
-		return rc;
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		rc = aes_ctr_sw(s390_msa4_functions[fc].hw_fc, data_length,
+				in_data, ctrlist, key, out_data);
+		if (rc)
+			return rc;
+		*hardware = ALGO_SW;
+	}
 
-	stats_increment(ICA_STATS_AES_CTR, ALGO_HW,
-			 (s390_msa4_functions[fc].hw_fc &
-			 S390_CRYPTO_DIRECTION_MASK) ==
-			 0 ?ENCRYPT:DECRYPT);
 	return 0;
 }
 
-
-
-static inline int s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
-			    const unsigned char *in_data,
-			    const unsigned char *ctrlist,
-			    unsigned char *key, unsigned char *out_data)
+/*
+ * Processes data_length bytes with the counters in ctrlist, without
+ * updating the statistics. *hardware is set to ALGO_SW if the software
+ * fallback was used.
+ */
+static inline int s390_aes_ctrlist_chunk(unsigned int fc,
+					 unsigned long data_length,
+					 const unsigned char *in_data,
+					 const unsigned char *ctrlist,
+					 unsigned char *key,
+					 unsigned char *out_data,
+					 int *hardware)
 {
 	int rc = 0;
 	unsigned char rest_in_data[AES_BLOCK_SIZE];
@@ -185,7 +213,7 @@ static inline int s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
 
 	if (tmp_data_length) {
 		rc = __s390_aes_ctrlist(fc, tmp_data_length, in_data,
-					ctrlist, key, out_data);
+					ctrlist, key, out_data, hardware);
 		if (rc)
 			return rc;
 	}
@@ -197,7 +225,7 @@ static inline int s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
 		rc = __s390_aes_ctrlist(fc, AES_BLOCK_SIZE,
 					rest_in_data,
 					ctrlist + tmp_data_length,
-					key, rest_out_data);
+					key, rest_out_data, hardware);
 		if (rc)
 			return rc;
 
@@ -208,17 +236,32 @@ static inline int s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
 	return rc;
 }
 
+static inline int s390_aes_ctrlist(unsigned int fc, unsigned long data_length,
+			    const unsigned char *in_data,
+			    const unsigned char *ctrlist,
+			    unsigned char *key, unsigned char *out_data)
+{
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
+	int rc;
+
+	rc = s390_aes_ctrlist_chunk(fc, data_length, in_data, ctrlist,
+				    key, out_data, &hardware);
+	if (rc)
+		return rc;
+
+	s390_aes_ctr_stats(fc, hardware, data_length, start);
+	return 0;
+}
+
 static inline int s390_aes_ctr(unsigned int fc, const unsigned char *in_data,
 			unsigned char *out_data, unsigned long data_length,
 			unsigned char *key, unsigned char *ctr,
 			unsigned int ctr_width)
 {
-	const unsigned char *src;
-	unsigned char *tmp_ctrlist = NULL;
-	unsigned long chunk_length;
-	unsigned long rest_length;
-	unsigned long tmp_length;
-
+	unsigned long tmp_length, total_length = data_length;
+	uint64_t start;
+	int hardware = ALGO_HW;
 	int rc = 0;
 
 	if (data_length == 0)
@@ -229,56 +272,33 @@ static inline int s390_aes_ctr(unsigned int fc, const unsigned char *in_data,
 		rc = s390_aes_ctrlist(fc, data_length, in_data, ctr,
 				      key, out_data);
 		if (rc)
-			goto free_out;
+			return rc;
 
-		__inc_aes_ctr((struct uint128 *)ctr,  ctr_width);
+		__inc_aes_ctr((struct uint128 *)ctr, ctr_width);
 		return rc;
 	}
 
-	/* find largest possible message chunk */
-	chunk_length = NEXT_BS(data_length, AES_BLOCK_SIZE);
-	tmp_ctrlist = malloc(chunk_length);
-
-	/* page size chunk fall back */
-	if ((!tmp_ctrlist) && (data_length > LARGE_MSG_CHUNK)) {
-		chunk_length = LARGE_MSG_CHUNK;
-		tmp_ctrlist = malloc(chunk_length);
-	}
-
-	/* single block chunk fall back */
-	if (!tmp_ctrlist)
-		chunk_length = AES_BLOCK_SIZE;
-
-	for (src = in_data, rest_length = data_length;
-	     src < (in_data + data_length);
-	     src += chunk_length, out_data += chunk_length,
-	     rest_length -= chunk_length) {
-		tmp_length = (rest_length < chunk_length) ?
-			      rest_length : chunk_length;
-		if (tmp_ctrlist) {
-			__fill_aes_ctrlist(tmp_ctrlist,
-			    NEXT_BS(tmp_length, AES_BLOCK_SIZE),
-			    (struct uint128 *)ctr, ctr_width);
-
-			rc = s390_aes_ctrlist(fc, tmp_length, src,
-					      tmp_ctrlist, key, out_data);
-			if (rc)
-				goto free_out;
-		} else {
-			/* single block fall back */
-			rc = s390_aes_ctrlist(fc, tmp_length, src,
-					      ctr, key, out_data);
-			if (rc)
-				goto free_out;
-
-			__inc_aes_ctr((struct uint128 *)ctr, ctr_width);
-		}
-	}
+	/* process the message in counter ring sized chunks */
+	start = stats_clock();
+	while (data_length) {
+		tmp_length = (data_length < CTR_RING_SIZE) ?
+			      data_length : CTR_RING_SIZE;
+
+		__fill_aes_ctrlist(ctr_ring, NEXT_BS(tmp_length, AES_BLOCK_SIZE),
+		    (struct uint128 *)ctr, ctr_width);
+
+		rc = s390_aes_ctrlist_chunk(fc, tmp_length, in_data, ctr_ring,
+					    key, out_data, &hardware);
+		if (rc)
+			return rc;
 
-free_out:
-	if (tmp_ctrlist)
-		free(tmp_ctrlist);
+		in_data += tmp_length;
+		out_data += tmp_length;
+		data_length -= tmp_length;
+	}
 
+	/* one operation per call, not per chunk */
+	s390_aes_ctr_stats(fc, hardware, total_length, start);
 	return rc;
 }
 
@@ -396,6 +416,7 @@ static inline int s390_aes_ecb(unsigned int fc, unsigned long data_length,
 			unsigned char *out_data)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	int hardware = ALGO_HW;
 
 	if (*s390_kmc_functions[fc].enabled)
@@ -410,11 +431,12 @@ static inline int s390_aes_ecb(unsigned int fc, unsigned long data_length,
 				     out_data);
 		hardware = ALGO_SW;
 	}
-	stats_increment(ICA_STATS_AES_ECB,
+	stats_add(ICA_STATS_AES_ECB,
 			hardware,
 			(s390_kmc_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			data_length, start);
 	return rc;
 }
 
@@ -423,6 +445,7 @@ static inline int s390_aes_cbc(unsigned int fc, unsigned long data_length,
 			unsigned char *key, unsigned char *out_data)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	int hardware = ALGO_HW;
 
 	if (*s390_kmc_functions[fc].enabled)
@@ -437,13 +460,253 @@ static inline int s390_aes_cbc(unsigned int fc, unsigned long data_length,
 				     out_data);
 		hardware = ALGO_SW;
 	}
-	stats_increment(ICA_STATS_AES_CBC,
+	stats_add(ICA_STATS_AES_CBC,
+			hardware, (s390_kmc_functions[fc].hw_fc &
+			S390_CRYPTO_DIRECTION_MASK) == 0 ?
+			ENCRYPT:DECRYPT,
+			data_length, start);
+	return rc;
+}
+
+/*
+ * An AES key prepared once for many operations: the key as it is placed
+ * in the CPACF parameter blocks, the OpenSSL key schedules for the
+ * software fallbacks and the GCM hash subkey H. The key is not modified
+ * after s390_aes_key_init(), so it may be used by several threads at once.
+ */
+struct ica_aes_key {
+	unsigned int key_length;
+	ica_aes_key_len_256_t key;
+	int sw;			/* enc_key and dec_key are valid */
+	AES_KEY enc_key;
+	AES_KEY dec_key;
+	ica_aes_vector_t subkey_h;
+};
+
+static inline int s390_aes_ecb_key_sw(const struct ica_aes_key *key,
+				      unsigned int function_code,
+				      unsigned long input_length,
+				      const unsigned char *input_data,
+				      unsigned char *output_data)
+{
+	const AES_KEY *aes_key;
+	unsigned long i;
+	unsigned int direction;
+
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (!key->sw)
+		return ENODEV;
+
+	if (function_code & S390_CRYPTO_DIRECTION_MASK) {
+		aes_key = &key->dec_key;
+		direction = AES_DECRYPT;
+	} else {
+		aes_key = &key->enc_key;
+		direction = AES_ENCRYPT;
+	}
+
+	for (i = 0; i < input_length; i += AES_BLOCK_SIZE) {
+		AES_ecb_encrypt(input_data + i, output_data + i,
+				aes_key, direction);
+	}
+
+	return 0;
+}
+
+static inline int s390_aes_cbc_key_sw(const struct ica_aes_key *key,
+				      unsigned int function_code,
+				      unsigned long input_length,
+				      const unsigned char *input_data,
+				      unsigned char *iv,
+				      unsigned char *output_data)
+{
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (!key->sw)
+		return ENODEV;
+
+	if (function_code & S390_CRYPTO_DIRECTION_MASK)
+		AES_cbc_encrypt(input_data, output_data, input_length,
+				&key->dec_key, iv, AES_DECRYPT);
+	else
+		AES_cbc_encrypt(input_data, output_data, input_length,
+				&key->enc_key, iv, AES_ENCRYPT);
+
+	return 0;
+}
+
+/* ECB with a key object, without updating the statistics */
+static inline int __s390_aes_ecb_key(const struct ica_aes_key *key,
+				     unsigned int fc, unsigned long data_length,
+				     const unsigned char *in_data,
+				     unsigned char *out_data, int *hardware)
+{
+	int rc = ENODEV;
+
+	if (*s390_kmc_functions[fc].enabled)
+		rc = s390_aes_ecb_hw(s390_kmc_functions[fc].hw_fc,
+				     data_length, in_data,
+				     (unsigned char *)key->key, out_data);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_aes_ecb_key_sw(key, s390_kmc_functions[fc].hw_fc,
+					 data_length, in_data, out_data);
+		*hardware = ALGO_SW;
+	}
+
+	return rc;
+}
+
+static inline int s390_aes_ecb_key(const struct ica_aes_key *key,
+				   unsigned int fc, unsigned long data_length,
+				   const unsigned char *in_data,
+				   unsigned char *out_data)
+{
+	int rc;
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
+
+	rc = __s390_aes_ecb_key(key, fc, data_length, in_data, out_data,
+				&hardware);
+	/* a failure without fallback is not counted */
+	if (rc && hardware == ALGO_HW)
+		return rc;
+	stats_add(ICA_STATS_AES_ECB,
+			hardware,
+			(s390_kmc_functions[fc].hw_fc &
+			S390_CRYPTO_DIRECTION_MASK) == 0 ?
+			ENCRYPT:DECRYPT,
+			data_length, start);
+	return rc;
+}
+
+static inline int s390_aes_cbc_key(const struct ica_aes_key *key,
+				   unsigned int fc, unsigned long data_length,
+				   const unsigned char *in_data,
+				   unsigned char *iv, unsigned char *out_data)
+{
+	int rc = ENODEV;
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
+
+	if (*s390_kmc_functions[fc].enabled)
+		rc = s390_aes_cbc_hw(s390_kmc_functions[fc].hw_fc,
+				     data_length, in_data, iv,
+				     (unsigned char *)key->key, out_data);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_aes_cbc_key_sw(key, s390_kmc_functions[fc].hw_fc,
+					 data_length, in_data, iv, out_data);
+		hardware = ALGO_SW;
+	}
+	stats_add(ICA_STATS_AES_CBC,
 			hardware, (s390_kmc_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			data_length, start);
 	return rc;
 }
 
+/*
+ * CTR with the key object: the software fallback works with the cached
+ * key schedule instead of expanding the key on every call.
+ */
+static inline void s390_aes_ctrlist_key_sw(const struct ica_aes_key *key,
+					   unsigned long data_length,
+					   const unsigned char *in_data,
+					   const unsigned char *ctrlist,
+					   unsigned char *out_data)
+{
+	unsigned char ks[AES_BLOCK_SIZE];
+	unsigned long i, j, n;
+
+	for (i = 0; i < data_length; i += AES_BLOCK_SIZE) {
+		AES_encrypt(ctrlist + i, ks, &key->enc_key);
+		n = data_length - i < AES_BLOCK_SIZE ?
+		    data_length - i : AES_BLOCK_SIZE;
+		for (j = 0; j < n; j++)
+			out_data[i + j] = in_data[i + j] ^ ks[j];
+	}
+
+	OPENSSL_cleanse(ks, sizeof(ks));
+}
+
+static inline int s390_aes_ctr_key(const struct ica_aes_key *key,
+				   unsigned int fc,
+				   const unsigned char *in_data,
+				   unsigned char *out_data,
+				   unsigned long data_length,
+				   unsigned char *ctr, unsigned int ctr_width)
+{
+	unsigned long tmp_length, total_length = data_length;
+	uint64_t start;
+
+	if (*s390_msa4_functions[fc].enabled || !ica_fallbacks_enabled ||
+	    !key->sw)
+		return s390_aes_ctr(fc, in_data, out_data, data_length,
+				    (unsigned char *)key->key, ctr, ctr_width);
+
+#ifdef ICA_FIPS
+	if (fips & ICA_FIPS_MODE)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	/* the counters advance as in s390_aes_ctr() */
+	start = stats_clock();
+	while (data_length) {
+		tmp_length = (data_length < CTR_RING_SIZE) ?
+			      data_length : CTR_RING_SIZE;
+
+		__fill_aes_ctrlist(ctr_ring, NEXT_BS(tmp_length, AES_BLOCK_SIZE),
+		    (struct uint128 *)ctr, ctr_width);
+
+		s390_aes_ctrlist_key_sw(key, tmp_length, in_data, ctr_ring,
+					out_data);
+
+		in_data += tmp_length;
+		out_data += tmp_length;
+		data_length -= tmp_length;
+	}
+
+	stats_add(ICA_STATS_AES_CTR, ALGO_SW, ENCRYPT, total_length, start);
+	return 0;
+}
+
+static inline int s390_aes_key_init(struct ica_aes_key *key,
+				    const unsigned char *key_data,
+				    unsigned int key_length)
+{
+	static const unsigned char zero[AES_BLOCK_SIZE];
+	int hardware;
+
+	OPENSSL_cleanse(key, sizeof(*key));
+	key->key_length = key_length;
+	memcpy(&key->key, key_data, key_length);
+
+	if (ica_fallbacks_enabled) {
+		AES_set_encrypt_key(key_data, key_length * 8, &key->enc_key);
+		AES_set_decrypt_key(key_data, key_length * 8, &key->dec_key);
+		key->sw = 1;
+	}
+
+	/*
+	 * The GCM hash subkey H = E(K, 0^128). Part of setting up the key,
+	 * not an ECB operation of the caller, so it is not counted.
+	 */
+	return __s390_aes_ecb_key(key, aes_directed_fc(key_length, ICA_ENCRYPT),
+				  AES_BLOCK_SIZE, zero, key->subkey_h,
+				  &hardware);
+}
+
 static inline int s390_aes_cfb_hw(unsigned int function_code,
 				  unsigned long input_length,
 				  const unsigned char *input_data,
@@ -482,18 +745,32 @@ static inline int __s390_aes_cfb(unsigned int fc, unsigned long data_length,
 				 unsigned char *out_data, unsigned int lcfb)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
 
 	if (*s390_msa4_functions[fc].enabled)
 		rc = s390_aes_cfb_hw(s390_msa4_functions[fc].hw_fc,
 				     data_length, in_data, iv, key,
 				     out_data, lcfb);
-	if (rc)
-		return rc;
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		rc = aes_cfb_sw(s390_msa4_functions[fc].hw_fc, data_length,
+				in_data, iv, key, out_data, lcfb);
+		if (rc)
+			return rc;
+		hardware = ALGO_SW;
+	}
 
-	stats_increment(ICA_STATS_AES_CFB, ALGO_HW,
+	stats_add(ICA_STATS_AES_CFB, hardware,
 			(s390_kmc_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			data_length, start);
 
 	return 0;
 }
@@ -575,18 +852,32 @@ static inline int __s390_aes_ofb(unsigned int fc, unsigned long input_length,
 				 unsigned char *output_data)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
 
 	if (*s390_msa4_functions[fc].enabled)
 		rc = s390_aes_ofb_hw(s390_msa4_functions[fc].hw_fc,
 				     input_length, input_data, iv, keys,
 				     output_data);
-	if (rc)
-		return rc;
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		rc = aes_ofb_sw(s390_msa4_functions[fc].hw_fc, input_length,
+				input_data, iv, keys, output_data);
+		if (rc)
+			return rc;
+		hardware = ALGO_SW;
+	}
 
-	stats_increment(ICA_STATS_AES_OFB, ALGO_HW,
+	stats_add(ICA_STATS_AES_OFB, hardware,
 			(s390_kmc_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			input_length, start);
 	return 0;
 }
 
@@ -820,18 +1111,32 @@ static inline int s390_aes_xts(unsigned int fc, unsigned long data_length,
 			unsigned int key_length, unsigned char *out_data)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
+	int hardware = ALGO_HW;
 
 	if (*s390_msa4_functions[fc].enabled)
 		rc = s390_aes_xts_hw(s390_msa4_functions[fc].hw_fc,
 				     data_length, in_data, tweak,
 				     key1, key2, key_length, out_data);
-	if (rc)
-		return rc;
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		rc = aes_xts_sw(s390_msa4_functions[fc].hw_fc, data_length,
+				in_data, tweak, key1, key2, out_data);
+		if (rc)
+			return rc;
+		hardware = ALGO_SW;
+	}
 
-	stats_increment(ICA_STATS_AES_XTS, ALGO_HW,
+	stats_add(ICA_STATS_AES_XTS, hardware,
 			(s390_kmc_functions[fc].hw_fc &
 			S390_CRYPTO_DIRECTION_MASK) == 0 ?
-			ENCRYPT:DECRYPT);
+			ENCRYPT:DECRYPT,
+			data_length, start);
 
 	return 0;
 }
@@ -15,41 +15,18 @@
 #define S390_CCM_H
 
 #include "s390_ctr.h"
+#include "s390_iov.h"
 
 #define S390_CCM_MAX_NONCE_LENGTH 13
 #define S390_CCM_MIN_NONCE_LENGTH  7
 #define S390_CCM_MAX_MAC_LENGTH   16
 #define S390_CCM_MIN_MAC_LENGTH    4
 
-/* assoc_data first meta block with data
- * for small assoc_data_length */
-struct meta_ad_small {
-	uint16_t length;
-	unsigned char data[14];
-} __attribute__((packed));
-
-/* assoc_data first meta block with prefix and data
- * for medium assoc_data_length */
-struct meta_ad_medium {
-	unsigned char prefix[2];
-	uint32_t length;
-	unsigned char data[10];
-} __attribute__((packed));
-
-/* assoc_data first meta block with prefix and data
- * for large assoc_data_length */
-struct meta_ad_large {
-	unsigned char prefix[2];
-	uint64_t length;
-	unsigned char data[6];
-} __attribute__((packed));
-
-/* assoc_data meta block union with size cipher block size */
-typedef union {
-	struct meta_ad_small small;
-	struct meta_ad_medium medium;
-	struct meta_ad_large large;
-} __attribute__((packed)) ad_meta_t;
+/*
+ * Both passes over the payload, CBC-MAC and CTR, are done chunk by chunk,
+ * so each chunk is still in the L1 cache for the second pass.
+ */
+#define S390_CCM_CHUNK_SIZE	CTR_RING_SIZE
 
 static inline unsigned int fc_to_key_length(unsigned int fc)
 {
@@ -118,170 +95,273 @@ static inline void __compute_initial_ctr(const unsigned char *nonce,
 	memcpy(ctr + sizeof(ctr_flags), nonce, nonce_length);
 }
 
-static inline unsigned int __auth_assoc_data(unsigned int function_code,
-					     const unsigned char *assoc_data,
-					     uint64_t assoc_data_length,
-					     const unsigned char *key,
-					     unsigned int key_length,
-					     unsigned char *iv)
+/*
+ * CCM state for processing a message in parts. The CBC-MAC input that does
+ * not yet fill a block is kept in buf. All parts of the payload except the
+ * last one must be multiples of the cipher block size.
+ */
+struct ccm_state {
+	unsigned int function_code;	/* directed */
+	unsigned int key_length;
+	ica_aes_key_len_256_t key;
+	unsigned int ctr_width;
+	unsigned char initial_ctr[AES_BLOCK_SIZE];
+	unsigned char ctr[AES_BLOCK_SIZE];
+	unsigned char mac[AES_BLOCK_SIZE];
+	unsigned char buf[AES_BLOCK_SIZE];
+	unsigned int buflen;
+	unsigned int payload;		/* assoc_data is complete */
+};
+
+static inline int s390_ccm_mac_update(struct ccm_state *state,
+				      const unsigned char *data,
+				      uint64_t data_length)
 {
-	unsigned int rc;
-	ad_meta_t meta;
-	unsigned char *meta_data;
-	unsigned long meta_data_length;
-	unsigned char tmp_block[AES_BLOCK_SIZE];
-	const unsigned char *rest;
-	unsigned long rest_length;
-	unsigned long head_length;
-	unsigned long tail_length;
-
-	/* preparing first block of assoc_data */
-	if (assoc_data_length < ((1ull << 16)-(1ull << 8))) {
-		meta.small.length = assoc_data_length;
-		meta_data = meta.small.data;
-		meta_data_length = sizeof(meta.small.data);
-	} else if (assoc_data_length < (1ull << 32)) {
-		meta.medium.prefix[0] = 0xff;
-		meta.medium.prefix[1] = 0xfe;
-		meta.medium.length = assoc_data_length;
-		meta_data = meta.medium.data;
-		meta_data_length = sizeof(meta.medium.data);
-	} else {
-		meta.large.prefix[0] = 0xff;
-		meta.large.prefix[1] = 0xff;
-		meta.large.length = assoc_data_length;
-		meta_data = meta.large.data;
-		meta_data_length = sizeof(meta.large.data);
+	unsigned int fc = UNDIRECTED_FC(state->function_code);
+	unsigned long n;
+	int rc;
+
+	if (state->buflen) {
+		n = AES_BLOCK_SIZE - state->buflen;
+		if (n > data_length)
+			n = data_length;
+		memcpy(state->buf + state->buflen, data, n);
+		state->buflen += n;
+		data += n;
+		data_length -= n;
+
+		if (state->buflen < AES_BLOCK_SIZE)
+			return 0;
+
+		rc = s390_cmac(fc, state->buf, AES_BLOCK_SIZE,
+			       state->key_length, state->key,
+			       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
+			       state->mac);
+		if (rc)
+			return rc;
+		state->buflen = 0;
 	}
 
-	if (assoc_data_length < meta_data_length) {
-		memset(meta_data, 0x00, meta_data_length);
-		memcpy(meta_data, assoc_data, assoc_data_length);
-		rest_length = 0;
-		rest = NULL;
-	} else {
-		memcpy(meta_data, assoc_data, meta_data_length);
-		rest_length = assoc_data_length - meta_data_length;
-		rest = assoc_data + meta_data_length;
+	n = data_length - (data_length % AES_BLOCK_SIZE);
+	if (n) {
+		rc = s390_cmac(fc, data, n,
+			       state->key_length, state->key,
+			       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
+			       state->mac);
+		if (rc)
+			return rc;
+		data += n;
+		data_length -= n;
 	}
 
-	/* processing first block of assoc_data */
-	rc = s390_cmac(function_code,
-		       (unsigned char *)&meta, AES_BLOCK_SIZE,
-		       key_length, key,
-		       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-		       iv);
-	if (rc)
-		return rc;
+	memcpy(state->buf, data, data_length);
+	state->buflen = data_length;
+	return 0;
+}
 
-	/* processing remaining assoc_data */
-	if (rest_length) {
-		tail_length = rest_length % AES_BLOCK_SIZE;
-		head_length = rest_length - tail_length;
-
-		if (head_length) {
-			rc = s390_cmac(function_code,
-				       rest, head_length,
-				       key_length, key,
-				       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-				       iv);
-			if (rc)
-				return rc;
+/* Pad the MAC input with zeros to the next block boundary. */
+static inline int s390_ccm_mac_pad(struct ccm_state *state)
+{
+	unsigned char zero[AES_BLOCK_SIZE];
+
+	if (!state->buflen)
+		return 0;
+
+	memset(zero, 0x00, sizeof(zero));
+	return s390_ccm_mac_update(state, zero,
+				   AES_BLOCK_SIZE - state->buflen);
+}
 
-			rest += head_length;
+/*
+ * Start a message: B0 and the encoded length of assoc_data are fed into
+ * the MAC, the assoc_data itself follows with s390_ccm_mac_update.
+ */
+static inline int s390_ccm_start(struct ccm_state *state,
+				 unsigned int function_code,
+				 const unsigned char *key,
+				 const unsigned char *nonce,
+				 unsigned int nonce_length,
+				 uint64_t assoc_data_length,
+				 uint64_t payload_length,
+				 unsigned int mac_length)
+{
+	/* B0 followed by the longest encoding of assoc_data_length */
+	unsigned char meta[AES_BLOCK_SIZE + 10];
+	unsigned int meta_length, length_size, i;
+
+	memset(state, 0x00, sizeof(*state));
+	state->function_code = function_code;
+	state->key_length = fc_to_key_length(function_code);
+	memcpy(state->key, key, state->key_length);
+
+	__compute_initial_ctr(nonce, nonce_length, state->initial_ctr);
+	state->ctr_width = (15 - nonce_length) * 8;
+	memcpy(state->ctr, state->initial_ctr, AES_BLOCK_SIZE);
+	__inc_aes_ctr((struct uint128 *)state->ctr, state->ctr_width);
+
+	__compute_meta_b0(nonce, nonce_length, assoc_data_length,
+			  payload_length, mac_length, meta);
+	meta_length = AES_BLOCK_SIZE;
+
+	/* length encoding of assoc_data, see NIST SP 800-38C, A.2.2 */
+	if (assoc_data_length) {
+		if (assoc_data_length < ((1ull << 16)-(1ull << 8))) {
+			length_size = 2;
+		} else if (assoc_data_length < (1ull << 32)) {
+			meta[meta_length++] = 0xff;
+			meta[meta_length++] = 0xfe;
+			length_size = 4;
+		} else {
+			meta[meta_length++] = 0xff;
+			meta[meta_length++] = 0xff;
+			length_size = 8;
 		}
+		for (i = length_size; i > 0; i--) {
+			meta[meta_length + i - 1] = assoc_data_length & 0xff;
+			assoc_data_length >>= 8;
+		}
+		meta_length += length_size;
+	}
+
+	return s390_ccm_mac_update(state, meta, meta_length);
+}
+
+/*
+ * En-/decrypt a part of the payload. The MAC is always computed over the
+ * plaintext, so in_data and out_data may be the same buffer. Both passes
+ * are done per chunk of S390_CCM_CHUNK_SIZE bytes, so the payload is read
+ * from memory only once.
+ */
+static inline int s390_ccm_crypt(struct ccm_state *state,
+				 const unsigned char *in_data,
+				 unsigned char *out_data,
+				 unsigned long data_length)
+{
+	unsigned long n;
+	int rc;
+
+	if (!state->payload) {
+		rc = s390_ccm_mac_pad(state);
+		if (rc)
+			return rc;
+		state->payload = 1;
+	}
 
-		/* assoc_data padding */
-		if (tail_length) {
-			memset(tmp_block, 0x00, AES_BLOCK_SIZE);
-			memcpy(tmp_block, rest, tail_length);
+	while (data_length) {
+		n = data_length < S390_CCM_CHUNK_SIZE ?
+		    data_length : S390_CCM_CHUNK_SIZE;
 
-			rc = s390_cmac(function_code,
-				       tmp_block, AES_BLOCK_SIZE,
-				       key_length, key,
-				       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-				       iv);
+		if (state->function_code % 2) {
+			/* decrypt */
+			rc = s390_aes_ctr(UNDIRECTED_FC(state->function_code),
+					  in_data, out_data, n, state->key,
+					  state->ctr, state->ctr_width);
 			if (rc)
 				return rc;
+			rc = s390_ccm_mac_update(state, out_data, n);
+		} else {
+			/* encrypt */
+			rc = s390_ccm_mac_update(state, in_data, n);
+			if (rc)
+				return rc;
+			rc = s390_aes_ctr(UNDIRECTED_FC(state->function_code),
+					  in_data, out_data, n, state->key,
+					  state->ctr, state->ctr_width);
 		}
+		if (rc)
+			return rc;
+
+		in_data += n;
+		out_data += n;
+		data_length -= n;
 	}
 
 	return 0;
 }
 
-static inline unsigned int s390_ccm_authenticate(unsigned int function_code,
-					  const unsigned char *payload,
-					  uint64_t payload_length,
-					  const unsigned char *assoc_data,
-					  unsigned long assoc_data_length,
-					  const unsigned char *nonce,
-					  unsigned int nonce_length,
-					  unsigned char *tag,
-					  unsigned int tag_length,
-					  const unsigned char *key,
-					  unsigned int key_length)
+/* Finish the MAC and encrypt it into mac. */
+static inline int s390_ccm_finish(struct ccm_state *state,
+				  unsigned char *mac, unsigned int mac_length)
 {
-	unsigned int rc;
-	unsigned char meta_b0[AES_BLOCK_SIZE];
-	unsigned char tmp_block[AES_BLOCK_SIZE];
-	unsigned long head_length;
-	unsigned long tail_length;
-
-	/* compute meta information block B0 */
-	__compute_meta_b0(nonce, nonce_length,
-			  assoc_data_length, payload_length, tag_length,
-			  meta_b0);
-
-	/* kmac of first block (intermediate) */
-	memset(tag, 0x00, AES_BLOCK_SIZE);
-	rc = s390_cmac(function_code,
-		       meta_b0, AES_BLOCK_SIZE,
-		       key_length, key,
-		       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-		       tag);
+	int rc;
+
+	rc = s390_ccm_mac_pad(state);
 	if (rc)
 		return rc;
 
-	/* kmac of assoc_data blocks (intermediate) */
-	if (assoc_data_length) {
-		rc = __auth_assoc_data(function_code,
-				       assoc_data, assoc_data_length,
-				       key, key_length,
-				       tag);
-		if (rc)
-			return rc;
-	}
-
-	/* kmac of payload (intermediate) */
-	tail_length = payload_length % AES_BLOCK_SIZE;
-	head_length = payload_length - tail_length;
+	return s390_aes_ctr(UNDIRECTED_FC(state->function_code),
+			    state->mac, mac, mac_length,
+			    state->key, state->initial_ctr, state->ctr_width);
+}
 
-	if (head_length) {
-		rc = s390_cmac(function_code,
-			       payload, head_length,
-			       key_length, key,
-			       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-			       tag);
+/*
+ * CCM over lists of buffers. Runs of complete blocks are processed in
+ * place; a block that spans two buffers is gathered into, and scattered
+ * from, a block on the stack.
+ */
+static inline int s390_ccm_iov(struct ccm_state *state,
+			       const struct iovec *assoc_data,
+			       unsigned int assoc_data_cnt,
+			       const struct iovec *in, unsigned int in_cnt,
+			       const struct iovec *out, unsigned int out_cnt,
+			       uint64_t payload_length)
+{
+	unsigned char in_block[AES_BLOCK_SIZE], out_block[AES_BLOCK_SIZE];
+	struct iov_iter ad, it_in, it_out;
+	size_t n, m;
+	int rc;
+
+	iov_iter_init(&ad, assoc_data, assoc_data_cnt);
+	while ((n = iov_iter_avail(&ad)) != 0) {
+		rc = s390_ccm_mac_update(state, iov_iter_ptr(&ad), n);
 		if (rc)
 			return rc;
+		iov_iter_advance(&ad, n);
 	}
 
-	if (tail_length) {
-		memset(tmp_block, 0x00, AES_BLOCK_SIZE);
-		memcpy(tmp_block, payload + head_length, tail_length);
-
-		rc = s390_cmac(function_code,
-			       tmp_block, AES_BLOCK_SIZE,
-			       key_length, key,
-			       AES_BLOCK_SIZE, NULL,	/* cmac_intermediate */
-			       tag);
+	iov_iter_init(&it_in, in, in_cnt);
+	iov_iter_init(&it_out, out, out_cnt);
+	while (payload_length) {
+		n = iov_iter_avail(&it_in);
+		m = iov_iter_avail(&it_out);
+		if (m < n)
+			n = m;
+		if (n < payload_length)
+			n -= n % AES_BLOCK_SIZE;
+		else
+			n = payload_length;
+
+		if (n) {
+			rc = s390_ccm_crypt(state, iov_iter_ptr(&it_in),
+					    iov_iter_ptr(&it_out), n);
+			iov_iter_advance(&it_in, n);
+			iov_iter_advance(&it_out, n);
+		} else {
+			n = payload_length < AES_BLOCK_SIZE ?
+			    payload_length : AES_BLOCK_SIZE;
+			iov_iter_copy_from(&it_in, in_block, n);
+			rc = s390_ccm_crypt(state, in_block, out_block, n);
+			iov_iter_copy_to(&it_out, out_block, n);
+		}
 		if (rc)
 			return rc;
+		payload_length -= n;
 	}
 
 	return 0;
 }
 
+/* Context of the streaming ica_aes_ccm_* functions. */
+struct ica_aes_ccm_ctx {
+	struct ccm_state state;
+	uint64_t assoc_data_left;
+	uint64_t payload_left;
+	unsigned int mac_length;
+	unsigned int partial;	/* last payload part was not block aligned */
+	unsigned int done;	/* mac is valid */
+	unsigned char mac[AES_BLOCK_SIZE];
+};
+
 static inline unsigned int s390_ccm(unsigned int function_code,
 		      unsigned char *payload, unsigned long payload_length,
 		      unsigned char *ciphertext,
@@ -290,61 +370,25 @@ static inline unsigned int s390_ccm(unsigned int function_code,
 		      unsigned char *mac, unsigned long mac_length,
 		      unsigned char *key)
 {
-	unsigned char initial_ctr[AES_BLOCK_SIZE];
-	unsigned char cipher_ctr[AES_BLOCK_SIZE];
-	unsigned char tag[AES_BLOCK_SIZE];
-	unsigned int ccm_ctr_width;
+	struct ccm_state state;
 	unsigned int rc;
 
-	/* compute initial counter */
-	__compute_initial_ctr(nonce, nonce_length, initial_ctr);
-	ccm_ctr_width = (15 - nonce_length) * 8;
-
-	if (payload_length) {
-		/* compute counter for en-/decryption */
-		memcpy(cipher_ctr, initial_ctr, AES_BLOCK_SIZE);
-		__inc_aes_ctr((struct uint128 *)cipher_ctr, ccm_ctr_width);
-
-		/* en-/decrypt */
-		if (function_code % 2) {
-			/* decrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
-					  ciphertext, payload, payload_length,
-					  key, cipher_ctr, ccm_ctr_width);
-			if (rc)
-				return rc;
-			/* mac */
-			rc = s390_ccm_authenticate(UNDIRECTED_FC(function_code),
-						   payload, payload_length,
-						   assoc_data, assoc_data_length,
-						   nonce, nonce_length,
-						   tag, mac_length,
-						   key, fc_to_key_length(function_code));
-			if (rc)
-				return rc;
-		} else {
-			/* mac */
-			rc = s390_ccm_authenticate(UNDIRECTED_FC(function_code),
-						   payload, payload_length,
-						   assoc_data, assoc_data_length,
-						   nonce, nonce_length,
-						   tag, mac_length,
-						   key, fc_to_key_length(function_code));
-			if (rc)
-				return rc;
-
-			/*encrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
-					  payload, ciphertext, payload_length,
-					  key, cipher_ctr, ccm_ctr_width);
-			if (rc)
-				return rc;
-		}
+	rc = s390_ccm_start(&state, function_code, key, nonce, nonce_length,
+			    assoc_data_length, payload_length, mac_length);
+	if (rc == 0 && assoc_data_length)
+		rc = s390_ccm_mac_update(&state, assoc_data, assoc_data_length);
+	if (rc == 0) {
+		if (function_code % 2)
+			rc = s390_ccm_crypt(&state, ciphertext, payload,
+					    payload_length);
+		else
+			rc = s390_ccm_crypt(&state, payload, ciphertext,
+					    payload_length);
 	}
+	if (rc == 0)
+		rc = s390_ccm_finish(&state, mac, mac_length);
 
-	/* encrypt tag into mac */
-	return s390_aes_ctr(UNDIRECTED_FC(function_code),
-			    tag, mac, mac_length,
-			    key, initial_ctr, ccm_ctr_width);
+	OPENSSL_cleanse(&state, sizeof(state));
+	return rc;
 }
 #endif
@@ -176,15 +176,30 @@ static inline int s390_cmac(unsigned long fc,
 		     unsigned int  mac_length, unsigned char *mac,
 		     unsigned char *iv)
 {
+	unsigned int hw_fc = s390_msa4_functions[fc].hw_fc;
 	int rc = ENODEV;
 
 	if (*s390_msa4_functions[fc].enabled)
-		rc = s390_cmac_hw(s390_msa4_functions[fc].hw_fc,
+		rc = s390_cmac_hw(hw_fc,
 				  message, message_length,
 				  key_length, key,
 				  mac_length, mac,
 				  iv);
 
+	/* there is no software fallback for DES and TDES */
+	if (rc && ica_fallbacks_enabled &&
+	    fc_block_size(hw_fc & S390_CRYPTO_FUNCTION_MASK) == AES_BLOCK_SIZE) {
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		rc = aes_cmac_sw(hw_fc, message, message_length, key,
+				 mac_length, mac, iv);
+		if (!rc)
+			_stats_increment(hw_fc & S390_CRYPTO_FUNCTION_MASK,
+					 ALGO_SW, ENCRYPT);
+	}
+
 	return rc;
 }
 #endif
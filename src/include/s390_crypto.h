@@ -22,6 +22,8 @@
 #ifndef S390_CRYPTO_H
 #define S390_CRYPTO_H
 
+#include <pthread.h>
+
 #define S390_CRYPTO_TEST_MASK(mask, function) \
 	(((unsigned char *)(mask))[((function) & 0x7F) >> 3] & \
 	(0x80 >> ((function) & 0x07)))
@@ -188,6 +190,28 @@ extern s390_supported_function_t s390_ppno_functions[];
 extern s390_supported_function_t s390_kdsa_functions[];
 
 void s390_crypto_switches_init(void);
+int s390_initialize_functionlist(void);
+int s390_get_functionlist(libica_func_list_element *pmech_list,
+			  unsigned int *pmech_list_len);
+
+/*
+ * Crypto Express adapters are looked up on first use. Read
+ * any_card_online and ecc_via_online_card through these helpers.
+ */
+extern pthread_once_t s390_cards_once;
+void s390_cards_init(void);
+
+static inline unsigned int s390_any_card_online(void)
+{
+	pthread_once(&s390_cards_once, s390_cards_init);
+	return any_card_online;
+}
+
+static inline unsigned int s390_ecc_via_online_card(void)
+{
+	pthread_once(&s390_cards_once, s390_cards_init);
+	return ecc_via_online_card;
+}
 
 /**
  * s390_pcc:
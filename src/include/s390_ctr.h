@@ -24,6 +24,14 @@
 
 #define LARGE_MSG_CHUNK 4096	/* page size */
 
+/*
+ * Per-thread counter block buffer of the CTR modes. Messages are processed
+ * in chunks of at most CTR_RING_SIZE bytes, so the counter blocks stay in
+ * the L1 cache and no memory is allocated, whatever the message size.
+ */
+#define CTR_RING_SIZE	(4 * LARGE_MSG_CHUNK)
+extern __thread unsigned char ctr_ring[CTR_RING_SIZE];
+
 static inline void __inc_des_ctr(uint64_t *iv, int ctr_bits)
 {
 	uint64_t ctr, mask;
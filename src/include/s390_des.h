@@ -472,21 +472,8 @@ static inline int s390_des_ofb(unsigned int fc, unsigned long data_length,
 	return rc;
 }
 
-static inline int __s390_des_ctrlist(unsigned int fc, unsigned long data_length,
-				     const unsigned char *in_data,
-				     const unsigned char *ctrlist,
-				     unsigned char *key,
-				     unsigned char *out_data)
+static inline void s390_des_ctr_stats(unsigned int fc)
 {
-	int rc = ENODEV;
-
-	if (*s390_msa4_functions[fc].enabled)
-		rc = s390_ctr_hw(s390_msa4_functions[fc].hw_fc,
-				 data_length, in_data, key,
-				 out_data, ctrlist);
-	if (rc)
-		return rc;
-
 	switch (s390_msa4_functions[fc].hw_fc & S390_CRYPTO_FUNCTION_MASK) {
 	case S390_CRYPTO_DEA_ENCRYPT:
 		stats_increment(ICA_STATS_DES_CTR, ALGO_HW,
@@ -502,14 +489,33 @@ static inline int __s390_des_ctrlist(unsigned int fc, unsigned long data_length,
 				0 ?ENCRYPT: DECRYPT);
 		break;
 	}
+}
 
-	return 0;
+static inline int __s390_des_ctrlist(unsigned int fc, unsigned long data_length,
+				     const unsigned char *in_data,
+				     const unsigned char *ctrlist,
+				     unsigned char *key,
+				     unsigned char *out_data)
+{
+	int rc = ENODEV;
+
+	if (*s390_msa4_functions[fc].enabled)
+		rc = s390_ctr_hw(s390_msa4_functions[fc].hw_fc,
+				 data_length, in_data, key,
+				 out_data, ctrlist);
+	return rc;
 }
 
-static inline int s390_des_ctrlist(unsigned int fc, unsigned long data_length,
-			    const unsigned char *in_data,
-			    const unsigned char *ctrlist,
-			    unsigned char *key, unsigned char *out_data)
+/*
+ * Processes data_length bytes with the counters in ctrlist, without
+ * updating the statistics.
+ */
+static inline int s390_des_ctrlist_chunk(unsigned int fc,
+					 unsigned long data_length,
+					 const unsigned char *in_data,
+					 const unsigned char *ctrlist,
+					 unsigned char *key,
+					 unsigned char *out_data)
 {
 	int rc = 0;
 	unsigned char rest_in_data[DES_BLOCK_SIZE];
@@ -545,17 +551,28 @@ static inline int s390_des_ctrlist(unsigned int fc, unsigned long data_length,
 	return rc;
 }
 
+static inline int s390_des_ctrlist(unsigned int fc, unsigned long data_length,
+			    const unsigned char *in_data,
+			    const unsigned char *ctrlist,
+			    unsigned char *key, unsigned char *out_data)
+{
+	int rc;
+
+	rc = s390_des_ctrlist_chunk(fc, data_length, in_data, ctrlist,
+				    key, out_data);
+	if (rc)
+		return rc;
+
+	s390_des_ctr_stats(fc);
+	return 0;
+}
+
 static inline int s390_des_ctr(unsigned int fc, const unsigned char *in_data,
 			unsigned char *out_data, unsigned long data_length,
 			unsigned char *key, unsigned char *ctr,
 			unsigned int ctr_width)
 {
-	const unsigned char *src;
-	unsigned char *tmp_ctrlist = NULL;
-	unsigned long chunk_length;
-	unsigned long rest_length;
 	unsigned long tmp_length;
-
 	int rc = 0;
 
 	if (data_length <= DES_BLOCK_SIZE) {
@@ -563,56 +580,32 @@ static inline int s390_des_ctr(unsigned int fc, const unsigned char *in_data,
 		rc = s390_des_ctrlist(fc, data_length, in_data, ctr,
 				      key, out_data);
 		if (rc)
-			goto free_out;
+			return rc;
 
 		__inc_des_ctr((uint64_t *)ctr, ctr_width);
 		return rc;
 	}
 
-	/* find largest possible message chunk */
-	/* get next multiple of blocksize of data_length */
-	chunk_length = NEXT_BS(data_length, DES_BLOCK_SIZE);
-	tmp_ctrlist = malloc(chunk_length);
+	/* process the message in counter ring sized chunks */
+	while (data_length) {
+		tmp_length = (data_length < CTR_RING_SIZE) ?
+			      data_length : CTR_RING_SIZE;
 
-	/* page size chunk fall back */
-	if ((!tmp_ctrlist) && (data_length > LARGE_MSG_CHUNK)) {
-		chunk_length = LARGE_MSG_CHUNK;
-		tmp_ctrlist = malloc(chunk_length);
-	}
+		__fill_des_ctrlist(ctr_ring, NEXT_BS(tmp_length, DES_BLOCK_SIZE),
+		    (uint64_t *)ctr, ctr_width);
 
-	/* single block chunk fall back */
-	if (!tmp_ctrlist)
-		chunk_length = DES_BLOCK_SIZE;
-
-	for (src = in_data, rest_length = data_length;
-	     src < (in_data + data_length);
-	     src += chunk_length, out_data += chunk_length,
-	     rest_length -= chunk_length) {
-		tmp_length = (rest_length < chunk_length) ?
-			      rest_length : chunk_length;
-		if (tmp_ctrlist) {
-			__fill_des_ctrlist(tmp_ctrlist,
-			    NEXT_BS(tmp_length, DES_BLOCK_SIZE),
-			    (uint64_t *)ctr, ctr_width);
-
-			rc = s390_des_ctrlist(fc, tmp_length, src,
-					      tmp_ctrlist, key, out_data);
-			if (rc)
-				goto free_out;
-		} else {
-			rc = s390_des_ctrlist(fc, tmp_length, src,
-					      ctr, key, out_data);
-			if (rc)
-				goto free_out;
-
-			__inc_des_ctr((uint64_t *)ctr, ctr_width);
-		}
-	}
+		rc = s390_des_ctrlist_chunk(fc, tmp_length, in_data, ctr_ring,
+					    key, out_data);
+		if (rc)
+			return rc;
 
-free_out:
-	if (tmp_ctrlist)
-		free(tmp_ctrlist);
+		in_data += tmp_length;
+		out_data += tmp_length;
+		data_length -= tmp_length;
+	}
 
+	/* one operation per call, not per chunk */
+	s390_des_ctr_stats(fc);
 	return rc;
 }
 
@@ -101,6 +101,7 @@ struct ica_drbg_mech{
 	pthread_rwlock_t lock;
 	const uint64_t test_intervall;
 	uint64_t test_ctr;
+	int test_ok;	/* health tests passed and not yet due again */
 	int error_state;
 };
 
@@ -14,6 +14,7 @@
 #define S390_ECDH_H
 
 #include <openssl/bn.h>
+#include <openssl/ec.h>
 #include <openssl/obj_mac.h>
 #include <asm/zcrypt.h>
 #include "ica_api.h"
@@ -28,6 +29,18 @@ struct ec_key_t {
 	unsigned char* D;
 }; /* ICA_EC_KEY */
 
+/* pre-parsed ECDSA key, see ica_ecdsa_ctx_new */
+struct ica_ecdsa_ctx {
+	/* private copy of the key, used for the cpacf and card requests */
+	ICA_EC_KEY key;
+	unsigned char buf[3 * MAX_ECC_PRIV_SIZE];
+	unsigned int privlen;
+	int has_priv;
+	int has_pub;
+	/* software path: validated key with precomputed generator table */
+	EC_KEY *eckey;
+};
+
 
 /* ICA_X25519_CTX */
 struct ica_x25519_ctx {
@@ -336,6 +349,15 @@ unsigned int ecdsa_verify_sw(const ICA_EC_KEY *pubkey,
 		const unsigned char *hash, unsigned int hash_length,
 		const unsigned char *signature);
 
+unsigned int ecdsa_ctx_init_sw(ica_ecdsa_ctx_t *ctx);
+void ecdsa_ctx_free_sw(ica_ecdsa_ctx_t *ctx);
+unsigned int ecdsa_ctx_sign_sw(const ica_ecdsa_ctx_t *ctx,
+		const unsigned char *hash, unsigned int hash_length,
+		unsigned char *signature);
+unsigned int ecdsa_ctx_verify_sw(const ica_ecdsa_ctx_t *ctx,
+		const unsigned char *hash, unsigned int hash_length,
+		const unsigned char *signature);
+
 /**
  * ECKeyGen parmblock.
  */
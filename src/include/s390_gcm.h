@@ -15,11 +15,18 @@
 #define S390_GCM_H
 
 #include "s390_ctr.h"
+#include "s390_iov.h"
 
 #define S390_GCM_MAX_TEXT_LENGTH (0x0000000fffffffe0ul) /* (2^31)-32 */
 #define S390_GCM_MAX_AAD_LENGTH  (0x2000000000000000ul) /* (2^61)    */
 #define S390_GCM_MAX_IV_LENGTH   (0x2000000000000000ul) /* (2^61)    */
 
+/*
+ * Without KMA, CTR and GHASH are done chunk by chunk, so each chunk of
+ * ciphertext is still in the L1 cache when it is hashed.
+ */
+#define S390_GCM_CHUNK_SIZE	CTR_RING_SIZE
+
 /* the recommended iv length for GCM is 96 bit or 12 byte */
 #define GCM_RECOMMENDED_IV_LENGTH 12
 
@@ -99,12 +106,21 @@ static inline int s390_ghash_hw(unsigned int fc,
 static inline int s390_ghash(const unsigned char *in_data, unsigned long data_length,
 		      const unsigned char *key, unsigned char *iv)
 {
-	if (!s390_kimd_functions[GHASH].enabled)
+	if (*s390_kimd_functions[GHASH].enabled)
+		return s390_ghash_hw(s390_kimd_functions[GHASH].hw_fc,
+				     in_data, data_length,
+				     iv, key);
+
+	if (!ica_fallbacks_enabled)
 		return ENODEV;
+#ifdef ICA_FIPS
+	if (fips & ICA_FIPS_MODE)
+		return EACCES;
+#endif /* ICA_FIPS */
 
-	return s390_ghash_hw(s390_kimd_functions[GHASH].hw_fc,
-			     in_data, data_length,
-			     iv, key);
+	ghash_sw(in_data, data_length, key, iv);
+	stats_increment(ICA_STATS_GHASH, ALGO_SW, ENCRYPT);
+	return 0;
 }
 
 static inline unsigned int __compute_j0(const unsigned char *iv,
@@ -158,81 +174,6 @@ static inline unsigned int __compute_j0(const unsigned char *iv,
 	return 0;
 }
 
-static inline unsigned int s390_gcm_authenticate(const unsigned char *ciphertext, unsigned long text_length,
-					  const unsigned char *aad, unsigned long aad_length,
-					  const unsigned char *subkey_h, unsigned char *iv)
-{
-	unsigned int rc;
-	unsigned char aad_pad[AES_BLOCK_SIZE];
-	unsigned long head_length;
-	unsigned long tail_length;
-	struct pad_meta c_pad_meta;
-
-	memset(iv, 0x00, AES_BLOCK_SIZE);
-
-	memset(c_pad_meta.pad, 0x00, sizeof(c_pad_meta.pad));
-	c_pad_meta.length_a = (uint64_t)(aad_length * 8ul);
-	c_pad_meta.length_b = (uint64_t)(text_length * 8ul);
-
-	if (aad_length) {
-		tail_length = aad_length % AES_BLOCK_SIZE;
-		head_length = aad_length - tail_length;
-
-		/* ghash aad head */
-		if (head_length) {
-			rc = s390_ghash(aad, head_length, subkey_h, iv);
-			if (rc)
-				return rc;
-		}
-
-		/* ghash aad tail */
-		if (tail_length) {
-			memset(aad_pad, 0x00, AES_BLOCK_SIZE);
-			memcpy(aad_pad, aad + head_length, tail_length);
-
-			rc = s390_ghash(aad_pad, AES_BLOCK_SIZE, subkey_h, iv);
-			if (rc)
-				return rc;
-		}
-	}
-
-	if (text_length) {
-		tail_length = text_length % AES_BLOCK_SIZE;
-		head_length = text_length - tail_length;
-
-		/* ghash ciphertext head */
-		if (head_length) {
-			rc = s390_ghash(ciphertext, head_length, subkey_h, iv);
-			if (rc)
-				return rc;
-		}
-
-		/* ghash ciphertext tail and meta data */
-		if (tail_length) {
-			memcpy(c_pad_meta.pad, ciphertext + head_length, tail_length);
-
-			rc = s390_ghash((unsigned char *)&c_pad_meta,
-					sizeof(c_pad_meta), subkey_h, iv);
-			if (rc)
-				return rc;
-		} else {
-			rc = s390_ghash((unsigned char *)&c_pad_meta.length_a,
-					AES_BLOCK_SIZE, subkey_h, iv);
-			if (rc)
-				return rc;
-		}
-	} else {
-		/* ghash meta data only */
-		rc = s390_ghash((unsigned char *)&c_pad_meta.length_a,
-				AES_BLOCK_SIZE,
-				subkey_h, iv);
-		if (rc)
-			return rc;
-	}
-
-	return 0;
-}
-
 static inline unsigned int s390_gcm_authenticate_intermediate(
 		const unsigned char *ciphertext, unsigned long text_length,
 		unsigned char *aad, unsigned long aad_length,
@@ -315,31 +256,105 @@ static inline unsigned int s390_gcm_authenticate_last(
 	return 0;
 }
 
-static inline int s390_gcm(unsigned int function_code,
+/* GHASH of data, a partial last block is padded with zeros. */
+static inline int s390_ghash_padded(const unsigned char *data,
+				    unsigned long data_length,
+				    const unsigned char *subkey_h,
+				    unsigned char *iv)
+{
+	unsigned char pad[AES_BLOCK_SIZE];
+	unsigned long tail_length = data_length % AES_BLOCK_SIZE;
+	unsigned long head_length = data_length - tail_length;
+	int rc;
+
+	if (head_length) {
+		rc = s390_ghash(data, head_length, subkey_h, iv);
+		if (rc)
+			return rc;
+	}
+
+	if (tail_length) {
+		memset(pad, 0x00, AES_BLOCK_SIZE);
+		memcpy(pad, data + head_length, tail_length);
+		rc = s390_ghash(pad, AES_BLOCK_SIZE, subkey_h, iv);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
+
+/*
+ * AES-CTR and GHASH of the ciphertext for the MSA 4 code path, stitched:
+ * the text is processed in chunks of S390_GCM_CHUNK_SIZE bytes, and each
+ * chunk is hashed while it is still in the cache. Only the last chunk may
+ * end with a partial block.
+ */
+static inline int s390_gcm_crypt_ghash(unsigned int function_code,
+				       const unsigned char *in_data,
+				       unsigned char *out_data,
+				       unsigned long data_length,
+				       unsigned char *key, unsigned char *ctr,
+				       const unsigned char *subkey_h,
+				       unsigned char *iv)
+{
+	unsigned long n;
+	int rc;
+
+	while (data_length) {
+		n = data_length < S390_GCM_CHUNK_SIZE ?
+		    data_length : S390_GCM_CHUNK_SIZE;
+
+		if (function_code % 2) {
+			/* mac, before in-place decryption overwrites it */
+			rc = s390_ghash_padded(in_data, n, subkey_h, iv);
+			if (rc)
+				return rc;
+			/* decrypt */
+			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
+					  in_data, out_data, n,
+					  key, ctr, GCM_CTR_WIDTH);
+			if (rc)
+				return rc;
+		} else {
+			/* encrypt */
+			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
+					  in_data, out_data, n,
+					  key, ctr, GCM_CTR_WIDTH);
+			if (rc)
+				return rc;
+			/* mac */
+			rc = s390_ghash_padded(out_data, n, subkey_h, iv);
+			if (rc)
+				return rc;
+		}
+
+		in_data += n;
+		out_data += n;
+		data_length -= n;
+	}
+
+	return 0;
+}
+
+/* GCM with a subkey H computed by the caller */
+static inline int __s390_gcm(unsigned int function_code,
 	     unsigned char *plaintext, unsigned long text_length,
 	     unsigned char *ciphertext,
 	     const unsigned char *iv, unsigned long iv_length,
 	     const unsigned char *aad, unsigned long aad_length,
 	     unsigned char *tag, unsigned long tag_length,
-	     unsigned char *key)
+	     unsigned char *key, unsigned char *subkey_h)
 {
-	unsigned char subkey_h[AES_BLOCK_SIZE];
 	unsigned char j0[AES_BLOCK_SIZE];
 	unsigned char tmp_ctr[AES_BLOCK_SIZE];
 	/* temporary tag must be of size cipher block size */
 	unsigned char tmp_tag[AES_BLOCK_SIZE];
 	unsigned int rc;
 
-	if (!msa4_switch)
+	if (!msa4_switch && !ica_fallbacks_enabled)
 		return ENODEV;
 
-	/* calculate subkey H */
-	rc = s390_aes_ecb(UNDIRECTED_FC(function_code),
-			  AES_BLOCK_SIZE, zero_block,
-			  key, subkey_h);
-	if (rc)
-		return rc;
-
 	/* calculate initial counter, based on iv */
 	__compute_j0(iv, iv_length, subkey_h, j0);
 
@@ -354,35 +369,29 @@ static inline int s390_gcm(unsigned int function_code,
 
 		__inc_aes_ctr((struct uint128 *)tmp_ctr, GCM_CTR_WIDTH);
 
-		if (function_code % 2) {
-			/* mac */
-			rc = s390_gcm_authenticate(ciphertext, text_length,
-						   aad, aad_length,
-						   subkey_h, tmp_tag);
-			if (rc)
-				return rc;
+		/* mac aad */
+		memset(tmp_tag, 0x00, AES_BLOCK_SIZE);
+		rc = s390_ghash_padded(aad, aad_length, subkey_h, tmp_tag);
+		if (rc)
+			return rc;
 
-			/* decrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
-					  ciphertext, plaintext, text_length,
-					  key, tmp_ctr, GCM_CTR_WIDTH);
-			if (rc)
-				return rc;
-		} else {
-			/* encrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code),
-					  plaintext, ciphertext, text_length,
-					  key, tmp_ctr, GCM_CTR_WIDTH);
-			if (rc)
-				return rc;
+		/* en-/decrypt and mac the ciphertext */
+		if (function_code % 2)
+			rc = s390_gcm_crypt_ghash(function_code, ciphertext,
+						  plaintext, text_length, key,
+						  tmp_ctr, subkey_h, tmp_tag);
+		else
+			rc = s390_gcm_crypt_ghash(function_code, plaintext,
+						  ciphertext, text_length, key,
+						  tmp_ctr, subkey_h, tmp_tag);
+		if (rc)
+			return rc;
 
-			/* mac */
-			rc = s390_gcm_authenticate(ciphertext, text_length,
-						   aad, aad_length,
-						   subkey_h, tmp_tag);
-			if (rc)
-				return rc;
-		}
+		/* mac lengths */
+		rc = s390_gcm_authenticate_last(aad_length, text_length,
+						subkey_h, tmp_tag);
+		if (rc)
+			return rc;
 
 		/* encrypt tag */
 		return s390_aes_ctr(UNDIRECTED_FC(function_code),
@@ -413,6 +422,32 @@ static inline int s390_gcm(unsigned int function_code,
 	}
 }
 
+static inline int s390_gcm(unsigned int function_code,
+	     unsigned char *plaintext, unsigned long text_length,
+	     unsigned char *ciphertext,
+	     const unsigned char *iv, unsigned long iv_length,
+	     const unsigned char *aad, unsigned long aad_length,
+	     unsigned char *tag, unsigned long tag_length,
+	     unsigned char *key)
+{
+	unsigned char subkey_h[AES_BLOCK_SIZE];
+	unsigned int rc;
+
+	if (!msa4_switch && !ica_fallbacks_enabled)
+		return ENODEV;
+
+	/* calculate subkey H */
+	rc = s390_aes_ecb(UNDIRECTED_FC(function_code),
+			  AES_BLOCK_SIZE, zero_block,
+			  key, subkey_h);
+	if (rc)
+		return rc;
+
+	return __s390_gcm(function_code, plaintext, text_length, ciphertext,
+			  iv, iv_length, aad, aad_length, tag, tag_length,
+			  key, subkey_h);
+}
+
 static inline int s390_gcm_initialize(unsigned int function_code,
 				      const unsigned char *iv,
 				      unsigned long iv_length,
@@ -514,35 +549,26 @@ static inline int s390_gcm_intermediate(unsigned int function_code,
 	unsigned int rc, laad;
 	unsigned char *in, *out;
 
-	if (!msa4_switch)
+	if (!msa4_switch && !ica_fallbacks_enabled)
 		return ENODEV;
 
 	if (!msa8_switch) {
-		if (function_code % 2) {
-			/* mac */
-			rc = s390_gcm_authenticate_intermediate(ciphertext, text_length, aad,
-				aad_length, subkey, tag);
-			if (rc)
-				return rc;
-
-			/* decrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code), ciphertext, plaintext,
-							  text_length, key, ctr, GCM_CTR_WIDTH);
-			if (rc)
-				return rc;
-		} else {
-			/* encrypt */
-			rc = s390_aes_ctr(UNDIRECTED_FC(function_code), plaintext, ciphertext,
-							  text_length, key, ctr, GCM_CTR_WIDTH);
-			if (rc)
-				return rc;
+		/* mac aad */
+		rc = s390_ghash_padded(aad, aad_length, subkey, tag);
+		if (rc)
+			return rc;
 
-			/* mac */
-			rc = s390_gcm_authenticate_intermediate(ciphertext, text_length, aad,
-				aad_length, subkey, tag);
-			if (rc)
-				return rc;
-		}
+		/* en-/decrypt and mac the ciphertext */
+		if (function_code % 2)
+			rc = s390_gcm_crypt_ghash(function_code, ciphertext,
+						  plaintext, text_length, key,
+						  ctr, subkey, tag);
+		else
+			rc = s390_gcm_crypt_ghash(function_code, plaintext,
+						  ciphertext, text_length, key,
+						  ctr, subkey, tag);
+		if (rc)
+			return rc;
 	} else {
 		if ((text_length > 0) || (aad_length % AES_BLOCK_SIZE))
 			laad = 1;
@@ -693,15 +719,66 @@ static inline int s390_aes_gcm_simulate_kma_full(const unsigned char *in_data,
 {
 	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
 
+	/* subkey H is always computed for the MSA 4 code path */
 	if (ctx->direction == ICA_ENCRYPT) {
-		return s390_gcm(function_code, (unsigned char*)in_data, data_length, out_data,
+		return __s390_gcm(function_code, (unsigned char*)in_data, data_length, out_data,
 			      ctx->iv, ctx->iv_length, aad, aad_length,
-			      ctx->tag, AES_BLOCK_SIZE, ctx->key);
+			      ctx->tag, AES_BLOCK_SIZE, ctx->key, ctx->subkey_h);
 	} else {
-		return s390_gcm(function_code, out_data, data_length, (unsigned char*)in_data,
+		return __s390_gcm(function_code, out_data, data_length, (unsigned char*)in_data,
 			      ctx->iv, ctx->iv_length, aad, aad_length,
-			      ctx->tag, AES_BLOCK_SIZE, ctx->key);
+			      ctx->tag, AES_BLOCK_SIZE, ctx->key, ctx->subkey_h);
+	}
+}
+
+/*
+ * Start a new message with the key of the context. Subkey H is only
+ * computed if it is not yet known: KMA derives it itself during the first
+ * operation and keeps it in the parameter block.
+ */
+static inline int s390_aes_gcm_kma_set_iv(const unsigned char *iv,
+		unsigned int iv_length, kma_ctx* ctx)
+{
+	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+	unsigned int *cv = (unsigned int*)&(ctx->j0[GCM_RECOMMENDED_IV_LENGTH]);
+	int rc;
+
+	memset(ctx->tag, 0, sizeof(ctx->tag));
+	ctx->total_aad_length = 0;
+	ctx->total_input_length = 0;
+	memset(ctx->ucb, 0, sizeof(ctx->ucb));
+	ctx->done = 0;
+	ctx->intermediate = 0;
+	ctx->first_time = 0;
+	ctx->iv = (unsigned char*)iv;
+	ctx->iv_length = iv_length;
+
+	/* Calculate subkey_h and j0 depending on iv_length */
+	if (*s390_kma_functions[function_code].enabled && iv_length == GCM_RECOMMENDED_IV_LENGTH) {
+		/* let KMA provide the subkey_h, j0 = iv || 00000001 */
+		memcpy(&(ctx->j0), iv, iv_length);
+		ctx->cv = 1;
+		*cv = 1;
+		return 0;
+	}
+
+	if (!ctx->subkey_provided) {
+		rc = s390_aes_ecb(UNDIRECTED_FC(function_code),
+				AES_BLOCK_SIZE, zero_block,
+				(unsigned char*)ctx->key, (unsigned char*)&(ctx->subkey_h));
+		if (rc)
+			return rc;
+		ctx->subkey_provided = 1;
 	}
+
+	/* Calculate initial counter, based on iv */
+	rc = __compute_j0(iv, iv_length, (const unsigned char*)&(ctx->subkey_h),
+			(unsigned char*)&(ctx->j0));
+	if (rc)
+		return rc;
+	ctx->cv = *cv;
+
+	return 0;
 }
 
 static inline int s390_aes_gcm_kma(const unsigned char *in_data,
@@ -752,4 +829,174 @@ static inline int s390_aes_gcm_kma(const unsigned char *in_data,
 	} else
 		return EIO;
 }
+/* Process a part of a message with KMA or its MSA 4 simulation. */
+static inline int s390_aes_gcm_kma_update(const unsigned char *in_data,
+		unsigned char *out_data, unsigned long data_length,
+		const unsigned char *aad, unsigned long aad_length,
+		unsigned int end_of_aad, unsigned int end_of_data,
+		kma_ctx* ctx)
+{
+	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+
+	if (!(*s390_kma_functions[function_code].enabled)) {
+
+		if (end_of_aad && end_of_data && !ctx->intermediate) {
+			ctx->done = 1;
+			return s390_aes_gcm_simulate_kma_full(in_data, out_data, data_length,
+									aad, aad_length, ctx);
+		} else {
+			ctx->intermediate = 1;
+			return s390_aes_gcm_simulate_kma_intermediate(in_data, out_data, data_length,
+									aad, aad_length, ctx);
+		}
+
+	} else {
+
+		return s390_aes_gcm_kma(in_data, out_data, data_length,
+								aad, aad_length, end_of_aad, end_of_data, ctx);
+	}
+}
+
+/* Make sure ctx->tag holds the tag of the processed message. */
+static inline int s390_aes_gcm_kma_tag(kma_ctx* ctx)
+{
+	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+
+	if (*s390_kma_functions[function_code].enabled || ctx->done)
+		return 0;
+
+	return s390_gcm_last(function_code, (unsigned char*)ctx->j0,
+			ctx->total_aad_length, ctx->total_input_length,
+			(unsigned char*)ctx->tag, AES_BLOCK_SIZE,
+			(unsigned char*)ctx->key, (unsigned char*)ctx->subkey_h);
+}
+
+/*
+ * KMA function code for processing a complete message with the subkey of
+ * ctx in one instruction, or 0 if KMA is not available.
+ */
+static inline unsigned int s390_aes_gcm_kma_message_fc(const kma_ctx* ctx)
+{
+	unsigned int function_code = aes_directed_fc(ctx->key_length, ctx->direction);
+	unsigned int hw_fc;
+
+	if (!(*s390_kma_functions[function_code].enabled))
+		return 0;
+
+	hw_fc = s390_kma_functions[function_code].hw_fc;
+	hw_fc = hw_fc | HS_FLAG;
+	hw_fc = hw_fc | LAAD_FLAG;
+	hw_fc = hw_fc | LPC_FLAG;
+	return hw_fc;
+}
+
+/*
+ * Process a complete message after s390_aes_gcm_kma_set_iv, the tag is
+ * left in ctx->tag. hw_fc is the result of s390_aes_gcm_kma_message_fc.
+ * With KMA, the message is not accounted in the statistics: callers
+ * processing many messages account them at once.
+ */
+static inline int s390_aes_gcm_kma_message(const unsigned char *in_data,
+		unsigned char *out_data, unsigned long data_length,
+		const unsigned char *aad, unsigned long aad_length,
+		unsigned int hw_fc, kma_ctx* ctx)
+{
+	int rc;
+
+	if (!hw_fc) {
+		rc = s390_aes_gcm_kma_update(in_data, out_data, data_length,
+				aad, aad_length, 1, 1, ctx);
+		if (rc)
+			return rc;
+		return s390_aes_gcm_kma_tag(ctx);
+	}
+
+	ctx->total_aad_length = aad_length*8;
+	ctx->total_input_length = data_length*8;
+
+	if (s390_kma(hw_fc, ctx, out_data, in_data, data_length,
+		     aad, aad_length) < 0)
+		return EIO;
+	return 0;
+}
+
+/*
+ * GCM over lists of buffers. Runs of complete blocks are processed in
+ * place; a block that spans two buffers is gathered into, and scattered
+ * from, a block on the stack.
+ */
+static inline int s390_aes_gcm_kma_iov(const struct iovec *aad,
+		unsigned int aad_cnt, uint64_t aad_length,
+		const struct iovec *in, unsigned int in_cnt,
+		const struct iovec *out, unsigned int out_cnt,
+		uint64_t data_length, kma_ctx* ctx)
+{
+	unsigned char in_block[AES_BLOCK_SIZE], out_block[AES_BLOCK_SIZE];
+	struct iov_iter it_aad, it_in, it_out;
+	size_t n, m;
+	int rc, last;
+
+	if (aad_length == 0 && data_length == 0)
+		return s390_aes_gcm_kma_update(NULL, NULL, 0, NULL, 0, 1, 1, ctx);
+
+	iov_iter_init(&it_aad, aad, aad_cnt);
+	while (aad_length) {
+		n = iov_iter_avail(&it_aad);
+		if (n < aad_length)
+			n -= n % AES_BLOCK_SIZE;
+		else
+			n = aad_length;
+		last = (n == aad_length);
+
+		if (n) {
+			rc = s390_aes_gcm_kma_update(NULL, NULL, 0,
+					iov_iter_ptr(&it_aad), n,
+					last, last && !data_length, ctx);
+			iov_iter_advance(&it_aad, n);
+		} else {
+			n = aad_length < AES_BLOCK_SIZE ?
+			    aad_length : AES_BLOCK_SIZE;
+			last = (n == aad_length);
+			iov_iter_copy_from(&it_aad, in_block, n);
+			rc = s390_aes_gcm_kma_update(NULL, NULL, 0, in_block, n,
+					last, last && !data_length, ctx);
+		}
+		if (rc)
+			return rc;
+		aad_length -= n;
+	}
+
+	iov_iter_init(&it_in, in, in_cnt);
+	iov_iter_init(&it_out, out, out_cnt);
+	while (data_length) {
+		n = iov_iter_avail(&it_in);
+		m = iov_iter_avail(&it_out);
+		if (m < n)
+			n = m;
+		if (n < data_length)
+			n -= n % AES_BLOCK_SIZE;
+		else
+			n = data_length;
+
+		if (n) {
+			rc = s390_aes_gcm_kma_update(iov_iter_ptr(&it_in),
+					iov_iter_ptr(&it_out), n, NULL, 0,
+					1, n == data_length, ctx);
+			iov_iter_advance(&it_in, n);
+			iov_iter_advance(&it_out, n);
+		} else {
+			n = data_length < AES_BLOCK_SIZE ?
+			    data_length : AES_BLOCK_SIZE;
+			iov_iter_copy_from(&it_in, in_block, n);
+			rc = s390_aes_gcm_kma_update(in_block, out_block, n,
+					NULL, 0, 1, n == data_length, ctx);
+			iov_iter_copy_to(&it_out, out_block, n);
+		}
+		if (rc)
+			return rc;
+		data_length -= n;
+	}
+
+	return s390_aes_gcm_kma_tag(ctx);
+}
 #endif
@@ -0,0 +1,105 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef S390_IOV_H
+#define S390_IOV_H
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/uio.h>
+
+/* A position in a list of buffers, empty buffers are skipped. */
+struct iov_iter {
+	const struct iovec *iov;
+	unsigned int iovcnt;
+	size_t offset;		/* in iov[0] */
+};
+
+static inline void iov_iter_init(struct iov_iter *it,
+				 const struct iovec *iov, unsigned int iovcnt)
+{
+	it->iov = iov;
+	it->iovcnt = iovcnt;
+	it->offset = 0;
+}
+
+/* Total length of the buffers, or UINT64_MAX if it does not fit. */
+static inline uint64_t iov_total_length(const struct iovec *iov,
+					unsigned int iovcnt)
+{
+	uint64_t total = 0;
+	unsigned int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (iov[i].iov_len > UINT64_MAX - total)
+			return UINT64_MAX;
+		total += iov[i].iov_len;
+	}
+
+	return total;
+}
+
+/* Number of contiguous bytes at the current position. */
+static inline size_t iov_iter_avail(struct iov_iter *it)
+{
+	while (it->iovcnt && it->offset == it->iov->iov_len) {
+		it->iov++;
+		it->iovcnt--;
+		it->offset = 0;
+	}
+
+	return it->iovcnt ? it->iov->iov_len - it->offset : 0;
+}
+
+/* The current position, valid if iov_iter_avail() is not zero. */
+static inline unsigned char *iov_iter_ptr(const struct iov_iter *it)
+{
+	return (unsigned char *)it->iov->iov_base + it->offset;
+}
+
+/* Skip n bytes, n must not exceed iov_iter_avail(). */
+static inline void iov_iter_advance(struct iov_iter *it, size_t n)
+{
+	it->offset += n;
+}
+
+/* Copy n bytes from the buffers to buf and skip them. */
+static inline void iov_iter_copy_from(struct iov_iter *it,
+				      unsigned char *buf, size_t n)
+{
+	size_t avail;
+
+	while (n) {
+		avail = iov_iter_avail(it);
+		if (avail > n)
+			avail = n;
+		memcpy(buf, iov_iter_ptr(it), avail);
+		iov_iter_advance(it, avail);
+		buf += avail;
+		n -= avail;
+	}
+}
+
+/* Copy n bytes from buf to the buffers and skip them. */
+static inline void iov_iter_copy_to(struct iov_iter *it,
+				    const unsigned char *buf, size_t n)
+{
+	size_t avail;
+
+	while (n) {
+		avail = iov_iter_avail(it);
+		if (avail > n)
+			avail = n;
+		memcpy(iov_iter_ptr(it), buf, avail);
+		iov_iter_advance(it, avail);
+		buf += avail;
+		n -= avail;
+	}
+}
+
+#endif /* S390_IOV_H */
@@ -0,0 +1,31 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef S390_PARALLELHASH_H
+#define S390_PARALLELHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "s390_crypto.h"
+
+#define PARALLELHASH_DEFAULT_WORKERS	4
+#define PARALLELHASH_MAX_WORKERS	64
+
+/*
+ * ParallelHash128/256 (NIST SP 800-185) with sha_function SHAKE_128 or
+ * SHAKE_256. The chunks of block_size bytes are hashed by up to workers
+ * threads, the calling thread and threads of the worker pool.
+ */
+int s390_parallelhash(kimd_functions_t sha_function,
+		      const unsigned char *data, uint64_t data_length,
+		      size_t block_size, const unsigned char *custom,
+		      size_t custom_length, unsigned char *output,
+		      size_t output_length, unsigned int workers);
+
+#endif
@@ -40,5 +40,33 @@ unsigned int rsa_key_generate_crt(ica_adapter_handle_t deviceHandle,
 unsigned int rsa_crt_sw(ica_rsa_modexpo_crt_t * pCrt);
 unsigned int rsa_mod_mult_sw(ica_rsa_modmult_t * pMul);
 unsigned int rsa_mod_expo_sw(ica_rsa_modexpo_t *pMex);
+
+/* pre-parsed RSA key, see ica_rsa_key_ctx_new_mod_expo/_crt */
+struct ica_rsa_key_ctx {
+	int is_crt;
+	unsigned int key_length;
+	/* private copy of the key material, used for the adapter requests */
+	ica_rsa_key_mod_expo_t me;
+	ica_rsa_key_crt_t crt;
+	unsigned char *buf;
+	size_t buf_length;
+	/* software path */
+	BIGNUM *n;
+	BIGNUM *e;
+	BIGNUM *p;
+	BIGNUM *q;
+	BIGNUM *dp;
+	BIGNUM *dq;
+	BIGNUM *qinv;
+	BN_MONT_CTX *mont_n;
+	BN_MONT_CTX *mont_p;
+	BN_MONT_CTX *mont_q;
+};
+
+unsigned int rsa_key_ctx_init_sw(ica_rsa_key_ctx_t *key_ctx);
+void rsa_key_ctx_free_sw(ica_rsa_key_ctx_t *key_ctx);
+unsigned int rsa_key_ctx_sw(const ica_rsa_key_ctx_t *key_ctx,
+			    const unsigned char *input_data,
+			    unsigned char *output_data);
 #endif
 
@@ -164,6 +164,80 @@ int s390_shake_256(unsigned char *iv, unsigned char *input_data,
 		unsigned int message_part, uint64_t *running_length_lo,
 		uint64_t *running_length_hi);
 
+/*
+ * Streaming hash context. Data is hashed with SHA_MSG_PART_FIRST and
+ * SHA_MSG_PART_MIDDLE calls of the s390_sha* functions as soon as a
+ * complete block is available; only the incomplete last block is kept in
+ * buf.
+ */
+struct ica_hash_ctx {
+	kimd_functions_t sha_function;
+	unsigned int message_part;	/* for the next complete block */
+	unsigned int buflen;
+	uint64_t running_length_lo;
+	uint64_t running_length_hi;
+	unsigned char iv[200];
+	unsigned char buf[200];
+};
+
+int s390_hash_init(struct ica_hash_ctx *ctx, kimd_functions_t sha_function);
+int s390_hash_update(struct ica_hash_ctx *ctx, const unsigned char *data,
+		     uint64_t data_length);
+int s390_hash_final(struct ica_hash_ctx *ctx, unsigned char *digest);
+
+/*
+ * HMAC context. The states after the key blocks are computed once per key,
+ * every MAC starts from a copy of them.
+ */
+struct ica_hmac_ctx {
+	struct ica_hash_ctx inner_pad;	/* after (key ^ ipad) */
+	struct ica_hash_ctx outer_pad;	/* after (key ^ opad) */
+	struct ica_hash_ctx inner;	/* the current message */
+};
+
+int s390_hmac_init(struct ica_hmac_ctx *ctx, kimd_functions_t sha_function,
+		   const unsigned char *key, size_t key_length);
+int s390_hmac_final(struct ica_hmac_ctx *ctx, unsigned char *mac);
+
+/*
+ * SHAKE context for output of arbitrary length. state is the KIMD
+ * parameter block. While absorbing, buf holds the incomplete last block;
+ * once squeezing has started, buflen is the number of output bytes already
+ * taken from the current state and further input is rejected.
+ */
+struct ica_xof_ctx {
+	kimd_functions_t sha_function;
+	unsigned int rate;
+	unsigned int hw_function_code;
+	int hw;
+	unsigned char pad;		/* domain separation, SHAKE_PAD */
+	int squeezing;
+	unsigned int buflen;
+	uint64_t absorbed;
+	unsigned char state[200];
+	unsigned char buf[200];
+};
+
+int s390_xof_init(struct ica_xof_ctx *ctx, kimd_functions_t sha_function);
+int s390_xof_absorb(struct ica_xof_ctx *ctx, const unsigned char *data,
+		    uint64_t data_length);
+int s390_xof_squeeze(struct ica_xof_ctx *ctx, unsigned char *output,
+		     size_t output_length);
+
+int s390_pbkdf2(kimd_functions_t sha_function, const unsigned char *password,
+		size_t password_length, const unsigned char *salt,
+		size_t salt_length, uint64_t iterations, unsigned char *dk,
+		size_t dk_length);
+int s390_hkdf(kimd_functions_t sha_function, const unsigned char *ikm,
+	      size_t ikm_length, const unsigned char *salt, size_t salt_length,
+	      const unsigned char *info, size_t info_length,
+	      unsigned char *okm, size_t okm_length);
+
+int s390_sha_multi(unsigned int num, const unsigned char *const input_data[],
+		   const size_t input_length[],
+		   unsigned char *const output_data[],
+		   kimd_functions_t sha_function);
+
 int s390_shake_hw(unsigned char *iv, unsigned char *input_data,
 		       uint64_t input_length, unsigned char *output_data, unsigned int output_length,
 		       unsigned int message_part, uint64_t *running_length_lo,
@@ -0,0 +1,71 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef SHA3_SW_H
+# define SHA3_SW_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define KECCAK_STATE_LEN	200
+#define KECCAK_WAYS		4
+
+/* domain separation and first padding bit (FIPS 202) */
+#define SHA3_PAD		0x06
+#define SHAKE_PAD		0x1f
+
+typedef uint64_t keccak_x4_t __attribute__((vector_size(KECCAK_WAYS * 8)));
+
+/*
+ * Software implementation of the Keccak-f[1600] permutation and the
+ * SHA-3/SHAKE sponge for machines without MSA 6.
+ *
+ * The state is the 200 byte KIMD/KLMD parameter block, i.e. the byte
+ * string of FIPS 202 with little-endian lanes, so a hash started with
+ * CPACF can be continued in software and vice versa. rate is the block
+ * length of the function in bytes.
+ */
+void keccak_f1600_sw(uint64_t a[25]);
+
+/* The permutation on KECCAK_WAYS independent states at once. */
+void keccak_f1600_x4_sw(keccak_x4_t a[25]);
+
+/* Absorb len bytes, len must be a multiple of rate. */
+void keccak_absorb_sw(unsigned char state[KECCAK_STATE_LEN],
+		      const unsigned char *in, size_t len, unsigned int rate);
+
+/* Absorb the last len bytes, pad and squeeze outlen bytes. */
+void keccak_final_sw(unsigned char state[KECCAK_STATE_LEN],
+		     const unsigned char *in, size_t len, unsigned int rate,
+		     unsigned char pad, unsigned char *out, size_t outlen);
+
+/* Hash a complete message. */
+void keccak_sw(const unsigned char *in, size_t len, unsigned int rate,
+	       unsigned char pad, unsigned char *out, size_t outlen);
+
+/*
+ * Hash num complete messages with the same function, KECCAK_WAYS of them
+ * at a time on interleaved states. out[i] receives outlen bytes.
+ */
+void keccak_multi_sw(unsigned int num, const unsigned char *const in[],
+		     const size_t len[], unsigned int rate, unsigned char pad,
+		     unsigned char *const out[], size_t outlen);
+
+/*
+ * The PBKDF2 iteration for HMAC-SHA-3 on up to KECCAK_WAYS output blocks
+ * at once: count times u[i] = HMAC(u[i]), t[i] ^= u[i]. inner and outer
+ * are the states after the (key ^ ipad) and (key ^ opad) blocks, u[i] and
+ * t[i] hold hashlen bytes.
+ */
+void keccak_hmac_iterate_x4_sw(const unsigned char inner[KECCAK_STATE_LEN],
+			       const unsigned char outer[KECCAK_STATE_LEN],
+			       unsigned int rate, unsigned int hashlen,
+			       unsigned int num, unsigned char *const u[],
+			       unsigned char *const t[], uint64_t count);
+
+#endif
@@ -0,0 +1,31 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#ifndef WORKER_POOL_H
+# define WORKER_POOL_H
+
+/*
+ * Library-wide pool of worker threads for the batch functions. The threads
+ * are created on first use, up to WORKER_POOL_MAX_THREADS, and wait for
+ * further work until the library is unloaded. A child process created by
+ * fork() starts without pool threads, they are created again when needed.
+ */
+#define WORKER_POOL_MAX_THREADS	63
+
+/*
+ * Runs fn(arg) on the calling thread and on up to workers - 1 pool threads
+ * at the same time, and returns when all of them have returned. fn must
+ * take its work items from arg until none are left: it may be run by fewer
+ * threads than asked for, by the calling thread alone in the worst case.
+ * With workers <= 1, fn is just called.
+ */
+void worker_pool_run(void *(*fn)(void *), void *arg, unsigned int workers);
+
+void worker_pool_fini(void);
+
+#endif
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <setjmp.h>
 #include <signal.h>
+#include <pthread.h>
 
 #include "init.h"
 #include "fips.h"
@@ -28,6 +29,7 @@
 #include "s390_crypto.h"
 #include "ica_api.h"
 #include "rng.h"
+#include "worker_pool.h"
 
 static sigjmp_buf sigill_jmp;
 
@@ -57,6 +59,40 @@ void end_sigill_section(struct sigaction *oldact, sigset_t *oldset)
 	sigprocmask(SIG_SETMASK, oldset, NULL);
 }
 
+static pthread_once_t rng_once = PTHREAD_ONCE_INIT;
+
+static void rng_init_once(void)
+{
+#ifndef ICA_FIPS
+	/* The fips_powerup_tests() include the ica_drbg_health_test(). */
+	ica_drbg_health_test(ica_drbg_generate, 256, true,
+				     ICA_DRBG_SHA512);
+#endif /* ICA_FIPS */
+
+	rng_init();
+
+	s390_prng_init();
+}
+
+/*
+ * The internal random number generators are instantiated when random
+ * bytes are requested for the first time.
+ */
+void init_rng(void)
+{
+	pthread_once(&rng_once, rng_init_once);
+}
+
+int ica_init(void)
+{
+	stats_init();
+	pthread_once(&s390_cards_once, s390_cards_init);
+	s390_initialize_functionlist();
+	init_rng();
+
+	return 0;
+}
+
 void __attribute__ ((constructor)) icainit(void)
 {
 	int value;
@@ -66,12 +102,12 @@ void __attribute__ ((constructor)) icainit(void)
 	if (!strcmp(program_invocation_name, "icastats"))
 		return;
 
-	if(stats_mmap(-1) == -1){
-		syslog(LOG_INFO,
-		  "Failed to access shared memory segment for libica statistics.");
-	}
-
 	/*
+	 * Only the cheap cpu facility and query instructions are executed
+	 * here. The statistics segment, the crypto card scan, the function
+	 * list and the random number generators are set up on first use
+	 * or by ica_init().
+	 *
 	 * Switches have to be done first. Otherwise we will not have
 	 * hw support in initialization.
 	 */
@@ -92,24 +128,22 @@ void __attribute__ ((constructor)) icainit(void)
 	if (ptr && sscanf(ptr, "%i", &value) == 1)
 		ica_set_stats_mode(value);
 
+	/* check for drbg thread mode environment variable */
+	ptr = getenv(ICA_DRBG_THREAD_ENV);
+	if (ptr && sscanf(ptr, "%i", &value) == 1)
+		ica_set_drbg_thread_mode(value);
+
 #ifdef ICA_FIPS
+	/* The power-up tests must pass before the library is used. */
 	fips_init();
 	fips_powerup_tests();
-#else
-	/* The fips_powerup_tests() include the ica_drbg_health_test(). */
-	ica_drbg_health_test(ica_drbg_generate, 256, true,
-				     ICA_DRBG_SHA512);
 #endif /* ICA_FIPS */
-
-	rng_init();
-
-	s390_prng_init();
-
-	s390_initialize_functionlist();
 }
 
 void __attribute__ ((destructor)) icaexit(void)
 {
+	worker_pool_fini();
+
 	rng_fini();
 
 	stats_munmap(SHM_CLOSE);
@@ -6,15 +6,195 @@
  * Copyright IBM Corp. 2018
  */
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <syslog.h>
+#include <unistd.h>
+#include <openssl/crypto.h>
 
 #include "ica_api.h"
+#include "init.h"
 #include "rng.h"
 #include "s390_crypto.h"
 
 static ica_drbg_t *rng_sh = ICA_DRBG_NEW_STATE_HANDLE;
+static unsigned int rng_sh_fork_gen;
+
+/*
+ * Per-thread drbg instances (see ica_set_drbg_thread_mode()). They are
+ * instantiated on first use, each with its own entropy input, and
+ * uninstantiated when the thread exits. A fork bumps rng_fork_gen, which
+ * makes the surviving thread in the child reseed its instances and drop
+ * its random byte pool before the next request. The shared instances are
+ * reseeded on their first use in the child (rng_fork_reseed()), so parent
+ * and child never share an output stream.
+ */
+struct rng_thread {
+	ica_drbg_t *sh[RNG_SH_NUM];
+	unsigned int fork_gen;
+	/* unserved random bytes are the last pool_avail bytes of pool */
+	size_t pool_avail;
+	unsigned char pool[RNG_POOL_SIZE];
+};
+
+static pthread_key_t rng_thread_key;
+static pthread_once_t rng_thread_once = PTHREAD_ONCE_INIT;
+static int rng_thread_key_valid;
+static volatile unsigned int rng_fork_gen;
+
+static void rng_pool_clear(struct rng_thread *t)
+{
+	OPENSSL_cleanse(t->pool, sizeof(t->pool));
+	t->pool_avail = 0;
+}
+
+static void rng_thread_free(void *ptr)
+{
+	struct rng_thread *t = ptr;
+	int i;
+
+	for (i = 0; i < RNG_SH_NUM; i++) {
+		if (t->sh[i] != NULL)
+			ica_drbg_uninstantiate(&t->sh[i]);
+	}
+	rng_pool_clear(t);
+	free(t);
+}
+
+static void rng_thread_atfork_child(void)
+{
+	rng_fork_gen++;
+}
+
+static void rng_thread_key_init(void)
+{
+	if (pthread_key_create(&rng_thread_key, rng_thread_free))
+		return;
+	if (pthread_atfork(NULL, NULL, rng_thread_atfork_child))
+		return;
+	rng_thread_key_valid = 1;
+}
+
+static struct rng_thread *rng_thread_get(void)
+{
+	struct rng_thread *t;
+	int i;
+
+	pthread_once(&rng_thread_once, rng_thread_key_init);
+	if (!rng_thread_key_valid)
+		return NULL;
+
+	t = pthread_getspecific(rng_thread_key);
+	if (t == NULL) {
+		t = calloc(1, sizeof(*t));
+		if (t == NULL)
+			return NULL;
+		if (pthread_setspecific(rng_thread_key, t)) {
+			free(t);
+			return NULL;
+		}
+		t->fork_gen = rng_fork_gen;
+	}
+
+	if (t->fork_gen != rng_fork_gen) {
+		rng_pool_clear(t);
+		for (i = 0; i < RNG_SH_NUM; i++) {
+			if (t->sh[i] != NULL &&
+			    ica_drbg_reseed(t->sh[i], false, NULL, 0))
+				ica_drbg_uninstantiate(&t->sh[i]);
+		}
+		t->fork_gen = rng_fork_gen;
+	}
+
+	return t;
+}
+
+ica_drbg_t *rng_thread_sh(int which)
+{
+	static const char *const pers[RNG_SH_NUM] = {"GLOBAL THREAD INSTANCE",
+						     "INTERNAL THREAD INSTANCE"};
+	static const bool pr[RNG_SH_NUM] = {true, false};
+	struct {
+		char name[32];
+		pid_t pid;
+		pthread_t tid;
+	} pers_buf;
+	struct rng_thread *t;
+
+	if (!ica_drbg_thread_enabled || (!sha512_switch && !sha512_drng_switch))
+		return NULL;
+
+	t = rng_thread_get();
+	if (t == NULL)
+		return NULL;
+
+	if (t->sh[which] == NULL) {
+		/* keep the instances of different threads apart */
+		memset(&pers_buf, 0, sizeof(pers_buf));
+		strncpy(pers_buf.name, pers[which], sizeof(pers_buf.name) - 1);
+		pers_buf.pid = getpid();
+		pers_buf.tid = pthread_self();
+
+		/* t->sh[which] stays NULL in case of failure */
+		ica_drbg_instantiate(&t->sh[which], 256, pr[which],
+				     ICA_DRBG_SHA512,
+				     (unsigned char *)&pers_buf,
+				     sizeof(pers_buf));
+	}
+
+	return t->sh[which];
+}
+
+int rng_fork_reseed(ica_drbg_t *sh, unsigned int *fork_gen)
+{
+	unsigned int gen = rng_fork_gen;
+
+	if (*fork_gen == gen)
+		return 0;
+
+	/* done here: an atfork handler should not do more than bump a counter */
+	if (ica_drbg_reseed(sh, false, NULL, 0))
+		return -1;
+	*fork_gen = gen;
+
+	return 0;
+}
+
+int rng_pool_gen(ica_drbg_t *sh, unsigned char *buf, size_t buflen)
+{
+	struct rng_thread *t;
+	unsigned char *src;
+	int rc;
+
+	if (sh == NULL || buflen > RNG_POOL_MAX_REQ)
+		return EINVAL;
+
+	t = rng_thread_get();
+	if (t == NULL)
+		return ENOMEM;
+
+	if (t->pool_avail < buflen) {
+		/* a remainder too short for the request is discarded */
+		rc = ica_drbg_generate(sh, 256, false, NULL, 0, t->pool,
+				       sizeof(t->pool));
+		if (rc) {
+			rng_pool_clear(t);
+			return rc;
+		}
+		t->pool_avail = sizeof(t->pool);
+	}
+
+	src = t->pool + sizeof(t->pool) - t->pool_avail;
+	memcpy(buf, src, buflen);
+	/* served bytes must not stay around */
+	OPENSSL_cleanse(src, buflen);
+	t->pool_avail -= buflen;
+
+	return 0;
+}
 
 /*
  * rng dev list. The first string (element 0) has the highest priority.
@@ -26,6 +206,9 @@ static const char *const RNGDEV[] = {"/dev/prandom",
 
 void rng_init(void)
 {
+	/* forks must be noticed by the shared instances as well */
+	pthread_once(&rng_thread_once, rng_thread_key_init);
+
 	if (!sha512_switch && !sha512_drng_switch)
 		return;
 
@@ -42,10 +225,18 @@ void rng_gen(unsigned char *buf, size_t buflen)
 {
 	const char *rngdev;
 	FILE *rng_fh;
+	ica_drbg_t *sh;
 	int rc;
 
-	if (rng_sh != NULL) {
-	    rc = ica_drbg_generate(rng_sh, 256, false, NULL, 0, buf, buflen);
+	init_rng();
+
+	sh = rng_thread_sh(RNG_SH_INTERNAL);
+	if (sh == NULL && rng_sh != NULL && !rng_fork_reseed(rng_sh,
+							     &rng_sh_fork_gen))
+		sh = rng_sh;
+
+	if (sh != NULL) {
+	    rc = ica_drbg_generate(sh, 256, false, NULL, 0, buf, buflen);
 	    if (!rc)
 		return;
 	}
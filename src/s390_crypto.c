@@ -25,10 +25,14 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <dirent.h>
+#include <pthread.h>
+#include <sys/auxv.h>
 
 #include "fips.h"
 #include "init.h"
 #include "s390_crypto.h"
+#include "s390_ctr.h"
+#include "ecx_sw.h"
 
 unsigned long long facility_bits[3];
 unsigned int sha1_switch, sha256_switch, sha512_switch, sha3_switch, des_switch,
@@ -37,6 +41,11 @@ unsigned int sha1_switch, sha256_switch, sha512_switch, sha3_switch, des_switch,
 	     msa4_switch, msa5_switch, msa8_switch, trng_switch, msa9_switch,
 		 ecc_via_online_card, any_card_online;
 
+pthread_once_t s390_cards_once = PTHREAD_ONCE_INIT;
+static pthread_once_t functionlist_once = PTHREAD_ONCE_INIT;
+
+__thread unsigned char ctr_ring[CTR_RING_SIZE] __attribute__((aligned(256)));
+
 #define CARD_AVAILABLE		0x01
 #define CEXnA_AVAILABLE		0x02
 #define CEXnC_AVAILABLE		0x04
@@ -161,26 +170,18 @@ static int read_cpuinfo(void)
 	return msa;
 }
 
+#ifndef HWCAP_S390_VX
+#define HWCAP_S390_VX	2048
+#endif
+
 /*
  * Check if "vector enablement control"-bit and
- * "AFP register control"-bit in control register 0 are set.
+ * "AFP register control"-bit in control register 0 are set. The kernel
+ * reports the vector facility in the hwcaps only if both are set.
  */
 static int vx_enabled(void)
 {
-	FILE *fd;
-	char buf[4096];
-
-	if ((fd = fopen("/proc/cpuinfo", "r")) == NULL)
-		return 0;
-
-	buf[0] = '\0';
-
-	while ((fgets(buf, sizeof(buf), fd) != NULL)
-	       && (strstr(buf, "features") != buf));
-
-	fclose(fd);
-
-	return (strstr(buf, " vx ") != NULL) ? 1 : 0;
+	return (getauxval(AT_HWCAP) & HWCAP_S390_VX) ? 1 : 0;
 }
 
 static int read_facility_bits(void)
@@ -421,19 +422,28 @@ unsigned int search_for_cards()
 
 void s390_crypto_switches_init(void)
 {
-	int msa, flags;
+	int msa;
 
 	msa = read_facility_bits();
 	if (!msa)
 		msa = read_cpuinfo();
 
+	set_switches(msa);
+}
+
+/*
+ * Scanning sysfs for adapters is comparatively expensive, so it is done
+ * when the first operation asks for an adapter, see s390_any_card_online().
+ */
+void s390_cards_init(void)
+{
+	int flags;
+
 	flags = search_for_cards();
 	if (flags & CARD_AVAILABLE)
 		any_card_online = 1;
 	if (flags & CEX4C_AVAILABLE)
 		ecc_via_online_card = 1;
-
-	set_switches(msa);
 }
 
 /*
@@ -456,13 +466,13 @@ libica_func_list_element_int icaList[] = {
  {SHA512, KIMD, SHA_512, ICA_FLAG_SW, 0},
  {SHA512_224, KIMD, SHA_512_224, ICA_FLAG_SW, 0},
  {SHA512_256, KIMD, SHA_512_256, ICA_FLAG_SW, 0},
- {SHA3_224, KIMD, SHA_3_224, 0, 0},
- {SHA3_256, KIMD, SHA_3_256, 0, 0},
- {SHA3_384, KIMD, SHA_3_384, 0, 0},
- {SHA3_512, KIMD, SHA_3_512, 0, 0},
- {SHAKE128, KIMD, SHAKE_128, 0, 0},
- {SHAKE256, KIMD, SHAKE_256, 0, 0},
- {G_HASH, KIMD, GHASH, 0, 0},
+ {SHA3_224, KIMD, SHA_3_224, ICA_FLAG_SW, 0},
+ {SHA3_256, KIMD, SHA_3_256, ICA_FLAG_SW, 0},
+ {SHA3_384, KIMD, SHA_3_384, ICA_FLAG_SW, 0},
+ {SHA3_512, KIMD, SHA_3_512, ICA_FLAG_SW, 0},
+ {SHAKE128, KIMD, SHAKE_128, ICA_FLAG_SW, 0},
+ {SHAKE256, KIMD, SHAKE_256, ICA_FLAG_SW, 0},
+ {G_HASH, KIMD, GHASH, ICA_FLAG_SW, 0},
 
  {DES_ECB,      KMC,  DEA_ENCRYPT, ICA_FLAG_SW, 0},
  {DES_CBC,      KMC,  DEA_ENCRYPT, ICA_FLAG_SW, 0},
@@ -480,29 +490,29 @@ libica_func_list_element_int icaList[] = {
 
  {AES_ECB,      KMC,  AES_128_ENCRYPT, ICA_FLAG_SW, 0},
  {AES_CBC,      KMC,  AES_128_ENCRYPT, ICA_FLAG_SW, 0},
- {AES_OFB,      MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_CFB,      MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_CTR,      MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_CMAC,     MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_CCM,      MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_GCM,      MSA4, AES_128_ENCRYPT,           0, 0},
- {AES_GCM_KMA,  MSA8, AES_128_GCM_ENCRYPT,       0, 0},
- {AES_XTS,      MSA4, AES_128_XTS_ENCRYPT,       0, 0},
+ {AES_OFB,      MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_CFB,      MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_CTR,      MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_CMAC,     MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_CCM,      MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_GCM,      MSA4, AES_128_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_GCM_KMA,  MSA8, AES_128_GCM_ENCRYPT, ICA_FLAG_SW, 0},
+ {AES_XTS,      MSA4, AES_128_XTS_ENCRYPT, ICA_FLAG_SW, 0},
  {P_RNG,        ADAPTER, 0, ICA_FLAG_SHW | ICA_FLAG_SW, 0}, // SHW (CPACF) + SW
  {EC_DH,        ADAPTER, 0, 0, 0},
  {EC_DSA_SIGN,	ADAPTER, 0, 0, 0},
  {EC_DSA_VERIFY, ADAPTER, 0, 0, 0},
  {EC_KGEN,      ADAPTER, 0, 0, 0},
- {ED25519_KEYGEN, MSA9, SCALAR_MULTIPLY_ED25519, 0, 0},
- {ED25519_SIGN,   MSA9, EDDSA_SIGN_ED25519, 0, 0},
- {ED25519_VERIFY, MSA9, EDDSA_VERIFY_ED25519, 0, 0},
- {ED448_KEYGEN,   MSA9, SCALAR_MULTIPLY_ED448, 0, 0},
- {ED448_SIGN,     MSA9, EDDSA_SIGN_ED448, 0, 0},
- {ED448_VERIFY,   MSA9, EDDSA_VERIFY_ED448, 0, 0},
- {X25519_KEYGEN,   MSA9, SCALAR_MULTIPLY_X25519, 0, 0},
- {X25519_DERIVE,   MSA9, SCALAR_MULTIPLY_X25519, 0, 0},
- {X448_KEYGEN,   MSA9, SCALAR_MULTIPLY_X448, 0, 0},
- {X448_DERIVE,   MSA9, SCALAR_MULTIPLY_X448, 0, 0},
+ {ED25519_KEYGEN, MSA9, SCALAR_MULTIPLY_ED25519, ICA_FLAG_SW, 0},
+ {ED25519_SIGN,   MSA9, EDDSA_SIGN_ED25519, ICA_FLAG_SW, 0},
+ {ED25519_VERIFY, MSA9, EDDSA_VERIFY_ED25519, ICA_FLAG_SW, 0},
+ {ED448_KEYGEN,   MSA9, SCALAR_MULTIPLY_ED448, ED448_SW_FLAGS, 0},
+ {ED448_SIGN,     MSA9, EDDSA_SIGN_ED448, ED448_SW_FLAGS, 0},
+ {ED448_VERIFY,   MSA9, EDDSA_VERIFY_ED448, ED448_SW_FLAGS, 0},
+ {X25519_KEYGEN,   MSA9, SCALAR_MULTIPLY_X25519, ICA_FLAG_SW, 0},
+ {X25519_DERIVE,   MSA9, SCALAR_MULTIPLY_X25519, ICA_FLAG_SW, 0},
+ {X448_KEYGEN,   MSA9, SCALAR_MULTIPLY_X448, ICA_FLAG_SW, 0},
+ {X448_DERIVE,   MSA9, SCALAR_MULTIPLY_X448, ICA_FLAG_SW, 0},
  {RSA_ME,       ADAPTER, 0, 0, 0},
  {RSA_CRT,      ADAPTER, 0, 0, 0},
  {RSA_KEY_GEN_ME, ADAPTER, 0, ICA_FLAG_SW, 0},  // SW (openssl)
@@ -517,11 +527,11 @@ libica_func_list_element_int icaList[] = {
  * Query s390_xxx_functions for each algorithm to check
  * CPACF support and update the corresponding SHW-flags.
  */
-int s390_initialize_functionlist()
+static void functionlist_init(void)
 {
 	unsigned int list_len = sizeof(icaList)/sizeof(libica_func_list_element_int);
 	unsigned int x;
-	
+
 	for (x = 0; x < list_len; x++) {
 
 		libica_func_list_element_int *e = &icaList[x];
@@ -585,7 +595,7 @@ int s390_initialize_functionlist()
 		case EC_DSA_SIGN: /* fall-through */
 		case EC_DSA_VERIFY: /* fall-through */
 		case EC_KGEN:
-			if (ecc_via_online_card) {
+			if (s390_ecc_via_online_card()) {
 				e->flags |= ICA_FLAG_DHW;
 				e->property |= ICA_PROPERTY_EC_BP | ICA_PROPERTY_EC_NIST;
 			}
@@ -593,7 +603,7 @@ int s390_initialize_functionlist()
 			break;
 		case RSA_ME: /* fall-through */
 		case RSA_CRT:
-			if (any_card_online) {
+			if (s390_any_card_online()) {
 				e->flags |= ICA_FLAG_DHW;
 				e->property |= ICA_PROPERTY_RSA_ALL;
 			}
@@ -603,7 +613,14 @@ int s390_initialize_functionlist()
 			break;
 		}
 	}
+}
 
+/*
+ * The function list is set up once, on the first query.
+ */
+int s390_initialize_functionlist(void)
+{
+	pthread_once(&functionlist_once, functionlist_init);
 	return 0;
 }
 
@@ -643,6 +660,8 @@ int s390_get_functionlist(libica_func_list_element *pmech_list,
 	return EINVAL;
   }
 
+  s390_initialize_functionlist();
+
   if (!pmech_list) {
 	*pmech_list_len = sizeof(icaList)/sizeof(libica_func_list_element_int);
 	return 0;
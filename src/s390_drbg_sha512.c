@@ -88,6 +88,7 @@ ica_drbg_mech_t DRBG_SHA512 = {
 	.lock = PTHREAD_RWLOCK_INITIALIZER,
 	.test_intervall = UINT64_MAX,
 	.test_ctr = 0,
+	.test_ok = 0,
 	.error_state = 0,
 };
 
@@ -31,6 +31,7 @@
 #include "init.h"
 #include "icastats.h"
 #include "s390_sha.h"
+#include "ecx_sw.h"
 
 #define CPRBXSIZE (sizeof(struct CPRBX))
 #define PARMBSIZE (2048)
@@ -662,7 +663,7 @@ unsigned int ecdh_hw(ica_adapter_handle_t adapter_handle,
 			return rc;
 	}
 
-	if (!ecc_via_online_card)
+	if (!s390_ecc_via_online_card())
 		return ENODEV;
 
 	if (adapter_handle == DRIVER_NOT_LOADED)
@@ -1050,7 +1051,7 @@ unsigned int ecdsa_sign_hw(ica_adapter_handle_t adapter_handle,
 			return rc;
 	}
 
-	if (!ecc_via_online_card)
+	if (!s390_ecc_via_online_card())
 		return ENODEV;
 
 	if (adapter_handle == DRIVER_NOT_LOADED)
@@ -1084,6 +1085,55 @@ ret:
 	return rc;
 }
 
+/**
+ * Make sure to use the original openssl ECDSA methods on the given key to
+ * avoid an endless loop when being called from IBMCA engine in software
+ * fallback.
+ */
+static void set_openssl_ecdsa_method(EC_KEY *a)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	ECDSA_set_method(a, ECDSA_OpenSSL());
+#else
+	EC_KEY_set_method(a, EC_KEY_OpenSSL());
+#endif
+}
+
+/**
+ * creates an ECDSA signature with a prepared private EC_KEY.
+ * Returns 0 if successful
+ *         EIO if an internal error occurred.
+ */
+static unsigned int ecdsa_do_sign_sw(EC_KEY *a, unsigned int privlen,
+		const unsigned char *hash, unsigned int hash_length,
+		unsigned char *signature)
+{
+	BIGNUM* r=NULL; BIGNUM* s=NULL;
+	ECDSA_SIG* sig = NULL;
+	unsigned int i,n;
+
+	sig = ECDSA_do_sign(hash, hash_length, a);
+	if (!sig)
+		return EIO;
+
+	ECDSA_SIG_get0(sig, (const BIGNUM**)&r, (const BIGNUM **)&s);
+
+	/* Insert leading 0x00's if r or s shorter than privlen */
+	n = privlen - BN_num_bytes(r);
+	for (i = 0; i < n; i++)
+		signature[i] = 0x00;
+	BN_bn2bin(r, &(signature[n]));
+
+	n = privlen - BN_num_bytes(s);
+	for (i = 0; i < n; i++)
+		signature[privlen+i] = 0x00;
+	BN_bn2bin(s, &(signature[privlen+n]));
+
+	ECDSA_SIG_free(sig); /* also frees r and s */
+
+	return 0;
+}
+
 /**
  * creates an ECDSA signature in software using OpenSSL.
  * Returns 0 if successful
@@ -1095,10 +1145,7 @@ unsigned int ecdsa_sign_sw(const ICA_EC_KEY *privkey,
 {
 	int rc = EIO;
 	EC_KEY *a = NULL;
-	BIGNUM* r=NULL; BIGNUM* s=NULL;
-	ECDSA_SIG* sig = NULL;
 	unsigned int privlen = privlen_from_nid(privkey->nid);
-	unsigned int i,n;
 
 #ifdef ICA_FIPS
 	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
@@ -1115,36 +1162,10 @@ unsigned int ecdsa_sign_sw(const ICA_EC_KEY *privkey,
 	if (!EC_KEY_check_key(a))
 		goto err;
 
-	/**
-	 * Make sure to use original openssl sign method to avoid endless loop when being
-	 * called from IBMCA engine in software fallback.
-	 */
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-	ECDSA_set_method(a, ECDSA_OpenSSL());
-#else
-	EC_KEY_set_method(a, EC_KEY_OpenSSL());
-#endif
-	sig = ECDSA_do_sign(hash, hash_length, a);
-	if (!sig)
-		goto err;
-
-	ECDSA_SIG_get0(sig, (const BIGNUM**)&r, (const BIGNUM **)&s);
-
-	/* Insert leading 0x00's if r or s shorter than privlen */
-	n = privlen - BN_num_bytes(r);
-	for (i = 0; i < n; i++)
-		signature[i] = 0x00;
-	BN_bn2bin(r, &(signature[n]));
-
-	n = privlen - BN_num_bytes(s);
-	for (i = 0; i < n; i++)
-		signature[privlen+i] = 0x00;
-	BN_bn2bin(s, &(signature[privlen+n]));
-
-	rc = 0;
+	set_openssl_ecdsa_method(a);
+	rc = ecdsa_do_sign_sw(a, privlen, hash, hash_length, signature);
 
 err:
-	ECDSA_SIG_free(sig); /* also frees r and s */
 	EC_KEY_free(a);
 
 	return (rc);
@@ -1503,7 +1524,7 @@ unsigned int ecdsa_verify_hw(ica_adapter_handle_t adapter_handle,
 			return rc;
 	}
 
-	if (!ecc_via_online_card)
+	if (!s390_ecc_via_online_card())
 		return ENODEV;
 
 	if (adapter_handle == DRIVER_NOT_LOADED)
@@ -1539,6 +1560,47 @@ ret:
 	return rc;
 }
 
+/**
+ * verifies an ECDSA signature with a prepared public EC_KEY.
+ *
+ * Returns 0 if successful
+ *         EIO if an internal error occurred
+ *         EFAULT if signature invalid.
+ */
+static unsigned int ecdsa_do_verify_sw(EC_KEY *a, unsigned int privlen,
+		const unsigned char *hash, unsigned int hash_length,
+		const unsigned char *signature)
+{
+	int rc;
+	BIGNUM *r, *s;
+	ECDSA_SIG* sig = NULL;
+
+	/* create ECDSA_SIG instance */
+	sig = ECDSA_SIG_new();
+	if (!sig)
+		return EIO;
+	r = BN_bin2bn(signature, privlen, NULL);
+	s = BN_bin2bn(signature + privlen, privlen, NULL);
+	ECDSA_SIG_set0(sig, r, s);
+
+	rc = ECDSA_do_verify(hash, hash_length, sig, a);
+	switch (rc) {
+	case 0: /* signature invalid */
+		rc = EFAULT;
+		break;
+	case 1: /* signature valid */
+		rc = 0;
+		break;
+	default: /* internal error */
+		rc = EIO;
+		break;
+	}
+
+	ECDSA_SIG_free(sig);
+
+	return rc;
+}
+
 /**
  * verifies an ECDSA signature in software using OpenSSL.
  *
@@ -1551,8 +1613,7 @@ unsigned int ecdsa_verify_sw(const ICA_EC_KEY *pubkey,
 		const unsigned char *signature) {
 	int rc = EIO;
 	EC_KEY *a = NULL;
-	BIGNUM *r, *s, *xa, *ya;
-	ECDSA_SIG* sig = NULL;
+	BIGNUM *xa, *ya;
 	unsigned int privlen = privlen_from_nid(pubkey->nid);
 
 #ifdef ICA_FIPS
@@ -1571,43 +1632,186 @@ unsigned int ecdsa_verify_sw(const ICA_EC_KEY *pubkey,
 		goto err;
 	}
 
-	/* create ECDSA_SIG instance */
-	sig = ECDSA_SIG_new();
-	r = BN_bin2bn(signature, privlen, NULL);
-	s = BN_bin2bn(signature + privlen, privlen, NULL);
-	ECDSA_SIG_set0(sig, r, s);
+	set_openssl_ecdsa_method(a);
+	rc = ecdsa_do_verify_sw(a, privlen, hash, hash_length, signature);
 
-	/**
-	 * Make sure to use original openssl verify method to avoid endless loop
-	 * when being called from IBMCA engine in software fallback.
-	 */
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-	ECDSA_set_method(a, ECDSA_OpenSSL());
-#else
-	EC_KEY_set_method(a, EC_KEY_OpenSSL());
-#endif
-	rc = ECDSA_do_verify(hash, hash_length, sig, a);
-	switch (rc) {
-	case 0: /* signature invalid */
-		rc = EFAULT;
-		break;
-	case 1: /* signature valid */
-		rc = 0;
-		break;
-	default: /* internal error */
-		rc = EIO;
-		break;
+err:
+	BN_clear_free(xa);
+	BN_clear_free(ya);
+	EC_KEY_free(a);
+
+	return rc;
+}
+
+static int is_zero(const unsigned char *buf, unsigned int len)
+{
+	unsigned char acc = 0;
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		acc |= buf[i];
+
+	return acc == 0;
+}
+
+/**
+ * prepares the software part of an ECDSA key context: builds the EC_KEY
+ * once, validates the key, fills in the public point if only the private
+ * value was given and precomputes the multiples of the generator used by
+ * every signature and verification.
+ *
+ * Returns 0 if successful
+ *         EINVAL if the key is invalid
+ *         ENOMEM/EIO if an internal error occurred.
+ */
+unsigned int ecdsa_ctx_init_sw(ica_ecdsa_ctx_t *ctx)
+{
+	ICA_EC_KEY *key = &ctx->key;
+	unsigned int privlen = ctx->privlen;
+	EC_KEY *a = NULL;
+	const EC_GROUP *group;
+	BIGNUM *xa = NULL, *ya = NULL, *x = NULL, *y = NULL;
+	unsigned char X[MAX_ECC_PRIV_SIZE], Y[MAX_ECC_PRIV_SIZE];
+	unsigned int i, n, rc = EIO;
+
+	ctx->has_priv = !is_zero(key->D, privlen);
+	ctx->has_pub = !is_zero(key->X, 2 * privlen);
+	if (!ctx->has_priv && !ctx->has_pub)
+		return EINVAL;
+
+	/* the context is still usable via the card if openssl lacks the curve */
+	if (!is_supported_openssl_curve(key->nid))
+		return ctx->has_pub ? 0 : EINVAL;
+
+	if (ctx->has_priv) {
+		a = make_eckey(key->nid, key->D, privlen);
+	} else {
+		xa = BN_bin2bn(key->X, privlen, NULL);
+		ya = BN_bin2bn(key->Y, privlen, NULL);
+		if (xa == NULL || ya == NULL) {
+			rc = ENOMEM;
+			goto err;
+		}
+		a = make_public_eckey(key->nid, xa, ya, privlen);
+	}
+	if (!a)
+		goto err;
+
+	/* on curve, not infinity, order and private/public match, once */
+	if (!EC_KEY_check_key(a)) {
+		rc = EINVAL;
+		goto err;
+	}
+
+	if (ctx->has_priv) {
+		group = EC_KEY_get0_group(a);
+		x = BN_new();
+		y = BN_new();
+		if (x == NULL || y == NULL) {
+			rc = ENOMEM;
+			goto err;
+		}
+		if (!EC_POINT_get_affine_coordinates_GFp(group,
+				EC_KEY_get0_public_key(a), x, y, NULL))
+			goto err;
+
+		n = privlen - BN_num_bytes(x);
+		for (i = 0; i < n; i++)
+			X[i] = 0x00;
+		BN_bn2bin(x, &(X[n]));
+		n = privlen - BN_num_bytes(y);
+		for (i = 0; i < n; i++)
+			Y[i] = 0x00;
+		BN_bn2bin(y, &(Y[n]));
+
+		if (ctx->has_pub) {
+			/* given public key must belong to the private key */
+			if (memcmp(key->X, X, privlen) || memcmp(key->Y, Y, privlen)) {
+				rc = EINVAL;
+				goto err;
+			}
+		} else {
+			memcpy(key->X, X, privlen);
+			memcpy(key->Y, Y, privlen);
+			ctx->has_pub = 1;
+		}
 	}
 
+	/*
+	 * Precompute the generator table (comb/wNAF, depending on the
+	 * openssl version and curve). It is an optimization only, so a
+	 * failure here is not fatal.
+	 */
+	(void)EC_KEY_precompute_mult(a, NULL);
+
+	set_openssl_ecdsa_method(a);
+	ctx->eckey = a;
+	a = NULL;
+	rc = 0;
+
 err:
 	BN_clear_free(xa);
 	BN_clear_free(ya);
-	ECDSA_SIG_free(sig);
+	BN_clear_free(x);
+	BN_clear_free(y);
 	EC_KEY_free(a);
 
 	return rc;
 }
 
+void ecdsa_ctx_free_sw(ica_ecdsa_ctx_t *ctx)
+{
+	EC_KEY_free(ctx->eckey);
+	ctx->eckey = NULL;
+}
+
+/**
+ * creates an ECDSA signature in software with a prepared key context.
+ *
+ * Returns 0 if successful
+ *         EINVAL if the context has no private key or openssl lacks the curve
+ *         EIO if an internal error occurred.
+ */
+unsigned int ecdsa_ctx_sign_sw(const ica_ecdsa_ctx_t *ctx,
+		const unsigned char *hash, unsigned int hash_length,
+		unsigned char *signature)
+{
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (ctx->eckey == NULL || !ctx->has_priv)
+		return EINVAL;
+
+	return ecdsa_do_sign_sw(ctx->eckey, ctx->privlen, hash, hash_length,
+				signature);
+}
+
+/**
+ * verifies an ECDSA signature in software with a prepared key context.
+ *
+ * Returns 0 if successful
+ *         EINVAL if openssl lacks the curve
+ *         EIO if an internal error occurred
+ *         EFAULT if signature invalid.
+ */
+unsigned int ecdsa_ctx_verify_sw(const ica_ecdsa_ctx_t *ctx,
+		const unsigned char *hash, unsigned int hash_length,
+		const unsigned char *signature)
+{
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if (ctx->eckey == NULL)
+		return EINVAL;
+
+	return ecdsa_do_verify_sw(ctx->eckey, ctx->privlen, hash, hash_length,
+				  signature);
+}
+
 /**
  * makes an ECKeyGen parmblock at given struct and returns its length.
  */
@@ -1864,7 +2068,7 @@ unsigned int eckeygen_hw(ica_adapter_handle_t adapter_handle, ICA_EC_KEY *key)
 			return rc;
 	}
 
-	if (!ecc_via_online_card)
+	if (!s390_ecc_via_online_card())
 		return ENODEV;
 
 	reply_p = make_eckeygen_request(key, &xcrb, &buf, &len);
@@ -1985,7 +2189,8 @@ err:
 
 /*
  * Derive public key.
- * Returns 0 if successful. Caller has to check for MSA 9.
+ * Returns 0 if successful. Uses CPACF if MSA 9 is available, the software
+ * engine otherwise (if fallbacks are enabled).
  */
 int x25519_derive_pub(unsigned char pub[32],
 		      const unsigned char priv[32])
@@ -1995,11 +2200,18 @@ int x25519_derive_pub(unsigned char pub[32],
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 	};
-	int rc;
+	int rc = ENODEV;
 
-	rc = scalar_mulx_cpacf(pub, priv, x25519_base_u, NID_X25519);
+	if (msa9_switch)
+		rc = scalar_mulx_cpacf(pub, priv, x25519_base_u, NID_X25519);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = x25519_sw(pub, priv, x25519_base_u);
+		stats_increment(ICA_STATS_X25519_KEYGEN, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_X25519_KEYGEN, ALGO_HW, ENCRYPT);
 
-	stats_increment(ICA_STATS_X25519_KEYGEN, ALGO_HW, ENCRYPT);
 	return rc;
 }
 
@@ -2013,16 +2225,23 @@ int x448_derive_pub(unsigned char pub[56],
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
 	};
-	int rc;
+	int rc = ENODEV;
 
-	rc = scalar_mulx_cpacf(pub, priv, x448_base_u, NID_X448);
+	if (msa9_switch)
+		rc = scalar_mulx_cpacf(pub, priv, x448_base_u, NID_X448);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = x448_sw(pub, priv, x448_base_u);
+		stats_increment(ICA_STATS_X448_KEYGEN, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_X448_KEYGEN, ALGO_HW, ENCRYPT);
 
-	stats_increment(ICA_STATS_X448_KEYGEN, ALGO_HW, ENCRYPT);
 	return rc;
 }
 
-int ed25519_derive_pub(unsigned char pub[32],
-		       const unsigned char priv[32])
+static int ed25519_derive_pub_hw(unsigned char pub[32],
+				 const unsigned char priv[32])
 {
 	/* base point coordinates (big-endian) */
 	static const unsigned char base_x[] = {
@@ -2070,18 +2289,41 @@ int ed25519_derive_pub(unsigned char pub[32],
 	/* to big endian */
 	s390_flip_endian_32(pub, pub);
 
-	stats_increment(ICA_STATS_ED25519_KEYGEN, ALGO_HW, ENCRYPT);
 	rc = 0;
 out:
 	return rc;
 }
 
 /*
- * Derive public key.
- * Returns 0 if successful. Caller has to check for MSA 9.
+ * Derive public key (big-endian).
+ * Returns 0 if successful. Uses CPACF if MSA 9 is available, the software
+ * engine otherwise (if fallbacks are enabled).
  */
-int ed448_derive_pub(unsigned char pub[57],
-		     const unsigned char priv[57])
+int ed25519_derive_pub(unsigned char pub[32],
+		       const unsigned char priv[32])
+{
+	int rc = ENODEV;
+
+	if (msa9_switch)
+		rc = ed25519_derive_pub_hw(pub, priv);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = ed25519_derive_pub_sw(pub, priv);
+		if (rc)
+			return rc;
+
+		/* to big endian */
+		s390_flip_endian_32(pub, pub);
+		stats_increment(ICA_STATS_ED25519_KEYGEN, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_ED25519_KEYGEN, ALGO_HW, ENCRYPT);
+
+	return 0;
+}
+
+static int ed448_derive_pub_hw(unsigned char pub[57],
+			       const unsigned char priv[57])
 {
 	/* base point coordinates (big-endian) */
 	static const unsigned char base_x[] = {
@@ -2143,12 +2385,42 @@ int ed448_derive_pub(unsigned char pub[57],
 	s390_flip_endian_64(pub64, pub64);
 
 	memcpy(pub, pub64 + 64 - 57, 57);
-	stats_increment(ICA_STATS_ED448_KEYGEN, ALGO_HW, ENCRYPT);
 	rc = 0;
 out:
 	return rc;
 }
 
+/*
+ * Derive public key (big-endian).
+ * Returns 0 if successful. Uses CPACF if MSA 9 is available, the software
+ * engine otherwise (if fallbacks are enabled).
+ */
+int ed448_derive_pub(unsigned char pub[57],
+		     const unsigned char priv[57])
+{
+	unsigned char pub64[64];
+	int rc = ENODEV;
+
+	if (msa9_switch)
+		rc = ed448_derive_pub_hw(pub, priv);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		memset(pub64, 0, sizeof(pub64));
+		rc = ed448_derive_pub_sw(pub64, priv);
+		if (rc)
+			return rc;
+
+		/* to big endian */
+		s390_flip_endian_64(pub64, pub64);
+		memcpy(pub, pub64 + 64 - 57, 57);
+		stats_increment(ICA_STATS_ED448_KEYGEN, ALGO_SW, ENCRYPT);
+	} else
+		stats_increment(ICA_STATS_ED448_KEYGEN, ALGO_HW, ENCRYPT);
+
+	return 0;
+}
+
 #ifdef ICA_INTERNAL_TEST_EC
 
 #include "../test/testcase.h"
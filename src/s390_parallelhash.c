@@ -0,0 +1,227 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "icastats.h"
+#include "s390_crypto.h"
+#include "s390_sha.h"
+#include "s390_parallelhash.h"
+#include "sha3_sw.h"
+#include "worker_pool.h"
+
+/* cSHAKE: the two bits 00 and the first bit of pad10*1 */
+#define CSHAKE_PAD		0x04
+
+/* chunks a worker takes at a time */
+#define PARALLELHASH_CHUNKS	16
+
+static const unsigned char parallelhash_name[] = "ParallelHash";
+
+/* SP 800-185, 2.3.1 */
+static size_t left_encode(unsigned char *out, uint64_t x)
+{
+	unsigned int n = 1, i;
+
+	while (n < 8 && (x >> (8 * n)))
+		n++;
+	out[0] = n;
+	for (i = 1; i <= n; i++)
+		out[i] = x >> (8 * (n - i));
+
+	return n + 1;
+}
+
+static size_t right_encode(unsigned char *out, uint64_t x)
+{
+	unsigned int n = 1, i;
+
+	while (n < 8 && (x >> (8 * n)))
+		n++;
+	for (i = 0; i < n; i++)
+		out[i] = x >> (8 * (n - 1 - i));
+	out[n] = n;
+
+	return n + 1;
+}
+
+struct parallelhash {
+	const unsigned char *data;
+	uint64_t data_length;
+	size_t block_size;
+	uint64_t chunks;
+	unsigned int rate;
+	unsigned int cv_length;
+	unsigned int hw_function_code;
+	int hw;
+	unsigned char *cv;	/* chaining values, cv_length bytes each */
+	uint64_t next;		/* next chunk to hash */
+	unsigned int failed;
+};
+
+/* the chaining value of a chunk is SHAKE(chunk, 2 * security strength) */
+static int hash_chunks(struct parallelhash *ph, uint64_t first, uint64_t last)
+{
+	const unsigned char *in[KECCAK_WAYS];
+	unsigned char *out[KECCAK_WAYS];
+	size_t len[KECCAK_WAYS];
+	unsigned char shabuff[200+16];
+	uint64_t i, off;
+	unsigned int n, w;
+
+	for (i = first; i < last; i += n) {
+		n = ph->hw || last - i < KECCAK_WAYS ? 1 : KECCAK_WAYS;
+		for (w = 0; w < n; w++) {
+			off = (i + w) * ph->block_size;
+			in[w] = ph->data + off;
+			len[w] = ph->data_length - off < ph->block_size ?
+				 ph->data_length - off : ph->block_size;
+			out[w] = ph->cv + (i + w) * ph->cv_length;
+		}
+
+		if (ph->hw) {
+			memset(shabuff, 0, sizeof(shabuff));
+			if (s390_klmd_shake(ph->hw_function_code, shabuff,
+					    out[0], ph->cv_length, in[0],
+					    len[0]) < 0)
+				return EIO;
+		} else if (n == 1) {
+			keccak_sw(in[0], len[0], ph->rate, SHAKE_PAD, out[0],
+				  ph->cv_length);
+		} else {
+			keccak_multi_sw(n, in, len, ph->rate, SHAKE_PAD, out,
+					ph->cv_length);
+		}
+	}
+
+	return 0;
+}
+
+static void *parallelhash_worker(void *arg)
+{
+	struct parallelhash *ph = arg;
+	uint64_t first, last;
+
+	while ((first = __sync_fetch_and_add(&ph->next, PARALLELHASH_CHUNKS))
+	       < ph->chunks) {
+		last = ph->chunks - first < PARALLELHASH_CHUNKS ?
+		       ph->chunks : first + PARALLELHASH_CHUNKS;
+		if (hash_chunks(ph, first, last))
+			__sync_fetch_and_add(&ph->failed, 1);
+	}
+
+	return NULL;
+}
+
+static int parallelhash_run(struct parallelhash *ph, unsigned int workers)
+{
+	uint64_t tasks;
+
+	if (workers == 0)
+		workers = PARALLELHASH_DEFAULT_WORKERS;
+	if (workers > PARALLELHASH_MAX_WORKERS)
+		workers = PARALLELHASH_MAX_WORKERS;
+	tasks = (ph->chunks + PARALLELHASH_CHUNKS - 1) / PARALLELHASH_CHUNKS;
+	if (workers > tasks)
+		workers = tasks;
+
+	worker_pool_run(parallelhash_worker, ph, workers);
+
+	return ph->failed ? EIO : 0;
+}
+
+int s390_parallelhash(kimd_functions_t sha_function,
+		      const unsigned char *data, uint64_t data_length,
+		      size_t block_size, const unsigned char *custom,
+		      size_t custom_length, unsigned char *output,
+		      size_t output_length, unsigned int workers)
+{
+	struct parallelhash ph;
+	struct ica_xof_ctx xof;
+	unsigned char enc[9];
+	uint64_t start = stats_clock();
+	int rc;
+
+	/* checks whether SHAKE is available at all */
+	rc = s390_xof_init(&xof, sha_function);
+	if (rc)
+		return rc;
+	xof.pad = CSHAKE_PAD;
+
+	memset(&ph, 0, sizeof(ph));
+	ph.data = data;
+	ph.data_length = data_length;
+	ph.block_size = block_size;
+	ph.chunks = data_length / block_size + (data_length % block_size != 0);
+	ph.rate = xof.rate;
+	ph.cv_length = sha_function == SHAKE_128 ? 32 : 64;
+	ph.hw_function_code = xof.hw_function_code;
+	ph.hw = xof.hw;
+
+	if (ph.chunks) {
+		if (ph.chunks > SIZE_MAX / ph.cv_length)
+			return EINVAL;
+		ph.cv = malloc(ph.chunks * ph.cv_length);
+		if (ph.cv == NULL)
+			return ENOMEM;
+
+		rc = parallelhash_run(&ph, workers);
+		if (rc)
+			goto out;
+	}
+
+	/*
+	 * cSHAKE(left_encode(B) || cv_0 || ... || right_encode(n) ||
+	 * right_encode(L), L, "ParallelHash", S)
+	 */
+
+	/* bytepad(encode_string(N) || encode_string(S), rate) */
+	rc = s390_xof_absorb(&xof, enc, left_encode(enc, xof.rate));
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, enc, left_encode(enc,
+				     (sizeof(parallelhash_name) - 1) * 8));
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, parallelhash_name,
+				     sizeof(parallelhash_name) - 1);
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, enc, left_encode(enc,
+				     (uint64_t)custom_length * 8));
+	if (rc == 0 && custom_length)
+		rc = s390_xof_absorb(&xof, custom, custom_length);
+	if (rc == 0 && xof.absorbed % xof.rate) {
+		memset(enc, 0, sizeof(enc));
+		while (rc == 0 && xof.absorbed % xof.rate)
+			rc = s390_xof_absorb(&xof, enc, 1);
+	}
+
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, enc, left_encode(enc, block_size));
+	if (rc == 0 && ph.chunks)
+		rc = s390_xof_absorb(&xof, ph.cv, ph.chunks * ph.cv_length);
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, enc, right_encode(enc, ph.chunks));
+	if (rc == 0)
+		rc = s390_xof_absorb(&xof, enc, right_encode(enc,
+				     (uint64_t)output_length * 8));
+	if (rc == 0)
+		rc = s390_xof_squeeze(&xof, output, output_length);
+
+	/* the leaf hashes and the final cSHAKE */
+	if (rc == 0)
+		stats_add_batch(sha_function == SHAKE_128 ?
+				ICA_STATS_SHAKE_128 : ICA_STATS_SHAKE_256,
+				ph.hw ? ALGO_HW : ALGO_SW, ENCRYPT,
+				ph.chunks + 1, data_length, start);
+out:
+	OPENSSL_cleanse(&xof, sizeof(xof));
+	free(ph.cv);
+	return rc;
+}
@@ -27,6 +27,7 @@
 #include "s390_crypto.h"
 #include "icastats.h"
 #include "s390_drbg.h"
+#include "rng.h"
 
 #define STCK_BUFFER  8
 
@@ -36,6 +37,7 @@
  * the ica_random_number_generate api,
  */
 ica_drbg_t *ica_drbg_global = ICA_DRBG_NEW_STATE_HANDLE;
+static unsigned int ica_drbg_global_fork_gen;
 
 sem_t semaphore;
 
@@ -185,22 +187,38 @@ int s390_prng(unsigned char *output_data, unsigned int output_length)
 	size_t i;
 	int rc = -1;
 	unsigned char *ptr = output_data;
+	ica_drbg_t *sh;
 
 	if (output_length == 0)
 		return 0;
 
+	init_rng();
+
 	const size_t q = output_length
 	    / ICA_DRBG_SHA512->max_no_of_bytes_per_req;
 	const size_t r = output_length
 	    % ICA_DRBG_SHA512->max_no_of_bytes_per_req;
 
 	/*
-	 * Try to use the global ica_drbg instantiation. If it does not exist
-	 * or it does not work, the old prng code is used.
+	 * Try to use the calling thread's ica_drbg instantiation, if enabled,
+	 * or the global one. If it does not exist or it does not work, the
+	 * old prng code is used.
 	 */
-	if (ica_drbg_global) {
+	sh = rng_thread_sh(RNG_SH_GLOBAL);
+	if (sh == NULL && ica_drbg_global != NULL &&
+	    !rng_fork_reseed(ica_drbg_global, &ica_drbg_global_fork_gen))
+		sh = ica_drbg_global;
+
+	/* small requests (IVs, nonces) are served from a per-thread pool */
+	if (sh && output_length <= RNG_POOL_MAX_REQ) {
+		rc = rng_pool_gen(sh, output_data, output_length);
+		if (rc == 0)
+			return 0;
+	}
+
+	if (sh) {
 		for (i = 0; i < q; i++) {
-			rc = ica_drbg_generate(ica_drbg_global, 256, false,
+			rc = ica_drbg_generate(sh, 256, false,
 			    NULL, 0, ptr,
 			    ICA_DRBG_SHA512->max_no_of_bytes_per_req);
 			if (rc)
@@ -209,7 +227,7 @@ int s390_prng(unsigned char *output_data, unsigned int output_length)
 			ptr += ICA_DRBG_SHA512->max_no_of_bytes_per_req;
 		}
 		if (r > 0) {
-			rc = ica_drbg_generate(ica_drbg_global, 256, false,
+			rc = ica_drbg_generate(sh, 256, false,
 			    NULL, 0, ptr, r);
 		}
 		if (rc == 0)
@@ -19,6 +19,7 @@
 #include <stdint.h>
 #include <openssl/crypto.h>
 #include <openssl/rsa.h>
+#include <pthread.h>
 
 #include <openssl/opensslconf.h>
 #ifdef OPENSSL_FIPS
@@ -996,3 +997,255 @@ static unsigned int mul_sw(int fc_1_length, char *fc1, int fc_2_length,
 	return rc;
 }
 
+
+/*
+ * Pre-parsed RSA keys. The key material is converted to BIGNUMs and the
+ * Montgomery contexts are set up once when the key context is created.
+ * The software path only reads them afterwards, so a key context can be
+ * used by several threads at the same time. Each thread keeps its own
+ * BN_CTX for the temporaries.
+ */
+static pthread_key_t rsa_bn_ctx_key;
+static pthread_once_t rsa_bn_ctx_once = PTHREAD_ONCE_INIT;
+
+static void rsa_bn_ctx_free(void *ctx)
+{
+	BN_CTX_free(ctx);
+}
+
+static void rsa_bn_ctx_key_init(void)
+{
+	pthread_key_create(&rsa_bn_ctx_key, rsa_bn_ctx_free);
+}
+
+static BN_CTX *rsa_bn_ctx_get(void)
+{
+	BN_CTX *ctx;
+
+	pthread_once(&rsa_bn_ctx_once, rsa_bn_ctx_key_init);
+
+	ctx = pthread_getspecific(rsa_bn_ctx_key);
+	if (ctx == NULL) {
+		ctx = BN_CTX_new();
+		if (ctx == NULL)
+			return NULL;
+		if (pthread_setspecific(rsa_bn_ctx_key, ctx)) {
+			BN_CTX_free(ctx);
+			return NULL;
+		}
+	}
+	return ctx;
+}
+
+static BN_MONT_CTX *rsa_mont_new(const BIGNUM *mod, BN_CTX *ctx)
+{
+	BN_MONT_CTX *mont;
+
+	mont = BN_MONT_CTX_new();
+	if (mont == NULL)
+		return NULL;
+
+	if (!BN_MONT_CTX_set(mont, mod, ctx)) {
+		BN_MONT_CTX_free(mont);
+		return NULL;
+	}
+	return mont;
+}
+
+/**
+ * Convert the key material of @key_ctx to BIGNUMs, validate it and set up
+ * the Montgomery contexts. For CRT keys the key material must already be
+ * in privileged form (p > q).
+ *
+ * Returns 0 if successful, EINVAL if the key is invalid, ENOMEM if memory
+ * allocation fails.
+ */
+unsigned int rsa_key_ctx_init_sw(ica_rsa_key_ctx_t *key_ctx)
+{
+	unsigned int short_length, long_length;
+	BN_CTX *ctx;
+	BIGNUM *tmp;
+	int rc = ENOMEM;
+
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if ((ctx = BN_CTX_new()) == NULL)
+		return ENOMEM;
+
+	BN_CTX_start(ctx);
+	if ((tmp = BN_CTX_get(ctx)) == NULL)
+		goto out;
+
+	if (!key_ctx->is_crt) {
+		key_ctx->n = BN_bin2bn(key_ctx->me.modulus,
+				       key_ctx->key_length, NULL);
+		key_ctx->e = BN_bin2bn(key_ctx->me.exponent,
+				       key_ctx->key_length, NULL);
+		if (key_ctx->n == NULL || key_ctx->e == NULL)
+			goto out;
+
+		rc = EINVAL;
+		if (!BN_is_odd(key_ctx->n) || BN_is_one(key_ctx->n) ||
+		    BN_is_zero(key_ctx->e))
+			goto out;
+
+		rc = ENOMEM;
+		key_ctx->mont_n = rsa_mont_new(key_ctx->n, ctx);
+		if (key_ctx->mont_n == NULL)
+			goto out;
+	} else {
+		short_length = (key_ctx->key_length + 1) / 2;
+		long_length = short_length + 8;
+
+		key_ctx->p = BN_bin2bn(key_ctx->crt.p, long_length, NULL);
+		key_ctx->q = BN_bin2bn(key_ctx->crt.q, short_length, NULL);
+		key_ctx->dp = BN_bin2bn(key_ctx->crt.dp, long_length, NULL);
+		key_ctx->dq = BN_bin2bn(key_ctx->crt.dq, short_length, NULL);
+		key_ctx->qinv = BN_bin2bn(key_ctx->crt.qInverse, long_length,
+					  NULL);
+		if (key_ctx->p == NULL || key_ctx->q == NULL ||
+		    key_ctx->dp == NULL || key_ctx->dq == NULL ||
+		    key_ctx->qinv == NULL)
+			goto out;
+
+		/* p and q odd, exponents and qInv reduced, qInv * q = 1 mod p */
+		rc = EINVAL;
+		if (!BN_is_odd(key_ctx->p) || BN_is_one(key_ctx->p) ||
+		    !BN_is_odd(key_ctx->q) || BN_is_one(key_ctx->q) ||
+		    BN_cmp(key_ctx->dp, key_ctx->p) >= 0 ||
+		    BN_cmp(key_ctx->dq, key_ctx->q) >= 0 ||
+		    BN_cmp(key_ctx->qinv, key_ctx->p) >= 0)
+			goto out;
+		rc = ENOMEM;
+		if (!BN_mod_mul(tmp, key_ctx->qinv, key_ctx->q, key_ctx->p,
+				ctx))
+			goto out;
+		rc = EINVAL;
+		if (!BN_is_one(tmp))
+			goto out;
+
+		/* private exponents, use the constant time code path */
+		BN_set_flags(key_ctx->dp, BN_FLG_CONSTTIME);
+		BN_set_flags(key_ctx->dq, BN_FLG_CONSTTIME);
+
+		rc = ENOMEM;
+		key_ctx->mont_p = rsa_mont_new(key_ctx->p, ctx);
+		key_ctx->mont_q = rsa_mont_new(key_ctx->q, ctx);
+		if (key_ctx->mont_p == NULL || key_ctx->mont_q == NULL)
+			goto out;
+	}
+	rc = 0;
+
+out:
+	BN_CTX_end(ctx);
+	BN_CTX_free(ctx);
+	if (rc)
+		rsa_key_ctx_free_sw(key_ctx);
+	return rc;
+}
+
+/**
+ * Release the BIGNUMs and Montgomery contexts of @key_ctx.
+ */
+void rsa_key_ctx_free_sw(ica_rsa_key_ctx_t *key_ctx)
+{
+	BN_free(key_ctx->n);
+	BN_free(key_ctx->e);
+	BN_clear_free(key_ctx->p);
+	BN_clear_free(key_ctx->q);
+	BN_clear_free(key_ctx->dp);
+	BN_clear_free(key_ctx->dq);
+	BN_clear_free(key_ctx->qinv);
+	BN_MONT_CTX_free(key_ctx->mont_n);
+	BN_MONT_CTX_free(key_ctx->mont_p);
+	BN_MONT_CTX_free(key_ctx->mont_q);
+
+	key_ctx->n = key_ctx->e = NULL;
+	key_ctx->p = key_ctx->q = NULL;
+	key_ctx->dp = key_ctx->dq = key_ctx->qinv = NULL;
+	key_ctx->mont_n = key_ctx->mont_p = key_ctx->mont_q = NULL;
+}
+
+/**
+ * Perform a RSA operation with a pre-parsed key, in software.
+ * @param key_ctx
+ * Key context set up by rsa_key_ctx_init_sw.
+ * @param input_data
+ * Input data, key_length bytes in big endian format.
+ * @param output_data
+ * Output buffer of key_length bytes.
+ *
+ * Returns 0 if successful.
+ */
+unsigned int rsa_key_ctx_sw(const ica_rsa_key_ctx_t *key_ctx,
+			    const unsigned char *input_data,
+			    unsigned char *output_data)
+{
+	BN_CTX *ctx;
+	BIGNUM *c, *m1, *m2;
+	int ln, rc = EIO;
+
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	if ((ctx = rsa_bn_ctx_get()) == NULL)
+		return ENOMEM;
+
+	BN_CTX_start(ctx);
+	c = BN_CTX_get(ctx);
+	m1 = BN_CTX_get(ctx);
+	if ((m2 = BN_CTX_get(ctx)) == NULL) {
+		rc = ENOMEM;
+		goto cleanup;
+	}
+
+	if (BN_bin2bn(input_data, key_ctx->key_length, c) == NULL)
+		goto cleanup;
+
+	if (!key_ctx->is_crt) {
+		/* check if modulus value > data value */
+		if (BN_cmp(c, key_ctx->n) >= 0) {
+			rc = EINVAL;
+			goto cleanup;
+		}
+		if (!BN_mod_exp_mont(m1, c, key_ctx->e, key_ctx->n, ctx,
+				     key_ctx->mont_n))
+			goto cleanup;
+	} else {
+		/* m1 = c^dp mod p, m2 = c^dq mod q */
+		if (!BN_mod(m1, c, key_ctx->p, ctx) ||
+		    !BN_mod_exp_mont(m1, m1, key_ctx->dp, key_ctx->p, ctx,
+				     key_ctx->mont_p))
+			goto cleanup;
+		if (!BN_mod(m2, c, key_ctx->q, ctx) ||
+		    !BN_mod_exp_mont(m2, m2, key_ctx->dq, key_ctx->q, ctx,
+				     key_ctx->mont_q))
+			goto cleanup;
+
+		/* m1 = m2 + q * (qInv * (m1 - m2) mod p) */
+		if (!BN_mod_sub(m1, m1, m2, key_ctx->p, ctx) ||
+		    !BN_mod_mul(m1, m1, key_ctx->qinv, key_ctx->p, ctx) ||
+		    !BN_mul(m1, m1, key_ctx->q, ctx) ||
+		    !BN_add(m1, m1, m2))
+			goto cleanup;
+	}
+
+	if ((ln = BN_num_bytes(m1)) > (int)key_ctx->key_length)
+		goto cleanup;
+
+	memset(output_data, 0, key_ctx->key_length - ln);
+	BN_bn2bin(m1, output_data + (key_ctx->key_length - ln));
+
+	rc = 0;
+
+cleanup:
+	BN_clear(m1);
+	BN_clear(m2);
+	BN_CTX_end(ctx);
+	return rc;
+}
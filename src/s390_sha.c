@@ -27,6 +27,7 @@
 #include "s390_sha.h"
 #include "init.h"
 #include "icastats.h"
+#include "sha3_sw.h"
 
 static int s390_sha1_sw(unsigned char *iv, unsigned char *input_data,
 			unsigned int input_length, unsigned char *output_data,
@@ -321,11 +322,80 @@ int s390_sha512_256_sw(unsigned char *iv, unsigned char *input_data,
 	return 0;
 }
 
+/*
+ * SHA-3 and SHAKE in software. iv and the running length have the same
+ * format as for s390_sha_hw(), so the parts of one message can be hashed
+ * by either of them.
+ */
+static int s390_sha3_sw(unsigned char *iv, unsigned char *input_data,
+			uint64_t input_length, unsigned char *output_data,
+			unsigned int output_length, unsigned int message_part,
+			uint64_t *running_length_lo,
+			uint64_t *running_length_hi,
+			kimd_functions_t sha_function)
+{
+	unsigned char state[KECCAK_STATE_LEN];
+	unsigned int rate = sha_constants[sha_function].block_length;
+	uint64_t remnant, complete_blocks_length, sum_lo, sum_hi = 0;
+
+#ifdef ICA_FIPS
+	if (fips & ICA_FIPS_MODE)
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	remnant = input_length % rate;
+	complete_blocks_length = input_length - remnant;
+
+	if ((message_part == SHA_MSG_PART_FIRST ||
+	     message_part == SHA_MSG_PART_MIDDLE) && (remnant != 0))
+		return EINVAL;
+
+	if (message_part == SHA_MSG_PART_ONLY ||
+	    message_part == SHA_MSG_PART_FIRST) {
+		memset(state, 0, sizeof(state));
+		sum_lo = 0;
+	} else {
+		memcpy(state, iv, sizeof(state));
+		sum_lo = *running_length_lo;
+		if (running_length_hi)
+			sum_hi = *running_length_hi;
+	}
+
+	if (message_part == SHA_MSG_PART_ONLY ||
+	    message_part == SHA_MSG_PART_FINAL) {
+		if (!is_shake(sha_function))
+			output_length = sha_constants[sha_function].hash_length;
+		keccak_final_sw(state, input_data, input_length, rate,
+				is_shake(sha_function) ? SHAKE_PAD : SHA3_PAD,
+				output_data, output_length);
+	} else {
+		keccak_absorb_sw(state, input_data, complete_blocks_length,
+				 rate);
+
+		sum_lo += complete_blocks_length;
+		if (sum_lo < complete_blocks_length)
+			sum_hi += 1;
+
+		/* like s390_sha_hw() */
+		if (!is_shake(sha_function))
+			memcpy(output_data, state,
+			       sha_constants[sha_function].hash_length);
+		memcpy(iv, state, sizeof(state));
+		*running_length_lo = sum_lo;
+		if (running_length_hi)
+			*running_length_hi = sum_hi;
+	}
+
+	OPENSSL_cleanse(state, sizeof(state));
+	return 0;
+}
+
 int s390_sha1(unsigned char *iv, unsigned char *input_data,
 	      unsigned int input_length, unsigned char *output_data,
 	      unsigned int message_part, uint64_t *running_length)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha1_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_1].hash_length,
@@ -335,9 +405,9 @@ int s390_sha1(unsigned char *iv, unsigned char *input_data,
 			return rc;
 		rc = s390_sha1_sw(iv, input_data, input_length, output_data,
 				  message_part, running_length);
-		stats_increment(ICA_STATS_SHA1, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA1, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA1, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA1, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -347,6 +417,7 @@ int s390_sha224(unsigned char *iv, unsigned char *input_data,
 		unsigned int message_part, uint64_t *running_length)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha256_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_224].hash_length,
@@ -356,9 +427,9 @@ int s390_sha224(unsigned char *iv, unsigned char *input_data,
 			return rc;
 		rc = s390_sha224_sw(iv, input_data, input_length, output_data,
 				  message_part, running_length);
-		stats_increment(ICA_STATS_SHA224, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA224, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA224, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA224, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -368,6 +439,7 @@ int s390_sha256(unsigned char *iv, unsigned char *input_data,
 		unsigned int message_part, uint64_t *running_length)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha256_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_256].hash_length,
@@ -377,9 +449,9 @@ int s390_sha256(unsigned char *iv, unsigned char *input_data,
 			return rc;
 		rc = s390_sha256_sw(iv, input_data, input_length, output_data,
 				    message_part, running_length);
-		stats_increment(ICA_STATS_SHA256, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA256, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA256, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA256, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -389,6 +461,7 @@ int s390_sha384(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha512_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				 sha_constants[SHA_384].hash_length,
@@ -400,9 +473,9 @@ int s390_sha384(unsigned char *iv, unsigned char *input_data,
 		rc = s390_sha384_sw(iv, input_data, input_length, output_data,
 				    message_part, running_length_lo,
 				    running_length_hi);
-		stats_increment(ICA_STATS_SHA384, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA384, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA384, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA384, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -413,6 +486,7 @@ int s390_sha512(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha512_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_512].hash_length,
@@ -424,9 +498,9 @@ int s390_sha512(unsigned char *iv, unsigned char *input_data,
 		rc = s390_sha512_sw(iv, input_data, input_length, output_data,
 				    message_part, running_length_lo,
 				    running_length_hi);
-		stats_increment(ICA_STATS_SHA512, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA512, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -437,6 +511,7 @@ int s390_sha512_224(unsigned char *iv, unsigned char *input_data,
 		    uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha512_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_512_224].hash_length,
@@ -448,9 +523,9 @@ int s390_sha512_224(unsigned char *iv, unsigned char *input_data,
 		rc = s390_sha512_224_sw(iv, input_data, input_length, output_data,
 					message_part, running_length_lo,
 					running_length_hi);
-		stats_increment(ICA_STATS_SHA512_224, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512_224, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA512_224, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512_224, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -461,6 +536,7 @@ int s390_sha512_256(unsigned char *iv, unsigned char *input_data,
 		    uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 	if (sha512_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_512_256].hash_length,
@@ -472,9 +548,9 @@ int s390_sha512_256(unsigned char *iv, unsigned char *input_data,
 		rc = s390_sha512_256_sw(iv, input_data, input_length, output_data,
 					message_part, running_length_lo,
 					running_length_hi);
-		stats_increment(ICA_STATS_SHA512_256, ALGO_SW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512_256, ALGO_SW, ENCRYPT, input_length, start);
 	} else
-		stats_increment(ICA_STATS_SHA512_256, ALGO_HW, ENCRYPT);
+		stats_add(ICA_STATS_SHA512_256, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -484,13 +560,21 @@ int s390_sha3_224(unsigned char *iv, unsigned char *input_data,
 		unsigned int message_part, uint64_t *running_length)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_3_224].hash_length,
 				 message_part, running_length, NULL, SHA_3_224);
-	if (rc == 0)
-		stats_increment(ICA_STATS_SHA3_224, ALGO_HW, ENCRYPT);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  sha_constants[SHA_3_224].hash_length, message_part,
+				  running_length, NULL, SHA_3_224);
+		stats_add(ICA_STATS_SHA3_224, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHA3_224, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -500,13 +584,21 @@ int s390_sha3_256(unsigned char *iv, unsigned char *input_data,
 		unsigned int message_part, uint64_t *running_length)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_3_256].hash_length,
 				 message_part, running_length, NULL, SHA_3_256);
-	if (rc == 0)
-		stats_increment(ICA_STATS_SHA3_256, ALGO_HW, ENCRYPT);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  sha_constants[SHA_3_256].hash_length, message_part,
+				  running_length, NULL, SHA_3_256);
+		stats_add(ICA_STATS_SHA3_256, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHA3_256, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -517,14 +609,23 @@ int s390_sha3_384(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_3_384].hash_length,
 				 message_part, running_length_lo,
 				 running_length_hi, SHA_3_384);
-	if (rc == 0)
-		stats_increment(ICA_STATS_SHA3_384, ALGO_HW, ENCRYPT);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  sha_constants[SHA_3_384].hash_length, message_part,
+				  running_length_lo,
+				  running_length_hi, SHA_3_384);
+		stats_add(ICA_STATS_SHA3_384, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHA3_384, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -535,14 +636,23 @@ int s390_sha3_512(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data,
 				sha_constants[SHA_3_512].hash_length,
 				 message_part, running_length_lo,
 				 running_length_hi, SHA_3_512);
-	if (rc == 0)
-		stats_increment(ICA_STATS_SHA3_512, ALGO_HW, ENCRYPT);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  sha_constants[SHA_3_512].hash_length, message_part,
+				  running_length_lo,
+				  running_length_hi, SHA_3_512);
+		stats_add(ICA_STATS_SHA3_512, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHA3_512, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -553,13 +663,22 @@ int s390_shake_128(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data, output_length,
 				 message_part, running_length_lo,
 				 running_length_hi, SHAKE_128);
-	if (rc == 0)
-		stats_increment(ICA_STATS_SHAKE_128, ALGO_HW, ENCRYPT);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  output_length, message_part,
+				  running_length_lo,
+				  running_length_hi, SHAKE_128);
+		stats_add(ICA_STATS_SHAKE_128, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHAKE_128, ALGO_HW, ENCRYPT, input_length, start);
 
 	return rc;
 }
@@ -570,13 +689,741 @@ int s390_shake_256(unsigned char *iv, unsigned char *input_data,
 		uint64_t *running_length_hi)
 {
 	int rc = ENODEV;
+	uint64_t start = stats_clock();
 
 	if (sha3_switch)
 		rc = s390_sha_hw(iv, input_data, input_length, output_data, output_length,
 				 message_part, running_length_lo,
 				 running_length_hi, SHAKE_256);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha3_sw(iv, input_data, input_length, output_data,
+				  output_length, message_part,
+				  running_length_lo,
+				  running_length_hi, SHAKE_256);
+		stats_add(ICA_STATS_SHAKE_256, ALGO_SW, ENCRYPT, input_length, start);
+	} else
+		stats_add(ICA_STATS_SHAKE_256, ALGO_HW, ENCRYPT, input_length, start);
+
+	return rc;
+}
+
+static int s390_sha_multi_hw(unsigned int num,
+			     const unsigned char *const input_data[],
+			     const size_t input_length[],
+			     unsigned char *const output_data[],
+			     kimd_functions_t sha_function)
+{
+	const SHA_CONSTANTS *c = &sha_constants[sha_function];
+	unsigned char shabuff[200+16];
+	uint64_t bits_lo, bits_hi;
+	unsigned int i;
+
+	for (i = 0; i < num; i++) {
+		memcpy(shabuff, c->default_iv, c->vector_length);
+		if (!is_sha3(sha_function)) {
+			bits_lo = (uint64_t)input_length[i] << 3;
+			bits_hi = (uint64_t)input_length[i] >> (64 - 3);
+			if (c->block_length == 128) {
+				memcpy(shabuff + c->vector_length, &bits_hi,
+				       sizeof(bits_hi));
+				memcpy(shabuff + c->vector_length
+				       + sizeof(bits_hi), &bits_lo,
+				       sizeof(bits_lo));
+			} else {
+				memcpy(shabuff + c->vector_length, &bits_lo,
+				       sizeof(bits_lo));
+			}
+		}
+
+		/* KLMD processes the complete blocks as well */
+		if (s390_klmd(c->hw_function_code, shabuff, input_data[i],
+			      input_length[i]) < 0)
+			return EIO;
+
+		memcpy(output_data[i], shabuff, c->hash_length);
+	}
+
+	return 0;
+}
+
+static int s390_sha_multi_sw(unsigned int num,
+			     const unsigned char *const input_data[],
+			     const size_t input_length[],
+			     unsigned char *const output_data[],
+			     kimd_functions_t sha_function)
+{
+	SHA256_CTX ctx256;
+	SHA512_CTX ctx512;
+	unsigned int i;
+
+	if (is_sha3(sha_function)) {
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+		keccak_multi_sw(num, input_data, input_length,
+				sha_constants[sha_function].block_length,
+				SHA3_PAD, output_data,
+				sha_constants[sha_function].hash_length);
+		return 0;
+	}
+
+#ifdef ICA_FIPS
+	if ((fips & ICA_FIPS_MODE) && (!FIPS_mode()))
+		return EACCES;
+#endif /* ICA_FIPS */
+
+	for (i = 0; i < num; i++) {
+		if (sha_function == SHA_256) {
+			SHA256_Init(&ctx256);
+			SHA256_Update(&ctx256, input_data[i], input_length[i]);
+			SHA256_Final(output_data[i], &ctx256);
+		} else {
+			SHA512_Init(&ctx512);
+			SHA512_Update(&ctx512, input_data[i], input_length[i]);
+			SHA512_Final(output_data[i], &ctx512);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Hash num complete messages. Every message is processed by a single
+ * KLMD on a freshly initialized parameter block, or in software, and the
+ * batch is accounted in the statistics as a whole.
+ */
+int s390_sha_multi(unsigned int num, const unsigned char *const input_data[],
+		   const size_t input_length[],
+		   unsigned char *const output_data[],
+		   kimd_functions_t sha_function)
+{
+	int rc = ENODEV, hw;
+	unsigned int i, switch_on, stats_field;
+	uint64_t bytes = 0, start = stats_clock();
+
+	switch (sha_function) {
+	case SHA_256:
+		switch_on = sha256_switch;
+		stats_field = ICA_STATS_SHA256;
+		break;
+	case SHA_512:
+		switch_on = sha512_switch;
+		stats_field = ICA_STATS_SHA512;
+		break;
+	case SHA_3_256:
+		switch_on = sha3_switch;
+		stats_field = ICA_STATS_SHA3_256;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	for (i = 0; i < num; i++)
+		bytes += input_length[i];
+
+	hw = ALGO_HW;
+	if (switch_on)
+		rc = s390_sha_multi_hw(num, input_data, input_length,
+				       output_data, sha_function);
+	if (rc) {
+		if (!ica_fallbacks_enabled)
+			return rc;
+		rc = s390_sha_multi_sw(num, input_data, input_length,
+				       output_data, sha_function);
+		hw = ALGO_SW;
+	}
+
 	if (rc == 0)
-		stats_increment(ICA_STATS_SHAKE_256, ALGO_HW, ENCRYPT);
+		stats_add_batch(stats_field, hw, ENCRYPT, num, bytes, start);
 
 	return rc;
 }
+
+/* bound for the length of one s390_sha* call, which may take 32 bits only */
+#define HASH_MAX_RUN	0x40000000
+
+static int hash_part(struct ica_hash_ctx *ctx, const unsigned char *data,
+		     uint64_t data_length, unsigned int message_part,
+		     unsigned char *output_data)
+{
+	unsigned char *in = (unsigned char *)data;
+	uint64_t *lo = &ctx->running_length_lo;
+	uint64_t *hi = &ctx->running_length_hi;
+
+	switch (ctx->sha_function) {
+	case SHA_1:
+		return s390_sha1(ctx->iv, in, data_length, output_data,
+				 message_part, lo);
+	case SHA_224:
+		return s390_sha224(ctx->iv, in, data_length, output_data,
+				   message_part, lo);
+	case SHA_256:
+		return s390_sha256(ctx->iv, in, data_length, output_data,
+				   message_part, lo);
+	case SHA_384:
+		return s390_sha384(ctx->iv, in, data_length, output_data,
+				   message_part, lo, hi);
+	case SHA_512:
+		return s390_sha512(ctx->iv, in, data_length, output_data,
+				   message_part, lo, hi);
+	case SHA_3_224:
+		return s390_sha3_224(ctx->iv, in, data_length, output_data,
+				     message_part, lo);
+	case SHA_3_256:
+		return s390_sha3_256(ctx->iv, in, data_length, output_data,
+				     message_part, lo);
+	case SHA_3_384:
+		return s390_sha3_384(ctx->iv, in, data_length, output_data,
+				     message_part, lo, hi);
+	case SHA_3_512:
+		return s390_sha3_512(ctx->iv, in, data_length, output_data,
+				     message_part, lo, hi);
+	default:
+		return EINVAL;
+	}
+}
+
+int s390_hash_init(struct ica_hash_ctx *ctx, kimd_functions_t sha_function)
+{
+	switch (sha_function) {
+	case SHA_1:
+	case SHA_224:
+	case SHA_256:
+	case SHA_384:
+	case SHA_512:
+	case SHA_3_224:
+	case SHA_3_256:
+	case SHA_3_384:
+	case SHA_3_512:
+		break;
+	default:
+		return EINVAL;
+	}
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	ctx->sha_function = sha_function;
+	ctx->message_part = SHA_MSG_PART_FIRST;
+	return 0;
+}
+
+int s390_hash_update(struct ica_hash_ctx *ctx, const unsigned char *data,
+		     uint64_t data_length)
+{
+	unsigned int block_length =
+	    sha_constants[ctx->sha_function].block_length;
+	unsigned char scratch[SHA512_DIGEST_LENGTH];
+	uint64_t run;
+	unsigned int n;
+	int rc = 0;
+
+	/* complete a buffered block first */
+	if (ctx->buflen) {
+		n = block_length - ctx->buflen;
+		if (n > data_length)
+			n = data_length;
+		memcpy(ctx->buf + ctx->buflen, data, n);
+		ctx->buflen += n;
+		data += n;
+		data_length -= n;
+
+		if (ctx->buflen < block_length)
+			return 0;
+
+		rc = hash_part(ctx, ctx->buf, block_length, ctx->message_part,
+			       scratch);
+		if (rc)
+			goto out;
+		ctx->message_part = SHA_MSG_PART_MIDDLE;
+		ctx->buflen = 0;
+	}
+
+	/* complete blocks are hashed in place */
+	while (data_length >= block_length) {
+		run = data_length - data_length % block_length;
+		if (run > HASH_MAX_RUN)
+			run = HASH_MAX_RUN - HASH_MAX_RUN % block_length;
+
+		rc = hash_part(ctx, data, run, ctx->message_part, scratch);
+		if (rc)
+			goto out;
+		ctx->message_part = SHA_MSG_PART_MIDDLE;
+		data += run;
+		data_length -= run;
+	}
+
+	if (data_length) {
+		memcpy(ctx->buf, data, data_length);
+		ctx->buflen = data_length;
+	}
+
+out:
+	OPENSSL_cleanse(scratch, sizeof(scratch));
+	return rc;
+}
+
+int s390_hash_final(struct ica_hash_ctx *ctx, unsigned char *digest)
+{
+	unsigned int message_part;
+	int rc;
+
+	message_part = ctx->message_part == SHA_MSG_PART_FIRST ?
+		       SHA_MSG_PART_ONLY : SHA_MSG_PART_FINAL;
+
+	rc = hash_part(ctx, ctx->buf, ctx->buflen, message_part, digest);
+
+	/* the context is ready for the next message */
+	s390_hash_init(ctx, ctx->sha_function);
+	return rc;
+}
+
+#define HMAC_IPAD	0x36
+#define HMAC_OPAD	0x5c
+
+/* RFC 2104; for SHA-3 the block length is the rate (FIPS 202) */
+int s390_hmac_init(struct ica_hmac_ctx *ctx, kimd_functions_t sha_function,
+		   const unsigned char *key, size_t key_length)
+{
+	unsigned char block[200];
+	unsigned int block_length, i;
+	int rc;
+
+	rc = s390_hash_init(&ctx->inner_pad, sha_function);
+	if (rc)
+		return rc;
+	block_length = sha_constants[sha_function].block_length;
+
+	memset(block, 0, sizeof(block));
+	if (key_length > block_length) {
+		rc = s390_hash_update(&ctx->inner_pad, key, key_length);
+		if (rc == 0)
+			rc = s390_hash_final(&ctx->inner_pad, block);
+		if (rc)
+			goto out;
+	} else if (key_length) {
+		memcpy(block, key, key_length);
+	}
+
+	/* a complete block is hashed right away, leaving only the state */
+	memcpy(&ctx->outer_pad, &ctx->inner_pad, sizeof(ctx->outer_pad));
+	for (i = 0; i < block_length; i++)
+		block[i] ^= HMAC_IPAD;
+	rc = s390_hash_update(&ctx->inner_pad, block, block_length);
+	if (rc)
+		goto out;
+	for (i = 0; i < block_length; i++)
+		block[i] ^= HMAC_IPAD ^ HMAC_OPAD;
+	rc = s390_hash_update(&ctx->outer_pad, block, block_length);
+	if (rc)
+		goto out;
+
+	memcpy(&ctx->inner, &ctx->inner_pad, sizeof(ctx->inner));
+out:
+	OPENSSL_cleanse(block, sizeof(block));
+	return rc;
+}
+
+int s390_hmac_final(struct ica_hmac_ctx *ctx, unsigned char *mac)
+{
+	struct ica_hash_ctx outer;
+	unsigned char digest[SHA512_DIGEST_LENGTH];
+	int rc;
+
+	rc = s390_hash_final(&ctx->inner, digest);
+	if (rc)
+		goto out;
+
+	memcpy(&outer, &ctx->outer_pad, sizeof(outer));
+	rc = s390_hash_update(&outer, digest,
+			      sha_constants[outer.sha_function].hash_length);
+	if (rc == 0)
+		rc = s390_hash_final(&outer, mac);
+	OPENSSL_cleanse(&outer, sizeof(outer));
+out:
+	/* the context is ready for the next message */
+	memcpy(&ctx->inner, &ctx->inner_pad, sizeof(ctx->inner));
+	OPENSSL_cleanse(digest, sizeof(digest));
+	return rc;
+}
+
+static stats_fields_t sha_stats_field(kimd_functions_t sha_function)
+{
+	switch (sha_function) {
+	case SHA_1:
+		return ICA_STATS_SHA1;
+	case SHA_224:
+		return ICA_STATS_SHA224;
+	case SHA_256:
+		return ICA_STATS_SHA256;
+	case SHA_384:
+		return ICA_STATS_SHA384;
+	case SHA_512:
+		return ICA_STATS_SHA512;
+	case SHA_3_224:
+		return ICA_STATS_SHA3_224;
+	case SHA_3_256:
+		return ICA_STATS_SHA3_256;
+	case SHA_3_384:
+		return ICA_STATS_SHA3_384;
+	default:
+		return ICA_STATS_SHA3_512;
+	}
+}
+
+/*
+ * count PBKDF2 iterations with one KLMD per hash: the message of the
+ * inner and of the outer hash is just u, after the key block already
+ * contained in the HMAC states.
+ */
+static int pbkdf2_iterate_hw(const struct ica_hmac_ctx *hmac,
+			     unsigned char *u, unsigned char *t,
+			     uint64_t count)
+{
+	kimd_functions_t sha_function = hmac->inner_pad.sha_function;
+	const SHA_CONSTANTS *c = &sha_constants[sha_function];
+	const unsigned char *iv;
+	unsigned char shabuff[200+16];
+	uint64_t bits_lo, bits_hi = 0, n;
+	unsigned int i, j;
+
+	bits_lo = (uint64_t)(c->block_length + c->hash_length) << 3;
+
+	for (n = 0; n < count; n++) {
+		for (i = 0; i < 2; i++) {
+			iv = i ? hmac->outer_pad.iv : hmac->inner_pad.iv;
+			memcpy(shabuff, iv, c->vector_length);
+			if (!is_sha3(sha_function)) {
+				if (c->block_length == 128) {
+					memcpy(shabuff + c->vector_length,
+					       &bits_hi, sizeof(bits_hi));
+					memcpy(shabuff + c->vector_length
+					       + sizeof(bits_hi), &bits_lo,
+					       sizeof(bits_lo));
+				} else {
+					memcpy(shabuff + c->vector_length,
+					       &bits_lo, sizeof(bits_lo));
+				}
+			}
+			if (s390_klmd(c->hw_function_code, shabuff, u,
+				      c->hash_length) < 0) {
+				OPENSSL_cleanse(shabuff, sizeof(shabuff));
+				return EIO;
+			}
+			memcpy(u, shabuff, c->hash_length);
+		}
+		for (j = 0; j < c->hash_length; j++)
+			t[j] ^= u[j];
+	}
+
+	OPENSSL_cleanse(shabuff, sizeof(shabuff));
+	return 0;
+}
+
+/* count PBKDF2 iterations through the generic HMAC context */
+static int pbkdf2_iterate(struct ica_hmac_ctx *hmac, unsigned char *u,
+			  unsigned char *t, uint64_t count)
+{
+	unsigned int hash_length =
+	    sha_constants[hmac->inner_pad.sha_function].hash_length;
+	unsigned int j;
+	uint64_t n;
+	int rc;
+
+	for (n = 0; n < count; n++) {
+		rc = s390_hash_update(&hmac->inner, u, hash_length);
+		if (rc == 0)
+			rc = s390_hmac_final(hmac, u);
+		if (rc)
+			return rc;
+		for (j = 0; j < hash_length; j++)
+			t[j] ^= u[j];
+	}
+
+	return 0;
+}
+
+/* PBKDF2 (RFC 8018) with HMAC */
+int s390_pbkdf2(kimd_functions_t sha_function, const unsigned char *password,
+		size_t password_length, const unsigned char *salt,
+		size_t salt_length, uint64_t iterations, unsigned char *dk,
+		size_t dk_length)
+{
+	struct ica_hmac_ctx hmac;
+	unsigned char u[KECCAK_WAYS][SHA512_DIGEST_LENGTH];
+	unsigned char t[KECCAK_WAYS][SHA512_DIGEST_LENGTH];
+	unsigned char *up[KECCAK_WAYS], *tp[KECCAK_WAYS], index[4];
+	unsigned int hash_length, lanes, num, w;
+	uint32_t block, blocks;
+	uint64_t start;
+	size_t n;
+	int rc, hw;
+
+	rc = s390_hmac_init(&hmac, sha_function, password, password_length);
+	if (rc)
+		goto out;
+
+	hash_length = sha_constants[sha_function].hash_length;
+	blocks = (dk_length + hash_length - 1) / hash_length;
+
+	hw = *s390_kimd_functions[sha_function].enabled;
+#ifdef ICA_FIPS
+	/* the software SHA-3 is not part of the module boundary */
+	lanes = !hw && is_sha3(sha_function) && ica_fallbacks_enabled
+		&& !(fips & ICA_FIPS_MODE) ? KECCAK_WAYS : 1;
+#else
+	lanes = !hw && is_sha3(sha_function) && ica_fallbacks_enabled ?
+		KECCAK_WAYS : 1;
+#endif /* ICA_FIPS */
+
+	for (w = 0; w < KECCAK_WAYS; w++) {
+		up[w] = u[w];
+		tp[w] = t[w];
+	}
+
+	for (block = 1; block <= blocks; block += num) {
+		num = blocks - block + 1 < lanes ? blocks - block + 1 : lanes;
+
+		/* U_1 = HMAC(P, S || INT(i)) */
+		for (w = 0; w < num; w++) {
+			index[0] = (block + w) >> 24;
+			index[1] = (block + w) >> 16;
+			index[2] = (block + w) >> 8;
+			index[3] = (block + w);
+			rc = s390_hash_update(&hmac.inner, salt, salt_length);
+			if (rc == 0)
+				rc = s390_hash_update(&hmac.inner, index,
+						      sizeof(index));
+			if (rc == 0)
+				rc = s390_hmac_final(&hmac, u[w]);
+			if (rc)
+				goto out;
+			memcpy(t[w], u[w], hash_length);
+		}
+
+		start = stats_clock();
+		if (lanes > 1) {
+			keccak_hmac_iterate_x4_sw(hmac.inner_pad.iv,
+				hmac.outer_pad.iv,
+				sha_constants[sha_function].block_length,
+				hash_length, num, up, tp, iterations - 1);
+			stats_add_batch(sha_stats_field(sha_function),
+					ALGO_SW, ENCRYPT,
+					2 * num * (iterations - 1),
+					2 * num * (iterations - 1) * hash_length,
+					start);
+		} else if (hw) {
+			rc = pbkdf2_iterate_hw(&hmac, u[0], t[0],
+					       iterations - 1);
+			if (rc)
+				goto out;
+			stats_add_batch(sha_stats_field(sha_function),
+					ALGO_HW, ENCRYPT, 2 * (iterations - 1),
+					2 * (iterations - 1) * hash_length,
+					start);
+		} else {
+			rc = pbkdf2_iterate(&hmac, u[0], t[0], iterations - 1);
+			if (rc)
+				goto out;
+		}
+
+		for (w = 0; w < num; w++) {
+			n = (size_t)(block + w - 1) * hash_length;
+			memcpy(dk + n, t[w], dk_length - n < hash_length ?
+			       dk_length - n : hash_length);
+		}
+	}
+
+out:
+	OPENSSL_cleanse(&hmac, sizeof(hmac));
+	OPENSSL_cleanse(u, sizeof(u));
+	OPENSSL_cleanse(t, sizeof(t));
+	return rc;
+}
+
+/* HKDF (RFC 5869) */
+int s390_hkdf(kimd_functions_t sha_function, const unsigned char *ikm,
+	      size_t ikm_length, const unsigned char *salt, size_t salt_length,
+	      const unsigned char *info, size_t info_length,
+	      unsigned char *okm, size_t okm_length)
+{
+	struct ica_hmac_ctx hmac;
+	unsigned char prk[SHA512_DIGEST_LENGTH], t[SHA512_DIGEST_LENGTH];
+	unsigned int hash_length = sha_constants[sha_function].hash_length;
+	unsigned char counter;
+	size_t n, len;
+	int rc;
+
+	/* extract, the default salt is a string of hash_length zeros */
+	if (salt == NULL || salt_length == 0) {
+		memset(prk, 0, sizeof(prk));
+		rc = s390_hmac_init(&hmac, sha_function, prk, hash_length);
+	} else {
+		rc = s390_hmac_init(&hmac, sha_function, salt, salt_length);
+	}
+	if (rc == 0)
+		rc = s390_hash_update(&hmac.inner, ikm, ikm_length);
+	if (rc == 0)
+		rc = s390_hmac_final(&hmac, prk);
+
+	/* expand, all blocks use the pad states of the same PRK */
+	if (rc == 0)
+		rc = s390_hmac_init(&hmac, sha_function, prk, hash_length);
+
+	for (n = 0, counter = 1; rc == 0 && n < okm_length; counter++) {
+		if (counter > 1)
+			rc = s390_hash_update(&hmac.inner, t, hash_length);
+		if (rc == 0)
+			rc = s390_hash_update(&hmac.inner, info, info_length);
+		if (rc == 0)
+			rc = s390_hash_update(&hmac.inner, &counter, 1);
+		if (rc == 0)
+			rc = s390_hmac_final(&hmac, t);
+		if (rc)
+			break;
+
+		len = okm_length - n < hash_length ? okm_length - n : hash_length;
+		memcpy(okm + n, t, len);
+		n += len;
+	}
+
+	OPENSSL_cleanse(&hmac, sizeof(hmac));
+	OPENSSL_cleanse(prk, sizeof(prk));
+	OPENSSL_cleanse(t, sizeof(t));
+	return rc;
+}
+
+int s390_xof_init(struct ica_xof_ctx *ctx, kimd_functions_t sha_function)
+{
+	if (sha_function != SHAKE_128 && sha_function != SHAKE_256)
+		return EINVAL;
+
+	OPENSSL_cleanse(ctx, sizeof(*ctx));
+	ctx->sha_function = sha_function;
+	ctx->rate = sha_constants[sha_function].block_length;
+	ctx->hw_function_code = sha_constants[sha_function].hw_function_code;
+	ctx->hw = *s390_kimd_functions[sha_function].enabled;
+	ctx->pad = SHAKE_PAD;
+
+	if (!ctx->hw) {
+		if (!ica_fallbacks_enabled)
+			return ENODEV;
+#ifdef ICA_FIPS
+		if (fips & ICA_FIPS_MODE)
+			return EACCES;
+#endif /* ICA_FIPS */
+	}
+
+	return 0;
+}
+
+/* absorb complete blocks, a block of zeros just permutes the state */
+static int xof_blocks(struct ica_xof_ctx *ctx, const unsigned char *in,
+		      uint64_t len)
+{
+	uint64_t run;
+
+	if (!ctx->hw) {
+		keccak_absorb_sw(ctx->state, in, len, ctx->rate);
+		return 0;
+	}
+
+	while (len) {
+		run = len;
+		if (run > HASH_MAX_RUN)
+			run = HASH_MAX_RUN - HASH_MAX_RUN % ctx->rate;
+		if (s390_kimd(ctx->hw_function_code, ctx->state, in, run) < 0)
+			return EIO;
+		in += run;
+		len -= run;
+	}
+
+	return 0;
+}
+
+int s390_xof_absorb(struct ica_xof_ctx *ctx, const unsigned char *data,
+		    uint64_t data_length)
+{
+	uint64_t run;
+	unsigned int n;
+	int rc;
+
+	if (ctx->squeezing)
+		return EINVAL;
+
+	ctx->absorbed += data_length;
+
+	if (ctx->buflen) {
+		n = ctx->rate - ctx->buflen;
+		if (n > data_length)
+			n = data_length;
+		memcpy(ctx->buf + ctx->buflen, data, n);
+		ctx->buflen += n;
+		data += n;
+		data_length -= n;
+
+		if (ctx->buflen < ctx->rate)
+			return 0;
+
+		rc = xof_blocks(ctx, ctx->buf, ctx->rate);
+		if (rc)
+			return rc;
+		ctx->buflen = 0;
+	}
+
+	run = data_length - data_length % ctx->rate;
+	if (run) {
+		rc = xof_blocks(ctx, data, run);
+		if (rc)
+			return rc;
+	}
+
+	if (data_length - run) {
+		memcpy(ctx->buf, data + run, data_length - run);
+		ctx->buflen = data_length - run;
+	}
+
+	return 0;
+}
+
+int s390_xof_squeeze(struct ica_xof_ctx *ctx, unsigned char *output,
+		     size_t output_length)
+{
+	static const unsigned char zeros[200];
+	size_t n;
+	int rc;
+
+	/* pad and absorb the last block, its state is the first output */
+	if (!ctx->squeezing) {
+		memset(ctx->buf + ctx->buflen, 0, ctx->rate - ctx->buflen);
+		ctx->buf[ctx->buflen] ^= ctx->pad;
+		ctx->buf[ctx->rate - 1] ^= 0x80;
+		rc = xof_blocks(ctx, ctx->buf, ctx->rate);
+		OPENSSL_cleanse(ctx->buf, sizeof(ctx->buf));
+		if (rc)
+			return rc;
+
+		ctx->squeezing = 1;
+		ctx->buflen = 0;
+	}
+
+	while (output_length) {
+		if (ctx->buflen == ctx->rate) {
+			rc = xof_blocks(ctx, zeros, ctx->rate);
+			if (rc)
+				return rc;
+			ctx->buflen = 0;
+		}
+
+		n = ctx->rate - ctx->buflen;
+		if (n > output_length)
+			n = output_length;
+		memcpy(output, ctx->state + ctx->buflen, n);
+		ctx->buflen += n;
+		output += n;
+		output_length -= n;
+	}
+
+	return 0;
+}
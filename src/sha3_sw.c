@@ -0,0 +1,415 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <openssl/crypto.h>
+
+#include "sha3_sw.h"
+
+static const uint64_t keccak_rc[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL,
+};
+
+#define ROL64(x, n)	(((x) << (n)) | ((x) >> (64 - (n))))
+
+/*
+ * One round on the lanes A[x + 5y]: theta, rho and pi into B, then chi
+ * back into A and iota. All rotations and lane moves are resolved at
+ * compile time. The same code serves uint64_t and keccak_x4_t lanes.
+ */
+#define KECCAK_ROUND(rc)						\
+	C0 = A[0] ^ A[5] ^ A[10] ^ A[15] ^ A[20];			\
+	C1 = A[1] ^ A[6] ^ A[11] ^ A[16] ^ A[21];			\
+	C2 = A[2] ^ A[7] ^ A[12] ^ A[17] ^ A[22];			\
+	C3 = A[3] ^ A[8] ^ A[13] ^ A[18] ^ A[23];			\
+	C4 = A[4] ^ A[9] ^ A[14] ^ A[19] ^ A[24];			\
+	D0 = C4 ^ ROL64(C1, 1);						\
+	D1 = C0 ^ ROL64(C2, 1);						\
+	D2 = C1 ^ ROL64(C3, 1);						\
+	D3 = C2 ^ ROL64(C4, 1);						\
+	D4 = C3 ^ ROL64(C0, 1);						\
+	B0 = (A[0] ^ D0);						\
+	B1 = ROL64(A[6] ^ D1, 44);					\
+	B2 = ROL64(A[12] ^ D2, 43);					\
+	B3 = ROL64(A[18] ^ D3, 21);					\
+	B4 = ROL64(A[24] ^ D4, 14);					\
+	B5 = ROL64(A[3] ^ D3, 28);					\
+	B6 = ROL64(A[9] ^ D4, 20);					\
+	B7 = ROL64(A[10] ^ D0, 3);					\
+	B8 = ROL64(A[16] ^ D1, 45);					\
+	B9 = ROL64(A[22] ^ D2, 61);					\
+	B10 = ROL64(A[1] ^ D1, 1);					\
+	B11 = ROL64(A[7] ^ D2, 6);					\
+	B12 = ROL64(A[13] ^ D3, 25);					\
+	B13 = ROL64(A[19] ^ D4, 8);					\
+	B14 = ROL64(A[20] ^ D0, 18);					\
+	B15 = ROL64(A[4] ^ D4, 27);					\
+	B16 = ROL64(A[5] ^ D0, 36);					\
+	B17 = ROL64(A[11] ^ D1, 10);					\
+	B18 = ROL64(A[17] ^ D2, 15);					\
+	B19 = ROL64(A[23] ^ D3, 56);					\
+	B20 = ROL64(A[2] ^ D2, 62);					\
+	B21 = ROL64(A[8] ^ D3, 55);					\
+	B22 = ROL64(A[14] ^ D4, 39);					\
+	B23 = ROL64(A[15] ^ D0, 41);					\
+	B24 = ROL64(A[21] ^ D1, 2);					\
+	A[0] = B0 ^ (~B1 & B2);						\
+	A[1] = B1 ^ (~B2 & B3);						\
+	A[2] = B2 ^ (~B3 & B4);						\
+	A[3] = B3 ^ (~B4 & B0);						\
+	A[4] = B4 ^ (~B0 & B1);						\
+	A[5] = B5 ^ (~B6 & B7);						\
+	A[6] = B6 ^ (~B7 & B8);						\
+	A[7] = B7 ^ (~B8 & B9);						\
+	A[8] = B8 ^ (~B9 & B5);						\
+	A[9] = B9 ^ (~B5 & B6);						\
+	A[10] = B10 ^ (~B11 & B12);					\
+	A[11] = B11 ^ (~B12 & B13);					\
+	A[12] = B12 ^ (~B13 & B14);					\
+	A[13] = B13 ^ (~B14 & B10);					\
+	A[14] = B14 ^ (~B10 & B11);					\
+	A[15] = B15 ^ (~B16 & B17);					\
+	A[16] = B16 ^ (~B17 & B18);					\
+	A[17] = B17 ^ (~B18 & B19);					\
+	A[18] = B18 ^ (~B19 & B15);					\
+	A[19] = B19 ^ (~B15 & B16);					\
+	A[20] = B20 ^ (~B21 & B22);					\
+	A[21] = B21 ^ (~B22 & B23);					\
+	A[22] = B22 ^ (~B23 & B24);					\
+	A[23] = B23 ^ (~B24 & B20);					\
+	A[24] = B24 ^ (~B20 & B21);					\
+	A[0] ^= (rc);
+
+#define KECCAK_PERMUTE(T)						\
+	T B0, B1, B2, B3, B4, B5, B6, B7, B8, B9, B10, B11, B12;	\
+	T B13, B14, B15, B16, B17, B18, B19, B20, B21, B22, B23, B24;	\
+	T C0, C1, C2, C3, C4, D0, D1, D2, D3, D4;			\
+	unsigned int i;							\
+									\
+	for (i = 0; i < 24; i++) {					\
+		KECCAK_ROUND(keccak_rc[i])				\
+	}
+
+void keccak_f1600_sw(uint64_t A[25])
+{
+	KECCAK_PERMUTE(uint64_t)
+}
+
+void keccak_f1600_x4_sw(keccak_x4_t A[25])
+{
+	KECCAK_PERMUTE(keccak_x4_t)
+}
+
+static inline uint64_t load64_le(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline void store64_le(unsigned char *p, uint64_t v)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	memcpy(p, &v, sizeof(v));
+}
+
+static void keccak_load(uint64_t A[25],
+			const unsigned char state[KECCAK_STATE_LEN])
+{
+	unsigned int j;
+
+	for (j = 0; j < 25; j++)
+		A[j] = load64_le(state + 8 * j);
+}
+
+static void keccak_store(unsigned char state[KECCAK_STATE_LEN],
+			 const uint64_t A[25])
+{
+	unsigned int j;
+
+	for (j = 0; j < 25; j++)
+		store64_le(state + 8 * j, A[j]);
+}
+
+static void keccak_xor_block(uint64_t A[25], const unsigned char *block,
+			     unsigned int rate)
+{
+	unsigned int j;
+
+	for (j = 0; j < rate / 8; j++)
+		A[j] ^= load64_le(block + 8 * j);
+}
+
+/* last receives the final, padded block of a message with len % rate bytes */
+static void keccak_pad_block(unsigned char *last, const unsigned char *in,
+			     size_t len, unsigned int rate, unsigned char pad)
+{
+	if (len)
+		memcpy(last, in, len);
+	memset(last + len, 0, rate - len);
+	last[len] ^= pad;
+	last[rate - 1] ^= 0x80;
+}
+
+static void keccak_squeeze(uint64_t A[25], unsigned int rate,
+			   unsigned char *out, size_t outlen)
+{
+	unsigned char block[KECCAK_STATE_LEN];
+	size_t n;
+
+	for (;;) {
+		n = outlen < rate ? outlen : rate;
+		keccak_store(block, A);
+		memcpy(out, block, n);
+		out += n;
+		outlen -= n;
+		if (outlen == 0)
+			break;
+		keccak_f1600_sw(A);
+	}
+
+	OPENSSL_cleanse(block, sizeof(block));
+}
+
+static void keccak_absorb(uint64_t A[25], const unsigned char *in,
+			  size_t len, unsigned int rate)
+{
+	for (; len >= rate; len -= rate, in += rate) {
+		keccak_xor_block(A, in, rate);
+		keccak_f1600_sw(A);
+	}
+}
+
+static void keccak_final(uint64_t A[25], const unsigned char *in,
+			 size_t len, unsigned int rate, unsigned char pad,
+			 unsigned char *out, size_t outlen)
+{
+	unsigned char last[KECCAK_STATE_LEN];
+	size_t full = len - len % rate;
+
+	keccak_absorb(A, in, full, rate);
+
+	keccak_pad_block(last, in + full, len - full, rate, pad);
+	keccak_xor_block(A, last, rate);
+	keccak_f1600_sw(A);
+
+	keccak_squeeze(A, rate, out, outlen);
+
+	OPENSSL_cleanse(last, sizeof(last));
+}
+
+void keccak_absorb_sw(unsigned char state[KECCAK_STATE_LEN],
+		      const unsigned char *in, size_t len, unsigned int rate)
+{
+	uint64_t A[25];
+
+	if (len == 0)
+		return;
+
+	keccak_load(A, state);
+	keccak_absorb(A, in, len, rate);
+	keccak_store(state, A);
+
+	OPENSSL_cleanse(A, sizeof(A));
+}
+
+void keccak_final_sw(unsigned char state[KECCAK_STATE_LEN],
+		     const unsigned char *in, size_t len, unsigned int rate,
+		     unsigned char pad, unsigned char *out, size_t outlen)
+{
+	uint64_t A[25];
+
+	keccak_load(A, state);
+	keccak_final(A, in, len, rate, pad, out, outlen);
+	keccak_store(state, A);
+
+	OPENSSL_cleanse(A, sizeof(A));
+}
+
+void keccak_sw(const unsigned char *in, size_t len, unsigned int rate,
+	       unsigned char pad, unsigned char *out, size_t outlen)
+{
+	uint64_t A[25];
+
+	memset(A, 0, sizeof(A));
+	keccak_final(A, in, len, rate, pad, out, outlen);
+
+	OPENSSL_cleanse(A, sizeof(A));
+}
+
+void keccak_multi_sw(unsigned int num, const unsigned char *const in[],
+		     const size_t len[], unsigned int rate, unsigned char pad,
+		     unsigned char *const out[], size_t outlen)
+{
+	keccak_x4_t A[25];
+	uint64_t lane[25];
+	unsigned char last[KECCAK_WAYS][KECCAK_STATE_LEN];
+	const unsigned char *block;
+	size_t blocks[KECCAK_WAYS], common, k;
+	unsigned int i, j, w, n;
+
+	for (i = 0; i < num; i += n) {
+		n = num - i < KECCAK_WAYS ? num - i : KECCAK_WAYS;
+		if (n == 1) {
+			keccak_sw(in[i], len[i], rate, pad, out[i], outlen);
+			continue;
+		}
+
+		common = SIZE_MAX;
+		for (w = 0; w < n; w++) {
+			blocks[w] = len[i + w] / rate;
+			keccak_pad_block(last[w], in[i + w] + blocks[w] * rate,
+					 len[i + w] % rate, rate, pad);
+			if (blocks[w] < common)
+				common = blocks[w];
+		}
+
+		/*
+		 * The messages run in lockstep up to and including the last
+		 * block of the shortest one. Unused ways just permute zeros.
+		 */
+		memset(A, 0, sizeof(A));
+		for (k = 0; k <= common; k++) {
+			for (w = 0; w < n; w++) {
+				block = k < blocks[w] ?
+					in[i + w] + k * rate : last[w];
+				for (j = 0; j < rate / 8; j++)
+					A[j][w] ^= load64_le(block + 8 * j);
+			}
+			keccak_f1600_x4_sw(A);
+		}
+
+		/* longer messages are finished one at a time */
+		for (w = 0; w < n; w++) {
+			for (j = 0; j < 25; j++)
+				lane[j] = A[j][w];
+			for (k = common + 1; k <= blocks[w]; k++) {
+				block = k < blocks[w] ?
+					in[i + w] + k * rate : last[w];
+				keccak_xor_block(lane, block, rate);
+				keccak_f1600_sw(lane);
+			}
+			keccak_squeeze(lane, rate, out[i + w], outlen);
+		}
+	}
+
+	OPENSSL_cleanse(A, sizeof(A));
+	OPENSSL_cleanse(lane, sizeof(lane));
+	OPENSSL_cleanse(last, sizeof(last));
+}
+
+static void lanes_from_bytes(keccak_x4_t *lanes, unsigned int w,
+			     const unsigned char *in, unsigned int len)
+{
+	unsigned char tmp[8];
+	unsigned int j;
+
+	for (j = 0; j < len / 8; j++)
+		lanes[j][w] = load64_le(in + 8 * j);
+	if (len % 8) {
+		memset(tmp, 0, sizeof(tmp));
+		memcpy(tmp, in + 8 * j, len % 8);
+		lanes[j][w] = load64_le(tmp);
+	}
+}
+
+static void lanes_to_bytes(unsigned char *out, const keccak_x4_t *lanes,
+			   unsigned int w, unsigned int len)
+{
+	unsigned char tmp[8];
+	unsigned int j;
+
+	for (j = 0; j < len / 8; j++)
+		store64_le(out + 8 * j, lanes[j][w]);
+	if (len % 8) {
+		store64_le(tmp, lanes[j][w]);
+		memcpy(out + 8 * j, tmp, len % 8);
+	}
+}
+
+void keccak_hmac_iterate_x4_sw(const unsigned char inner[KECCAK_STATE_LEN],
+			       const unsigned char outer[KECCAK_STATE_LEN],
+			       unsigned int rate, unsigned int hashlen,
+			       unsigned int num, unsigned char *const u[],
+			       unsigned char *const t[], uint64_t count)
+{
+	const keccak_x4_t zero = { 0 };
+	keccak_x4_t A[25], I[25], O[25], U[8], T[8];
+	unsigned int full = hashlen / 8, lanes = (hashlen + 7) / 8, j, w;
+	uint64_t st[25], mask, pad;
+	uint64_t n;
+
+	/* the padding of the one block messages is part of the start states */
+	mask = hashlen % 8 ? ((uint64_t)1 << (8 * (hashlen % 8))) - 1 : ~0ULL;
+	pad = (uint64_t)SHA3_PAD << (8 * (hashlen % 8));
+
+	keccak_load(st, inner);
+	for (j = 0; j < 25; j++)
+		I[j] = zero + st[j];
+	keccak_load(st, outer);
+	for (j = 0; j < 25; j++)
+		O[j] = zero + st[j];
+	I[full] ^= pad;
+	O[full] ^= pad;
+	I[rate / 8 - 1] ^= 0x8000000000000000ULL;
+	O[rate / 8 - 1] ^= 0x8000000000000000ULL;
+
+	memset(U, 0, sizeof(U));
+	memset(T, 0, sizeof(T));
+	for (w = 0; w < num; w++) {
+		lanes_from_bytes(U, w, u[w], hashlen);
+		lanes_from_bytes(T, w, t[w], hashlen);
+	}
+
+	for (n = 0; n < count; n++) {
+		memcpy(A, I, sizeof(A));
+		for (j = 0; j < lanes; j++)
+			A[j] ^= U[j];
+		keccak_f1600_x4_sw(A);
+		for (j = 0; j < lanes; j++)
+			U[j] = A[j];
+		U[lanes - 1] &= mask;
+
+		memcpy(A, O, sizeof(A));
+		for (j = 0; j < lanes; j++)
+			A[j] ^= U[j];
+		keccak_f1600_x4_sw(A);
+		for (j = 0; j < lanes; j++) {
+			U[j] = A[j];
+			T[j] ^= A[j];
+		}
+		U[lanes - 1] &= mask;
+		T[lanes - 1] &= mask;
+	}
+
+	for (w = 0; w < num; w++) {
+		lanes_to_bytes(u[w], U, w, hashlen);
+		lanes_to_bytes(t[w], T, w, hashlen);
+	}
+
+	OPENSSL_cleanse(A, sizeof(A));
+	OPENSSL_cleanse(I, sizeof(I));
+	OPENSSL_cleanse(O, sizeof(O));
+	OPENSSL_cleanse(U, sizeof(U));
+	OPENSSL_cleanse(T, sizeof(T));
+	OPENSSL_cleanse(st, sizeof(st));
+}
@@ -0,0 +1,196 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+
+#include "worker_pool.h"
+
+struct worker_job {
+	void *(*fn)(void *);
+	void *arg;
+	unsigned int wanted;	/* pool threads still to join in */
+	unsigned int active;	/* pool threads running fn */
+	unsigned int fork_gen;
+	struct worker_job *next;
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* all of the following are protected by pool_lock */
+static struct worker_job *pool_jobs;
+static pthread_t pool_tid[WORKER_POOL_MAX_THREADS];
+static unsigned int pool_threads;
+static unsigned int pool_busy;
+static unsigned int pool_wanted;
+static unsigned int pool_fork_gen;
+static int pool_exit;
+
+static void pool_unlink(struct worker_job *job)
+{
+	struct worker_job **p;
+
+	for (p = &pool_jobs; *p != NULL; p = &(*p)->next) {
+		if (*p == job) {
+			*p = job->next;
+			return;
+		}
+	}
+}
+
+static void *pool_thread(void *unused)
+{
+	struct worker_job *job;
+
+	(void)unused;
+
+	pthread_mutex_lock(&pool_lock);
+	for (;;) {
+		while (pool_jobs == NULL && !pool_exit)
+			pthread_cond_wait(&pool_work, &pool_lock);
+		if (pool_exit)
+			break;
+
+		job = pool_jobs;
+		if (--job->wanted == 0)
+			pool_jobs = job->next;
+		pool_wanted--;
+		job->active++;
+		pool_busy++;
+		pthread_mutex_unlock(&pool_lock);
+
+		job->fn(job->arg);
+
+		pthread_mutex_lock(&pool_lock);
+		pool_busy--;
+		if (--job->active == 0)
+			pthread_cond_broadcast(&pool_done);
+	}
+	pthread_mutex_unlock(&pool_lock);
+
+	return NULL;
+}
+
+static void pool_atfork_prepare(void)
+{
+	pthread_mutex_lock(&pool_lock);
+}
+
+static void pool_atfork_parent(void)
+{
+	pthread_mutex_unlock(&pool_lock);
+}
+
+/*
+ * Only the forking thread exists in the child. Jobs of the parent are
+ * abandoned, the pool starts over with new threads.
+ */
+static void pool_atfork_child(void)
+{
+	pool_jobs = NULL;
+	pool_threads = 0;
+	pool_busy = 0;
+	pool_wanted = 0;
+	pool_fork_gen++;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static void pool_init(void)
+{
+	pthread_atfork(pool_atfork_prepare, pool_atfork_parent,
+		       pool_atfork_child);
+}
+
+/* called with pool_lock held */
+static void pool_grow(void)
+{
+	sigset_t set, oldset;
+
+	/* signals of the application are not delivered to pool threads */
+	sigfillset(&set);
+	pthread_sigmask(SIG_SETMASK, &set, &oldset);
+
+	while (pool_threads < pool_busy + pool_wanted &&
+	       pool_threads < WORKER_POOL_MAX_THREADS) {
+		if (pthread_create(&pool_tid[pool_threads], NULL, pool_thread,
+				   NULL))
+			break;
+		pool_threads++;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+}
+
+void worker_pool_run(void *(*fn)(void *), void *arg, unsigned int workers)
+{
+	struct worker_job job, **p;
+
+	if (workers <= 1) {
+		fn(arg);
+		return;
+	}
+
+	pthread_once(&pool_once, pool_init);
+
+	job.fn = fn;
+	job.arg = arg;
+	job.wanted = workers - 1 < WORKER_POOL_MAX_THREADS ?
+		     workers - 1 : WORKER_POOL_MAX_THREADS;
+	job.active = 0;
+	job.next = NULL;
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool_exit) {
+		pthread_mutex_unlock(&pool_lock);
+		fn(arg);
+		return;
+	}
+	job.fork_gen = pool_fork_gen;
+	for (p = &pool_jobs; *p != NULL; p = &(*p)->next)
+		;
+	*p = &job;
+	pool_wanted += job.wanted;
+	pool_grow();
+	pthread_cond_broadcast(&pool_work);
+	pthread_mutex_unlock(&pool_lock);
+
+	/* the calling thread is one of the workers */
+	fn(arg);
+
+	pthread_mutex_lock(&pool_lock);
+	/* the pool threads of the parent do not exist in a child */
+	if (job.fork_gen == pool_fork_gen) {
+		if (job.wanted) {
+			/* no work is left for threads that did not join in */
+			pool_wanted -= job.wanted;
+			job.wanted = 0;
+			pool_unlink(&job);
+		}
+		while (job.active)
+			pthread_cond_wait(&pool_done, &pool_lock);
+	}
+	pthread_mutex_unlock(&pool_lock);
+}
+
+void worker_pool_fini(void)
+{
+	unsigned int i, threads;
+
+	pthread_mutex_lock(&pool_lock);
+	pool_exit = 1;
+	threads = pool_threads;
+	pthread_cond_broadcast(&pool_work);
+	pthread_mutex_unlock(&pool_lock);
+
+	for (i = 0; i < threads; i++)
+		pthread_join(pool_tid[i], NULL);
+}
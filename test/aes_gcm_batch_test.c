@@ -0,0 +1,178 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define BATCH_SIZE	64
+#define MAX_LEN		1500
+#define AAD_LEN		20
+#define TAG_LEN		16
+
+static const unsigned int key_lengths[] = {
+	AES_KEY_LEN128, AES_KEY_LEN192, AES_KEY_LEN256,
+};
+
+static unsigned char iv[BATCH_SIZE][16];
+static unsigned char aad[BATCH_SIZE][AAD_LEN];
+static unsigned char pt[BATCH_SIZE][MAX_LEN];
+static unsigned char ct[BATCH_SIZE][MAX_LEN];
+static unsigned char out[BATCH_SIZE][MAX_LEN];
+static unsigned char tag[BATCH_SIZE][TAG_LEN];
+static size_t aad_length[BATCH_SIZE], length[BATCH_SIZE];
+
+static const unsigned char *iv_ptr[BATCH_SIZE], *aad_ptr[BATCH_SIZE];
+static const unsigned char *pt_ptr[BATCH_SIZE], *ct_ptr[BATCH_SIZE];
+static unsigned char *ct_out[BATCH_SIZE], *pt_out[BATCH_SIZE];
+static unsigned char *tag_out[BATCH_SIZE];
+static const unsigned char *tag_ptr[BATCH_SIZE];
+
+static void random_bytes(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+}
+
+/* The batch must give the same result as one message at a time. */
+static int run_batch(const ica_aes_key_t *aes_key, unsigned int iv_length,
+		     int with_aad)
+{
+	const unsigned char *const *aadp = with_aad ? aad_ptr : NULL;
+	unsigned char ref_ct[MAX_LEN], ref_tag[TAG_LEN];
+	int status[BATCH_SIZE], rc;
+	unsigned int i;
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		random_bytes(iv[i], sizeof(iv[i]));
+		random_bytes(aad[i], sizeof(aad[i]));
+		aad_length[i] = with_aad ? rand() % (AAD_LEN + 1) : 0;
+		length[i] = rand() % (MAX_LEN + 1);
+		random_bytes(pt[i], length[i]);
+	}
+
+	rc = ica_aes_gcm_seal_batch(aes_key, BATCH_SIZE, iv_ptr, iv_length,
+				    aadp, aad_length, pt_ptr, ct_out, length,
+				    tag_out, TAG_LEN, status);
+	if (rc) {
+		printf("ica_aes_gcm_seal_batch failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		rc = ica_aes_gcm_key(aes_key, pt[i], length[i], ref_ct,
+				     iv[i], iv_length, aad[i], aad_length[i],
+				     ref_tag, TAG_LEN, ICA_ENCRYPT);
+		if (rc || status[i] || memcmp(ct[i], ref_ct, length[i]) ||
+		    memcmp(tag[i], ref_tag, TAG_LEN)) {
+			printf("Message %u differs (%d, %d), length %zu\n", i,
+			       rc, status[i], length[i]);
+			return TEST_FAIL;
+		}
+	}
+
+	/* decrypt in place, with some bad tags */
+	for (i = 0; i < BATCH_SIZE; i++)
+		memcpy(out[i], ct[i], length[i]);
+	tag[3][0] ^= 0x01;
+	tag[BATCH_SIZE - 1][TAG_LEN - 1] ^= 0x80;
+
+	rc = ica_aes_gcm_open_batch(aes_key, BATCH_SIZE, iv_ptr, iv_length,
+				    aadp, aad_length,
+				    (const unsigned char *const *)pt_out,
+				    pt_out, length, tag_ptr, TAG_LEN, status);
+	if (rc != EFAULT) {
+		printf("ica_aes_gcm_open_batch accepted bad tags (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		if (i == 3 || i == BATCH_SIZE - 1) {
+			if (status[i] != EFAULT) {
+				printf("Message %u: bad tag not detected\n", i);
+				return TEST_FAIL;
+			}
+			continue;
+		}
+		if (status[i] || memcmp(out[i], pt[i], length[i])) {
+			printf("Message %u: decryption failed (%d)\n", i,
+			       status[i]);
+			return TEST_FAIL;
+		}
+	}
+
+	/* status is optional */
+	tag[3][0] ^= 0x01;
+	tag[BATCH_SIZE - 1][TAG_LEN - 1] ^= 0x80;
+	rc = ica_aes_gcm_open_batch(aes_key, BATCH_SIZE, iv_ptr, iv_length,
+				    aadp, aad_length, ct_ptr, pt_out, length,
+				    tag_ptr, TAG_LEN, NULL);
+	if (rc) {
+		printf("ica_aes_gcm_open_batch failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char key[AES_KEY_LEN256];
+	ica_aes_key_t *aes_key;
+	unsigned int i;
+	int rc;
+
+	set_verbosity(argc, argv);
+
+	srand(time(NULL));
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		iv_ptr[i] = iv[i];
+		aad_ptr[i] = aad[i];
+		pt_ptr[i] = pt[i];
+		ct_ptr[i] = ct[i];
+		ct_out[i] = ct[i];
+		pt_out[i] = out[i];
+		tag_out[i] = tag[i];
+		tag_ptr[i] = tag[i];
+	}
+
+	for (i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+		random_bytes(key, sizeof(key));
+		rc = ica_aes_key_new(key, key_lengths[i], &aes_key);
+		if (rc == ENODEV)
+			exit(TEST_SKIP);
+		if (rc) {
+			printf("ica_aes_key_new failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+
+		if (ica_aes_gcm_seal_batch(aes_key, 0, iv_ptr, 12, NULL, NULL,
+					   pt_ptr, ct_out, length, tag_out,
+					   TAG_LEN, NULL) != EINVAL) {
+			printf("ica_aes_gcm_seal_batch accepted an empty "
+			       "batch\n");
+			return TEST_FAIL;
+		}
+
+		if (run_batch(aes_key, 12, 1) || run_batch(aes_key, 16, 1) ||
+		    run_batch(aes_key, 12, 0))
+			return TEST_FAIL;
+
+		ica_aes_key_free(aes_key);
+	}
+
+	printf("All AES-GCM batch tests passed.\n");
+	return TEST_SUCC;
+}
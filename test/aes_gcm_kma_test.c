@@ -714,6 +714,102 @@ int test_gcm_kat_update_in_place(int iteration)
 /*
  * Performs GCM tests.
  */
+/* one context for several messages, only the iv is set for each of them */
+int test_gcm_kat_set_iv(int iteration)
+{
+	unsigned int aad_length = gcm_kats[iteration].aadlen;
+	unsigned int data_length = gcm_kats[iteration].datalen;
+	unsigned int t_length = gcm_kats[iteration].taglen;
+	unsigned int iv_length = gcm_kats[iteration].ivlen;
+	unsigned int key_length = gcm_kats[iteration].keylen;
+
+	unsigned char* iv = (unsigned char*)&(gcm_kats[iteration].iv);
+	unsigned char* input_data = (unsigned char*)&(gcm_kats[iteration].data);
+	unsigned char* result = (unsigned char*)&(gcm_kats[iteration].result);
+	unsigned char* aad = (unsigned char*)&(gcm_kats[iteration].aad);
+	unsigned char* key = (unsigned char*)&(gcm_kats[iteration].key);
+	unsigned char* t_result = (unsigned char*)&(gcm_kats[iteration].tag);
+	unsigned char t[t_length];
+	unsigned char other_iv[16];
+	unsigned char other_data[AES_BLOCK_SIZE + 3];
+	unsigned char other_out[sizeof(other_data)];
+
+	unsigned int vla_length = data_length ? data_length : 1;
+	unsigned char encrypt[vla_length];
+	unsigned char decrypt[vla_length];
+	int rc, i;
+
+	memset(other_iv, 0x5a, sizeof(other_iv));
+	memset(other_data, 0xa5, sizeof(other_data));
+
+	kma_ctx* ctx = ica_aes_gcm_kma_ctx_new();
+	if (!ctx) {
+		V_(printf("Error: Cannot create gcm context.\n"));
+		return TEST_FAIL;
+	}
+
+	/* a message with another iv of each kind precedes the known answer */
+	rc = ica_aes_gcm_kma_init(ICA_ENCRYPT, other_iv, sizeof(other_iv), key,
+				  key_length, ctx);
+	if (rc) {
+		V_(printf("Error: Cannot initialize gcm context.\n"));
+		return TEST_FAIL;
+	}
+	for (i = 0; i < 2; i++) {
+		if (i == 1 && ica_aes_gcm_kma_set_iv(other_iv, 12, ctx))
+			return TEST_FAIL;
+		rc = ica_aes_gcm_kma_update(other_data, other_out,
+					    sizeof(other_data), aad,
+					    aad_length, 1, 1, ctx);
+		if (rc == ENODEV) {
+			VV_(printf("Operation is not permitted on this machine. Test skipped!\n"));
+			return TEST_SKIP;
+		}
+		if (rc || ica_aes_gcm_kma_get_tag(t, t_length, ctx))
+			return TEST_FAIL;
+	}
+
+	rc = ica_aes_gcm_kma_set_iv(iv, iv_length, ctx);
+	if (rc) {
+		V_(printf("ica_aes_gcm_kma_set_iv failed with rc = %i\n", rc));
+		return TEST_FAIL;
+	}
+	rc = ica_aes_gcm_kma_update(input_data, encrypt, data_length, aad,
+				    aad_length, 1, 1, ctx);
+	if (rc || ica_aes_gcm_kma_get_tag(t, t_length, ctx)) {
+		V_(printf("ica_aes_gcm_kma encrypt failed with rc = %i\n", rc));
+		return TEST_FAIL;
+	}
+	if (memcmp(result, encrypt, data_length) ||
+	    memcmp(t, t_result, t_length)) {
+		V_(printf("Result after ica_aes_gcm_kma_set_iv does not match!\n"));
+		return TEST_FAIL;
+	}
+
+	/* decrypt twice with the same iv */
+	rc = ica_aes_gcm_kma_init(ICA_DECRYPT, other_iv, sizeof(other_iv), key,
+				  key_length, ctx);
+	for (i = 0; rc == 0 && i < 2; i++) {
+		rc = ica_aes_gcm_kma_set_iv(iv, iv_length, ctx);
+		if (rc == 0)
+			rc = ica_aes_gcm_kma_update(encrypt, decrypt,
+						    data_length, aad,
+						    aad_length, 1, 1, ctx);
+		if (rc == 0)
+			rc = ica_aes_gcm_kma_verify_tag(t_result, t_length,
+							ctx);
+		if (rc == 0 && memcmp(decrypt, input_data, data_length))
+			rc = EFAULT;
+	}
+	if (rc) {
+		V_(printf("Decryption after ica_aes_gcm_kma_set_iv failed with rc = %i\n", rc));
+		return TEST_FAIL;
+	}
+
+	ica_aes_gcm_kma_ctx_free(ctx);
+	return TEST_SUCC;
+}
+
 int main(int argc, char **argv)
 {
 	int rc = 0;
@@ -747,10 +843,16 @@ int main(int argc, char **argv)
 			V_(printf("test_gcm_kat_update_in_place %i failed with rc = %i\n", iteration, rc));
 			error_count++;
 		}
+
+		rc = test_gcm_kat_set_iv(iteration);
+		if (rc) {
+			V_(printf("test_gcm_kat_set_iv %i failed with rc = %i\n", iteration, rc));
+			error_count++;
+		}
 	}
 
 	if (error_count) {
-		printf("%i of %li AES-GCM-KMA tests failed.\n", error_count, NUM_GCM_TESTS*4);
+		printf("%i of %li AES-GCM-KMA tests failed.\n", error_count, NUM_GCM_TESTS*5);
 		return TEST_FAIL;
 	}
 
@@ -704,6 +704,200 @@ int test_gcm_kat_update_in_place(int iteration)
 	return TEST_SUCC;
 }
 
+/*
+ * Messages longer than the chunks in which the stitched MSA 4 path
+ * interleaves counter mode and GHASH, most of them with a partial final
+ * block. Key, iv, aad and data are generated by gcm_large_fill(), the
+ * tags were computed with OpenSSL.
+ */
+static const struct {
+	unsigned int keylen;
+	unsigned int ivlen;
+	unsigned int aadlen;
+	unsigned int datalen;
+	unsigned char tag[AES_BLOCK_SIZE];
+} gcm_large_kats[] = {
+	{ 16, 12, 0, 16384,
+	  { 0x6c, 0xc0, 0xfb, 0xf3, 0xed, 0xb3, 0xd4, 0x0b,
+	    0x1e, 0xf1, 0xa4, 0xae, 0x52, 0xe2, 0x2a, 0x04 } },
+	{ 24, 12, 20, 16385,
+	  { 0xc1, 0x6a, 0xe5, 0x25, 0xea, 0xdd, 0x41, 0x45,
+	    0x7a, 0x7a, 0xea, 0x61, 0x88, 0x5d, 0x59, 0xa6 } },
+	{ 32, 12, 13, 40007,
+	  { 0x17, 0x6c, 0xc2, 0xba, 0x94, 0xbf, 0xf7, 0x95,
+	    0xe8, 0x4d, 0xc6, 0x0f, 0xe6, 0xc9, 0x39, 0x3e } },
+	{ 16, 60, 100, 32773,
+	  { 0x6b, 0x0f, 0x0d, 0xdf, 0x3a, 0x91, 0x28, 0xa8,
+	    0xd3, 0x6e, 0x56, 0xb6, 0xd8, 0xc1, 0x25, 0x0d } },
+};
+
+#define NUM_GCM_LARGE_TESTS (sizeof(gcm_large_kats) / sizeof(gcm_large_kats[0]))
+
+/* Length of the first ica_aes_gcm_intermediate() call, a block multiple. */
+#define GCM_LARGE_FIRST_CHUNK	16400
+
+static void gcm_large_fill(unsigned char *key, unsigned char *iv,
+			   unsigned char *aad, unsigned char *data,
+			   unsigned int datalen)
+{
+	unsigned int i;
+
+	for (i = 0; i < 32; i++)
+		key[i] = 0x10 + i;
+	for (i = 0; i < 60; i++)
+		iv[i] = 0xc0 ^ i;
+	for (i = 0; i < 100; i++)
+		aad[i] = i * 3;
+	for (i = 0; i < datalen; i++)
+		data[i] = (i * 31 + 7) & 0xff;
+}
+
+int test_gcm_large(int iteration)
+{
+	unsigned int aad_length = gcm_large_kats[iteration].aadlen;
+	unsigned int data_length = gcm_large_kats[iteration].datalen;
+	unsigned int iv_length = gcm_large_kats[iteration].ivlen;
+	unsigned int key_length = gcm_large_kats[iteration].keylen;
+	const unsigned char *t_result = gcm_large_kats[iteration].tag;
+	unsigned int first = GCM_LARGE_FIRST_CHUNK < data_length ?
+			     GCM_LARGE_FIRST_CHUNK : 0;
+	unsigned char key[32], iv[60], aad[100];
+	unsigned char t[AES_BLOCK_SIZE];
+	unsigned char icb[AES_BLOCK_SIZE];
+	unsigned char ucb[AES_BLOCK_SIZE];
+	unsigned char subkey[AES_BLOCK_SIZE];
+	unsigned char running_tag[AES_BLOCK_SIZE];
+	unsigned char *input_data, *encrypt, *buf;
+	int rc = 0;
+
+	VV_(printf("Test Parameters for iteration = %i\n", iteration));
+	VV_(printf("key length = %i, data length = %i, iv length = %i "
+		   "aad_length = %i\n", key_length, data_length, iv_length,
+		   aad_length));
+
+	input_data = malloc(data_length);
+	encrypt = malloc(data_length);
+	buf = malloc(data_length);
+	if (!input_data || !encrypt || !buf) {
+		rc = TEST_FAIL;
+		goto out;
+	}
+	gcm_large_fill(key, iv, aad, input_data, data_length);
+
+	/* one-shot encryption against the known tag */
+	rc = ica_aes_gcm(input_data, data_length, encrypt, iv, iv_length,
+			 aad, aad_length, t, AES_BLOCK_SIZE,
+			 key, key_length, ICA_ENCRYPT);
+	if (rc == EPERM) {
+		VV_(printf("ica_aes_gcm returns with EPERM (%d).\n", rc));
+		VV_(printf("Operation is not permitted on this machine. Test skipped!\n"));
+		rc = TEST_SKIP;
+		goto out;
+	}
+	if (rc) {
+		V_(printf("ica_aes_gcm encrypt failed with rc = %i\n", rc));
+		rc = TEST_FAIL;
+		goto out;
+	}
+	if (memcmp(t, t_result, AES_BLOCK_SIZE)) {
+		V_(printf("Tag result does not match the expected tag!\n"));
+		VV_(printf("Expected tag:\n"));
+		dump_array((unsigned char *)t_result, AES_BLOCK_SIZE);
+		VV_(printf("Tag Result:\n"));
+		dump_array(t, AES_BLOCK_SIZE);
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	/* in-place encryption */
+	memcpy(buf, input_data, data_length);
+	rc = ica_aes_gcm(buf, data_length, buf, iv, iv_length,
+			 aad, aad_length, t, AES_BLOCK_SIZE,
+			 key, key_length, ICA_ENCRYPT);
+	if (rc || memcmp(buf, encrypt, data_length) ||
+	    memcmp(t, t_result, AES_BLOCK_SIZE)) {
+		V_(printf("In-place encryption does not match (rc = %i)!\n", rc));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	/* in-place decryption, which also verifies the tag */
+	rc = ica_aes_gcm(buf, data_length, buf, iv, iv_length,
+			 aad, aad_length, t, AES_BLOCK_SIZE,
+			 key, key_length, ICA_DECRYPT);
+	if (rc || memcmp(buf, input_data, data_length)) {
+		V_(printf("In-place decryption does not match (rc = %i)!\n", rc));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	/* in-place streaming encryption, the last part is not a block multiple */
+	memcpy(buf, input_data, data_length);
+	memset(running_tag, 0, AES_BLOCK_SIZE);
+	rc = ica_aes_gcm_initialize(iv, iv_length, key, key_length,
+				    icb, ucb, subkey, ICA_ENCRYPT);
+	if (!rc && first)
+		rc = ica_aes_gcm_intermediate(buf, first, buf, ucb,
+					      aad, aad_length,
+					      running_tag, AES_BLOCK_SIZE,
+					      key, key_length, subkey,
+					      ICA_ENCRYPT);
+	if (!rc)
+		rc = ica_aes_gcm_intermediate(buf + first, data_length - first,
+					      buf + first, ucb,
+					      first ? NULL : aad,
+					      first ? 0 : aad_length,
+					      running_tag, AES_BLOCK_SIZE,
+					      key, key_length, subkey,
+					      ICA_ENCRYPT);
+	if (!rc)
+		rc = ica_aes_gcm_last(icb, aad_length, data_length, running_tag,
+				      t, AES_BLOCK_SIZE, key, key_length,
+				      subkey, ICA_ENCRYPT);
+	if (rc || memcmp(buf, encrypt, data_length) ||
+	    memcmp(running_tag, t_result, AES_BLOCK_SIZE)) {
+		V_(printf("Streaming encryption does not match (rc = %i)!\n", rc));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	/* in-place streaming decryption */
+	memset(running_tag, 0, AES_BLOCK_SIZE);
+	memcpy(t, t_result, AES_BLOCK_SIZE);
+	rc = ica_aes_gcm_initialize(iv, iv_length, key, key_length,
+				    icb, ucb, subkey, ICA_DECRYPT);
+	if (!rc && first)
+		rc = ica_aes_gcm_intermediate(buf, first, buf, ucb,
+					      aad, aad_length,
+					      running_tag, AES_BLOCK_SIZE,
+					      key, key_length, subkey,
+					      ICA_DECRYPT);
+	if (!rc)
+		rc = ica_aes_gcm_intermediate(buf + first, data_length - first,
+					      buf + first, ucb,
+					      first ? NULL : aad,
+					      first ? 0 : aad_length,
+					      running_tag, AES_BLOCK_SIZE,
+					      key, key_length, subkey,
+					      ICA_DECRYPT);
+	if (!rc)
+		rc = ica_aes_gcm_last(icb, aad_length, data_length, running_tag,
+				      t, AES_BLOCK_SIZE, key, key_length,
+				      subkey, ICA_DECRYPT);
+	if (rc || memcmp(buf, input_data, data_length)) {
+		V_(printf("Streaming decryption does not match (rc = %i)!\n", rc));
+		rc = TEST_FAIL;
+		goto out;
+	}
+
+	rc = TEST_SUCC;
+out:
+	free(input_data);
+	free(encrypt);
+	free(buf);
+	return rc;
+}
+
 /*
  * Performs GCM tests.
  */
@@ -742,8 +936,17 @@ int main(int argc, char **argv)
 		}
 	}
 
+	for (iteration = 0; iteration < NUM_GCM_LARGE_TESTS; iteration++) {
+		rc = test_gcm_large(iteration);
+		if (rc == TEST_FAIL) {
+			V_(printf("test_gcm_large %i failed\n", iteration));
+			error_count++;
+		}
+	}
+
 	if (error_count) {
-		printf("%i of %li AES-GCM tests failed.\n", error_count, NUM_GCM_TESTS*4);
+		printf("%i of %li AES-GCM tests failed.\n", error_count,
+		       NUM_GCM_TESTS*4 + NUM_GCM_LARGE_TESTS);
 		return TEST_FAIL;
 	}
 
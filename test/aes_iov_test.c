@@ -0,0 +1,229 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/uio.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define AES_BLOCK_SIZE	16
+#define AADLEN		(5 * AES_BLOCK_SIZE + 3)
+#define DATALEN		(16 * AES_BLOCK_SIZE + 7)
+#define MAX_IOV		64
+#define ITERATIONS	200
+
+static const unsigned int key_lengths[] = {
+	AES_KEY_LEN128, AES_KEY_LEN192, AES_KEY_LEN256,
+};
+
+static void random_bytes(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+}
+
+/* Split buf into randomly sized fragments, including empty ones. */
+static unsigned int split(unsigned char *buf, size_t len, struct iovec *iov)
+{
+	unsigned int cnt = 0;
+	size_t off = 0, n;
+
+	while (off < len) {
+		n = rand() % 3 ? rand() % (3 * AES_BLOCK_SIZE) : 0;
+		if (n > len - off || cnt == MAX_IOV - 1)
+			n = len - off;
+		iov[cnt].iov_base = buf + off;
+		iov[cnt].iov_len = n;
+		off += n;
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/* The scattered functions must match the ones on contiguous buffers. */
+static int run_gcm(const ica_aes_key_t *aes_key, unsigned char *key,
+		   unsigned int key_length)
+{
+	unsigned char aad[AADLEN], pt[DATALEN], ct[DATALEN], out[DATALEN];
+	unsigned char iv[AES_BLOCK_SIZE], tag[AES_BLOCK_SIZE];
+	unsigned char tag2[AES_BLOCK_SIZE];
+	struct iovec aad_iov[MAX_IOV], in_iov[MAX_IOV], out_iov[MAX_IOV];
+	unsigned int aad_cnt, in_cnt, out_cnt, iv_length;
+	unsigned long aad_length, length;
+	int rc;
+
+	iv_length = rand() % 2 ? 12 : 16;
+	aad_length = rand() % (AADLEN + 1);
+	length = rand() % (DATALEN + 1);
+	random_bytes(iv, sizeof(iv));
+	random_bytes(aad, sizeof(aad));
+	random_bytes(pt, sizeof(pt));
+
+	rc = ica_aes_gcm(pt, length, ct, iv, iv_length, aad, aad_length,
+			 tag, AES_BLOCK_SIZE, key, key_length, ICA_ENCRYPT);
+	if (rc) {
+		printf("ica_aes_gcm failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	aad_cnt = split(aad, aad_length, aad_iov);
+	in_cnt = split(pt, length, in_iov);
+	out_cnt = split(out, length, out_iov);
+	rc = ica_aes_gcm_sealv(aes_key, iv, iv_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, out_iov, out_cnt,
+			       tag2, AES_BLOCK_SIZE);
+	if (rc || memcmp(out, ct, length) || memcmp(tag, tag2, sizeof(tag))) {
+		printf("ica_aes_gcm_sealv differs (%d), aad %lu, data %lu\n",
+		       rc, aad_length, length);
+		return TEST_FAIL;
+	}
+
+	/* in place */
+	in_cnt = split(out, length, in_iov);
+	rc = ica_aes_gcm_openv(aes_key, iv, iv_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, in_iov, in_cnt,
+			       tag, AES_BLOCK_SIZE);
+	if (rc || memcmp(out, pt, length)) {
+		printf("ica_aes_gcm_openv failed (%d), aad %lu, data %lu\n",
+		       rc, aad_length, length);
+		return TEST_FAIL;
+	}
+
+	tag[0] ^= 0x01;
+	in_cnt = split(ct, length, in_iov);
+	out_cnt = split(out, length, out_iov);
+	rc = ica_aes_gcm_openv(aes_key, iv, iv_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, out_iov, out_cnt,
+			       tag, AES_BLOCK_SIZE);
+	if (rc != EFAULT) {
+		printf("ica_aes_gcm_openv accepted a bad tag (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	return TEST_SUCC;
+}
+
+static int run_ccm(const ica_aes_key_t *aes_key, unsigned char *key,
+		   unsigned int key_length)
+{
+	unsigned char aad[AADLEN], pt[DATALEN], ct[DATALEN + AES_BLOCK_SIZE];
+	unsigned char out[DATALEN], nonce[13], mac[AES_BLOCK_SIZE];
+	struct iovec aad_iov[MAX_IOV], in_iov[MAX_IOV], out_iov[MAX_IOV];
+	unsigned int aad_cnt, in_cnt, out_cnt, nonce_length, mac_length;
+	unsigned long aad_length, length;
+	int rc;
+
+	nonce_length = 7 + rand() % 7;
+	mac_length = 4 + 2 * (rand() % 7);
+	aad_length = rand() % (AADLEN + 1);
+	length = rand() % (DATALEN + 1);
+	if (aad_length == 0 && length == 0)
+		length = 1;
+	random_bytes(nonce, sizeof(nonce));
+	random_bytes(aad, sizeof(aad));
+	random_bytes(pt, sizeof(pt));
+
+	rc = ica_aes_ccm(pt, length, ct, mac_length, aad, aad_length,
+			 nonce, nonce_length, key, key_length, ICA_ENCRYPT);
+	if (rc) {
+		printf("ica_aes_ccm failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	aad_cnt = split(aad, aad_length, aad_iov);
+	in_cnt = split(pt, length, in_iov);
+	out_cnt = split(out, length, out_iov);
+	rc = ica_aes_ccm_sealv(aes_key, nonce, nonce_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, out_iov, out_cnt,
+			       mac, mac_length);
+	if (rc || memcmp(out, ct, length) ||
+	    memcmp(mac, ct + length, mac_length)) {
+		printf("ica_aes_ccm_sealv differs (%d), aad %lu, data %lu\n",
+		       rc, aad_length, length);
+		return TEST_FAIL;
+	}
+
+	/* in place */
+	in_cnt = split(out, length, in_iov);
+	rc = ica_aes_ccm_openv(aes_key, nonce, nonce_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, in_iov, in_cnt,
+			       mac, mac_length);
+	if (rc || memcmp(out, pt, length)) {
+		printf("ica_aes_ccm_openv failed (%d), aad %lu, data %lu\n",
+		       rc, aad_length, length);
+		return TEST_FAIL;
+	}
+
+	mac[mac_length - 1] ^= 0x01;
+	in_cnt = split(ct, length, in_iov);
+	out_cnt = split(out, length, out_iov);
+	rc = ica_aes_ccm_openv(aes_key, nonce, nonce_length, aad_iov, aad_cnt,
+			       in_iov, in_cnt, out_iov, out_cnt,
+			       mac, mac_length);
+	if (rc != EFAULT) {
+		printf("ica_aes_ccm_openv accepted a bad MAC (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char key[AES_KEY_LEN256], buf[2 * AES_BLOCK_SIZE];
+	unsigned char iv[AES_BLOCK_SIZE], tag[AES_BLOCK_SIZE];
+	struct iovec in_iov, out_iov;
+	ica_aes_key_t *aes_key;
+	unsigned int i, j;
+	int rc;
+
+	set_verbosity(argc, argv);
+
+	srand(time(NULL));
+
+	for (i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+		random_bytes(key, sizeof(key));
+		rc = ica_aes_key_new(key, key_lengths[i], &aes_key);
+		if (rc == ENODEV)
+			exit(TEST_SKIP);
+		if (rc) {
+			printf("ica_aes_key_new failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+
+		for (j = 0; j < ITERATIONS; j++) {
+			if (run_gcm(aes_key, key, key_lengths[i]) ||
+			    run_ccm(aes_key, key, key_lengths[i]))
+				return TEST_FAIL;
+		}
+
+		/* the total lengths of in and out must match */
+		in_iov.iov_base = buf;
+		in_iov.iov_len = sizeof(buf);
+		out_iov.iov_base = buf;
+		out_iov.iov_len = sizeof(buf) - 1;
+		if (ica_aes_gcm_sealv(aes_key, iv, sizeof(iv), NULL, 0,
+				      &in_iov, 1, &out_iov, 1,
+				      tag, sizeof(tag)) != EINVAL) {
+			printf("ica_aes_gcm_sealv accepted different lengths\n");
+			return TEST_FAIL;
+		}
+
+		ica_aes_key_free(aes_key);
+	}
+
+	printf("All AES scatter-gather tests passed.\n");
+	return TEST_SUCC;
+}
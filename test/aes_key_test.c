@@ -0,0 +1,186 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ica_api.h"
+#include "testcase.h"
+#include "aes_gcm_test.h"
+
+#define DATALEN		(8 * AES_BLOCK_SIZE + 5)
+
+static const unsigned int key_lengths[] = {
+	AES_KEY_LEN128, AES_KEY_LEN192, AES_KEY_LEN256,
+};
+
+static unsigned char data[DATALEN];
+
+static void random_bytes(unsigned char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = rand();
+}
+
+/* the key object functions must match the ones taking the raw key */
+static int run_key(unsigned int key_length)
+{
+	unsigned char key[AES_KEY_LEN256], iv[AES_BLOCK_SIZE];
+	unsigned char iv1[AES_BLOCK_SIZE], iv2[AES_BLOCK_SIZE];
+	unsigned char out1[DATALEN], out2[DATALEN], back[DATALEN];
+	unsigned char tag1[AES_BLOCK_SIZE], tag2[AES_BLOCK_SIZE];
+	unsigned long len = DATALEN - DATALEN % AES_BLOCK_SIZE;
+	ica_aes_key_t *aes_key;
+	int rc;
+
+	random_bytes(key, sizeof(key));
+	random_bytes(iv, sizeof(iv));
+
+	rc = ica_aes_key_new(key, key_length, &aes_key);
+	if (rc == ENODEV)
+		exit(TEST_SKIP);
+	if (rc) {
+		printf("ica_aes_key_new failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	/* ECB */
+	if (ica_aes_ecb(data, out1, len, key, key_length, ICA_ENCRYPT) ||
+	    ica_aes_ecb_key(aes_key, data, out2, len, ICA_ENCRYPT) ||
+	    memcmp(out1, out2, len)) {
+		printf("ica_aes_ecb_key encryption differs\n");
+		return TEST_FAIL;
+	}
+	if (ica_aes_ecb_key(aes_key, out2, back, len, ICA_DECRYPT) ||
+	    memcmp(back, data, len)) {
+		printf("ica_aes_ecb_key decryption failed\n");
+		return TEST_FAIL;
+	}
+
+	/* CBC, the chaining value is returned as well */
+	memcpy(iv1, iv, sizeof(iv));
+	memcpy(iv2, iv, sizeof(iv));
+	if (ica_aes_cbc(data, out1, len, key, key_length, iv1, ICA_ENCRYPT) ||
+	    ica_aes_cbc_key(aes_key, data, out2, len, iv2, ICA_ENCRYPT) ||
+	    memcmp(out1, out2, len) || memcmp(iv1, iv2, sizeof(iv1))) {
+		printf("ica_aes_cbc_key encryption differs\n");
+		return TEST_FAIL;
+	}
+	memcpy(iv2, iv, sizeof(iv));
+	if (ica_aes_cbc_key(aes_key, out2, back, len, iv2, ICA_DECRYPT) ||
+	    memcmp(back, data, len)) {
+		printf("ica_aes_cbc_key decryption failed\n");
+		return TEST_FAIL;
+	}
+
+	/* CTR needs MSA 4, so it may not be available */
+	memcpy(iv1, iv, sizeof(iv));
+	memcpy(iv2, iv, sizeof(iv));
+	rc = ica_aes_ctr(data, out1, DATALEN, key, key_length, iv1, 32,
+			 ICA_ENCRYPT);
+	if (rc == 0) {
+		if (ica_aes_ctr_key(aes_key, data, out2, DATALEN, iv2, 32) ||
+		    memcmp(out1, out2, DATALEN) ||
+		    memcmp(iv1, iv2, sizeof(iv1))) {
+			printf("ica_aes_ctr_key differs\n");
+			return TEST_FAIL;
+		}
+	}
+
+	/* GCM */
+	rc = ica_aes_gcm(data, DATALEN, out1, iv, 12, key, 7, tag1,
+			 sizeof(tag1), key, key_length, ICA_ENCRYPT);
+	if (rc == 0) {
+		if (ica_aes_gcm_key(aes_key, data, DATALEN, out2, iv, 12, key,
+				    7, tag2, sizeof(tag2), ICA_ENCRYPT) ||
+		    memcmp(out1, out2, DATALEN) ||
+		    memcmp(tag1, tag2, sizeof(tag1))) {
+			printf("ica_aes_gcm_key encryption differs\n");
+			return TEST_FAIL;
+		}
+		if (ica_aes_gcm_key(aes_key, back, DATALEN, out2, iv, 12, key,
+				    7, tag2, sizeof(tag2), ICA_DECRYPT) ||
+		    memcmp(back, data, DATALEN)) {
+			printf("ica_aes_gcm_key decryption failed\n");
+			return TEST_FAIL;
+		}
+		tag2[0] ^= 0x01;
+		if (ica_aes_gcm_key(aes_key, back, DATALEN, out2, iv, 12, key,
+				    7, tag2, sizeof(tag2), ICA_DECRYPT)
+		    != EFAULT) {
+			printf("ica_aes_gcm_key accepted a bad tag\n");
+			return TEST_FAIL;
+		}
+	}
+
+	ica_aes_key_free(aes_key);
+	return TEST_SUCC;
+}
+
+static int gcm_kat(void)
+{
+	unsigned char out[MAX_ARRAY_SIZE], tag[MAX_ARRAY_SIZE];
+	ica_aes_key_t *aes_key;
+	unsigned int i;
+	int rc;
+
+	for (i = 0; i < NUM_GCM_TESTS; i++) {
+		if (ica_aes_key_new(gcm_kats[i].key, gcm_kats[i].keylen,
+				    &aes_key))
+			return TEST_FAIL;
+
+		rc = ica_aes_gcm_key(aes_key, gcm_kats[i].data,
+				     gcm_kats[i].datalen, out, gcm_kats[i].iv,
+				     gcm_kats[i].ivlen, gcm_kats[i].aad,
+				     gcm_kats[i].aadlen, tag,
+				     gcm_kats[i].taglen, ICA_ENCRYPT);
+		ica_aes_key_free(aes_key);
+		if (rc == ENODEV || rc == EPERM)
+			return TEST_SUCC;
+		if (rc || memcmp(out, gcm_kats[i].result, gcm_kats[i].datalen)
+		    || memcmp(tag, gcm_kats[i].tag, gcm_kats[i].taglen)) {
+			printf("GCM known answer test %u failed (%d)\n", i, rc);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char key[AES_KEY_LEN128];
+	ica_aes_key_t *aes_key;
+	unsigned int i;
+
+	set_verbosity(argc, argv);
+
+	if (ica_aes_key_new(key, 17, &aes_key) != EINVAL) {
+		printf("ica_aes_key_new accepted a bad key length\n");
+		return TEST_FAIL;
+	}
+	ica_aes_key_free(NULL);
+
+	srand(time(NULL));
+	random_bytes(data, sizeof(data));
+
+	for (i = 0; i < sizeof(key_lengths) / sizeof(key_lengths[0]); i++) {
+		if (run_key(key_lengths[i]))
+			return TEST_FAIL;
+	}
+
+	if (gcm_kat())
+		return TEST_FAIL;
+
+	printf("All AES key object tests passed.\n");
+	return TEST_SUCC;
+}
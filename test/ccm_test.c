@@ -162,6 +162,100 @@ int api_ccm_test(void)
 	return TEST_SUCC;
 }
 
+/* The streaming API must match the known answers however the message is
+ * split into parts. */
+int api_ccm_stream_test(void)
+{
+	unsigned char out_data[32], mac[16];
+	unsigned long off, n;
+	ica_aes_ccm_ctx_t *ctx;
+	unsigned int t;
+	int rc;
+
+	VV_(printf("Test of streaming CCM api\n"));
+	if (!(ctx = ica_aes_ccm_ctx_new()))
+		return TEST_ERR;
+
+	for (t = 0; t < NUM_CCM_TESTS; t++) {
+		rc = ica_aes_ccm_init(ICA_ENCRYPT, nonce[t], nonce_length[t],
+				      assoc_data_length[t], payload_length[t],
+				      cbc_mac_length[t], key[t], key_length[t],
+				      ctx);
+		/* associated data in odd sized parts, payload by blocks */
+		for (off = 0; !rc && off < assoc_data_length[t]; off += n) {
+			n = assoc_data_length[t] - off < 13 ?
+			    assoc_data_length[t] - off : 13;
+			rc = ica_aes_ccm_update(NULL, NULL, 0,
+						assoc_data[t] + off, n, ctx);
+		}
+		for (off = 0; !rc && off < payload_length[t]; off += n) {
+			n = payload_length[t] - off < 16 ?
+			    payload_length[t] - off : 16;
+			rc = ica_aes_ccm_update(payload_after_decrypt[t] + off,
+						out_data + off, n, NULL, 0, ctx);
+		}
+		if (!rc)
+			rc = ica_aes_ccm_get_mac(mac, cbc_mac_length[t], ctx);
+		if (rc || memcmp(out_data, cipher_text[t], payload_length[t]) ||
+		    memcmp(mac, cipher_text[t] + payload_length[t],
+			   cbc_mac_length[t])) {
+			printf("Streaming encryption of test %u failed (%d).\n",
+			       t, rc);
+			return TEST_FAIL;
+		}
+
+		/* all associated data with the first payload block */
+		n = payload_length[t] < 16 ? payload_length[t] : 16;
+		rc = ica_aes_ccm_init(ICA_DECRYPT, nonce[t], nonce_length[t],
+				      assoc_data_length[t], payload_length[t],
+				      cbc_mac_length[t], key[t], key_length[t],
+				      ctx);
+		if (!rc)
+			rc = ica_aes_ccm_update(cipher_text[t], out_data, n,
+						assoc_data[t],
+						assoc_data_length[t], ctx);
+		if (!rc)
+			rc = ica_aes_ccm_update(cipher_text[t] + n,
+						out_data + n,
+						payload_length[t] - n,
+						NULL, 0, ctx);
+		if (!rc)
+			rc = ica_aes_ccm_verify_mac(cipher_text[t] +
+						    payload_length[t],
+						    cbc_mac_length[t], ctx);
+		if (rc || memcmp(out_data, payload_after_decrypt[t],
+				 payload_length[t])) {
+			printf("Streaming decryption of test %u failed (%d).\n",
+			       t, rc);
+			return TEST_FAIL;
+		}
+
+		mac[0] ^= 0x01;
+		if (ica_aes_ccm_verify_mac(mac, cbc_mac_length[t], ctx)
+		    != EFAULT) {
+			printf("Streaming decryption of test %u accepted a bad "
+			       "MAC.\n", t);
+			return TEST_FAIL;
+		}
+
+		/* the payload must not come before the associated data */
+		rc = ica_aes_ccm_init(ICA_ENCRYPT, nonce[t], nonce_length[t],
+				      assoc_data_length[t], payload_length[t],
+				      cbc_mac_length[t], key[t], key_length[t],
+				      ctx);
+		if (rc || ica_aes_ccm_update(payload_after_decrypt[t],
+					     out_data, payload_length[t],
+					     NULL, 0, ctx) != EINVAL) {
+			printf("Streaming encryption of test %u accepted the "
+			       "payload first.\n", t);
+			return TEST_FAIL;
+		}
+	}
+
+	ica_aes_ccm_ctx_free(ctx);
+	return TEST_SUCC;
+}
+
 int main(int argc, char **argv)
 {
 	int rc = 0;
@@ -174,6 +268,12 @@ int main(int argc, char **argv)
 		return TEST_FAIL;
 	}
 
+	rc = api_ccm_stream_test();
+	if (rc) {
+		printf("api_ccm_stream_test failed with rc = %i.\n", rc);
+		return TEST_FAIL;
+	}
+
 	printf("All AES-CCM tests passed.\n");
 	return TEST_SUCC;
 }
@@ -0,0 +1,152 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "ica_api.h"
+#include "rng.h"
+#include "testcase.h"
+
+#define NUM_THREADS	8
+#define ITERATIONS	1000
+#define RND_LEN		32
+
+static unsigned char first[NUM_THREADS][RND_LEN];
+
+static void *thread_main(void *arg)
+{
+	unsigned char buf[RND_LEN];
+	long idx = (long)arg;
+	int i;
+
+	for (i = 0; i < ITERATIONS; i++) {
+		if (ica_random_number_generate(sizeof(buf), buf))
+			return (void *)1;
+		if (i == 0)
+			memcpy(first[idx], buf, sizeof(buf));
+	}
+	return NULL;
+}
+
+/*
+ * Parent and child must not continue with the same output stream. Runs in
+ * a new thread, whose random byte pool starts out empty: the first request
+ * fills it, the following ones drain it, so that both parent and child
+ * refill their pool from the drbg after the fork.
+ */
+static int check_fork(void)
+{
+	unsigned char parent[RND_LEN], child[RND_LEN];
+	int fd[2], status;
+	pid_t pid;
+	int i;
+
+	if (pipe(fd))
+		return TEST_FAIL;
+
+	for (i = 0; i < RNG_POOL_SIZE / RND_LEN; i++) {
+		if (ica_random_number_generate(sizeof(parent), parent))
+			return TEST_FAIL;
+	}
+
+	pid = fork();
+	if (pid < 0)
+		return TEST_FAIL;
+	if (pid == 0) {
+		close(fd[0]);
+		if (ica_random_number_generate(sizeof(child), child))
+			exit(1);
+		if (write(fd[1], child, sizeof(child)) != sizeof(child))
+			exit(1);
+		exit(0);
+	}
+
+	close(fd[1]);
+	if (ica_random_number_generate(sizeof(parent), parent))
+		return TEST_FAIL;
+	if (read(fd[0], child, sizeof(child)) != sizeof(child))
+		return TEST_FAIL;
+	close(fd[0]);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status) != 0)
+		return TEST_FAIL;
+
+	if (!memcmp(parent, child, sizeof(parent))) {
+		printf("Parent and child produced the same random bytes\n");
+		return TEST_FAIL;
+	}
+	return TEST_SUCC;
+}
+
+static void *fork_thread_main(void *arg)
+{
+	(void)arg;
+
+	return check_fork() ? (void *)1 : NULL;
+}
+
+static int run_check_fork(void)
+{
+	pthread_t thread;
+	void *ret;
+
+	if (pthread_create(&thread, NULL, fork_thread_main, NULL))
+		return TEST_FAIL;
+	if (pthread_join(thread, &ret) || ret != NULL)
+		return TEST_FAIL;
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	pthread_t threads[NUM_THREADS];
+	void *ret;
+	long i, j;
+
+	set_verbosity(argc, argv);
+
+	ica_set_drbg_thread_mode(1);
+
+	for (i = 0; i < NUM_THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, thread_main, (void *)i))
+			EXIT_ERR("pthread_create failed.");
+	}
+	for (i = 0; i < NUM_THREADS; i++) {
+		if (pthread_join(threads[i], &ret) || ret != NULL) {
+			printf("ica_random_number_generate failed in thread %ld\n",
+			       i);
+			return TEST_FAIL;
+		}
+	}
+
+	/* every thread must get its own output stream */
+	for (i = 0; i < NUM_THREADS; i++) {
+		for (j = i + 1; j < NUM_THREADS; j++) {
+			if (!memcmp(first[i], first[j], RND_LEN)) {
+				printf("Threads %ld and %ld produced the same "
+				       "random bytes\n", i, j);
+				return TEST_FAIL;
+			}
+		}
+	}
+
+	if (run_check_fork())
+		return TEST_FAIL;
+
+	/* the shared instance is reseeded in the child as well */
+	ica_set_drbg_thread_mode(0);
+	if (run_check_fork())
+		return TEST_FAIL;
+
+	printf("All DRBG thread mode tests passed.\n");
+	return TEST_SUCC;
+}
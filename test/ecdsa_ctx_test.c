@@ -0,0 +1,182 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <openssl/obj_mac.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MAX_ECC_PRIV_SIZE	66 /* 521 bits */
+#define MAX_ECDSA_SIG_SIZE	132
+#define ITERATIONS		4
+
+static const unsigned int nids[] = {
+	NID_X9_62_prime256v1,
+	NID_secp384r1,
+	NID_secp521r1,
+};
+
+static unsigned char hash[32] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+
+static int run_curve(ica_adapter_handle_t adapter_handle, unsigned int nid)
+{
+	ICA_EC_KEY *key, *priv, *pub;
+	ica_ecdsa_ctx_t *priv_ctx = NULL, *pub_ctx = NULL, *bad_ctx = NULL;
+	unsigned char signature[MAX_ECDSA_SIG_SIZE];
+	unsigned char q[2 * MAX_ECC_PRIV_SIZE], d[MAX_ECC_PRIV_SIZE];
+	unsigned int privlen, len;
+	int j, rc;
+
+	key = ica_ec_key_new(nid, &privlen);
+	priv = ica_ec_key_new(nid, &privlen);
+	pub = ica_ec_key_new(nid, &privlen);
+	if (key == NULL || priv == NULL || pub == NULL) {
+		printf("ica_ec_key_new failed\n");
+		return TEST_FAIL;
+	}
+
+	rc = ica_ec_key_generate(adapter_handle, key);
+	if (rc) {
+		printf("ica_ec_key_generate failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	ica_ec_key_get_public_key(key, q, &len);
+	ica_ec_key_get_private_key(key, d, &len);
+
+	/* private context from D only, public context from (X,Y) only */
+	ica_ec_key_init(NULL, NULL, d, priv);
+	ica_ec_key_init(q, q + privlen, NULL, pub);
+
+	rc = ica_ecdsa_ctx_new(priv, &priv_ctx);
+	if (rc) {
+		printf("ica_ecdsa_ctx_new (private) failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	rc = ica_ecdsa_ctx_new(pub, &pub_ctx);
+	if (rc) {
+		printf("ica_ecdsa_ctx_new (public) failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	/* the key contexts are reused for several operations */
+	for (j = 0; j < ITERATIONS; j++) {
+		rc = ica_ecdsa_ctx_sign(adapter_handle, priv_ctx, hash,
+					sizeof(hash), signature, sizeof(signature));
+		if (rc) {
+			printf("ica_ecdsa_ctx_sign failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+		rc = ica_ecdsa_ctx_verify(adapter_handle, pub_ctx, hash,
+					  sizeof(hash), signature,
+					  sizeof(signature));
+		if (rc) {
+			printf("ica_ecdsa_ctx_verify failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+		rc = ica_ecdsa_ctx_verify(adapter_handle, priv_ctx, hash,
+					  sizeof(hash), signature,
+					  sizeof(signature));
+		if (rc) {
+			printf("ica_ecdsa_ctx_verify (private) failed with %d\n",
+			       rc);
+			return TEST_FAIL;
+		}
+		rc = ica_ecdsa_verify(adapter_handle, key, hash, sizeof(hash),
+				      signature, sizeof(signature));
+		if (rc) {
+			printf("ica_ecdsa_verify failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+	}
+
+	signature[privlen / 2] ^= 0x01;
+	rc = ica_ecdsa_ctx_verify(adapter_handle, pub_ctx, hash, sizeof(hash),
+				  signature, sizeof(signature));
+	if (rc != EFAULT) {
+		printf("ica_ecdsa_ctx_verify accepted a bad signature (%d)\n",
+		       rc);
+		return TEST_FAIL;
+	}
+
+	/* a public context cannot sign */
+	if (ica_ecdsa_ctx_sign(adapter_handle, pub_ctx, hash, sizeof(hash),
+			       signature, sizeof(signature)) != EINVAL) {
+		printf("ica_ecdsa_ctx_sign signed with a public key\n");
+		return TEST_FAIL;
+	}
+
+	/* a point that is not on the curve is rejected */
+	q[privlen + 1] ^= 0x01;
+	ica_ec_key_init(q, q + privlen, NULL, pub);
+	if (ica_ecdsa_ctx_new(pub, &bad_ctx) != EINVAL) {
+		printf("ica_ecdsa_ctx_new accepted an invalid point\n");
+		return TEST_FAIL;
+	}
+
+	/* a public key that does not belong to D is rejected */
+	ica_ec_key_init(q, q + privlen, d, priv);
+	if (ica_ecdsa_ctx_new(priv, &bad_ctx) != EINVAL) {
+		printf("ica_ecdsa_ctx_new accepted a mismatching key pair\n");
+		return TEST_FAIL;
+	}
+
+	ica_ecdsa_ctx_free(priv_ctx);
+	ica_ecdsa_ctx_free(pub_ctx);
+	ica_ec_key_free(key);
+	ica_ec_key_free(priv);
+	ica_ec_key_free(pub);
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	ica_adapter_handle_t adapter_handle;
+	unsigned int i;
+	int rc;
+
+	set_verbosity(argc, argv);
+
+	rc = ica_open_adapter(&adapter_handle);
+	if (rc != 0) {
+		V_(printf("ica_open_adapter failed and returned %d (0x%x).\n", rc, rc));
+	}
+
+	if (ica_ecdsa_ctx_new(NULL, NULL) != EINVAL) {
+		printf("ica_ecdsa_ctx_new accepted a NULL key\n");
+		return TEST_FAIL;
+	}
+	ica_ecdsa_ctx_free(NULL);
+
+	for (i = 0; i < sizeof(nids) / sizeof(nids[0]); i++) {
+		V_(printf("Testing curve %d\n", nids[i]));
+
+		/* software path only */
+		setenv("ICAPATH", "2", 1);
+		if (run_curve(adapter_handle, nids[i]))
+			return TEST_FAIL;
+
+		/* hw with sw fallback */
+		unset_env_icapath();
+		if (run_curve(adapter_handle, nids[i]))
+			return TEST_FAIL;
+	}
+
+	ica_close_adapter(adapter_handle);
+
+	printf("All ECDSA key context tests passed.\n");
+	return TEST_SUCC;
+}
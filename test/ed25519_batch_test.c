@@ -0,0 +1,265 @@
+/*
+ * This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ *
+ * Copyright IBM Corp. 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ica_api.h"
+#include "testcase.h"
+
+#define BATCH_SIZE	64
+#define MSGLEN		256
+
+static ICA_ED25519_CTX *ctx[BATCH_SIZE];
+static unsigned char msg[BATCH_SIZE][MSGLEN];
+static unsigned char sig[BATCH_SIZE][64];
+static unsigned char pub[BATCH_SIZE][32];
+static size_t msglen[BATCH_SIZE];
+
+static const unsigned char *msg_ptr[BATCH_SIZE];
+static const unsigned char *sig_ptr[BATCH_SIZE];
+static const unsigned char *pub_ptr[BATCH_SIZE];
+
+/*
+ * Signatures of TORSION_MSG whose public key A or R part has a component
+ * of small order T. They all pass the cofactored verification equation,
+ * but libica uses the cofactorless one, like KDSA, which accepts only
+ * those where the small order components cancel.
+ */
+#define TORSION_MSG	"torsion"
+
+static const struct {
+	unsigned char pub[32];
+	unsigned char sig[64];
+	int valid;
+} torsion_tv[] = {
+	/* R = [r]B + T, T of order 8 */
+	{
+	  {
+	    0x75, 0x8b, 0x89, 0x0e, 0x14, 0xd8, 0x6c, 0xb8,
+	    0xce, 0x8e, 0xaf, 0x22, 0xf7, 0x06, 0x1c, 0x54,
+	    0x80, 0x1d, 0x3f, 0x89, 0x56, 0x78, 0x4e, 0xdd,
+	    0xeb, 0x86, 0x4b, 0x6e, 0xff, 0xfd, 0x4e, 0x3e },
+	  {
+	    0xfc, 0xf4, 0x2a, 0xae, 0xea, 0xa1, 0xb8, 0xf2,
+	    0x7f, 0xd5, 0xee, 0x47, 0x9e, 0x23, 0x77, 0x87,
+	    0xb5, 0x60, 0x45, 0x18, 0xbd, 0x1d, 0xe1, 0x67,
+	    0x3b, 0x73, 0xab, 0xc1, 0xe1, 0x19, 0x23, 0xef,
+	    0x4a, 0x49, 0x2b, 0xea, 0x90, 0xca, 0x80, 0x0f,
+	    0x6d, 0x62, 0x94, 0x30, 0xb0, 0x0b, 0xf2, 0x25,
+	    0x9c, 0x67, 0x0d, 0x05, 0xaf, 0x1d, 0x81, 0x57,
+	    0x9b, 0xea, 0xe9, 0x26, 0x7f, 0x67, 0x1b, 0x01 },
+	  0,
+	},
+	/* A = [a]B + T, R with the matching small order component */
+	{
+	  {
+	    0x3a, 0x45, 0xf1, 0x0c, 0x96, 0xe0, 0xc8, 0x2d,
+	    0x9c, 0xdf, 0x8e, 0xad, 0x68, 0xa2, 0x88, 0xef,
+	    0xae, 0x72, 0x6f, 0x37, 0x02, 0x34, 0x06, 0xdb,
+	    0xaa, 0x97, 0xf7, 0xc5, 0x3d, 0xc1, 0x5d, 0x97 },
+	  {
+	    0x21, 0xbb, 0xeb, 0xd7, 0x9a, 0x04, 0xd0, 0xa2,
+	    0xec, 0xdf, 0xf1, 0x01, 0x62, 0xc8, 0xee, 0x62,
+	    0xf3, 0x66, 0x15, 0xc0, 0x97, 0x4a, 0x0a, 0x31,
+	    0x57, 0xe5, 0x37, 0xea, 0x06, 0x4a, 0x23, 0x69,
+	    0x75, 0x96, 0x98, 0x23, 0x29, 0xd3, 0x1e, 0x3c,
+	    0x12, 0x70, 0x61, 0x56, 0x5e, 0x5a, 0xb5, 0x4c,
+	    0xb3, 0xe1, 0xe2, 0x42, 0xad, 0x66, 0x46, 0xe2,
+	    0x4d, 0x28, 0xe2, 0x04, 0x69, 0xdd, 0xd7, 0x00 },
+	  1,
+	},
+	/* A = [a]B + T, R = [r]B */
+	{
+	  {
+	    0x3a, 0x45, 0xf1, 0x0c, 0x96, 0xe0, 0xc8, 0x2d,
+	    0x9c, 0xdf, 0x8e, 0xad, 0x68, 0xa2, 0x88, 0xef,
+	    0xae, 0x72, 0x6f, 0x37, 0x02, 0x34, 0x06, 0xdb,
+	    0xaa, 0x97, 0xf7, 0xc5, 0x3d, 0xc1, 0x5d, 0x97 },
+	  {
+	    0xcc, 0x44, 0x14, 0x28, 0x65, 0xfb, 0x2f, 0x5d,
+	    0x13, 0x20, 0x0e, 0xfe, 0x9d, 0x37, 0x11, 0x9d,
+	    0x0c, 0x99, 0xea, 0x3f, 0x68, 0xb5, 0xf5, 0xce,
+	    0xa8, 0x1a, 0xc8, 0x15, 0xf9, 0xb5, 0xdc, 0x96,
+	    0x77, 0x82, 0xea, 0x50, 0xf2, 0xcd, 0x8a, 0xf9,
+	    0x33, 0xd4, 0x03, 0x28, 0x38, 0x69, 0xcb, 0x0f,
+	    0x85, 0x27, 0x4f, 0x31, 0x79, 0x2e, 0x17, 0xe3,
+	    0x84, 0x55, 0x38, 0x59, 0x68, 0xb9, 0xc4, 0x02 },
+	  0,
+	},
+};
+
+static void check_functionlist(void)
+{
+	unsigned int i, listlen, func;
+	libica_func_list_element *list;
+
+	if (ica_get_functionlist(NULL, &listlen))
+		EXIT_ERR("ica_get_functionlist failed.");
+
+	func = 0;
+
+	list = calloc(1, sizeof(*list) * listlen);
+	if (list == NULL)
+		EXIT_ERR("calloc failed.");
+
+	if (ica_get_functionlist(list, &listlen))
+		EXIT_ERR("ica_get_functionlist failed.");
+
+	for (i = 0; i < listlen; i++) {
+		if (list[i].mech_mode_id == ED25519_SIGN
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
+			func |= 0x01;
+		if (list[i].mech_mode_id == ED25519_VERIFY
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
+			func |= 0x02;
+	}
+
+	free(list);
+
+	if (func != (0x01 | 0x02))
+		exit(TEST_SKIP);
+}
+
+/* The batch result must match verifying each signature on its own. */
+static void check_batch(unsigned int num, int expect_valid)
+{
+	int status[BATCH_SIZE], rc, single, all_valid = 1;
+	unsigned int i;
+
+	rc = ica_ed25519_verify_batch(num, msg_ptr, msglen, sig_ptr, pub_ptr,
+				      status);
+
+	for (i = 0; i < num; i++) {
+		if (ica_ed25519_key_set(ctx[i], NULL, pub[i]))
+			EXIT_ERR("ica_ed25519_key_set failed.");
+		single = ica_ed25519_verify(ctx[i], sig[i], msg_ptr[i],
+					    msglen[i]);
+		if ((single != 0) != (status[i] != 0)) {
+			V_(printf("Signature %u: batch %d, single %d\n", i,
+				  status[i], single));
+			EXIT_ERR("ica_ed25519_verify_batch status mismatch.");
+		}
+		if (single)
+			all_valid = 0;
+	}
+
+	if (all_valid != expect_valid || (rc == 0) != all_valid)
+		EXIT_ERR("ica_ed25519_verify_batch returned wrong result.");
+
+	/* status is optional */
+	rc = ica_ed25519_verify_batch(num, msg_ptr, msglen, sig_ptr, pub_ptr,
+				      NULL);
+	if ((rc == 0) != all_valid)
+		EXIT_ERR("ica_ed25519_verify_batch without status failed.");
+}
+
+/* Batches of sizes below and above the software batch threshold. */
+static void check_torsion(void)
+{
+	static const unsigned int sizes[] = { 1, 2, 3, 4, 5, 16, BATCH_SIZE };
+	unsigned char pub_save[32], sig_save[64];
+	size_t msglen_save;
+	unsigned int i, j;
+
+	memcpy(pub_save, pub[0], sizeof(pub_save));
+	memcpy(sig_save, sig[0], sizeof(sig_save));
+	msglen_save = msglen[0];
+
+	for (i = 0; i < sizeof(torsion_tv) / sizeof(torsion_tv[0]); i++) {
+		memcpy(pub[0], torsion_tv[i].pub, sizeof(pub[0]));
+		memcpy(sig[0], torsion_tv[i].sig, sizeof(sig[0]));
+		msg_ptr[0] = (const unsigned char *)TORSION_MSG;
+		msglen[0] = strlen(TORSION_MSG);
+
+		for (j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+			check_batch(sizes[j], torsion_tv[i].valid);
+	}
+
+	memcpy(pub[0], pub_save, sizeof(pub_save));
+	memcpy(sig[0], sig_save, sizeof(sig_save));
+	msg_ptr[0] = msg[0];
+	msglen[0] = msglen_save;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int i;
+	size_t j;
+
+	set_verbosity(argc, argv);
+
+	check_functionlist();
+
+	srand(time(NULL));
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		msglen[i] = rand() % MSGLEN;
+		for (j = 0; j < msglen[i]; j++)
+			msg[i][j] = rand();
+
+		if (ica_ed25519_ctx_new(&ctx[i]))
+			EXIT_ERR("ica_ed25519_ctx_new failed.");
+		if (ica_ed25519_key_gen(ctx[i]))
+			EXIT_ERR("ica_ed25519_key_gen failed.");
+		if (ica_ed25519_key_get(ctx[i], NULL, pub[i]))
+			EXIT_ERR("ica_ed25519_key_get failed.");
+		if (ica_ed25519_sign(ctx[i], sig[i], msg[i], msglen[i]))
+			EXIT_ERR("ica_ed25519_sign failed.");
+
+		msg_ptr[i] = msg[i];
+		sig_ptr[i] = sig[i];
+		pub_ptr[i] = pub[i];
+	}
+
+	/* invalid parameters */
+	if (ica_ed25519_verify_batch(0, msg_ptr, msglen, sig_ptr, pub_ptr,
+				     NULL) == 0)
+		EXIT_ERR("ica_ed25519_verify_batch accepted an empty batch.");
+	if (ica_ed25519_verify_batch(BATCH_SIZE, msg_ptr, msglen, NULL,
+				     pub_ptr, NULL) == 0)
+		EXIT_ERR("ica_ed25519_verify_batch accepted NULL signatures.");
+
+	VV_(printf("\n=== ED25519 BATCH: valid ===\n"));
+	check_batch(1, 1);
+	check_batch(5, 1);
+	check_batch(BATCH_SIZE, 1);
+
+	VV_(printf("\n=== ED25519 BATCH: invalid ===\n"));
+	sig[3][40] ^= 0x01;		/* S */
+	sig[17][2] ^= 0x10;		/* R */
+	pub[42][7] ^= 0x04;		/* public key */
+	sig[60][63] |= 0x80;		/* S >= l */
+	check_batch(BATCH_SIZE, 0);
+
+	/* valid signatures again, but one for the wrong message */
+	sig[3][40] ^= 0x01;
+	sig[17][2] ^= 0x10;
+	pub[42][7] ^= 0x04;
+	sig[60][63] &= 0x7f;
+	msg_ptr[9] = msg[10];
+	j = msglen[9];
+	msglen[9] = msglen[10];
+	check_batch(BATCH_SIZE, 0);
+	msg_ptr[9] = msg[9];
+	msglen[9] = j;
+
+	VV_(printf("\n=== ED25519 BATCH: small order components ===\n"));
+	check_torsion();
+
+	for (i = 0; i < BATCH_SIZE; i++) {
+		if (ica_ed25519_ctx_del(&ctx[i]))
+			EXIT_ERR("ica_ed25519_ctx_del failed.");
+	}
+
+	printf("All Ed25519 batch verification tests passed.\n");
+	return TEST_SUCC;
+}
@@ -96,22 +96,22 @@ static void check_functionlist(void)
 
 	for (i = 0; i < listlen; i++) {
 		if (list[i].mech_mode_id == ED25519_KEYGEN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x01;
 		if (list[i].mech_mode_id == ED25519_SIGN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x02;
 		if (list[i].mech_mode_id == ED25519_VERIFY
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x04;
 		if (list[i].mech_mode_id == ED448_KEYGEN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x08;
 		if (list[i].mech_mode_id == ED448_SIGN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x10;
 		if (list[i].mech_mode_id == ED448_VERIFY
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x20;
 	}
 
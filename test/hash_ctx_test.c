@@ -0,0 +1,234 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/uio.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MSGLEN		5000
+#define ITERATIONS	20
+
+static unsigned char msg[MSGLEN];
+
+static const struct {
+	unsigned int alg;
+	const char *name;
+	unsigned int hashlen;
+} algs[] = {
+	{ SHA1, "SHA-1", SHA1_HASH_LENGTH },
+	{ SHA224, "SHA-224", SHA224_HASH_LENGTH },
+	{ SHA256, "SHA-256", SHA256_HASH_LENGTH },
+	{ SHA384, "SHA-384", SHA384_HASH_LENGTH },
+	{ SHA512, "SHA-512", SHA512_HASH_LENGTH },
+	{ SHA3_224, "SHA3-224", SHA3_224_HASH_LENGTH },
+	{ SHA3_256, "SHA3-256", SHA3_256_HASH_LENGTH },
+	{ SHA3_384, "SHA3-384", SHA3_384_HASH_LENGTH },
+	{ SHA3_512, "SHA3-512", SHA3_512_HASH_LENGTH },
+};
+
+/* the reference digest of the first len bytes of msg */
+static int oneshot(unsigned int alg, unsigned int len, unsigned char *out)
+{
+	sha_context_t sha_context;
+	sha256_context_t sha256_context;
+	sha512_context_t sha512_context;
+	sha3_224_context_t sha3_224_context;
+	sha3_256_context_t sha3_256_context;
+	sha3_384_context_t sha3_384_context;
+	sha3_512_context_t sha3_512_context;
+
+	switch (alg) {
+	case SHA1:
+		return ica_sha1(SHA_MSG_PART_ONLY, len, msg, &sha_context,
+				out);
+	case SHA224:
+		return ica_sha224(SHA_MSG_PART_ONLY, len, msg,
+				  &sha256_context, out);
+	case SHA256:
+		return ica_sha256(SHA_MSG_PART_ONLY, len, msg,
+				  &sha256_context, out);
+	case SHA384:
+		return ica_sha384(SHA_MSG_PART_ONLY, len, msg,
+				  &sha512_context, out);
+	case SHA512:
+		return ica_sha512(SHA_MSG_PART_ONLY, len, msg,
+				  &sha512_context, out);
+	case SHA3_224:
+		return ica_sha3_224(SHA_MSG_PART_ONLY, len, msg,
+				    &sha3_224_context, out);
+	case SHA3_256:
+		return ica_sha3_256(SHA_MSG_PART_ONLY, len, msg,
+				    &sha3_256_context, out);
+	case SHA3_384:
+		return ica_sha3_384(SHA_MSG_PART_ONLY, len, msg,
+				    &sha3_384_context, out);
+	default:
+		return ica_sha3_512(SHA_MSG_PART_ONLY, len, msg,
+				    &sha3_512_context, out);
+	}
+}
+
+static int check(const char *name, const unsigned char *digest,
+		 const unsigned char *expected, unsigned int hashlen,
+		 const char *what)
+{
+	if (memcmp(digest, expected, hashlen)) {
+		printf("%s: %s digest differs\n", name, what);
+		dump_array((unsigned char *)digest, hashlen);
+		dump_array((unsigned char *)expected, hashlen);
+		return TEST_FAIL;
+	}
+	return TEST_SUCC;
+}
+
+static int run_alg(unsigned int a)
+{
+	unsigned char expected[SHA512_HASH_LENGTH], digest[SHA512_HASH_LENGTH];
+	unsigned char copy_digest[SHA512_HASH_LENGTH];
+	ica_hash_ctx_t *ctx, *copy;
+	struct iovec iov[8];
+	unsigned int len, off, n, i, iter;
+	int rc;
+
+	/* the copy takes over the algorithm of the context it is copied from */
+	rc = ica_hash_ctx_new(algs[a].alg, &ctx);
+	if (rc == 0)
+		rc = ica_hash_ctx_new(algs[(a + 1) % (sizeof(algs) /
+					  sizeof(algs[0]))].alg, &copy);
+	if (rc) {
+		printf("ica_hash_ctx_new failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	for (iter = 0; iter < ITERATIONS; iter++) {
+		len = rand() % MSGLEN + 1;
+		rc = oneshot(algs[a].alg, len, expected);
+		if (rc == ENODEV) {
+			printf("Skipping %s, not available\n", algs[a].name);
+			goto out;
+		}
+		if (rc) {
+			printf("%s one-shot hash failed with %d\n",
+			       algs[a].name, rc);
+			return TEST_FAIL;
+		}
+
+		/* updates of random size, including empty ones */
+		for (off = 0; off < len; off += n) {
+			n = rand() % 300;
+			if (n > len - off)
+				n = len - off;
+			rc = ica_hash_update(ctx, msg + off, n);
+			if (rc) {
+				printf("ica_hash_update failed with %d\n", rc);
+				return TEST_FAIL;
+			}
+			/* fork off a copy in the middle of the message */
+			if (off < len / 2 && off + n >= len / 2) {
+				rc = ica_hash_ctx_copy(copy, ctx);
+				if (rc) {
+					printf("ica_hash_ctx_copy failed with %d\n",
+					       rc);
+					return TEST_FAIL;
+				}
+				rc = ica_hash_update(copy, msg + off + n,
+						     len - off - n);
+				if (rc == 0)
+					rc = ica_hash_final(copy, copy_digest);
+				if (rc) {
+					printf("hashing the copy failed with %d\n",
+					       rc);
+					return TEST_FAIL;
+				}
+				if (check(algs[a].name, copy_digest, expected,
+					  algs[a].hashlen, "copied context"))
+					return TEST_FAIL;
+			}
+		}
+		rc = ica_hash_final(ctx, digest);
+		if (rc) {
+			printf("ica_hash_final failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+		if (check(algs[a].name, digest, expected, algs[a].hashlen,
+			  "streamed"))
+			return TEST_FAIL;
+
+		/* the same message as scatter-gather list */
+		for (i = 0, off = 0; i < 8; i++, off += n) {
+			n = i < 7 ? rand() % (len - off + 1) : len - off;
+			iov[i].iov_base = msg + off;
+			iov[i].iov_len = n;
+		}
+		rc = ica_hash_updatev(ctx, iov, 8);
+		if (rc == 0)
+			rc = ica_hash_final(ctx, digest);
+		if (rc) {
+			printf("ica_hash_updatev failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+		if (check(algs[a].name, digest, expected, algs[a].hashlen,
+			  "iovec"))
+			return TEST_FAIL;
+	}
+
+	/* an aborted message does not leak into the next one */
+	rc = oneshot(algs[a].alg, 100, expected);
+	if (rc == 0)
+		rc = ica_hash_update(ctx, msg + 1, 777);
+	if (rc == 0)
+		rc = ica_hash_init(ctx);
+	if (rc == 0)
+		rc = ica_hash_update(ctx, msg, 100);
+	if (rc == 0)
+		rc = ica_hash_final(ctx, digest);
+	if (rc) {
+		printf("reinitialized context failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	if (check(algs[a].name, digest, expected, algs[a].hashlen,
+		  "reinitialized"))
+		return TEST_FAIL;
+
+	VV_(printf("%s passed\n", algs[a].name));
+out:
+	ica_hash_ctx_free(ctx);
+	ica_hash_ctx_free(copy);
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	ica_hash_ctx_t *ctx;
+	unsigned int i;
+
+	set_verbosity(argc, argv);
+
+	srand(time(NULL));
+	for (i = 0; i < MSGLEN; i++)
+		msg[i] = rand();
+
+	if (ica_hash_ctx_new(SHAKE128, &ctx) != EINVAL) {
+		printf("ica_hash_ctx_new accepted SHAKE128\n");
+		return TEST_FAIL;
+	}
+	ica_hash_ctx_free(NULL);
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++) {
+		if (run_alg(i))
+			return TEST_FAIL;
+	}
+
+	printf("All hash context tests passed.\n");
+	return TEST_SUCC;
+}
@@ -0,0 +1,169 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/opensslv.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MAX_KEYLEN	300
+#define MAX_MSGLEN	2000
+#define ITERATIONS	50
+
+/* RFC 4231, test case 2 */
+static const unsigned char rfc4231_key[] = "Jefe";
+static const unsigned char rfc4231_msg[] = "what do ya want for nothing?";
+static const unsigned char rfc4231_mac[] = {
+	0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e,
+	0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+	0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+	0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43,
+};
+
+static unsigned char key[MAX_KEYLEN];
+static unsigned char msg[MAX_MSGLEN];
+
+static const struct {
+	unsigned int alg;
+	const char *name;
+	const EVP_MD *(*md)(void);
+} algs[] = {
+	{ SHA1, "HMAC-SHA-1", EVP_sha1 },
+	{ SHA224, "HMAC-SHA-224", EVP_sha224 },
+	{ SHA256, "HMAC-SHA-256", EVP_sha256 },
+	{ SHA384, "HMAC-SHA-384", EVP_sha384 },
+	{ SHA512, "HMAC-SHA-512", EVP_sha512 },
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	{ SHA3_224, "HMAC-SHA3-224", EVP_sha3_224 },
+	{ SHA3_256, "HMAC-SHA3-256", EVP_sha3_256 },
+	{ SHA3_384, "HMAC-SHA3-384", EVP_sha3_384 },
+	{ SHA3_512, "HMAC-SHA3-512", EVP_sha3_512 },
+#endif
+};
+
+static int run_alg(unsigned int a)
+{
+	unsigned char mac[EVP_MAX_MD_SIZE], expected[EVP_MAX_MD_SIZE];
+	unsigned int keylen, msglen, maclen, off, n, iter;
+	ica_hmac_ctx_t *ctx;
+	int rc;
+
+	for (iter = 0; iter < ITERATIONS; iter++) {
+		/* keys shorter and longer than the block length */
+		keylen = rand() % MAX_KEYLEN;
+		msglen = rand() % MAX_MSGLEN;
+
+		if (HMAC(algs[a].md(), key, keylen, msg, msglen, expected,
+			 &maclen) == NULL) {
+			printf("OpenSSL HMAC failed\n");
+			return TEST_FAIL;
+		}
+
+		rc = ica_hmac_ctx_new(algs[a].alg, key, keylen, &ctx);
+		if (rc == ENODEV) {
+			printf("Skipping %s, not available\n", algs[a].name);
+			return TEST_SUCC;
+		}
+		if (rc) {
+			printf("ica_hmac_ctx_new failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+
+		/* the same context for several messages */
+		for (n = 0; n < 3; n++) {
+			rc = ica_hmac(ctx, msg, msglen, mac);
+			if (rc) {
+				printf("ica_hmac failed with %d\n", rc);
+				return TEST_FAIL;
+			}
+			if (memcmp(mac, expected, maclen)) {
+				printf("%s: MAC differs (key %u, message %u "
+				       "bytes)\n", algs[a].name, keylen, msglen);
+				dump_array(mac, maclen);
+				dump_array(expected, maclen);
+				return TEST_FAIL;
+			}
+		}
+
+		/* streamed in random pieces after an aborted message */
+		rc = ica_hmac_update(ctx, key, keylen);
+		if (rc == 0)
+			rc = ica_hmac_init(ctx);
+		for (off = 0; rc == 0 && off < msglen; off += n) {
+			n = rand() % 200;
+			if (n > msglen - off)
+				n = msglen - off;
+			rc = ica_hmac_update(ctx, msg + off, n);
+		}
+		if (rc == 0)
+			rc = ica_hmac_final(ctx, mac);
+		if (rc) {
+			printf("streaming %s failed with %d\n", algs[a].name,
+			       rc);
+			return TEST_FAIL;
+		}
+		if (memcmp(mac, expected, maclen)) {
+			printf("%s: streamed MAC differs\n", algs[a].name);
+			return TEST_FAIL;
+		}
+
+		ica_hmac_ctx_free(ctx);
+	}
+
+	VV_(printf("%s passed\n", algs[a].name));
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char mac[SHA256_HASH_LENGTH];
+	ica_hmac_ctx_t *ctx;
+	unsigned int i;
+	int rc;
+
+	set_verbosity(argc, argv);
+
+	rc = ica_hmac_ctx_new(SHA256, rfc4231_key, sizeof(rfc4231_key) - 1,
+			      &ctx);
+	if (rc == 0)
+		rc = ica_hmac(ctx, rfc4231_msg, sizeof(rfc4231_msg) - 1, mac);
+	if (rc) {
+		printf("HMAC-SHA-256 known answer test failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	if (memcmp(mac, rfc4231_mac, sizeof(mac))) {
+		printf("HMAC-SHA-256 known answer test: MAC differs\n");
+		return TEST_FAIL;
+	}
+	ica_hmac_ctx_free(ctx);
+
+	if (ica_hmac_ctx_new(SHAKE256, rfc4231_key, 4, &ctx) != EINVAL) {
+		printf("ica_hmac_ctx_new accepted SHAKE256\n");
+		return TEST_FAIL;
+	}
+
+	srand(time(NULL));
+	for (i = 0; i < MAX_KEYLEN; i++)
+		key[i] = rand();
+	for (i = 0; i < MAX_MSGLEN; i++)
+		msg[i] = rand();
+
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++) {
+		if (run_alg(i))
+			return TEST_FAIL;
+	}
+
+	printf("All HMAC tests passed.\n");
+	return TEST_SUCC;
+}
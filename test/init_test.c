@@ -0,0 +1,45 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+int main(int argc, char **argv)
+{
+	libica_func_list_element *list;
+	unsigned char buf[64];
+	unsigned int listlen;
+
+	set_verbosity(argc, argv);
+
+	/* lazily initialized parts are used before ica_init() */
+	if (ica_get_functionlist(NULL, &listlen))
+		EXIT_ERR("ica_get_functionlist failed.");
+	if (ica_random_number_generate(sizeof(buf), buf))
+		EXIT_ERR("ica_random_number_generate failed.");
+
+	if (ica_init())
+		EXIT_ERR("ica_init failed.");
+	if (ica_init())
+		EXIT_ERR("second ica_init failed.");
+
+	list = calloc(listlen, sizeof(*list));
+	if (list == NULL)
+		EXIT_ERR("calloc failed.");
+	if (ica_get_functionlist(list, &listlen))
+		EXIT_ERR("ica_get_functionlist failed.");
+	free(list);
+
+	if (ica_random_number_generate(sizeof(buf), buf))
+		EXIT_ERR("ica_random_number_generate failed.");
+
+	printf("All init tests passed.\n");
+	return TEST_SUCC;
+}
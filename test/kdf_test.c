@@ -0,0 +1,173 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include <openssl/opensslv.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MAX_DKLEN	300
+
+/* RFC 6070, PBKDF2-HMAC-SHA1 with c = 2 */
+static const unsigned char pbkdf2_dk[] = {
+	0xea, 0x6c, 0x01, 0x4d, 0xc7, 0x2d, 0x6f, 0x8c, 0xcd, 0x1e,
+	0xd9, 0x2a, 0xce, 0x1d, 0x41, 0xf0, 0xd8, 0xde, 0x89, 0x57,
+};
+
+/* RFC 5869, test cases 1 and 3 */
+static const unsigned char hkdf_ikm[22] = {
+	0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+	0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b, 0x0b,
+};
+static const unsigned char hkdf_salt[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c,
+};
+static const unsigned char hkdf_info[] = {
+	0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9,
+};
+static const unsigned char hkdf_okm1[42] = {
+	0x3c, 0xb2, 0x5f, 0x25, 0xfa, 0xac, 0xd5, 0x7a, 0x90, 0x43, 0x4f,
+	0x64, 0xd0, 0x36, 0x2f, 0x2a, 0x2d, 0x2d, 0x0a, 0x90, 0xcf, 0x1a,
+	0x5a, 0x4c, 0x5d, 0xb0, 0x2d, 0x56, 0xec, 0xc4, 0xc5, 0xbf, 0x34,
+	0x00, 0x72, 0x08, 0xd5, 0xb8, 0x87, 0x18, 0x58, 0x65,
+};
+static const unsigned char hkdf_okm3[42] = {
+	0x8d, 0xa4, 0xe7, 0x75, 0xa5, 0x63, 0xc1, 0x8f, 0x71, 0x5f, 0x80,
+	0x2a, 0x06, 0x3c, 0x5a, 0x31, 0xb8, 0xa1, 0x1f, 0x5c, 0x5e, 0xe1,
+	0x87, 0x9e, 0xc3, 0x45, 0x4e, 0x5f, 0x3c, 0x73, 0x8d, 0x2d, 0x9d,
+	0x20, 0x13, 0x95, 0xfa, 0xa4, 0xb6, 0x1a, 0x96, 0xc8,
+};
+
+static const struct {
+	unsigned int alg;
+	const char *name;
+	const EVP_MD *(*md)(void);
+} algs[] = {
+	{ SHA1, "SHA-1", EVP_sha1 },
+	{ SHA256, "SHA-256", EVP_sha256 },
+	{ SHA512, "SHA-512", EVP_sha512 },
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+	{ SHA3_224, "SHA3-224", EVP_sha3_224 },
+	{ SHA3_512, "SHA3-512", EVP_sha3_512 },
+#endif
+};
+
+static int known_answers(void)
+{
+	unsigned char out[42];
+	int rc;
+
+	rc = ica_pbkdf2(SHA1, (const unsigned char *)"password", 8,
+			(const unsigned char *)"salt", 4, 2, out,
+			sizeof(pbkdf2_dk));
+	if (rc || memcmp(out, pbkdf2_dk, sizeof(pbkdf2_dk))) {
+		printf("PBKDF2 known answer test failed (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	rc = ica_hkdf(SHA256, hkdf_ikm, sizeof(hkdf_ikm), hkdf_salt,
+		      sizeof(hkdf_salt), hkdf_info, sizeof(hkdf_info), out,
+		      sizeof(hkdf_okm1));
+	if (rc || memcmp(out, hkdf_okm1, sizeof(hkdf_okm1))) {
+		printf("HKDF known answer test 1 failed (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	rc = ica_hkdf(SHA256, hkdf_ikm, sizeof(hkdf_ikm), NULL, 0, NULL, 0,
+		      out, sizeof(hkdf_okm3));
+	if (rc || memcmp(out, hkdf_okm3, sizeof(hkdf_okm3))) {
+		printf("HKDF known answer test 3 failed (%d)\n", rc);
+		return TEST_FAIL;
+	}
+
+	return TEST_SUCC;
+}
+
+static int run_alg(unsigned int a)
+{
+	unsigned char password[40], salt[24];
+	unsigned char dk[MAX_DKLEN], expected[MAX_DKLEN];
+	unsigned int iterations, dklen, i;
+	int rc;
+
+	for (i = 0; i < sizeof(password); i++)
+		password[i] = rand();
+	for (i = 0; i < sizeof(salt); i++)
+		salt[i] = rand();
+
+	/* derived keys of one up to several output blocks */
+	for (dklen = 1; dklen <= MAX_DKLEN; dklen += 37) {
+		iterations = rand() % 2000 + 1;
+
+		if (!PKCS5_PBKDF2_HMAC((const char *)password,
+				       sizeof(password), salt, sizeof(salt),
+				       iterations, algs[a].md(), dklen,
+				       expected)) {
+			printf("OpenSSL PBKDF2 failed\n");
+			return TEST_FAIL;
+		}
+
+		rc = ica_pbkdf2(algs[a].alg, password, sizeof(password), salt,
+				sizeof(salt), iterations, dk, dklen);
+		if (rc == ENODEV) {
+			printf("Skipping %s, not available\n", algs[a].name);
+			return TEST_SUCC;
+		}
+		if (rc) {
+			printf("ica_pbkdf2 failed with %d\n", rc);
+			return TEST_FAIL;
+		}
+		if (memcmp(dk, expected, dklen)) {
+			printf("PBKDF2-HMAC-%s: %u bytes, %u iterations "
+			       "differ\n", algs[a].name, dklen, iterations);
+			dump_array(dk, dklen);
+			dump_array(expected, dklen);
+			return TEST_FAIL;
+		}
+	}
+
+	VV_(printf("PBKDF2-HMAC-%s passed\n", algs[a].name));
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned char out[32];
+	unsigned int i;
+
+	set_verbosity(argc, argv);
+
+	if (known_answers())
+		return TEST_FAIL;
+
+	if (ica_pbkdf2(SHA256, (const unsigned char *)"pw", 2, NULL, 0, 0,
+		       out, sizeof(out)) != EINVAL) {
+		printf("ica_pbkdf2 accepted zero iterations\n");
+		return TEST_FAIL;
+	}
+	if (ica_hkdf(SHA256, hkdf_ikm, sizeof(hkdf_ikm), NULL, 0, NULL, 0,
+		     out, 255 * SHA256_HASH_LENGTH + 1) != EINVAL) {
+		printf("ica_hkdf accepted an overlong output\n");
+		return TEST_FAIL;
+	}
+
+	srand(time(NULL));
+	for (i = 0; i < sizeof(algs) / sizeof(algs[0]); i++) {
+		if (run_alg(i))
+			return TEST_FAIL;
+	}
+
+	printf("All key derivation tests passed.\n");
+	return TEST_SUCC;
+}
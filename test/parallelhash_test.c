@@ -0,0 +1,173 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MSGLEN		(1024 * 1024 + 77)
+#define OUTLEN		200
+
+typedef int (*parallelhash_t)(const unsigned char *, uint64_t, size_t,
+			      const unsigned char *, size_t, unsigned char *,
+			      size_t, unsigned int);
+
+/* NIST SP 800-185 examples */
+static const unsigned char x[24] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27,
+};
+static const unsigned char s[] = "Parallel Data";
+
+static const unsigned char ph128_sample1[32] = {
+	0xba, 0x8d, 0xc1, 0xd1, 0xd9, 0x79, 0x33, 0x1d,
+	0x3f, 0x81, 0x36, 0x03, 0xc6, 0x7f, 0x72, 0x60,
+	0x9a, 0xb5, 0xe4, 0x4b, 0x94, 0xa0, 0xb8, 0xf9,
+	0xaf, 0x46, 0x51, 0x44, 0x54, 0xa2, 0xb4, 0xf5,
+};
+static const unsigned char ph128_sample2[32] = {
+	0xfc, 0x48, 0x4d, 0xcb, 0x3f, 0x84, 0xdc, 0xee,
+	0xdc, 0x35, 0x34, 0x38, 0x15, 0x1b, 0xee, 0x58,
+	0x15, 0x7d, 0x6e, 0xfe, 0xd0, 0x44, 0x5a, 0x81,
+	0xf1, 0x65, 0xe4, 0x95, 0x79, 0x5b, 0x72, 0x06,
+};
+static const unsigned char ph256_sample4[64] = {
+	0xbc, 0x1e, 0xf1, 0x24, 0xda, 0x34, 0x49, 0x5e,
+	0x94, 0x8e, 0xad, 0x20, 0x7d, 0xd9, 0x84, 0x22,
+	0x35, 0xda, 0x43, 0x2d, 0x2b, 0xbc, 0x54, 0xb4,
+	0xc1, 0x10, 0xe6, 0x4c, 0x45, 0x11, 0x05, 0x53,
+	0x1b, 0x7f, 0x2a, 0x3e, 0x0c, 0xe0, 0x55, 0xc0,
+	0x28, 0x05, 0xe7, 0xc2, 0xde, 0x1f, 0xb7, 0x46,
+	0xaf, 0x97, 0xa1, 0xdd, 0x01, 0xf4, 0x3b, 0x82,
+	0x4e, 0x31, 0xb8, 0x76, 0x12, 0x41, 0x04, 0x29,
+};
+
+static const struct {
+	parallelhash_t func;
+	const unsigned char *custom;
+	size_t custom_length;
+	const unsigned char *result;
+	size_t result_length;
+} samples[] = {
+	{ ica_parallelhash128, NULL, 0, ph128_sample1, 32 },
+	{ ica_parallelhash128, s, sizeof(s) - 1, ph128_sample2, 32 },
+	{ ica_parallelhash256, NULL, 0, ph256_sample4, 64 },
+};
+
+static const unsigned int threads[] = { 1, 2, 3, 0, 64 };
+
+static int known_answers(void)
+{
+	unsigned char out[64];
+	unsigned int i, j;
+	int rc;
+
+	for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+		for (j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+			rc = samples[i].func(x, sizeof(x), 8, samples[i].custom,
+					     samples[i].custom_length, out,
+					     samples[i].result_length,
+					     threads[j]);
+			if (rc == ENODEV)
+				exit(TEST_SKIP);
+			if (rc) {
+				printf("ParallelHash sample %u failed with %d\n",
+				       i, rc);
+				return TEST_FAIL;
+			}
+			if (memcmp(out, samples[i].result,
+				   samples[i].result_length)) {
+				printf("ParallelHash sample %u with %u threads "
+				       "failed\n", i, threads[j]);
+				dump_array(out, samples[i].result_length);
+				return TEST_FAIL;
+			}
+		}
+	}
+
+	return TEST_SUCC;
+}
+
+/* the result must not depend on the number of threads */
+static int run_threads(parallelhash_t func, const unsigned char *msg,
+		       size_t block_size)
+{
+	unsigned char ref[OUTLEN], out[OUTLEN];
+	unsigned int j;
+
+	if (func(msg, MSGLEN, block_size, s, sizeof(s) - 1, ref, OUTLEN, 1))
+		return TEST_FAIL;
+
+	for (j = 1; j < sizeof(threads) / sizeof(threads[0]); j++) {
+		if (func(msg, MSGLEN, block_size, s, sizeof(s) - 1, out, OUTLEN,
+			 threads[j])) {
+			printf("ParallelHash with %u threads failed\n",
+			       threads[j]);
+			return TEST_FAIL;
+		}
+		if (memcmp(ref, out, OUTLEN)) {
+			printf("ParallelHash with %u threads and block size "
+			       "%zu differs\n", threads[j], block_size);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t block_sizes[] = { 1, 100, 8192, MSGLEN + 1 };
+	unsigned char *msg, out[OUTLEN];
+	unsigned int i;
+
+	set_verbosity(argc, argv);
+
+	if (known_answers())
+		return TEST_FAIL;
+
+	if (ica_parallelhash128(x, sizeof(x), 0, NULL, 0, out, OUTLEN, 0)
+	    != EINVAL) {
+		printf("ica_parallelhash128 accepted a zero block size\n");
+		return TEST_FAIL;
+	}
+	if (ica_parallelhash256(NULL, 1, 8, NULL, 0, out, OUTLEN, 0)
+	    != EINVAL) {
+		printf("ica_parallelhash256 accepted a NULL message\n");
+		return TEST_FAIL;
+	}
+
+	msg = malloc(MSGLEN);
+	if (msg == NULL)
+		EXIT_ERR("malloc failed.");
+	srand(time(NULL));
+	for (i = 0; i < MSGLEN; i++)
+		msg[i] = rand();
+
+	for (i = 0; i < sizeof(block_sizes) / sizeof(block_sizes[0]); i++) {
+		if (run_threads(ica_parallelhash128, msg, block_sizes[i]) ||
+		    run_threads(ica_parallelhash256, msg, block_sizes[i]))
+			return TEST_FAIL;
+	}
+
+	/* an empty message still has a result */
+	if (ica_parallelhash128(NULL, 0, 8, NULL, 0, out, OUTLEN, 0)) {
+		printf("ica_parallelhash128 failed for an empty message\n");
+		return TEST_FAIL;
+	}
+
+	free(msg);
+
+	printf("All ParallelHash tests passed.\n");
+	return TEST_SUCC;
+}
@@ -0,0 +1,172 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ica_api.h"
+#include "rsa_test.h"
+#include "testcase.h"
+
+#define BATCH_SIZE	16
+
+struct completion {
+	unsigned int done;
+	unsigned int seen[BATCH_SIZE];
+	unsigned int errors;
+};
+
+static void batch_done(void *user_data, unsigned int index, unsigned int rc)
+{
+	struct completion *c = user_data;
+
+	if (index >= BATCH_SIZE || __sync_fetch_and_add(&c->seen[index], 1))
+		__sync_fetch_and_add(&c->errors, 1);
+	if (rc)
+		__sync_fetch_and_add(&c->errors, 1);
+	__sync_fetch_and_add(&c->done, 1);
+}
+
+static int check_completion(struct completion *c, unsigned int *status,
+			    const char *name)
+{
+	unsigned int j;
+
+	if (c->done != BATCH_SIZE || c->errors) {
+		printf("%s: %u of %u callbacks, %u errors\n", name, c->done,
+		       BATCH_SIZE, c->errors);
+		return TEST_FAIL;
+	}
+	for (j = 0; j < BATCH_SIZE; j++) {
+		if (status[j]) {
+			printf("%s: request %u failed with %u\n", name, j,
+			       status[j]);
+			return TEST_FAIL;
+		}
+	}
+	return TEST_SUCC;
+}
+
+/*
+ * Run ME and CRT batches for key @i. With @adapter_handle set to
+ * DRIVER_NOT_LOADED all requests take the software path, which serves as a
+ * local stub device when no crypto adapter is available.
+ */
+static int run_batches(ica_adapter_handle_t adapter_handle, int i,
+		       unsigned int workers)
+{
+	static unsigned char in[BATCH_SIZE][512], out[BATCH_SIZE][512];
+	unsigned char *in_ptr[BATCH_SIZE], *out_ptr[BATCH_SIZE];
+	unsigned int status[BATCH_SIZE];
+	struct completion c;
+	unsigned int j, len = RSA_BYTE_LENGHT[i];
+	int rc;
+
+	ica_rsa_key_mod_expo_t mod_expo_key = {len, n[i], e[i]};
+	ica_rsa_key_crt_t crt_key = {len, p[i], q[i], dp[i], dq[i], qinv[i]};
+
+	for (j = 0; j < BATCH_SIZE; j++) {
+		memcpy(in[j], input_data, len);
+		in_ptr[j] = in[j];
+		out_ptr[j] = out[j];
+	}
+
+	/* encrypt with public key (ME) */
+	memset(out, 0, sizeof(out));
+	memset(&c, 0, sizeof(c));
+	rc = ica_rsa_mod_expo_batch(adapter_handle, BATCH_SIZE, in_ptr,
+				    &mod_expo_key, out_ptr, status, workers,
+				    batch_done, &c);
+	if (rc) {
+		printf("ica_rsa_mod_expo_batch failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	if (check_completion(&c, status, "ica_rsa_mod_expo_batch"))
+		return TEST_FAIL;
+	for (j = 0; j < BATCH_SIZE; j++) {
+		if (memcmp(out[j], ciphertext[i], len)) {
+			printf("Ciphertext mismatch for request %u\n", j);
+			return TEST_FAIL;
+		}
+	}
+
+	/* decrypt with private key (CRT) */
+	for (j = 0; j < BATCH_SIZE; j++)
+		memcpy(in[j], ciphertext[i], len);
+	memset(out, 0, sizeof(out));
+	memset(&c, 0, sizeof(c));
+	rc = ica_rsa_crt_batch(adapter_handle, BATCH_SIZE, in_ptr, &crt_key,
+			       out_ptr, status, workers, batch_done, &c);
+	if (rc) {
+		printf("ica_rsa_crt_batch failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	if (check_completion(&c, status, "ica_rsa_crt_batch"))
+		return TEST_FAIL;
+	for (j = 0; j < BATCH_SIZE; j++) {
+		if (memcmp(out[j], input_data, len)) {
+			printf("Plaintext mismatch for request %u\n", j);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	ica_adapter_handle_t adapter_handle;
+	unsigned char *in_ptr[1], *out_ptr[1];
+	unsigned char buf[512];
+	int i, rc;
+
+	set_verbosity(argc, argv);
+
+	rc = ica_open_adapter(&adapter_handle);
+	if (rc != 0) {
+		V_(printf("ica_open_adapter failed and returned %d (0x%x).\n", rc, rc));
+	}
+
+	/* invalid parameters */
+	ica_rsa_key_mod_expo_t mod_expo_key = {RSA_BYTE_LENGHT[0], n[0], e[0]};
+	in_ptr[0] = NULL;
+	out_ptr[0] = buf;
+	if (ica_rsa_mod_expo_batch(adapter_handle, 1, in_ptr, &mod_expo_key,
+				   out_ptr, NULL, 0, NULL, NULL) != EINVAL) {
+		printf("ica_rsa_mod_expo_batch accepted a NULL input\n");
+		return TEST_FAIL;
+	}
+	if (ica_rsa_mod_expo_batch(adapter_handle, 0, in_ptr, &mod_expo_key,
+				   out_ptr, NULL, 0, NULL, NULL) != EINVAL) {
+		printf("ica_rsa_mod_expo_batch accepted an empty batch\n");
+		return TEST_FAIL;
+	}
+
+	for (i = 0; i < 6; i++) {
+		V_(printf("modulus size = %d\n", RSA_BYTE_LENGHT[i]));
+
+		/* adapter (or fallback), default and single worker */
+		if (run_batches(adapter_handle, i, 0))
+			return TEST_FAIL;
+		if (run_batches(adapter_handle, i, 1))
+			return TEST_FAIL;
+
+		/* stub device: software path only */
+		if (run_batches(DRIVER_NOT_LOADED, i, 8))
+			return TEST_FAIL;
+	}
+
+	rc = ica_close_adapter(adapter_handle);
+	if (rc != 0) {
+		printf("ica_close_adapter failed and returned %d (0x%x).\n", rc, rc);
+		return TEST_FAIL;
+	}
+
+	printf("All RSA batch tests passed.\n");
+	return TEST_SUCC;
+}
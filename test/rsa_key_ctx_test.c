@@ -0,0 +1,122 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ica_api.h"
+#include "rsa_test.h"
+#include "testcase.h"
+
+#define ITERATIONS	4
+
+static int run_key(ica_adapter_handle_t adapter_handle, int i)
+{
+	ica_rsa_key_ctx_t *me_ctx = NULL, *crt_ctx = NULL;
+	unsigned char result[512];
+	unsigned int len = RSA_BYTE_LENGHT[i];
+	int j, rc;
+
+	ica_rsa_key_mod_expo_t mod_expo_key = {len, n[i], e[i]};
+	ica_rsa_key_crt_t crt_key = {len, p[i], q[i], dp[i], dq[i], qinv[i]};
+
+	rc = ica_rsa_key_ctx_new_mod_expo(&mod_expo_key, &me_ctx);
+	if (rc) {
+		printf("ica_rsa_key_ctx_new_mod_expo failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+	rc = ica_rsa_key_ctx_new_crt(&crt_key, &crt_ctx);
+	if (rc) {
+		printf("ica_rsa_key_ctx_new_crt failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	/* the key contexts are reused for several operations */
+	for (j = 0; j < ITERATIONS; j++) {
+		memset(result, 0, sizeof(result));
+		rc = ica_rsa_key_ctx_compute(adapter_handle, me_ctx,
+					     input_data, result);
+		if (rc) {
+			printf("ica_rsa_key_ctx_compute (ME) failed with %d\n",
+			       rc);
+			return TEST_FAIL;
+		}
+		if (memcmp(result, ciphertext[i], len)) {
+			printf("Ciphertext mismatch\n");
+			return TEST_FAIL;
+		}
+
+		memset(result, 0, sizeof(result));
+		rc = ica_rsa_key_ctx_compute(adapter_handle, crt_ctx,
+					     ciphertext[i], result);
+		if (rc) {
+			printf("ica_rsa_key_ctx_compute (CRT) failed with %d\n",
+			       rc);
+			return TEST_FAIL;
+		}
+		if (memcmp(result, input_data, len)) {
+			printf("Plaintext mismatch\n");
+			return TEST_FAIL;
+		}
+	}
+
+	ica_rsa_key_ctx_free(me_ctx);
+	ica_rsa_key_ctx_free(crt_ctx);
+
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	ica_adapter_handle_t adapter_handle;
+	ica_rsa_key_ctx_t *key_ctx = NULL;
+	unsigned char even_modulus[128];
+	int i, rc;
+
+	set_verbosity(argc, argv);
+
+	rc = ica_open_adapter(&adapter_handle);
+	if (rc != 0) {
+		V_(printf("ica_open_adapter failed and returned %d (0x%x).\n", rc, rc));
+	}
+
+	/* invalid keys are rejected when the context is created */
+	memcpy(even_modulus, n[0], sizeof(even_modulus));
+	even_modulus[sizeof(even_modulus) - 1] &= 0xfe;
+	ica_rsa_key_mod_expo_t bad_key = {sizeof(even_modulus), even_modulus,
+					  e[0]};
+	if (ica_rsa_key_ctx_new_mod_expo(&bad_key, &key_ctx) != EINVAL) {
+		printf("ica_rsa_key_ctx_new_mod_expo accepted an even modulus\n");
+		return TEST_FAIL;
+	}
+	if (ica_rsa_key_ctx_new_mod_expo(NULL, &key_ctx) != EINVAL) {
+		printf("ica_rsa_key_ctx_new_mod_expo accepted a NULL key\n");
+		return TEST_FAIL;
+	}
+	ica_rsa_key_ctx_free(NULL);
+
+	for (i = 0; i < 6; i++) {
+		V_(printf("modulus size = %d\n", RSA_BYTE_LENGHT[i]));
+
+		if (run_key(adapter_handle, i))
+			return TEST_FAIL;
+
+		/* software path only */
+		if (run_key(DRIVER_NOT_LOADED, i))
+			return TEST_FAIL;
+	}
+
+	rc = ica_close_adapter(adapter_handle);
+	if (rc != 0) {
+		printf("ica_close_adapter failed and returned %d (0x%x).\n", rc, rc);
+		return TEST_FAIL;
+	}
+
+	printf("All RSA key context tests passed.\n");
+	return TEST_SUCC;
+}
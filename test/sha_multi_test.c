@@ -0,0 +1,127 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define NUM_MSGS	37
+#define MAX_MSGLEN	1000
+
+static unsigned char msg[NUM_MSGS][MAX_MSGLEN];
+static size_t msglen[NUM_MSGS];
+static unsigned char digest[NUM_MSGS][SHA512_HASH_LENGTH];
+static unsigned char single[SHA512_HASH_LENGTH];
+
+static const unsigned char *msg_ptr[NUM_MSGS];
+static unsigned char *digest_ptr[NUM_MSGS];
+
+static int single_hash(unsigned int alg, unsigned int i)
+{
+	sha256_context_t sha256_context;
+	sha512_context_t sha512_context;
+	sha3_256_context_t sha3_256_context;
+
+	switch (alg) {
+	case SHA256:
+		return ica_sha256(SHA_MSG_PART_ONLY, msglen[i], msg[i],
+				  &sha256_context, single);
+	case SHA512:
+		return ica_sha512(SHA_MSG_PART_ONLY, msglen[i], msg[i],
+				  &sha512_context, single);
+	default:
+		return ica_sha3_256(SHA_MSG_PART_ONLY, msglen[i], msg[i],
+				    &sha3_256_context, single);
+	}
+}
+
+static int run_test(unsigned int alg, const char *name, unsigned int hashlen,
+		    unsigned int (*multi)(unsigned int,
+					  const unsigned char *const [],
+					  const size_t [],
+					  unsigned char *const []))
+{
+	unsigned int i, num;
+	int rc;
+
+	/* batches of all sizes, so every grouping of messages is used */
+	for (num = 1; num <= NUM_MSGS; num++) {
+		memset(digest, 0, sizeof(digest));
+
+		rc = multi(num, msg_ptr, msglen, digest_ptr);
+		if (rc) {
+			printf("%s_multi failed with %d\n", name, rc);
+			return TEST_FAIL;
+		}
+
+		for (i = 0; i < num; i++) {
+			rc = single_hash(alg, i);
+			if (rc) {
+				printf("%s failed with %d\n", name, rc);
+				return TEST_FAIL;
+			}
+			if (memcmp(digest[i], single, hashlen)) {
+				printf("%s_multi: digest %u of %u differs\n",
+				       name, i, num);
+				dump_array(digest[i], hashlen);
+				dump_array(single, hashlen);
+				return TEST_FAIL;
+			}
+		}
+	}
+
+	if (multi(0, msg_ptr, msglen, digest_ptr) != EINVAL) {
+		printf("%s_multi accepted an empty batch\n", name);
+		return TEST_FAIL;
+	}
+
+	VV_(printf("%s_multi passed\n", name));
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int i, j;
+
+	set_verbosity(argc, argv);
+
+	srand(time(NULL));
+
+	for (i = 0; i < NUM_MSGS; i++) {
+		/* short messages around the block sizes and a few long ones */
+		msglen[i] = i < NUM_MSGS - 4 ? (i * 7) % 200 + 1
+					     : rand() % MAX_MSGLEN + 1;
+		for (j = 0; j < msglen[i]; j++)
+			msg[i][j] = rand();
+		msg_ptr[i] = msg[i];
+		digest_ptr[i] = digest[i];
+	}
+
+	if (run_test(SHA256, "ica_sha256", SHA256_HASH_LENGTH,
+		     ica_sha256_multi))
+		return TEST_FAIL;
+	if (run_test(SHA512, "ica_sha512", SHA512_HASH_LENGTH,
+		     ica_sha512_multi))
+		return TEST_FAIL;
+
+	if (sha3_available()) {
+		if (run_test(SHA3_256, "ica_sha3_256", SHA3_256_HASH_LENGTH,
+			     ica_sha3_256_multi))
+			return TEST_FAIL;
+	} else {
+		printf("Skipping SHA3-256 batch test, because SHA3 not "
+		       "available on this machine.\n");
+	}
+
+	printf("All multi-buffer hash tests passed.\n");
+	return TEST_SUCC;
+}
@@ -58,16 +58,16 @@ static void check_functionlist(void)
 
 	for (i = 0; i < listlen; i++) {
 		if (list[i].mech_mode_id == X25519_KEYGEN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x01;
 		if (list[i].mech_mode_id == X25519_DERIVE
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x02;
 		if (list[i].mech_mode_id == X448_KEYGEN
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x04;
 		if (list[i].mech_mode_id == X448_DERIVE
-		    && (list[i].flags & 4))
+		    && (list[i].flags & (ICA_FLAG_SHW | ICA_FLAG_SW)))
 			func |= 0x08;
 	}
 
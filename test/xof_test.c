@@ -0,0 +1,138 @@
+/* This program is released under the Common Public License V1.0
+ *
+ * You should have received a copy of Common Public License V1.0 along with
+ * with this program.
+ */
+
+/* Copyright IBM Corp. 2020 */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ica_api.h"
+#include "testcase.h"
+
+#define MSGLEN		1000
+#define OUTLEN		2000
+
+static unsigned char msg[MSGLEN];
+
+/* the whole output in one piece with ica_shake_128/256() */
+static int shake(unsigned int alg, size_t msglen, unsigned char *out)
+{
+	shake_128_context_t ctx128;
+	shake_256_context_t ctx256;
+
+	if (alg == SHAKE128)
+		return ica_shake_128(SHA_MSG_PART_ONLY, msglen, msg, &ctx128,
+				     out, OUTLEN);
+	return ica_shake_256(SHA_MSG_PART_ONLY, msglen, msg, &ctx256, out,
+			     OUTLEN);
+}
+
+static int run_alg(unsigned int alg, size_t msglen)
+{
+	unsigned char ref[OUTLEN], out[OUTLEN], copy[OUTLEN];
+	ica_xof_ctx_t *ctx, *ctx2;
+	size_t i, n;
+	int rc;
+
+	/* the copy takes over the algorithm of the context it is copied from */
+	rc = ica_xof_ctx_new(alg, &ctx);
+	if (rc == ENODEV)
+		exit(TEST_SKIP);
+	if (rc || ica_xof_ctx_new(alg == SHAKE128 ? SHAKE256 : SHAKE128,
+				  &ctx2)) {
+		printf("ica_xof_ctx_new failed with %d\n", rc);
+		return TEST_FAIL;
+	}
+
+	if (shake(alg, msglen, ref)) {
+		printf("ica_shake failed\n");
+		return TEST_FAIL;
+	}
+
+	/* absorb and squeeze in pieces of random length */
+	for (i = 0; i < msglen; i += n) {
+		n = rand() % 400;
+		if (n > msglen - i)
+			n = msglen - i;
+		if (ica_xof_absorb(ctx, msg + i, n)) {
+			printf("ica_xof_absorb failed\n");
+			return TEST_FAIL;
+		}
+	}
+	if (ica_xof_ctx_copy(ctx2, ctx)) {
+		printf("ica_xof_ctx_copy failed\n");
+		return TEST_FAIL;
+	}
+	for (i = 0; i < OUTLEN; i += n) {
+		n = rand() % 300;
+		if (n > OUTLEN - i)
+			n = OUTLEN - i;
+		if (ica_xof_squeeze(ctx, out + i, n)) {
+			printf("ica_xof_squeeze failed\n");
+			return TEST_FAIL;
+		}
+	}
+	if (memcmp(out, ref, OUTLEN)) {
+		printf("SHAKE%u output differs for a %zu byte message\n",
+		       alg == SHAKE128 ? 128 : 256, msglen);
+		dump_array(out, OUTLEN);
+		return TEST_FAIL;
+	}
+
+	/* the copy continues independently */
+	if (ica_xof_squeeze(ctx2, copy, OUTLEN) ||
+	    memcmp(copy, ref, OUTLEN)) {
+		printf("Copied context differs\n");
+		return TEST_FAIL;
+	}
+
+	/* no more input once output has been taken */
+	if (ica_xof_absorb(ctx, msg, 1) != EINVAL) {
+		printf("ica_xof_absorb accepted data after squeezing\n");
+		return TEST_FAIL;
+	}
+
+	/* a new message */
+	if (ica_xof_init(ctx) || ica_xof_absorb(ctx, msg, msglen) ||
+	    ica_xof_squeeze(ctx, out, OUTLEN) || memcmp(out, ref, OUTLEN)) {
+		printf("Reinitialized context differs\n");
+		return TEST_FAIL;
+	}
+
+	ica_xof_ctx_free(ctx);
+	ica_xof_ctx_free(ctx2);
+	return TEST_SUCC;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t msglens[] = { 0, 1, 135, 136, 168, 169, MSGLEN };
+	ica_xof_ctx_t *ctx;
+	unsigned int i;
+
+	set_verbosity(argc, argv);
+
+	if (ica_xof_ctx_new(SHA3_256, &ctx) != EINVAL) {
+		printf("ica_xof_ctx_new accepted a fixed length hash\n");
+		return TEST_FAIL;
+	}
+	ica_xof_ctx_free(NULL);
+
+	srand(time(NULL));
+	for (i = 0; i < MSGLEN; i++)
+		msg[i] = rand();
+
+	for (i = 0; i < sizeof(msglens) / sizeof(msglens[0]); i++) {
+		if (run_alg(SHAKE128, msglens[i]) ||
+		    run_alg(SHAKE256, msglens[i]))
+			return TEST_FAIL;
+	}
+
+	printf("All SHAKE XOF context tests passed.\n");
+	return TEST_SUCC;
+}